@@ -1,15 +1,37 @@
 
 cbuffer CBCommon : register(b0)
 {
-    float3 diffuse;
-    float specular;
-    float specularHardness;
+    float3 directionalLight;
 };
 
 cbuffer CBStatic : register(b1)
 {
     float4x4 matView;
     float4x4 matProj;
-    float3 directionalLight;
 };
 
+// Root constants, see DrawConstants in D3D12Core.h
+cbuffer DrawConstants : register(b2)
+{
+    uint textureIndex;
+    uint objectIndex;
+};
+
+// Per instance constants for the whole frame. An instanced draw's instances are consecutive, starting at objectIndex
+struct ObjectConstants
+{
+    float4x4 matWorld;
+    uint materialIndex;
+};
+
+StructuredBuffer<ObjectConstants> Objects : register(t1);
+
+// Every material, indexed by ObjectConstants::materialIndex
+struct MaterialConstants
+{
+    float3 diffuse;
+    float specular;
+    float specularHardness;
+};
+
+StructuredBuffer<MaterialConstants> Materials : register(t2);
@@ -2,7 +2,11 @@
 #include "Lighting.h"
 
 SamplerState Sampler;
+#if USE_BINDLESS_TEXTURES
+Texture2D Textures[] : register(t0, space1);
+#else
 Texture2D Texture;
+#endif
 
 
 struct VS_IN
@@ -20,6 +24,7 @@ struct VS_OUT
 	float3 normal : NORMAL;
 	float4 viewPos : TEXCOORD0;
 	float2 uv : TEXCOORD1;
+	nointerpolation uint objectIndex : OBJECTINDEX;
 };
 
 struct PS_OUT
@@ -27,13 +32,17 @@ struct PS_OUT
 	float4 col : SV_TARGET;
 };
 
-VS_OUT VSMain(VS_IN I)
+VS_OUT VSMain(VS_IN I, uint instanceID : SV_InstanceID)
 {
 	VS_OUT O;
+	O.objectIndex = objectIndex + instanceID;
+	float4x4 matWorld = Objects[O.objectIndex].matWorld;
+
 	O.col = I.col;
-	O.viewPos = mul(matView, float4(I.pos, 1.0f));
+	O.viewPos = mul(matView, mul(matWorld, float4(I.pos, 1.0f)));
 	O.hpos = mul(matProj, O.viewPos);
-	O.normal = mul(matView, float4(I.normal, 0.0f)).xyz;
+	// Assumes no non-uniform scale, otherwise this would need the inverse transpose
+	O.normal = mul(matView, mul(matWorld, float4(I.normal, 0.0f))).xyz;
 	O.uv = I.uv;
 	return O;
 }
@@ -46,9 +55,16 @@ PS_OUT PSMain(VS_OUT I)
 	float3 n = normalize(I.normal);
 	float3 l = directionalLight;
 
+#if USE_BINDLESS_TEXTURES
+	// Same index for the whole draw, so no need for NonUniformResourceIndex
+	float3 albedoColour = Textures[textureIndex].Sample(Sampler, I.uv).rgb;
+#else
 	float3 albedoColour = Texture.Sample(Sampler, I.uv).rgb;
+#endif
+
+	MaterialConstants material = Materials[Objects[I.objectIndex].materialIndex];
 
 	O.col.a = 1.0f;
-	O.col.rgb = albedoColour * diffuse * Lambertian(n, l) + specular * BlinnPhongSpecular(l, v, n, specularHardness);
+	O.col.rgb = albedoColour * material.diffuse * Lambertian(n, l) + material.specular * BlinnPhongSpecular(l, v, n, material.specularHardness);
 	return O;
 }
@@ -4,6 +4,7 @@
 #include "Scene.h"
 #include "Shell.h"
 
+#include "Generic/JobSystem.h"
 #include "Renderer/Renderer.h"
 
 #include <windows.h>
@@ -11,6 +12,7 @@
 
 #define CAMERA_MOVE_SPEED 10.0f
 
+JobSystem* g_pJobSystem;
 Renderer* g_pRenderer;
 Scene* s_pCurrScene;
 Camera camera;
@@ -23,6 +25,8 @@ std::chrono::time_point<HighResClock> currentFrameTime;
 
 void EngineInitialise()
 {
+    // This thread becomes worker 0, and one more worker is kept for the render thread
+    g_pJobSystem = new JobSystem(0, 1);
     g_pRenderer = new Renderer();
     startTime = HighResClock::now();
     currentFrameTime = startTime;
@@ -44,13 +48,13 @@ void EngineDispose()
 
     delete s_pCurrScene;
     delete g_pRenderer;
+    delete g_pJobSystem;
 }
 
 void EngineAssetsLoad()
 {
-    g_pRenderer->UploadBegin();
     s_pCurrScene = Scene::Load("../Data/Models/CursedCornell.obj");
-    g_pRenderer->UploadEnd();
+    g_pRenderer->UploadFlush();
 }
 
 void EngineLog(const char* message)
@@ -2,6 +2,8 @@
 
 #include "Renderer/Renderer.h"
 
+class JobSystem;
+
 void EngineInitialise();
 
 void EngineAssetsLoad();
@@ -16,4 +18,5 @@ void EngineIdle();
 
 float EngineGetCurrTime();
 
+extern JobSystem* g_pJobSystem;
 extern Renderer* g_pRenderer;
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Buddy allocator over [0, size), only hands out offsets so it can sit in front of any kind of memory. Both size and minBlockSize must be
+// powers of two. Every block is aligned to its own size, so asking for at least as much as the alignment you need is enough. Not thread safe!
+class BuddyAllocator
+{
+public:
+    BuddyAllocator(uint64 size, uint64 minBlockSize) :
+        m_size(size),
+        m_minBlockSize(minBlockSize),
+        m_allocatedSize(0)
+    {
+        ASSERT(size >= minBlockSize && minBlockSize > 0);
+        ASSERT((size & (size - 1)) == 0 && (minBlockSize & (minBlockSize - 1)) == 0);
+
+        // Level 0 is the whole range, each level down halves the block size until we hit minBlockSize
+        uint32 numLevels = 1;
+        while ((size >> (numLevels - 1)) > minBlockSize)
+        {
+            numLevels++;
+        }
+        m_freeBlocks.resize(numLevels);
+        m_freeBlocks[0].insert(0);
+    }
+
+    bool Allocate(uint64 size, uint64& offsetOut)
+    {
+        if (size == 0 || size > m_size)
+        {
+            return false;
+        }
+
+        uint32 level = GetLevel(size);
+
+        // Find the nearest level up with a free block, then split it down to the size we want
+        int32 freeLevel = (int32)level;
+        while (freeLevel >= 0 && m_freeBlocks[freeLevel].empty())
+        {
+            freeLevel--;
+        }
+        if (freeLevel < 0)
+        {
+            return false;
+        }
+
+        uint64 offset = *m_freeBlocks[freeLevel].begin();
+        m_freeBlocks[freeLevel].erase(m_freeBlocks[freeLevel].begin());
+        for (uint32 i = (uint32)freeLevel + 1; i <= level; i++)
+        {
+            // Keep the lower half, the upper half is its buddy
+            m_freeBlocks[i].insert(offset + GetBlockSize(i));
+        }
+
+        m_allocatedLevels[offset] = level;
+        m_allocatedSize += GetBlockSize(level);
+        offsetOut = offset;
+        return true;
+    }
+
+    void Free(uint64 offset)
+    {
+        auto it = m_allocatedLevels.find(offset);
+        ASSERT(it != m_allocatedLevels.end());
+
+        uint32 level = it->second;
+        m_allocatedLevels.erase(it);
+        m_allocatedSize -= GetBlockSize(level);
+
+        // Merge with our buddy for as long as it's free
+        while (level > 0)
+        {
+            uint64 buddy = offset ^ GetBlockSize(level);
+            auto buddyIt = m_freeBlocks[level].find(buddy);
+            if (buddyIt == m_freeBlocks[level].end())
+            {
+                break;
+            }
+
+            m_freeBlocks[level].erase(buddyIt);
+            offset = std::min(offset, buddy);
+            level--;
+        }
+
+        m_freeBlocks[level].insert(offset);
+    }
+
+    // Size of the block an allocation of this size actually uses
+    uint64 GetAllocationSize(uint64 size)
+    {
+        return GetBlockSize(GetLevel(size));
+    }
+
+    uint64 GetSize()
+    {
+        return m_size;
+    }
+
+    // In whole blocks, so includes the padding up to a power of two
+    uint64 GetAllocatedSize()
+    {
+        return m_allocatedSize;
+    }
+
+    uint64 GetLargestFreeBlock()
+    {
+        for (uint32 i = 0; i < m_freeBlocks.size(); i++)
+        {
+            if (!m_freeBlocks[i].empty())
+            {
+                return GetBlockSize(i);
+            }
+        }
+        return 0;
+    }
+
+    // 1 - largest free block / total free, 0 when all the free space is in one block
+    float GetFragmentation()
+    {
+        uint64 freeSize = m_size - m_allocatedSize;
+        return freeSize > 0 ? 1.0f - (float)GetLargestFreeBlock() / (float)freeSize : 0.0f;
+    }
+
+    uint32 GetAllocationCount()
+    {
+        return (uint32)m_allocatedLevels.size();
+    }
+
+    bool IsEmpty()
+    {
+        return m_allocatedLevels.empty();
+    }
+
+private:
+    uint64 GetBlockSize(uint32 level)
+    {
+        return m_size >> level;
+    }
+
+    // Deepest level with blocks big enough for size
+    uint32 GetLevel(uint64 size)
+    {
+        uint32 level = (uint32)m_freeBlocks.size() - 1;
+        while (GetBlockSize(level) < size)
+        {
+            level--;
+        }
+        return level;
+    }
+
+    uint64 m_size;
+    uint64 m_minBlockSize;
+    uint64 m_allocatedSize;
+
+    // Offsets of the free blocks at each level, ordered so we always split the lowest one and keep the top of the range free for longer
+    std::vector<std::set<uint64>> m_freeBlocks;
+    std::unordered_map<uint64, uint32> m_allocatedLevels;
+};
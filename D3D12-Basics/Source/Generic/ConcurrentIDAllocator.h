@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+// Thread safe, lock free version of IDAllocator for a fixed number of IDs (same rules on the enum). Freed IDs go on a Treiber stack
+// linked through an array indexed by ID, with a tag in the head bumped by every push and pop so a thread holding a stale head can't
+// succeed in swapping it (ABA). IDs are handed out from initialID upwards, so initialID + maxIDs must fit in the enum. Once all maxIDs
+// are in use AllocID returns -1, which every ID enum keeps for its invalid value.
+template <typename IDEnumType>
+class ConcurrentIDAllocator
+{
+public:
+    ConcurrentIDAllocator(IDEnumType initialID, uint32 maxIDs) :
+        m_initialID((int32)initialID),
+        m_maxIDs(maxIDs),
+        m_nextID(0),
+        m_freeHead(PackHead(0, FreeListEnd))
+    {
+        m_pNext = new std::atomic<uint32>[maxIDs];
+    }
+
+    ~ConcurrentIDAllocator()
+    {
+        delete[] m_pNext;
+    }
+
+    IDEnumType AllocID()
+    {
+        uint64 head = m_freeHead.load(std::memory_order_acquire);
+        uint32 nextID = m_nextID.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (GetIndex(head) != FreeListEnd)
+            {
+                // If another thread pops this index first the tag will have moved on and the exchange fails, so reading a stale next is fine
+                uint32 index = GetIndex(head);
+                uint32 next = m_pNext[index].load(std::memory_order_relaxed);
+                if (m_freeHead.compare_exchange_weak(head, PackHead(GetTag(head) + 1, next), std::memory_order_acquire, std::memory_order_acquire))
+                {
+                    return (IDEnumType)(m_initialID + (int32)index);
+                }
+            }
+            else if (nextID < m_maxIDs)
+            {
+                // Only bumped while there's room, so it never runs past maxIDs however many threads are here
+                if (m_nextID.compare_exchange_weak(nextID, nextID + 1, std::memory_order_relaxed))
+                {
+                    return (IDEnumType)(m_initialID + (int32)nextID);
+                }
+            }
+            else
+            {
+                // Something may have been freed since we last looked
+                uint64 latestHead = m_freeHead.load(std::memory_order_acquire);
+                if (GetIndex(latestHead) == FreeListEnd)
+                {
+                    return (IDEnumType)-1;
+                }
+                head = latestHead;
+            }
+        }
+    }
+
+    void FreeID(IDEnumType id)
+    {
+        uint32 index = (uint32)((int32)id - m_initialID);
+        ASSERT(index < m_maxIDs);
+
+        uint64 head = m_freeHead.load(std::memory_order_relaxed);
+        do
+        {
+            m_pNext[index].store(GetIndex(head), std::memory_order_relaxed);
+        }
+        while (!m_freeHead.compare_exchange_weak(head, PackHead(GetTag(head) + 1, index), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+private:
+    static const uint32 FreeListEnd = 0xFFFFFFFF;
+
+    static uint64 PackHead(uint32 tag, uint32 index)
+    {
+        return ((uint64)tag << 32) | index;
+    }
+
+    static uint32 GetTag(uint64 head)
+    {
+        return (uint32)(head >> 32);
+    }
+
+    static uint32 GetIndex(uint64 head)
+    {
+        return (uint32)head;
+    }
+
+    int32 m_initialID;
+    uint32 m_maxIDs;
+
+    // Next free index below each free one, only meaningful while the ID is on the free list
+    std::atomic<uint32>* m_pNext;
+
+    std::atomic<uint32> m_nextID;
+    std::atomic<uint64> m_freeHead;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Generic/ConcurrentIDAllocator.h"
+#include "Generic/SlotMap.h"
+
+#include <atomic>
+
+// Thread safe, lock free version of SlotMap for a fixed number of values, with handles packed the same way. Values sit in one array
+// indexed by slot which is allocated up front, so they never move and a Get on one thread is never invalidated by an Insert or Remove
+// on another. Slots come from a ConcurrentIDAllocator, and once they're all in use Insert returns an invalid (-1) handle.
+//
+// Only the slots are synchronised, not the values. Handles have to be passed to other threads in a way that publishes the value (a job
+// finishing, a lock...), and anything written to a value after it's inserted needs synchronising by whoever writes it.
+template <typename HandleType, typename T>
+class ConcurrentSlotMap
+{
+public:
+    static_assert(sizeof(HandleType) == sizeof(int32), "ConcurrentSlotMap handles must be 32 bit");
+
+    ConcurrentSlotMap(uint32 capacity) :
+        m_capacity(capacity),
+        m_slotAllocator(0, capacity)
+    {
+        ASSERT(capacity > 0 && capacity <= SLOT_MAP_INDEX_MASK);
+        m_pValues = new T[capacity];
+        m_pStates = new std::atomic<uint32>[capacity];
+        for (uint32 i = 0; i < capacity; i++)
+        {
+            m_pStates[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~ConcurrentSlotMap()
+    {
+        delete[] m_pStates;
+        delete[] m_pValues;
+    }
+
+    HandleType Insert(const T& value)
+    {
+        int32 index = m_slotAllocator.AllocID();
+        if (index < 0)
+        {
+            return (HandleType)-1;
+        }
+
+        // Nothing else can touch the slot until it's marked occupied, and the release publishes the value with it
+        m_pValues[index] = value;
+        uint32 generation = m_pStates[index].load(std::memory_order_relaxed) & SLOT_MAP_GENERATION_MASK;
+        m_pStates[index].store(generation | OccupiedBit, std::memory_order_release);
+
+        return MakeHandle((uint32)index, generation);
+    }
+
+    void Remove(HandleType handle)
+    {
+        ASSERT(Contains(handle));
+        uint32 index = SlotMap<HandleType, T>::GetIndex(handle);
+
+        m_pValues[index] = T();
+        uint32 generation = SlotMap<HandleType, T>::GetGeneration(handle);
+        m_pStates[index].store((generation + 1) & SLOT_MAP_GENERATION_MASK, std::memory_order_release);
+        m_slotAllocator.FreeID((int32)index);
+    }
+
+    bool Contains(HandleType handle)
+    {
+        if ((int32)handle < 0)
+        {
+            return false;
+        }
+
+        uint32 index = SlotMap<HandleType, T>::GetIndex(handle);
+        return index < m_capacity &&
+            m_pStates[index].load(std::memory_order_acquire) == (SlotMap<HandleType, T>::GetGeneration(handle) | OccupiedBit);
+    }
+
+    T& Get(HandleType handle)
+    {
+        ASSERT(Contains(handle));
+        return m_pValues[SlotMap<HandleType, T>::GetIndex(handle)];
+    }
+
+    T& operator[](HandleType handle)
+    {
+        return Get(handle);
+    }
+
+    uint32 GetCapacity()
+    {
+        return m_capacity;
+    }
+
+private:
+    // Set in a slot's state while it holds a value, the rest of the state is the slot's generation
+    static const uint32 OccupiedBit = 0x80000000;
+
+    static HandleType MakeHandle(uint32 index, uint32 generation)
+    {
+        return (HandleType)(int32)((generation << SLOT_MAP_INDEX_BITS) | index);
+    }
+
+    uint32 m_capacity;
+    T* m_pValues;
+    std::atomic<uint32>* m_pStates;
+
+    ConcurrentIDAllocator<int32> m_slotAllocator;
+};
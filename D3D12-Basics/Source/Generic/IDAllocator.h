@@ -1,6 +1,9 @@
 #include "SimpleDequeue.h"
 #include <type_traits>
 
+// Freed IDs are kept inline up to this many, so churning a handful of resources doesn't allocate
+#define ID_ALLOCATOR_INLINE_FREE_IDS 16
+
 // Not thread safe! MUST use an enum with an explicitly defined type!
 template <typename IDEnumType>
 class IDAllocator
@@ -11,7 +14,7 @@ public:
 
     IDEnumType AllocID()
     {
-        if (m_unusedIDs.IsEmpty())
+        if (!m_unusedIDs.IsEmpty())
         {
             return m_unusedIDs.PopBack();
         }
@@ -29,6 +32,6 @@ public:
     }
 
 private:
-    SimpleDequeue<IDEnumType> m_unusedIDs;
+    SimpleDequeue<IDEnumType, ID_ALLOCATOR_INLINE_FREE_IDS> m_unusedIDs;
     IDEnumType m_nextID;
 };
\ No newline at end of file
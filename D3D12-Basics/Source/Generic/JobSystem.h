@@ -0,0 +1,368 @@
+#pragma once
+
+#include "Generic/WorkStealingDeque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// Bytes of data copied into each job, enough for a few pointers and a range
+#define JOB_DATA_SIZE 40
+// Jobs each worker keeps for reuse, must be a power of two. Jobs are heap allocated instead while the pool's next one is in use.
+#define JOB_POOL_SIZE 4096
+// Failed attempts to find work before a worker goes to sleep
+#define JOB_SPINS_BEFORE_SLEEP 64
+
+// How many jobs haven't finished yet. Run adds one for each job it's given, and each job takes one off when it's done. A job which
+// depends on others waits on their counter, which runs other jobs in the meantime rather than blocking the worker.
+struct JobCounter
+{
+    std::atomic<int32> count{ 0 };
+
+    bool IsDone()
+    {
+        return count.load(std::memory_order_acquire) == 0;
+    }
+};
+
+typedef void (*JobFunction)(const void* pData);
+
+// Work stealing job scheduler. Every worker has its own deque of jobs, pushes the jobs it creates onto it and pops them back off,
+// and steals from the other workers' deques when it runs out. Idle workers sleep until more jobs are queued.
+//
+// The thread which creates the job system is worker 0 and only runs jobs while it's in Wait or ParallelFor, as do any threads which
+// attach themselves later. Jobs can only be run from worker threads, and only one job system can exist at a time since the worker
+// index is thread local.
+class JobSystem
+{
+public:
+    // numWorkers includes the creating thread, 0 means one per hardware thread. numAttachableThreads reserves workers for threads
+    // the caller creates itself, see AttachThread.
+    JobSystem(
+        uint32 numWorkers = 0,
+        uint32 numAttachableThreads = 0) :
+        m_fQuit(false),
+        m_numQueuedJobs(0),
+        m_numSleeping(0)
+    {
+        if (numWorkers == 0)
+        {
+            numWorkers = std::thread::hardware_concurrency();
+        }
+        m_numWorkerThreads = numWorkers > 0 ? numWorkers : 1;
+        m_numWorkers = m_numWorkerThreads + numAttachableThreads;
+        m_nextAttachedWorker.store(m_numWorkerThreads);
+
+        m_pWorkers = new Worker[m_numWorkers];
+
+        WorkerIndex() = 0;
+        for (uint32 i = 1; i < m_numWorkerThreads; i++)
+        {
+            m_pWorkers[i].thread = std::thread(&JobSystem::WorkerMain, this, i);
+        }
+    }
+
+    // Anything still queued is dropped, so wait on whatever matters first
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_fQuit.store(true);
+        }
+        m_wakeCondition.notify_all();
+
+        for (uint32 i = 1; i < m_numWorkerThreads; i++)
+        {
+            m_pWorkers[i].thread.join();
+        }
+
+        delete[] m_pWorkers;
+        WorkerIndex() = InvalidWorker;
+    }
+
+    // Queues pFunction to be called with a copy of dataSize bytes of pData, so pData can go out of scope once this returns.
+    // pCounter can be null if nothing waits on the job.
+    void Run(
+        JobFunction pFunction,
+        const void* pData,
+        uint32 dataSize,
+        JobCounter* pCounter)
+    {
+        ASSERT(dataSize <= JOB_DATA_SIZE);
+
+        uint32 workerIndex = GetWorkerIndex();
+        Worker& worker = m_pWorkers[workerIndex];
+
+        // Only reuse a job once it's finished, which it almost always will be by the time the pool wraps around. Waiting for it
+        // isn't an option, it may be further up this thread's stack.
+        Job* pJob = &worker.pJobPool[worker.nextJob++ & (JOB_POOL_SIZE - 1)];
+        if (pJob->fInUse.load(std::memory_order_acquire))
+        {
+            pJob = new Job();
+            pJob->fHeapAllocated = true;
+        }
+
+        pJob->fInUse.store(true, std::memory_order_relaxed);
+        pJob->pFunction = pFunction;
+        pJob->pCounter = pCounter;
+        memcpy(pJob->data, pData, dataSize);
+
+        if (pCounter)
+        {
+            pCounter->count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Counted before it's pushed, so the count can run ahead of the deques but never behind them
+        m_numQueuedJobs.fetch_add(1);
+        worker.deque.Push(pJob);
+
+        if (m_numSleeping.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wakeCondition.notify_one();
+        }
+    }
+
+    // Runs jobs on this thread until every job counted by pCounter has finished
+    void Wait(
+        JobCounter* pCounter)
+    {
+        uint32 workerIndex = GetWorkerIndex();
+        while (!pCounter->IsDone())
+        {
+            RunPendingJob(workerIndex);
+        }
+    }
+
+    // Calls function(first, end) for sub ranges of [begin, end) no longer than grainSize across every worker, and returns once
+    // they've all finished. Ranges are halved as they're run, so the first thing thieves steal is the biggest piece left.
+    template <typename Function>
+    void ParallelFor(
+        uint32 begin,
+        uint32 end,
+        uint32 grainSize,
+        const Function& function)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        JobCounter counter;
+
+        ParallelForData<Function> data;
+        data.pJobSystem = this;
+        data.pFunction = &function;
+        data.pCounter = &counter;
+        data.begin = begin;
+        data.end = end;
+        data.grainSize = grainSize > 0 ? grainSize : 1;
+
+        Run(&JobSystem::ParallelForJob<Function>, &data, sizeof(data), &counter);
+        Wait(&counter);
+    }
+
+    // Makes the calling thread one of the workers reserved by the constructor, so it can run and wait on jobs. Like worker 0 it only
+    // runs jobs while it's waiting, and it has to be done with the job system before the job system is destroyed.
+    void AttachThread(
+        void)
+    {
+        ASSERT(WorkerIndex() == InvalidWorker);
+
+        uint32 workerIndex = m_nextAttachedWorker.fetch_add(1);
+        ASSERT(workerIndex < m_numWorkers);
+        WorkerIndex() = workerIndex;
+    }
+
+    uint32 GetNumWorkers()
+    {
+        return m_numWorkers;
+    }
+
+    // Which worker the calling thread is, for indexing per worker data
+    uint32 GetWorkerIndex()
+    {
+        uint32 workerIndex = WorkerIndex();
+        ASSERT(workerIndex < m_numWorkers);
+        return workerIndex;
+    }
+
+private:
+    static const uint32 InvalidWorker = 0xFFFFFFFF;
+
+    struct Job
+    {
+        JobFunction pFunction = nullptr;
+        JobCounter* pCounter = nullptr;
+        std::atomic<bool> fInUse{ false };
+        bool fHeapAllocated = false;
+        alignas(8) char data[JOB_DATA_SIZE];
+    };
+
+    struct Worker
+    {
+        Worker()
+        {
+            pJobPool = new Job[JOB_POOL_SIZE];
+        }
+
+        ~Worker()
+        {
+            delete[] pJobPool;
+        }
+
+        WorkStealingDeque<Job*> deque;
+
+        // Only touched by the worker itself
+        Job* pJobPool;
+        uint32 nextJob = 0;
+        uint32 nextVictim = 0;
+
+        std::thread thread;
+    };
+
+    template <typename Function>
+    struct ParallelForData
+    {
+        JobSystem* pJobSystem;
+        const Function* pFunction;
+        JobCounter* pCounter;
+        uint32 begin;
+        uint32 end;
+        uint32 grainSize;
+    };
+
+    template <typename Function>
+    static void ParallelForJob(
+        const void* pData)
+    {
+        static_assert(sizeof(ParallelForData<Function>) <= JOB_DATA_SIZE, "ParallelFor data doesn't fit in a job");
+
+        // Hand the top half of the range off until what's left is small enough to run here
+        ParallelForData<Function> data = *(const ParallelForData<Function>*)pData;
+        while (data.end - data.begin > data.grainSize)
+        {
+            ParallelForData<Function> upper = data;
+            upper.begin = data.begin + (data.end - data.begin) / 2;
+            data.pJobSystem->Run(&JobSystem::ParallelForJob<Function>, &upper, sizeof(upper), data.pCounter);
+            data.end = upper.begin;
+        }
+
+        (*data.pFunction)(data.begin, data.end);
+    }
+
+    static uint32& WorkerIndex()
+    {
+        static thread_local uint32 workerIndex = InvalidWorker;
+        return workerIndex;
+    }
+
+    // Own deque first, then steal, starting from a different victim each time so thieves spread out
+    bool FindJob(
+        uint32 workerIndex,
+        Job*& pJobOut)
+    {
+        Worker& worker = m_pWorkers[workerIndex];
+        if (worker.deque.Pop(pJobOut))
+        {
+            m_numQueuedJobs.fetch_sub(1);
+            return true;
+        }
+
+        for (uint32 i = 0; i < m_numWorkers; i++)
+        {
+            uint32 victim = (worker.nextVictim++) % m_numWorkers;
+            if (victim != workerIndex && m_pWorkers[victim].deque.Steal(pJobOut))
+            {
+                m_numQueuedJobs.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Execute(
+        Job* pJob)
+    {
+        pJob->pFunction(pJob->data);
+
+        // Read before the job's released, the worker that owns it may reuse it straight away
+        JobCounter* pCounter = pJob->pCounter;
+        if (pJob->fHeapAllocated)
+        {
+            delete pJob;
+        }
+        else
+        {
+            pJob->fInUse.store(false, std::memory_order_release);
+        }
+
+        if (pCounter)
+        {
+            pCounter->count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Runs one job if there is one, otherwise gives up the rest of the time slice
+    void RunPendingJob(
+        uint32 workerIndex)
+    {
+        Job* pJob;
+        if (FindJob(workerIndex, pJob))
+        {
+            Execute(pJob);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void WorkerMain(
+        uint32 workerIndex)
+    {
+        WorkerIndex() = workerIndex;
+
+        uint32 idleSpins = 0;
+        while (!m_fQuit.load(std::memory_order_relaxed))
+        {
+            Job* pJob;
+            if (FindJob(workerIndex, pJob))
+            {
+                Execute(pJob);
+                idleSpins = 0;
+                continue;
+            }
+
+            if (++idleSpins < JOB_SPINS_BEFORE_SLEEP)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            idleSpins = 0;
+
+            // Registering as asleep before checking for jobs, and Run counting jobs before checking for sleepers, means at least one
+            // of them sees the other so a job can't be queued without waking anyone
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_numSleeping.fetch_add(1);
+            m_wakeCondition.wait(lock, [this]() { return m_numQueuedJobs.load() > 0 || m_fQuit.load(); });
+            m_numSleeping.fetch_sub(1);
+        }
+    }
+
+    // Workers past m_numWorkerThreads are reserved for attached threads
+    uint32 m_numWorkers;
+    uint32 m_numWorkerThreads;
+    std::atomic<uint32> m_nextAttachedWorker;
+    Worker* m_pWorkers;
+
+    std::atomic<bool> m_fQuit;
+    std::atomic<int32> m_numQueuedJobs;
+    std::atomic<int32> m_numSleeping;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <map>
+
+// Hands out ranges of [0, size) in whatever unit the caller wants (bytes, vertices, indices...). Doesn't touch any memory itself.
+// Best fit from a free list which is coalesced on free, so adjacent free ranges never sit next to each other. Not thread safe!
+class OffsetAllocator
+{
+public:
+    OffsetAllocator(uint32 size) :
+        m_size(size),
+        m_freeSize(size)
+    {
+        if (size > 0)
+        {
+            InsertFreeRange(0, size);
+        }
+    }
+
+    bool Allocate(uint32 size, uint32& offsetOut)
+    {
+        ASSERT(size > 0);
+
+        // Smallest free range that still fits
+        auto it = m_freeRangesBySize.lower_bound(size);
+        if (it == m_freeRangesBySize.end())
+        {
+            return false;
+        }
+
+        uint32 rangeSize = it->first;
+        uint32 rangeOffset = it->second;
+        m_freeRangesByOffset.erase(rangeOffset);
+        m_freeRangesBySize.erase(it);
+
+        if (rangeSize > size)
+        {
+            InsertFreeRange(rangeOffset + size, rangeSize - size);
+        }
+
+        m_freeSize -= size;
+        offsetOut = rangeOffset;
+        return true;
+    }
+
+    void Free(uint32 offset, uint32 size)
+    {
+        ASSERT(size > 0 && offset + size <= m_size);
+        m_freeSize += size;
+
+        auto next = m_freeRangesByOffset.lower_bound(offset);
+        ASSERT(next == m_freeRangesByOffset.end() || next->first >= offset + size);
+
+        // Merge with the range after this one
+        if (next != m_freeRangesByOffset.end() && next->first == offset + size)
+        {
+            size += next->second->first;
+            m_freeRangesBySize.erase(next->second);
+            next = m_freeRangesByOffset.erase(next);
+        }
+
+        // Merge with the range before this one
+        if (next != m_freeRangesByOffset.begin())
+        {
+            auto prev = std::prev(next);
+            uint32 prevSize = prev->second->first;
+            ASSERT(prev->first + prevSize <= offset);
+            if (prev->first + prevSize == offset)
+            {
+                offset = prev->first;
+                size += prevSize;
+                m_freeRangesBySize.erase(prev->second);
+                m_freeRangesByOffset.erase(prev);
+            }
+        }
+
+        InsertFreeRange(offset, size);
+    }
+
+    uint32 GetSize()
+    {
+        return m_size;
+    }
+
+    uint32 GetFreeSize()
+    {
+        return m_freeSize;
+    }
+
+    uint32 GetUsedSize()
+    {
+        return m_size - m_freeSize;
+    }
+
+    uint32 GetLargestFreeRange()
+    {
+        return m_freeRangesBySize.empty() ? 0 : m_freeRangesBySize.rbegin()->first;
+    }
+
+    bool IsEmpty()
+    {
+        return m_freeSize == m_size;
+    }
+
+private:
+    typedef std::multimap<uint32, uint32> FreeRangesBySize;
+
+    void InsertFreeRange(uint32 offset, uint32 size)
+    {
+        FreeRangesBySize::iterator it = m_freeRangesBySize.emplace(size, offset);
+        m_freeRangesByOffset.emplace(offset, it);
+    }
+
+    uint32 m_size;
+    uint32 m_freeSize;
+
+    // Size -> offset for best fit lookups, and offset -> the same entry for finding neighbours to merge with
+    FreeRangesBySize m_freeRangesBySize;
+    std::map<uint32, FreeRangesBySize::iterator> m_freeRangesByOffset;
+};
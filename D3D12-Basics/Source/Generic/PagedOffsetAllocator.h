@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Generic/OffsetAllocator.h"
+
+#include <algorithm>
+#include <vector>
+
+// OffsetAllocators in pages which are added as they're needed, so there's no fixed limit. Ranges bigger than a page get a page of
+// their own, and empty pages other than the first are released. Only hands out (page, offset) pairs, so the caller keeps whatever
+// memory backs each page alongside it, indexed by page. Not thread safe!
+class PagedOffsetAllocator
+{
+public:
+    PagedOffsetAllocator(uint32 pageSize) :
+        m_pageSize(pageSize)
+    {
+        ASSERT(pageSize > 0);
+        CreatePage(pageSize);
+    }
+
+    ~PagedOffsetAllocator()
+    {
+        for (OffsetAllocator* pPage : m_pages)
+        {
+            delete pPage;
+        }
+    }
+
+    // Returns true if a new page had to be created for the allocation, which the caller then has to back with GetPageSize(pageOut)
+    // units of memory
+    bool Allocate(uint32 count, int32& pageOut, uint32& offsetOut)
+    {
+        ASSERT(count > 0);
+
+        for (int32 i = 0; i < (int32)m_pages.size(); i++)
+        {
+            if (m_pages[i] && m_pages[i]->Allocate(count, offsetOut))
+            {
+                pageOut = i;
+                return false;
+            }
+        }
+
+        pageOut = CreatePage(std::max(count, m_pageSize));
+        bool fAllocated = m_pages[pageOut]->Allocate(count, offsetOut);
+        ASSERT(fAllocated);
+        (void)fAllocated;
+        return true;
+    }
+
+    // Returns true if the page was released, after which the caller should release its memory too
+    bool Free(int32 page, uint32 offset, uint32 count)
+    {
+        OffsetAllocator* pPage = m_pages[page];
+        ASSERT(pPage);
+        pPage->Free(offset, count);
+
+        // Hang on to the first page so streaming a few allocations in and out doesn't keep creating and releasing pages
+        if (page != 0 && pPage->IsEmpty())
+        {
+            delete pPage;
+            m_pages[page] = nullptr;
+            return true;
+        }
+        return false;
+    }
+
+    uint32 GetPageSize(int32 page)
+    {
+        return m_pages[page]->GetSize();
+    }
+
+    // Pages which exist, and the units allocated and free across them
+    void GetStats(uint32& numPagesOut, uint32& usedOut, uint32& freeOut)
+    {
+        numPagesOut = 0;
+        usedOut = 0;
+        freeOut = 0;
+        for (OffsetAllocator* pPage : m_pages)
+        {
+            if (pPage)
+            {
+                numPagesOut++;
+                usedOut += pPage->GetUsedSize();
+                freeOut += pPage->GetFreeSize();
+            }
+        }
+    }
+
+private:
+    int32 CreatePage(uint32 size)
+    {
+        OffsetAllocator* pPage = new OffsetAllocator(size);
+
+        auto it = std::find(m_pages.begin(), m_pages.end(), nullptr);
+        if (it != m_pages.end())
+        {
+            *it = pPage;
+            return (int32)(it - m_pages.begin());
+        }
+
+        m_pages.push_back(pPage);
+        return (int32)m_pages.size() - 1;
+    }
+
+    uint32 m_pageSize;
+
+    // Released pages leave a nullptr behind to be reused
+    std::vector<OffsetAllocator*> m_pages;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstring>
+#include <utility>
+
+namespace RadixSort
+{
+    // LSD radix sort of 64 bit keys, 8 bits per pass, carrying a 32 bit value along with each key. Stable, so keys which compare equal
+    // keep the order they were added in. Sorts in place, using the temp arrays (at least count long) as the other half of the ping-pong.
+    // Passes where every key has the same digit are skipped, so keys with lots of unused bits cost less.
+    inline void SortKeyValues(
+        uint64* pKeys,
+        uint32* pValues,
+        uint64* pTempKeys,
+        uint32* pTempValues,
+        uint32 count)
+    {
+        uint64* pSrcKeys = pKeys;
+        uint32* pSrcValues = pValues;
+        uint64* pDstKeys = pTempKeys;
+        uint32* pDstValues = pTempValues;
+
+        // Count every digit in one go, so we know up front which passes can be skipped
+        uint32 histograms[8][256] = {};
+        for (uint32 i = 0; i < count; i++)
+        {
+            uint64 key = pKeys[i];
+            for (uint32 pass = 0; pass < 8; pass++)
+            {
+                histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        for (uint32 pass = 0; pass < 8; pass++)
+        {
+            uint32* histogram = histograms[pass];
+            uint32 shift = pass * 8;
+
+            if (count == 0 || histogram[(pSrcKeys[0] >> shift) & 0xFF] == count)
+            {
+                continue;
+            }
+
+            // Histogram -> starting offset of each digit
+            uint32 offset = 0;
+            for (uint32 digit = 0; digit < 256; digit++)
+            {
+                uint32 digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+
+            for (uint32 i = 0; i < count; i++)
+            {
+                uint32 dst = histogram[(pSrcKeys[i] >> shift) & 0xFF]++;
+                pDstKeys[dst] = pSrcKeys[i];
+                pDstValues[dst] = pSrcValues[i];
+            }
+
+            std::swap(pSrcKeys, pDstKeys);
+            std::swap(pSrcValues, pDstValues);
+        }
+
+        // Odd number of passes leaves the result in the temp arrays
+        if (pSrcKeys != pKeys)
+        {
+            memcpy(pKeys, pSrcKeys, count * sizeof(uint64));
+            memcpy(pValues, pSrcValues, count * sizeof(uint32));
+        }
+    }
+}
@@ -1,109 +1,146 @@
 #pragma once
 
 
-template <typename T>
+// Ring buffer over one contiguous array which doubles when full, so pushing and popping never allocate once it's grown to size.
+// The first InlineCapacity values are stored in the dequeue itself, so small ones never touch the heap at all. T has to be
+// default constructible and copyable.
+template <typename T, uint32 InlineCapacity = 0>
 class SimpleDequeue
 {
 public:
-    ~SimpleDequeue()
+    SimpleDequeue()
+    {
+        m_pData = InlineCapacity > 0 ? m_inline : nullptr;
+        m_capacity = InlineCapacity;
+    }
+
+    SimpleDequeue(const SimpleDequeue& other) :
+        SimpleDequeue()
+    {
+        CopyFrom(other);
+    }
+
+    SimpleDequeue& operator=(const SimpleDequeue& other)
     {
-        while (tail != nullptr)
+        if (this != &other)
         {
-            SimpleDequeueNode* node = tail;
-            tail = tail->prev;
-            delete node;
+            m_head = 0;
+            m_count = 0;
+            CopyFrom(other);
         }
+        return *this;
     }
 
-    void PushFront(T value)
+    ~SimpleDequeue()
     {
-        SimpleDequeueNode* node = new SimpleDequeueNode(value);
-        if (!tail)
+        if (m_pData != m_inline)
         {
-            head = tail = node;
+            delete[] m_pData;
         }
-        else
+    }
+
+    void PushFront(T value)
+    {
+        if (m_count == m_capacity)
         {
-            node->next = head;
-            head->prev = node;
-            head = node;
+            Grow();
         }
+
+        m_head = m_head == 0 ? m_capacity - 1 : m_head - 1;
+        m_pData[m_head] = value;
+        m_count++;
     }
 
     void PushBack(T value)
     {
-        SimpleDequeueNode* node = new SimpleDequeueNode(value);
-        if (!tail)
-        {
-            head = tail = node;
-        }
-        else
+        if (m_count == m_capacity)
         {
-            tail->next = node;
-            node->prev = tail;
-            tail = node;
+            Grow();
         }
+
+        m_pData[Wrap(m_head + m_count)] = value;
+        m_count++;
     }
 
     T PopFront()
     {
-        ASSERT(head && tail);
-
-        SimpleDequeueNode* node = head;
-        if (head == tail)
-        {
-            head = nullptr;
-            tail = nullptr;
-        }
-        else
-        {
-            head = head->next;
-            head->prev = nullptr;
-        }
+        ASSERT(m_count > 0);
 
-        T value = node->value;
-        delete node;
+        T value = m_pData[m_head];
+        m_head = Wrap(m_head + 1);
+        m_count--;
         return value;
     }
 
     T PopBack()
     {
-        ASSERT(head && tail);
+        ASSERT(m_count > 0);
+
+        m_count--;
+        return m_pData[Wrap(m_head + m_count)];
+    }
+
+    bool IsEmpty()
+    {
+        return m_count == 0;
+    }
+
+    uint32 Size()
+    {
+        return m_count;
+    }
+
+private:
+    uint32 Wrap(uint32 index)
+    {
+        return index >= m_capacity ? index - m_capacity : index;
+    }
+
+    void Grow()
+    {
+        Reserve(m_capacity > 0 ? m_capacity * 2 : 16);
+    }
 
-        SimpleDequeueNode* node = tail;
-        if (head == tail)
+    // Unwraps the values to the start of the new array
+    void Reserve(uint32 capacity)
+    {
+        if (capacity <= m_capacity)
         {
-            head = nullptr;
-            tail = nullptr;
+            return;
         }
-        else
+
+        T* pData = new T[capacity];
+        for (uint32 i = 0; i < m_count; i++)
         {
-            tail = tail->prev;
-            tail->next = nullptr;
+            pData[i] = m_pData[Wrap(m_head + i)];
         }
 
-        T value = node->value;
-        delete node;
-        return value;
-    }
+        if (m_pData != m_inline)
+        {
+            delete[] m_pData;
+        }
 
-    bool IsEmpty()
-    {   
-        return head != nullptr;
+        m_pData = pData;
+        m_capacity = capacity;
+        m_head = 0;
     }
 
-private:
-    struct SimpleDequeueNode
+    void CopyFrom(const SimpleDequeue& other)
     {
-        SimpleDequeueNode(T _value) :
-            value(_value) {}
+        Reserve(other.m_count);
+        for (uint32 i = 0; i < other.m_count; i++)
+        {
+            uint32 index = other.m_head + i;
+            m_pData[i] = other.m_pData[index >= other.m_capacity ? index - other.m_capacity : index];
+        }
+        m_count = other.m_count;
+    }
 
-        T value;
-        SimpleDequeueNode* next = nullptr;
-        SimpleDequeueNode* prev = nullptr;
-    };
+    // Points at m_inline until we outgrow it
+    T* m_pData;
+    uint32 m_capacity;
+    uint32 m_head = 0;
+    uint32 m_count = 0;
 
-    SimpleDequeueNode* head = nullptr;
-    SimpleDequeueNode* tail = nullptr;
+    T m_inline[InlineCapacity > 0 ? InlineCapacity : 1];
 };
-
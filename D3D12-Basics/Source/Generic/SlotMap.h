@@ -0,0 +1,148 @@
+#pragma once
+
+#include <type_traits>
+#include <vector>
+
+// Handles are an int32 enum (same rules as IDAllocator) packing a slot index in the low bits and that slot's generation above it.
+// Removing bumps the slot's generation, so stale handles are caught rather than silently finding whatever reused the slot.
+// Handles stay positive so -1 is still free for an invalid value.
+#define SLOT_MAP_INDEX_BITS 20
+#define SLOT_MAP_INDEX_MASK ((1u << SLOT_MAP_INDEX_BITS) - 1)
+#define SLOT_MAP_GENERATION_MASK ((1u << (31 - SLOT_MAP_INDEX_BITS)) - 1)
+
+// Values are kept densely packed in one array so iterating is a linear walk, and a lookup is two array reads. Removal swaps the last
+// value into the hole, so pointers into the map are only good until the next Insert or Remove. Freed slots are reused most recently
+// freed first. Not thread safe!
+template <typename HandleType, typename T>
+class SlotMap
+{
+public:
+    static_assert(sizeof(HandleType) == sizeof(int32), "SlotMap handles must be 32 bit");
+
+    HandleType Insert(const T& value)
+    {
+        uint32 index;
+        if (m_freeSlotHead != SLOT_MAP_INDEX_MASK)
+        {
+            index = m_freeSlotHead;
+            m_freeSlotHead = m_slots[index].next;
+        }
+        else
+        {
+            index = (uint32)m_slots.size();
+            ASSERT(index < SLOT_MAP_INDEX_MASK);
+            m_slots.push_back(Slot());
+        }
+
+        Slot& slot = m_slots[index];
+        slot.dense = (uint32)m_values.size();
+        slot.fOccupied = true;
+
+        m_values.push_back(value);
+        m_denseToSlot.push_back(index);
+
+        return MakeHandle(index, slot.generation);
+    }
+
+    void Remove(HandleType handle)
+    {
+        ASSERT(Contains(handle));
+        uint32 index = GetIndex(handle);
+        Slot& slot = m_slots[index];
+
+        // Move the last value into the hole so the values stay packed
+        uint32 last = (uint32)m_values.size() - 1;
+        if (slot.dense != last)
+        {
+            m_values[slot.dense] = std::move(m_values[last]);
+            m_denseToSlot[slot.dense] = m_denseToSlot[last];
+            m_slots[m_denseToSlot[last]].dense = slot.dense;
+        }
+        m_values.pop_back();
+        m_denseToSlot.pop_back();
+
+        slot.generation = (slot.generation + 1) & SLOT_MAP_GENERATION_MASK;
+        slot.fOccupied = false;
+        slot.next = m_freeSlotHead;
+        m_freeSlotHead = index;
+    }
+
+    bool Contains(HandleType handle)
+    {
+        if ((int32)handle < 0)
+        {
+            return false;
+        }
+
+        uint32 index = GetIndex(handle);
+        return index < m_slots.size() && m_slots[index].fOccupied && m_slots[index].generation == GetGeneration(handle);
+    }
+
+    T& Get(HandleType handle)
+    {
+        ASSERT(Contains(handle));
+        return m_values[m_slots[GetIndex(handle)].dense];
+    }
+
+    T& operator[](HandleType handle)
+    {
+        return Get(handle);
+    }
+
+    uint32 Size()
+    {
+        return (uint32)m_values.size();
+    }
+
+    bool IsEmpty()
+    {
+        return m_values.empty();
+    }
+
+    // Dense iteration over the values, in no particular order
+    typename std::vector<T>::iterator begin()
+    {
+        return m_values.begin();
+    }
+
+    typename std::vector<T>::iterator end()
+    {
+        return m_values.end();
+    }
+
+    // Slots are handed out from 0 upwards and only reused once removed, so this can index other per-slot arrays
+    static uint32 GetIndex(HandleType handle)
+    {
+        return (uint32)handle & SLOT_MAP_INDEX_MASK;
+    }
+
+    static uint32 GetGeneration(HandleType handle)
+    {
+        return ((uint32)handle >> SLOT_MAP_INDEX_BITS) & SLOT_MAP_GENERATION_MASK;
+    }
+
+private:
+    struct Slot
+    {
+        uint32 generation = 0;
+        // Where the value is in m_values while occupied, the next free slot while not
+        union
+        {
+            uint32 dense;
+            uint32 next;
+        };
+        bool fOccupied = false;
+    };
+
+    static HandleType MakeHandle(uint32 index, uint32 generation)
+    {
+        return (HandleType)(int32)((generation << SLOT_MAP_INDEX_BITS) | index);
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<T> m_values;
+    std::vector<uint32> m_denseToSlot;
+
+    // SLOT_MAP_INDEX_MASK is never a valid index so doubles as the end of the free list
+    uint32 m_freeSlotHead = SLOT_MAP_INDEX_MASK;
+};
@@ -29,4 +29,17 @@ namespace Utils
     {
         return val > min ? val < max ? val : max : min;
     }
+
+    // FNV-1a, pass the result back in as the seed to hash several blocks of data together
+    inline uint64 Hash(const void* data, size_t size, uint64 seed = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64 hash = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
 }
\ No newline at end of file
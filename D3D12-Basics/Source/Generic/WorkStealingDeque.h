@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Chase-Lev work stealing deque (with the memory orderings from Le et al. 2013). The owning thread pushes and pops at the bottom,
+// LIFO so it works on what's still hot in cache, and any other thread can steal from the top. T has to be trivially copyable and
+// small enough to be lock free, i.e. a pointer or an index.
+//
+// The ring doubles when it fills up. A thief may still be reading the old ring, so old rings are only freed with the deque.
+template <typename T>
+class WorkStealingDeque
+{
+public:
+    WorkStealingDeque(uint32 initialCapacity = 256) :
+        m_top(0),
+        m_bottom(0)
+    {
+        ASSERT(initialCapacity > 0 && (initialCapacity & (initialCapacity - 1)) == 0);
+        m_pRing.store(new Ring(initialCapacity), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque()
+    {
+        delete m_pRing.load(std::memory_order_relaxed);
+        for (uint32 i = 0; i < (uint32)m_retiredRings.size(); i++)
+        {
+            delete m_retiredRings[i];
+        }
+    }
+
+    // Owner only
+    void Push(T item)
+    {
+        int64 bottom = m_bottom.load(std::memory_order_relaxed);
+        int64 top = m_top.load(std::memory_order_acquire);
+        Ring* pRing = m_pRing.load(std::memory_order_relaxed);
+
+        if (bottom - top > (int64)pRing->mask)
+        {
+            pRing = Grow(pRing, top, bottom);
+        }
+
+        pRing->Put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Takes the most recently pushed item, returns false if there's nothing left.
+    bool Pop(T& itemOut)
+    {
+        int64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Ring* pRing = m_pRing.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Was already empty
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        itemOut = pRing->Get(bottom);
+        if (top == bottom)
+        {
+            // Last item, so race any thieves for it through top
+            bool fWon = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return fWon;
+        }
+        return true;
+    }
+
+    // Any thread. Takes the oldest item, returns false if there was nothing or another thread got to it first.
+    bool Steal(T& itemOut)
+    {
+        int64 top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return false;
+        }
+
+        Ring* pRing = m_pRing.load(std::memory_order_acquire);
+        T item = pRing->Get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        itemOut = item;
+        return true;
+    }
+
+    // Only a hint when other threads are stealing
+    bool IsEmpty()
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring
+    {
+        Ring(uint32 capacity) :
+            mask(capacity - 1)
+        {
+            pItems = new std::atomic<T>[capacity];
+        }
+
+        ~Ring()
+        {
+            delete[] pItems;
+        }
+
+        T Get(int64 index)
+        {
+            return pItems[index & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64 index, T item)
+        {
+            pItems[index & mask].store(item, std::memory_order_relaxed);
+        }
+
+        uint64 mask;
+        std::atomic<T>* pItems;
+    };
+
+    Ring* Grow(
+        Ring* pRing,
+        int64 top,
+        int64 bottom)
+    {
+        Ring* pNewRing = new Ring((uint32)(pRing->mask + 1) * 2);
+        for (int64 i = top; i < bottom; i++)
+        {
+            pNewRing->Put(i, pRing->Get(i));
+        }
+
+        m_retiredRings.push_back(pRing);
+        m_pRing.store(pNewRing, std::memory_order_release);
+        return pNewRing;
+    }
+
+    // Padded onto separate cache lines, thieves hammer top while the owner works at the bottom. Padding rather than alignas since
+    // deques are allocated with new, which doesn't respect over-alignment before C++17.
+    std::atomic<int64> m_top;
+    char m_pad[64];
+    std::atomic<int64> m_bottom;
+    std::atomic<Ring*> m_pRing;
+
+    // Owner only
+    std::vector<Ring*> m_retiredRings;
+};
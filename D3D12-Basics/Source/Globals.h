@@ -6,6 +6,14 @@ struct Globals
     bool fD3DDebug = false;
     bool fGPUValidation = false;
 
+    // Frames the simulation can run ahead of the render thread. More overlaps more work at the cost of latency, 0 renders on the
+    // main thread between updates.
+    uint32 renderPipelineDepth = 1;
+
+    // Logs the average time AdvanceFrame waits on the GPU every FRAME_WAIT_REPORT_INTERVAL frames, along with the swap chain and
+    // frames in flight counts it was measured with
+    bool fMeasureFrameWait = false;
+
     Vector2 totalMouseDelta = {0.0f, 0.0f};
     Vector3 cameraMoveDirection;
 };
@@ -2,11 +2,18 @@
 
 class Texture;
 
+enum MaterialID : int32;
+
 struct Material
 {
     char name[100]; 
 
     Vector3 diffuse;
+    float specular = 0.5f;
+    float specularHardness = 10.0f;
     // Bind just one texture per material for now
     Texture* diffuseTexture = nullptr;
+
+    // Where the renderer keeps this material's constants, see Renderer::MaterialCreate
+    MaterialID id;
 };
\ No newline at end of file
@@ -0,0 +1,716 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+// Half the surface area, which is all SAH needs since it only compares areas
+static float sHalfArea(
+    const float* pMin,
+    const float* pMax)
+{
+    float dx = pMax[0] - pMin[0];
+    float dy = pMax[1] - pMin[1];
+    float dz = pMax[2] - pMin[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static void sObjectBox(
+    const CullingBounds& bounds,
+    uint32 object,
+    float* pMinOut,
+    float* pMaxOut)
+{
+    pMinOut[0] = bounds.boxCentreX[object] - bounds.boxExtentX[object];
+    pMinOut[1] = bounds.boxCentreY[object] - bounds.boxExtentY[object];
+    pMinOut[2] = bounds.boxCentreZ[object] - bounds.boxExtentZ[object];
+    pMaxOut[0] = bounds.boxCentreX[object] + bounds.boxExtentX[object];
+    pMaxOut[1] = bounds.boxCentreY[object] + bounds.boxExtentY[object];
+    pMaxOut[2] = bounds.boxCentreZ[object] + bounds.boxExtentZ[object];
+}
+
+static void sBoxGrow(
+    const float* pMin,
+    const float* pMax,
+    float* pMinInOut,
+    float* pMaxInOut)
+{
+    for (uint32 axis = 0; axis < 3; axis++)
+    {
+        pMinInOut[axis] = std::min(pMinInOut[axis], pMin[axis]);
+        pMaxInOut[axis] = std::max(pMaxInOut[axis], pMax[axis]);
+    }
+}
+
+static void sBoxEmpty(
+    float* pMinOut,
+    float* pMaxOut)
+{
+    for (uint32 axis = 0; axis < 3; axis++)
+    {
+        pMinOut[axis] = FLT_MAX;
+        pMaxOut[axis] = -FLT_MAX;
+    }
+}
+
+static float sCentroid(
+    const CullingBounds& bounds,
+    uint32 object,
+    uint32 axis)
+{
+    return axis == 0 ? bounds.boxCentreX[object] : axis == 1 ? bounds.boxCentreY[object] : bounds.boxCentreZ[object];
+}
+
+// Levels splitting at the median takes to get count objects down to leaves
+static uint32 sMedianSplitLevels(
+    uint32 count)
+{
+    uint32 levels = 0;
+    while (count > BVH_MAX_LEAF_SIZE)
+    {
+        count = (count + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+static uint32 sBinIndex(
+    float centroid,
+    float centroidMin,
+    float binScale)
+{
+    return std::min((uint32)((centroid - centroidMin) * binScale), (uint32)BVH_SAH_BINS - 1);
+}
+
+void BVH::Build(
+    const CullingBounds& bounds)
+{
+    m_nodes.clear();
+    m_objects.resize(bounds.Size());
+    for (uint32 i = 0; i < bounds.Size(); i++)
+    {
+        m_objects[i] = i;
+    }
+
+    if (bounds.Size() == 0)
+    {
+        return;
+    }
+
+    std::vector<BuildNode> buildNodes;
+    buildNodes.reserve(2 * bounds.Size() / BVH_MAX_LEAF_SIZE + 1);
+    int32 root = BuildRecursive(bounds, 0, bounds.Size(), 0, buildNodes);
+
+    // Binary nodes have two children, so collapsing into fours roughly halves the count again
+    m_nodes.reserve(buildNodes.size() / 2 + 1);
+    Collapse(buildNodes, root);
+}
+
+int32 BVH::BuildRecursive(
+    const CullingBounds& bounds,
+    uint32 objectFirst,
+    uint32 objectCount,
+    uint32 depth,
+    std::vector<BuildNode>& buildNodes)
+{
+    int32 index = (int32)buildNodes.size();
+    buildNodes.push_back(BuildNode());
+
+    BuildNode node;
+    node.objectFirst = objectFirst;
+    node.objectCount = objectCount;
+    node.left = -1;
+    node.right = -1;
+    sBoxEmpty(node.boundsMin, node.boundsMax);
+
+    float centroidMin[3];
+    float centroidMax[3];
+    sBoxEmpty(centroidMin, centroidMax);
+    for (uint32 i = objectFirst; i < objectFirst + objectCount; i++)
+    {
+        float objectMin[3];
+        float objectMax[3];
+        sObjectBox(bounds, m_objects[i], objectMin, objectMax);
+        sBoxGrow(objectMin, objectMax, node.boundsMin, node.boundsMax);
+
+        float centroid[3] = { bounds.boxCentreX[m_objects[i]], bounds.boxCentreY[m_objects[i]], bounds.boxCentreZ[m_objects[i]] };
+        sBoxGrow(centroid, centroid, centroidMin, centroidMax);
+    }
+
+    if (objectCount <= BVH_MAX_LEAF_SIZE)
+    {
+        buildNodes[index] = node;
+        return index;
+    }
+
+    // Any split leaves each side with at most objectCount - 1 objects, so as long as this one's still true a median split further
+    // down can always get back within the cap
+    if (depth + sMedianSplitLevels(objectCount) >= BVH_MAX_BUILD_DEPTH)
+    {
+        uint32 axis = 0;
+        for (uint32 i = 1; i < 3; i++)
+        {
+            if (centroidMax[i] - centroidMin[i] > centroidMax[axis] - centroidMin[axis])
+            {
+                axis = i;
+            }
+        }
+
+        uint32 splitObject = objectFirst + objectCount / 2;
+        std::nth_element(&m_objects[objectFirst], &m_objects[splitObject], &m_objects[objectFirst] + objectCount, [&](uint32 a, uint32 b)
+        {
+            return sCentroid(bounds, a, axis) < sCentroid(bounds, b, axis);
+        });
+
+        node.left = BuildRecursive(bounds, objectFirst, splitObject - objectFirst, depth + 1, buildNodes);
+        node.right = BuildRecursive(bounds, splitObject, objectFirst + objectCount - splitObject, depth + 1, buildNodes);
+        buildNodes[index] = node;
+        return index;
+    }
+
+    // Cost of each split is the area of each side times the objects in it, the parent's area and the cost of visiting it are the
+    // same for every split so they're left out
+    struct Bin
+    {
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32 count;
+    };
+
+    // Every axis is binned in the one pass over the objects, axes the centroids are all level on are skipped
+    Bin bins[3][BVH_SAH_BINS];
+    float binScales[3];
+    for (uint32 axis = 0; axis < 3; axis++)
+    {
+        float centroidExtent = centroidMax[axis] - centroidMin[axis];
+        binScales[axis] = centroidExtent > 0.0f ? BVH_SAH_BINS / centroidExtent : 0.0f;
+        for (uint32 bin = 0; bin < BVH_SAH_BINS; bin++)
+        {
+            sBoxEmpty(bins[axis][bin].boundsMin, bins[axis][bin].boundsMax);
+            bins[axis][bin].count = 0;
+        }
+    }
+
+    for (uint32 i = objectFirst; i < objectFirst + objectCount; i++)
+    {
+        uint32 object = m_objects[i];
+        float objectMin[3];
+        float objectMax[3];
+        sObjectBox(bounds, object, objectMin, objectMax);
+
+        for (uint32 axis = 0; axis < 3; axis++)
+        {
+            Bin& bin = bins[axis][sBinIndex(sCentroid(bounds, object, axis), centroidMin[axis], binScales[axis])];
+            sBoxGrow(objectMin, objectMax, bin.boundsMin, bin.boundsMax);
+            bin.count++;
+        }
+    }
+
+    uint32 bestAxis = 3;
+    uint32 bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (uint32 axis = 0; axis < 3; axis++)
+    {
+        if (binScales[axis] == 0.0f)
+        {
+            continue;
+        }
+
+        // Everything from each bin up, so the splits can then be costed in one sweep up from the bottom
+        float aboveArea[BVH_SAH_BINS];
+        uint32 aboveCount[BVH_SAH_BINS];
+        {
+            float boundsMin[3];
+            float boundsMax[3];
+            sBoxEmpty(boundsMin, boundsMax);
+            uint32 count = 0;
+            for (uint32 bin = BVH_SAH_BINS - 1; bin > 0; bin--)
+            {
+                sBoxGrow(bins[axis][bin].boundsMin, bins[axis][bin].boundsMax, boundsMin, boundsMax);
+                count += bins[axis][bin].count;
+                aboveArea[bin] = count > 0 ? sHalfArea(boundsMin, boundsMax) : 0.0f;
+                aboveCount[bin] = count;
+            }
+        }
+
+        float boundsMin[3];
+        float boundsMax[3];
+        sBoxEmpty(boundsMin, boundsMax);
+        uint32 belowCount = 0;
+        for (uint32 split = 1; split < BVH_SAH_BINS; split++)
+        {
+            sBoxGrow(bins[axis][split - 1].boundsMin, bins[axis][split - 1].boundsMax, boundsMin, boundsMax);
+            belowCount += bins[axis][split - 1].count;
+            if (belowCount == 0 || aboveCount[split] == 0)
+            {
+                continue;
+            }
+
+            float cost = sHalfArea(boundsMin, boundsMax) * belowCount + aboveArea[split] * aboveCount[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32 splitObject;
+    if (bestAxis == 3)
+    {
+        // Every centroid is in the same place, so there's nothing to choose between splits
+        splitObject = objectFirst + objectCount / 2;
+    }
+    else
+    {
+        uint32* pSplit = std::partition(&m_objects[objectFirst], &m_objects[objectFirst] + objectCount, [&](uint32 object)
+        {
+            return sBinIndex(sCentroid(bounds, object, bestAxis), centroidMin[bestAxis], binScales[bestAxis]) < bestSplit;
+        });
+        splitObject = (uint32)(pSplit - m_objects.data());
+    }
+
+    node.left = BuildRecursive(bounds, objectFirst, splitObject - objectFirst, depth + 1, buildNodes);
+    node.right = BuildRecursive(bounds, splitObject, objectFirst + objectCount - splitObject, depth + 1, buildNodes);
+    buildNodes[index] = node;
+    return index;
+}
+
+uint32 BVH::Collapse(
+    const std::vector<BuildNode>& buildNodes,
+    int32 buildNode)
+{
+    uint32 index = (uint32)m_nodes.size();
+    m_nodes.push_back(Node());
+
+    // Pull grandchildren up in place of whichever child is biggest, since that's the one a query is most likely to have to open
+    int32 slots[4];
+    uint32 numSlots = 0;
+    if (buildNodes[buildNode].left < 0)
+    {
+        // Only the root can be a leaf, when there are too few objects to split
+        slots[numSlots++] = buildNode;
+    }
+    else
+    {
+        slots[numSlots++] = buildNodes[buildNode].left;
+        slots[numSlots++] = buildNodes[buildNode].right;
+        while (numSlots < 4)
+        {
+            int32 biggest = -1;
+            float biggestArea = -1.0f;
+            for (uint32 slot = 0; slot < numSlots; slot++)
+            {
+                const BuildNode& child = buildNodes[slots[slot]];
+                float area = sHalfArea(child.boundsMin, child.boundsMax);
+                if (child.left >= 0 && area > biggestArea)
+                {
+                    biggest = (int32)slot;
+                    biggestArea = area;
+                }
+            }
+
+            if (biggest < 0)
+            {
+                break;
+            }
+
+            const BuildNode& opened = buildNodes[slots[biggest]];
+            slots[biggest] = opened.left;
+            slots[numSlots++] = opened.right;
+        }
+    }
+
+    // Unused slots are left empty rather than given bounds that might not compare cleanly, queries mask them out
+    Node node;
+    memset(&node, 0, sizeof(node));
+    node.numChildren = numSlots;
+    for (uint32 slot = 0; slot < numSlots; slot++)
+    {
+        const BuildNode& child = buildNodes[slots[slot]];
+        node.minX[slot] = child.boundsMin[0];
+        node.minY[slot] = child.boundsMin[1];
+        node.minZ[slot] = child.boundsMin[2];
+        node.maxX[slot] = child.boundsMax[0];
+        node.maxY[slot] = child.boundsMax[1];
+        node.maxZ[slot] = child.boundsMax[2];
+        node.objectFirst[slot] = child.objectFirst;
+        node.objectCount[slot] = child.objectCount;
+        node.children[slot] = -1;
+    }
+    m_nodes[index] = node;
+
+    // Children are collapsed after their parent so nodes end up depth first, which Refit relies on
+    for (uint32 slot = 0; slot < numSlots; slot++)
+    {
+        if (buildNodes[slots[slot]].left >= 0)
+        {
+            int32 child = (int32)Collapse(buildNodes, slots[slot]);
+            m_nodes[index].children[slot] = child;
+        }
+    }
+
+    return index;
+}
+
+uint32 BVH::GetDepth() const
+{
+    // Children always come after their parents, so one pass forwards sees every parent's depth before its children's
+    std::vector<uint32> depths(m_nodes.size(), 1);
+    uint32 maxDepth = 0;
+    for (uint32 index = 0; index < (uint32)m_nodes.size(); index++)
+    {
+        const Node& node = m_nodes[index];
+        for (uint32 slot = 0; slot < node.numChildren; slot++)
+        {
+            if (node.children[slot] >= 0)
+            {
+                depths[node.children[slot]] = depths[index] + 1;
+            }
+        }
+        maxDepth = std::max(maxDepth, depths[index]);
+    }
+    return maxDepth;
+}
+
+void BVH::Refit(
+    const CullingBounds& bounds)
+{
+    ASSERT(bounds.Size() == (uint32)m_objects.size());
+
+    // Children always come after their parents, so going backwards every child is refitted before the node that holds its bounds
+    for (int32 index = (int32)m_nodes.size() - 1; index >= 0; index--)
+    {
+        Node& node = m_nodes[index];
+        for (uint32 slot = 0; slot < node.numChildren; slot++)
+        {
+            float boundsMin[3];
+            float boundsMax[3];
+            sBoxEmpty(boundsMin, boundsMax);
+
+            if (node.children[slot] < 0)
+            {
+                for (uint32 i = node.objectFirst[slot]; i < node.objectFirst[slot] + node.objectCount[slot]; i++)
+                {
+                    float objectMin[3];
+                    float objectMax[3];
+                    sObjectBox(bounds, m_objects[i], objectMin, objectMax);
+                    sBoxGrow(objectMin, objectMax, boundsMin, boundsMax);
+                }
+            }
+            else
+            {
+                const Node& child = m_nodes[node.children[slot]];
+                for (uint32 childSlot = 0; childSlot < child.numChildren; childSlot++)
+                {
+                    float childMin[3] = { child.minX[childSlot], child.minY[childSlot], child.minZ[childSlot] };
+                    float childMax[3] = { child.maxX[childSlot], child.maxY[childSlot], child.maxZ[childSlot] };
+                    sBoxGrow(childMin, childMax, boundsMin, boundsMax);
+                }
+            }
+
+            node.minX[slot] = boundsMin[0];
+            node.minY[slot] = boundsMin[1];
+            node.minZ[slot] = boundsMin[2];
+            node.maxX[slot] = boundsMax[0];
+            node.maxY[slot] = boundsMax[1];
+            node.maxZ[slot] = boundsMax[2];
+        }
+    }
+}
+
+uint32 BVH::QueryFrustum(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32* pResultsOut) const
+{
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+
+    __m128 planeX[FrustumPlaneCount], planeY[FrustumPlaneCount], planeZ[FrustumPlaneCount], planeW[FrustumPlaneCount];
+    __m128 absPlaneX[FrustumPlaneCount], absPlaneY[FrustumPlaneCount], absPlaneZ[FrustumPlaneCount];
+    for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+    {
+        const Vector4& p = frustum.planes[plane];
+        planeX[plane] = _mm_set1_ps(p.x);
+        planeY[plane] = _mm_set1_ps(p.y);
+        planeZ[plane] = _mm_set1_ps(p.z);
+        planeW[plane] = _mm_set1_ps(p.w);
+        absPlaneX[plane] = _mm_set1_ps(fabsf(p.x));
+        absPlaneY[plane] = _mm_set1_ps(fabsf(p.y));
+        absPlaneZ[plane] = _mm_set1_ps(fabsf(p.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    uint32 numResults = 0;
+    uint32 stack[BVH_MAX_STACK_DEPTH];
+    uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        __m128 minX = _mm_loadu_ps(node.minX);
+        __m128 minY = _mm_loadu_ps(node.minY);
+        __m128 minZ = _mm_loadu_ps(node.minZ);
+        __m128 maxX = _mm_loadu_ps(node.maxX);
+        __m128 maxY = _mm_loadu_ps(node.maxY);
+        __m128 maxZ = _mm_loadu_ps(node.maxZ);
+        __m128 centreX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        __m128 centreY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        __m128 centreZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        // Outside any plane culls the child, inside every plane means everything under it is visible
+        __m128 outside = zero;
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[plane], centreX), _mm_mul_ps(planeY[plane], centreY)),
+                _mm_add_ps(_mm_mul_ps(planeZ[plane], centreZ), planeW[plane]));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(absPlaneX[plane], extentX), _mm_mul_ps(absPlaneY[plane], extentY)),
+                _mm_mul_ps(absPlaneZ[plane], extentZ));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(distance, radius), zero));
+        }
+
+        uint32 childMask = (1u << node.numChildren) - 1;
+        uint32 visibleMask = ~(uint32)_mm_movemask_ps(outside) & childMask;
+        uint32 insideMask = (uint32)_mm_movemask_ps(inside) & visibleMask;
+
+        for (uint32 slot = 0; slot < node.numChildren; slot++)
+        {
+            if (!(visibleMask & (1u << slot)))
+            {
+                continue;
+            }
+
+            const uint32* pObjects = &m_objects[node.objectFirst[slot]];
+            uint32 objectCount = node.objectCount[slot];
+            if (insideMask & (1u << slot))
+            {
+                memcpy(pResultsOut + numResults, pObjects, objectCount * sizeof(uint32));
+                numResults += objectCount;
+            }
+            else if (node.children[slot] >= 0 && stackSize < BVH_MAX_STACK_DEPTH)
+            {
+                stack[stackSize++] = (uint32)node.children[slot];
+            }
+            else
+            {
+                // A leaf, or a subtree which doesn't fit on the stack, which the build's depth cap should make impossible. Either
+                // way its objects are contiguous so can be tested one by one.
+                ASSERT(node.children[slot] < 0);
+                for (uint32 i = 0; i < objectCount; i++)
+                {
+                    pResultsOut[numResults] = pObjects[i];
+                    numResults += FrustumCulling::IsVisible(frustum, bounds, pObjects[i]);
+                }
+            }
+        }
+    }
+
+    return numResults;
+}
+
+uint32 BVH::QuerySphere(
+    const Vector3& centre,
+    float radius,
+    const CullingBounds& bounds,
+    uint32* pResultsOut) const
+{
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 centreX = _mm_set1_ps(centre.x);
+    const __m128 centreY = _mm_set1_ps(centre.y);
+    const __m128 centreZ = _mm_set1_ps(centre.z);
+    const __m128 radiusSq = _mm_set1_ps(radius * radius);
+
+    uint32 numResults = 0;
+    uint32 stack[BVH_MAX_STACK_DEPTH];
+    uint32 stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        // Distance from the centre to the nearest point of each box, which is 0 along any axis the centre's within the box on
+        __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), centreX), zero), _mm_max_ps(_mm_sub_ps(centreX, _mm_loadu_ps(node.maxX)), zero));
+        __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), centreY), zero), _mm_max_ps(_mm_sub_ps(centreY, _mm_loadu_ps(node.maxY)), zero));
+        __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), centreZ), zero), _mm_max_ps(_mm_sub_ps(centreZ, _mm_loadu_ps(node.maxZ)), zero));
+        __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        uint32 childMask = (1u << node.numChildren) - 1;
+        uint32 overlapMask = (uint32)_mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq)) & childMask;
+
+        for (uint32 slot = 0; slot < node.numChildren; slot++)
+        {
+            if (!(overlapMask & (1u << slot)))
+            {
+                continue;
+            }
+
+            // Subtrees which don't fit on the stack are tested object by object, see QueryFrustum
+            ASSERT(node.children[slot] < 0 || stackSize < BVH_MAX_STACK_DEPTH);
+            if (node.children[slot] >= 0 && stackSize < BVH_MAX_STACK_DEPTH)
+            {
+                stack[stackSize++] = (uint32)node.children[slot];
+                continue;
+            }
+
+            for (uint32 i = node.objectFirst[slot]; i < node.objectFirst[slot] + node.objectCount[slot]; i++)
+            {
+                uint32 object = m_objects[i];
+                float ox = std::max(fabsf(centre.x - bounds.boxCentreX[object]) - bounds.boxExtentX[object], 0.0f);
+                float oy = std::max(fabsf(centre.y - bounds.boxCentreY[object]) - bounds.boxExtentY[object], 0.0f);
+                float oz = std::max(fabsf(centre.z - bounds.boxCentreZ[object]) - bounds.boxExtentZ[object], 0.0f);
+
+                pResultsOut[numResults] = object;
+                numResults += ox * ox + oy * oy + oz * oz <= radius * radius;
+            }
+        }
+    }
+
+    return numResults;
+}
+
+bool BVH::QueryRay(
+    const Vector3& origin,
+    const Vector3& direction,
+    float maxDistance,
+    const CullingBounds& bounds,
+    uint32& objectOut,
+    float& distanceOut) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    // Slab test. A zero direction component gives an infinite inverse, which still works out as long as the origin isn't exactly
+    // on one of the box's faces on that axis.
+    float invDirection[3] = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+    const __m128 originX = _mm_set1_ps(origin.x);
+    const __m128 originY = _mm_set1_ps(origin.y);
+    const __m128 originZ = _mm_set1_ps(origin.z);
+    const __m128 invDirectionX = _mm_set1_ps(invDirection[0]);
+    const __m128 invDirectionY = _mm_set1_ps(invDirection[1]);
+    const __m128 invDirectionZ = _mm_set1_ps(invDirection[2]);
+
+    bool fHit = false;
+    float nearest = maxDistance;
+
+    // Entry distances go on the stack with the node, so anything further than a hit found since it was pushed is skipped
+    uint32 stack[BVH_MAX_STACK_DEPTH];
+    float stackDistances[BVH_MAX_STACK_DEPTH];
+    uint32 stackSize = 0;
+    stack[stackSize] = 0;
+    stackDistances[stackSize++] = 0.0f;
+    while (stackSize > 0)
+    {
+        stackSize--;
+        if (stackDistances[stackSize] > nearest)
+        {
+            continue;
+        }
+        const Node& node = m_nodes[stack[stackSize]];
+
+        __m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), invDirectionX);
+        __m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), invDirectionX);
+        __m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), invDirectionY);
+        __m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), invDirectionY);
+        __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), invDirectionZ);
+        __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), invDirectionZ);
+
+        __m128 tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0X, t1X), _mm_min_ps(t0Y, t1Y)), _mm_max_ps(_mm_min_ps(t0Z, t1Z), _mm_setzero_ps()));
+        __m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0X, t1X), _mm_max_ps(t0Y, t1Y)), _mm_min_ps(_mm_max_ps(t0Z, t1Z), _mm_set1_ps(nearest)));
+
+        uint32 childMask = (1u << node.numChildren) - 1;
+        uint32 hitMask = (uint32)_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)) & childMask;
+        if (!hitMask)
+        {
+            continue;
+        }
+
+        float enterDistances[4];
+        _mm_storeu_ps(enterDistances, tEnter);
+
+        // Nearest children are pushed last so they're visited first, and are more likely to shorten the ray for the rest
+        uint32 hitSlots[4];
+        uint32 numHitSlots = 0;
+        for (uint32 slot = 0; slot < node.numChildren; slot++)
+        {
+            if (hitMask & (1u << slot))
+            {
+                uint32 insert = numHitSlots++;
+                while (insert > 0 && enterDistances[hitSlots[insert - 1]] < enterDistances[slot])
+                {
+                    hitSlots[insert] = hitSlots[insert - 1];
+                    insert--;
+                }
+                hitSlots[insert] = slot;
+            }
+        }
+
+        for (uint32 hit = 0; hit < numHitSlots; hit++)
+        {
+            uint32 slot = hitSlots[hit];
+            // Subtrees which don't fit on the stack are tested object by object, see QueryFrustum
+            ASSERT(node.children[slot] < 0 || stackSize < BVH_MAX_STACK_DEPTH);
+            if (node.children[slot] >= 0 && stackSize < BVH_MAX_STACK_DEPTH)
+            {
+                stack[stackSize] = (uint32)node.children[slot];
+                stackDistances[stackSize++] = enterDistances[slot];
+                continue;
+            }
+
+            for (uint32 i = node.objectFirst[slot]; i < node.objectFirst[slot] + node.objectCount[slot]; i++)
+            {
+                uint32 object = m_objects[i];
+                float objectMin[3];
+                float objectMax[3];
+                sObjectBox(bounds, object, objectMin, objectMax);
+
+                float originArray[3] = { origin.x, origin.y, origin.z };
+                float enter = 0.0f;
+                float exit = nearest;
+                for (uint32 axis = 0; axis < 3; axis++)
+                {
+                    float t0 = (objectMin[axis] - originArray[axis]) * invDirection[axis];
+                    float t1 = (objectMax[axis] - originArray[axis]) * invDirection[axis];
+                    enter = std::max(enter, std::min(t0, t1));
+                    exit = std::min(exit, std::max(t0, t1));
+                }
+
+                if (enter <= exit && (!fHit || enter < nearest))
+                {
+                    fHit = true;
+                    nearest = enter;
+                    objectOut = object;
+                }
+            }
+        }
+    }
+
+    if (fHit)
+    {
+        distanceOut = nearest;
+    }
+    return fHit;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Renderer/FrustumCulling.h"
+
+#include <vector>
+
+// Ranges of at most this many objects become leaves
+#define BVH_MAX_LEAF_SIZE 4
+// Buckets centroids are sorted into along each axis when looking for the cheapest split
+#define BVH_SAH_BINS 16
+// Deepest the binary tree is allowed to get. Ranges which could otherwise end up deeper are split at their median instead of where
+// the surface area heuristic says, which can pick lopsided splits over and over for badly spread out objects.
+#define BVH_MAX_BUILD_DEPTH 64
+// Deepest a query's traversal stack can get. Every level of the tree leaves at most three siblings waiting on it, so the build's
+// depth cap keeps within it.
+#define BVH_MAX_STACK_DEPTH 256
+
+static_assert(3 * BVH_MAX_BUILD_DEPTH + 4 <= BVH_MAX_STACK_DEPTH, "BVH queries' stacks are too small for the deepest tree");
+
+// Four wide bounding volume hierarchy over the boxes of a CullingBounds. It's built top down into a binary tree, splitting where the
+// binned surface area heuristic says is cheapest, and that's then collapsed so each node keeps up to four children's bounds side by
+// side and a query tests all of them at once with SSE.
+//
+// Nodes are stored depth first and the objects are reordered to match, so every subtree covers one contiguous range of objects and
+// a subtree that's entirely inside a query is returned without visiting it.
+class BVH
+{
+public:
+    void Build(
+        const CullingBounds& bounds);
+
+    // Fits every node around bounds' boxes again without changing the tree, for when objects have moved. Much cheaper than Build,
+    // but the tree gets worse the further objects have moved since it was built. bounds has to have the same objects as Build had.
+    void Refit(
+        const CullingBounds& bounds);
+
+    // Writes the indices of the objects that FrustumCulling::Cull would keep to pResultsOut (which needs room for every object), in
+    // no particular order, and returns how many there are
+    uint32 QueryFrustum(
+        const Frustum& frustum,
+        const CullingBounds& bounds,
+        uint32* pResultsOut) const;
+
+    // Same as QueryFrustum, but for objects whose box overlaps the sphere
+    uint32 QuerySphere(
+        const Vector3& centre,
+        float radius,
+        const CullingBounds& bounds,
+        uint32* pResultsOut) const;
+
+    // Finds the nearest object whose box the ray hits within maxDistance. direction doesn't need to be normalised, distances are in
+    // multiples of it.
+    bool QueryRay(
+        const Vector3& origin,
+        const Vector3& direction,
+        float maxDistance,
+        const CullingBounds& bounds,
+        uint32& objectOut,
+        float& distanceOut) const;
+
+    bool IsEmpty() const
+    {
+        return m_nodes.empty();
+    }
+
+    uint32 GetNumNodes() const
+    {
+        return (uint32)m_nodes.size();
+    }
+
+    // Levels of four wide nodes, for debugging
+    uint32 GetDepth() const;
+
+private:
+    // Children are packed into the first numChildren slots. A child is either another node, or a leaf of objects when its node
+    // index is -1. Either way it covers objects[objectFirst] up to objects[objectFirst + objectCount - 1].
+    struct Node
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+
+        int32 children[4];
+        uint32 objectFirst[4];
+        uint32 objectCount[4];
+        uint32 numChildren;
+    };
+
+    // Binary tree the build makes before it's collapsed, left is -1 for leaves
+    struct BuildNode
+    {
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32 objectFirst;
+        uint32 objectCount;
+        int32 left;
+        int32 right;
+    };
+
+    int32 BuildRecursive(
+        const CullingBounds& bounds,
+        uint32 objectFirst,
+        uint32 objectCount,
+        uint32 depth,
+        std::vector<BuildNode>& buildNodes);
+
+    uint32 Collapse(
+        const std::vector<BuildNode>& buildNodes,
+        int32 buildNode);
+
+    std::vector<Node> m_nodes;
+
+    // Object indices in tree order
+    std::vector<uint32> m_objects;
+};
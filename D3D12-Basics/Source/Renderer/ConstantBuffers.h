@@ -28,10 +28,25 @@ struct CBStatic : ConstantData
 {
     Matrix4x4 matView;
     Matrix4x4 matProj;
-    Vector3 directionalLight;
 };
 
+// Same for every draw, so only set once a frame
 struct CBCommon : ConstantData
+{
+    Vector3 directionalLight;
+};
+
+// One of these per instance, written for the whole frame into one structured buffer. Must match ObjectConstants in
+// Shaders/ConstantBuffers.h, structured buffers are tightly packed so there's no padding to worry about.
+struct ObjectConstants
+{
+    // Transposed for the shader, like matView and matProj
+    Matrix4x4 matWorld;
+    uint32 materialIndex;
+};
+
+// One of these per material in the material table, see MaterialTable. Must match MaterialConstants in Shaders/ConstantBuffers.h
+struct MaterialConstants
 {
     Vector3 diffuse;
     float specular;
@@ -0,0 +1,162 @@
+#include "CommandListStateCache.h"
+
+CommandListStateCache::CommandListStateCache()
+{
+    Reset(nullptr, nullptr);
+}
+
+void CommandListStateCache::Reset(
+    ID3D12GraphicsCommandList* pCmdList,
+    ID3D12PipelineState* pInitialPipelineState)
+{
+    m_pCmdList = pCmdList;
+
+    m_pRootSignature = nullptr;
+    m_pPipelineState = pInitialPipelineState;
+    m_topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    m_vertexBufferView = {};
+    m_indexBufferView = {};
+    m_validRootParams = 0;
+
+    m_stats = BindingStats();
+}
+
+void CommandListStateCache::SetGraphicsRootSignature(
+    ID3D12RootSignature* pRootSignature)
+{
+    if (m_pRootSignature == pRootSignature)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    m_pCmdList->SetGraphicsRootSignature(pRootSignature);
+    m_pRootSignature = pRootSignature;
+    m_validRootParams = 0;
+    m_stats.bindsIssued++;
+}
+
+void CommandListStateCache::SetPipelineState(
+    ID3D12PipelineState* pPipelineState)
+{
+    if (m_pPipelineState == pPipelineState)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    m_pCmdList->SetPipelineState(pPipelineState);
+    m_pPipelineState = pPipelineState;
+    m_stats.bindsIssued++;
+}
+
+void CommandListStateCache::IASetPrimitiveTopology(
+    D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    if (m_topology == topology)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    m_pCmdList->IASetPrimitiveTopology(topology);
+    m_topology = topology;
+    m_stats.bindsIssued++;
+}
+
+void CommandListStateCache::IASetVertexBuffer(
+    const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+    if (m_vertexBufferView.BufferLocation == view.BufferLocation &&
+        m_vertexBufferView.SizeInBytes == view.SizeInBytes &&
+        m_vertexBufferView.StrideInBytes == view.StrideInBytes)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    m_pCmdList->IASetVertexBuffers(0, 1, &view);
+    m_vertexBufferView = view;
+    m_stats.bindsIssued++;
+}
+
+void CommandListStateCache::IASetIndexBuffer(
+    const D3D12_INDEX_BUFFER_VIEW& view)
+{
+    if (m_indexBufferView.BufferLocation == view.BufferLocation &&
+        m_indexBufferView.SizeInBytes == view.SizeInBytes &&
+        m_indexBufferView.Format == view.Format)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    m_pCmdList->IASetIndexBuffer(&view);
+    m_indexBufferView = view;
+    m_stats.bindsIssued++;
+}
+
+void CommandListStateCache::SetGraphicsRootDescriptorTable(
+    uint32 rootParameterIndex,
+    D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    if (RootParameterSet(rootParameterIndex, baseDescriptor.ptr))
+    {
+        m_pCmdList->SetGraphicsRootDescriptorTable(rootParameterIndex, baseDescriptor);
+    }
+}
+
+void CommandListStateCache::SetGraphicsRootConstantBufferView(
+    uint32 rootParameterIndex,
+    D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+{
+    if (RootParameterSet(rootParameterIndex, bufferLocation))
+    {
+        m_pCmdList->SetGraphicsRootConstantBufferView(rootParameterIndex, bufferLocation);
+    }
+}
+
+void CommandListStateCache::SetGraphicsRootShaderResourceView(
+    uint32 rootParameterIndex,
+    D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+{
+    if (RootParameterSet(rootParameterIndex, bufferLocation))
+    {
+        m_pCmdList->SetGraphicsRootShaderResourceView(rootParameterIndex, bufferLocation);
+    }
+}
+
+void CommandListStateCache::SetGraphicsRoot32BitConstants(
+    uint32 rootParameterIndex,
+    uint32 num32BitValues,
+    const void* pSrcData)
+{
+    ASSERT(num32BitValues > 0 && num32BitValues <= 2);
+
+    uint64 value = 0;
+    memcpy(&value, pSrcData, num32BitValues * sizeof(uint32));
+    if (RootParameterSet(rootParameterIndex, value))
+    {
+        m_pCmdList->SetGraphicsRoot32BitConstants(rootParameterIndex, num32BitValues, pSrcData, 0);
+    }
+}
+
+// Returns whether the parameter actually needs setting on the command list
+bool CommandListStateCache::RootParameterSet(
+    uint32 rootParameterIndex,
+    uint64 value)
+{
+    ASSERT(m_pRootSignature);
+    ASSERT(rootParameterIndex < COMMAND_LIST_STATE_CACHE_MAX_ROOT_PARAMS);
+
+    if (Utils::TestBit32(rootParameterIndex, m_validRootParams) && m_rootParams[rootParameterIndex] == value)
+    {
+        m_stats.bindsSkipped++;
+        return false;
+    }
+
+    m_rootParams[rootParameterIndex] = value;
+    Utils::SetBit32(rootParameterIndex, m_validRootParams);
+    m_stats.bindsIssued++;
+    return true;
+}
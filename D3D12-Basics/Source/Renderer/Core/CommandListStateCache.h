@@ -0,0 +1,82 @@
+#pragma once
+#include "D3D12Header.h"
+
+#define COMMAND_LIST_STATE_CACHE_MAX_ROOT_PARAMS 16
+
+// Counts since the cache was last reset, i.e. for one command list
+struct BindingStats
+{
+    uint32 bindsIssued = 0;
+    uint32 bindsSkipped = 0;
+};
+
+// Sits in front of a graphics command list and drops any call which would bind what's already bound. Only knows about state set
+// through it, so anything bound on the list directly must be followed by a Reset.
+class CommandListStateCache
+{
+public:
+    CommandListStateCache();
+
+    // Forget everything, pCmdList has just been reset with pInitialPipelineState
+    void Reset(
+        ID3D12GraphicsCommandList* pCmdList,
+        ID3D12PipelineState* pInitialPipelineState);
+
+    void SetGraphicsRootSignature(
+        ID3D12RootSignature* pRootSignature);
+
+    void SetPipelineState(
+        ID3D12PipelineState* pPipelineState);
+
+    void IASetPrimitiveTopology(
+        D3D12_PRIMITIVE_TOPOLOGY topology);
+
+    void IASetVertexBuffer(
+        const D3D12_VERTEX_BUFFER_VIEW& view);
+
+    void IASetIndexBuffer(
+        const D3D12_INDEX_BUFFER_VIEW& view);
+
+    void SetGraphicsRootDescriptorTable(
+        uint32 rootParameterIndex,
+        D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+
+    void SetGraphicsRootConstantBufferView(
+        uint32 rootParameterIndex,
+        D3D12_GPU_VIRTUAL_ADDRESS bufferLocation);
+
+    void SetGraphicsRootShaderResourceView(
+        uint32 rootParameterIndex,
+        D3D12_GPU_VIRTUAL_ADDRESS bufferLocation);
+
+    // Sets all of a root constants parameter at once, at most two values so they can be cached like any other root argument
+    void SetGraphicsRoot32BitConstants(
+        uint32 rootParameterIndex,
+        uint32 num32BitValues,
+        const void* pSrcData);
+
+    const BindingStats& GetStats()
+    {
+        return m_stats;
+    }
+
+private:
+    bool RootParameterSet(
+        uint32 rootParameterIndex,
+        uint64 value);
+
+    ID3D12GraphicsCommandList* m_pCmdList;
+
+    ID3D12RootSignature* m_pRootSignature;
+    ID3D12PipelineState* m_pPipelineState;
+    D3D12_PRIMITIVE_TOPOLOGY m_topology;
+    D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
+    D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
+
+    // Whatever each root parameter was last set to (GPU descriptor handle, virtual address or packed constants), only valid if its bit is set.
+    // Cleared whenever the root signature changes since that resets all root arguments.
+    uint64 m_rootParams[COMMAND_LIST_STATE_CACHE_MAX_ROOT_PARAMS];
+    uint32 m_validRootParams;
+
+    BindingStats m_stats;
+};
@@ -1,6 +1,7 @@
 #include "D3D12Core.h"
 
 #include <d3dcompiler.h>
+#include <chrono>
 
 #include "Shell.h"
 #include "Engine.h"
@@ -17,19 +18,42 @@
 
 #define USE_HARDCODED_SCENE 0
 
+// Textures are written once into a persistent region of the shader visible heap indexed by TextureID, and draws pass the index as
+// a root constant instead of staging and copying a table. Needs resource binding tier 2 for the unbounded table.
+#define USE_BINDLESS_TEXTURES 1
+
 #define D3D_COMPILE_STANDARD_FILE_INCLUDE ((ID3DInclude*)(UINT_PTR)1)
 
 #define SRV_DESCRIPTOR_POOL_SIZE 5000
 #define SRV_DESCRIPTOR_TABLE_MAX_SLOTS 16
 #define SRV_MAX_ALLOCATED 4096
+#define CPU_DESCRIPTOR_PAGE_SIZE 1024
+#define MATERIAL_TABLE_CAPACITY 4096
+
+#if USE_BINDLESS_TEXTURES
+#define BINDLESS_TEXTURE_CAPACITY SRV_MAX_ALLOCATED
+#else
+#define BINDLESS_TEXTURE_CAPACITY 0
+#endif
+
+// Most vertex or index buffers there can be at once, each table's slots are allocated up front
+#define GEOMETRY_TABLE_CAPACITY 65536
+
+#define VERTEX_ARENA_BLOCK_SIZE _32MB
+#define INDEX_ARENA_BLOCK_SIZE _16MB
 
 enum RootSignatureSlot : int32
 {
     RSS_SRVTABLE,
+    RSS_ROOTCONSTANTS,
+    RSS_OBJECTCONSTANTS,
+    RSS_MATERIALS,
     RSS_CBSTART,
     RSS_COUNT = RSS_CBSTART + CBIDCount
 };
 
+typedef std::chrono::high_resolution_clock HighResClock;
+
 // Local Functions  ////////////////////////////////////////////////////////////////////////
 
 static void sCompileShader(
@@ -45,12 +69,21 @@ static void sCompileShader(
         compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
     }
 
+#if USE_BINDLESS_TEXTURES
+    // Indexing an unbounded texture array needs shader model 5.1
+    const D3D_SHADER_MACRO defines[] = { { "USE_BINDLESS_TEXTURES", "1" }, { nullptr, nullptr } };
+    const char* target = fIsVertexShader ? "vs_5_1" : "ps_5_1";
+#else
+    const D3D_SHADER_MACRO* defines = nullptr;
+    const char* target = fIsVertexShader ? "vs_5_0" : "ps_5_0";
+#endif
+
     HRESULT result = D3DCompileFromFile(
         SHADER_FILE,
-        nullptr,
+        defines,
         D3D_COMPILE_STANDARD_FILE_INCLUDE,
         entryPoint,
-        fIsVertexShader ? "vs_5_0" : "ps_5_0",
+        target,
         compileFlags,
         0,
         shaderBlob,
@@ -67,7 +100,11 @@ static void sCompileShader(
 
 // Member Functions  ///////////////////////////////////////////////////////////////////////
 
-D3D12Core::D3D12Core()
+D3D12Core::D3D12Core() :
+    m_vertexBuffers(GEOMETRY_TABLE_CAPACITY),
+    m_indexBuffers(GEOMETRY_TABLE_CAPACITY),
+    m_textures(SRV_MAX_ALLOCATED),
+    m_bindlessSlotAllocator(BindlessTextureSlot(BindlessTextureSlotDefault + 1), BINDLESS_TEXTURE_CAPACITY - 1)
 {
     if (globals.fD3DDebug)
     {
@@ -81,11 +118,12 @@ D3D12Core::D3D12Core()
         }
     }
     
-    for (int32 i = 0; i < NUM_SWAP_CHAIN_BUFFERS; i++)
+    for (int32 i = 0; i < NUM_FRAMES_IN_FLIGHT; i++)
     {
         m_frameFenceValues[i] = 0;
     }
     m_fenceValue = 0;
+    m_numObjectConstants = 0;
 
     m_device = new Device();
 
@@ -101,9 +139,28 @@ D3D12Core::D3D12Core()
     m_scissorRect.top = 0;
     m_scissorRect.bottom = GetWindowHeight();
 
-    m_uploadStream = new UploadStream(m_device);
+    m_uploadStream = new UploadStream(m_device, _32MB, UploadStream::ModeRing);
+    m_pUploadQueue = new D3D12UploadQueue(m_device);
+    m_pUploadContext = new UploadContext(m_pUploadQueue);
+
+    m_pVertexArena = new GeometryArena(m_device, sizeof(Vertex), VERTEX_ARENA_BLOCK_SIZE);
+    m_pIndexArena = new GeometryArena(m_device, sizeof(uint32), INDEX_ARENA_BLOCK_SIZE);
+
+    m_pGeneralDescriptorAllocator = new DescriptorAllocator(m_device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, CPU_DESCRIPTOR_PAGE_SIZE);
+    m_pDescriptorPool = new DescriptorPool(m_device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, SRV_DESCRIPTOR_POOL_SIZE, SRV_DESCRIPTOR_TABLE_MAX_SLOTS, BINDLESS_TEXTURE_CAPACITY);
 
-    m_pDescriptorPool = new DescriptorPool(m_device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, SRV_DESCRIPTOR_POOL_SIZE, SRV_DESCRIPTOR_TABLE_MAX_SLOTS);
+    m_pMaterialTable = new MaterialTable(m_device, MATERIAL_TABLE_CAPACITY);
+
+    for (uint32 i = 0; i < NUM_RECORDING_CONTEXTS; i++)
+    {
+#if USE_BINDLESS_TEXTURES
+        m_recordingContexts[i].pDescriptorPool = m_pDescriptorPool;
+#else
+        // Staging isn't thread safe, so every context but the first gets a pool of its own
+        m_recordingContexts[i].pDescriptorPool = i == 0 ? m_pDescriptorPool :
+            new DescriptorPool(m_device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, SRV_DESCRIPTOR_POOL_SIZE, SRV_DESCRIPTOR_TABLE_MAX_SLOTS);
+#endif
+    }
 
     InitialisePipeline();
     InitialAssetsLoad();
@@ -111,9 +168,30 @@ D3D12Core::D3D12Core()
 
 D3D12Core::~D3D12Core()
 {
+    TextureDestroy(m_defaultTexture);
+
+    // The GPU has to have been flushed by now, so anything still queued can go
+    DeferredDestroysProcess(UINT64_MAX);
+
+    m_device->DestroyResource(m_pDepthStencil);
+
+    delete m_pMaterialTable;
+#if !USE_BINDLESS_TEXTURES
+    for (uint32 i = 1; i < NUM_RECORDING_CONTEXTS; i++)
+    {
+        delete m_recordingContexts[i].pDescriptorPool;
+    }
+#endif
     delete m_pDescriptorPool;
+    delete m_pGeneralDescriptorAllocator;
+    delete m_pUploadContext;
+    delete m_pUploadQueue;
+    delete m_pIndexArena;
+    delete m_pVertexArena;
     delete m_uploadStream;
     delete m_device;
+
+    CloseHandle(m_fenceEvent);
 }
 
 void D3D12Core::InitialisePipeline()
@@ -157,7 +235,7 @@ void D3D12Core::InitialisePipeline()
 
         swapChain.As(&m_swapChain3);
 
-        m_frameIndex = m_swapChain3->GetCurrentBackBufferIndex();
+        m_backBufferIndex = m_swapChain3->GetCurrentBackBufferIndex();
     }
 
     // Create RTV Descriptor Heap and RTV Descriptors
@@ -188,7 +266,7 @@ void D3D12Core::InitialisePipeline()
         heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
         heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
         heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        m_device->CreateTexture2D(heapProps, WINDOW_WIDTH, WINDOW_HEIGHT, 1, DXGI_FORMAT_D32_FLOAT, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL, &clearValue, &m_depthStencil);
+        m_device->CreateTexture2D(heapProps, WINDOW_WIDTH, WINDOW_HEIGHT, 1, DXGI_FORMAT_D32_FLOAT, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL, &clearValue, &m_pDepthStencil);
 
         D3D12_DESCRIPTOR_HEAP_DESC descHeapDesc = {};
         descHeapDesc.NumDescriptors = 1;
@@ -203,27 +281,24 @@ void D3D12Core::InitialisePipeline()
         depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
         depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
 
-        m_device->CreateDepthStencilView(m_depthStencil.Get(), &depthStencilDesc, handle);
-    }
-
-    // Create CPU General descriptor heap 
-    {
-        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-        desc.NumDescriptors = SRV_MAX_ALLOCATED;
-        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        m_device->CreateDescriptorHeap(desc, &m_generalDescriptorHeap, m_generalDescriptorSize);
-        m_nextGeneralDescriptor = m_generalDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+        m_device->CreateDepthStencilView(m_pDepthStencil, &depthStencilDesc, handle);
     }
 
     ConstantBuffersInit();
 
-    for (int32 i = 0; i < NUM_SWAP_CHAIN_BUFFERS; i++)
+    for (int32 i = 0; i < NUM_FRAMES_IN_FLIGHT; i++)
     {
         m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &m_cmdAllocators[i]);
+
+        for (uint32 context = 0; context < NUM_RECORDING_CONTEXTS; context++)
+        {
+            m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &m_recordingContexts[context].cmdAllocators[i]);
+        }
     }
     
     m_device->CreateFence(0, &m_fence);
+    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    ASSERT(m_fenceEvent);
 }
 
 void D3D12Core::CreateRootSignature()
@@ -239,7 +314,13 @@ void D3D12Core::CreateRootSignature()
 
         D3D12_DESCRIPTOR_RANGE range = {};
         range.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+#if USE_BINDLESS_TEXTURES
+        // Every texture, in their own space so they don't clash with anything bound the old way
+        range.NumDescriptors = UINT_MAX;
+        range.RegisterSpace = 1;
+#else
         range.NumDescriptors = 1;
+#endif
         range.BaseShaderRegister = 0;
         range.OffsetInDescriptorsFromTableStart = 0;
 
@@ -252,6 +333,34 @@ void D3D12Core::CreateRootSignature()
         textureTableParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
     }
 
+    // Root Constants, after the inline CBVs' registers
+    {
+        D3D12_ROOT_PARAMETER& constantsParam = params[RSS_ROOTCONSTANTS];
+        constantsParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        constantsParam.Constants.ShaderRegister = CBIDCount;
+        constantsParam.Constants.RegisterSpace = 0;
+        constantsParam.Constants.Num32BitValues = sizeof(DrawConstants) / sizeof(uint32);
+        constantsParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    }
+
+    // Object Constants, a structured buffer so a root SRV
+    {
+        D3D12_ROOT_PARAMETER& objectsParam = params[RSS_OBJECTCONSTANTS];
+        objectsParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        objectsParam.Descriptor.ShaderRegister = 1;
+        objectsParam.Descriptor.RegisterSpace = 0;
+        objectsParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    }
+
+    // Material Table, also a structured buffer
+    {
+        D3D12_ROOT_PARAMETER& materialsParam = params[RSS_MATERIALS];
+        materialsParam.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        materialsParam.Descriptor.ShaderRegister = 2;
+        materialsParam.Descriptor.RegisterSpace = 0;
+        materialsParam.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+    }
+
     // Inline CBVs
     {
         for (int32 id = 0; id < CBIDCount; id++)
@@ -318,6 +427,7 @@ void D3D12Core::ConstantBufferSetData(
     }
     else
     {
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
         m_dynamicConstantBufferAllocations[id] = m_uploadStream->AllocateAligned(Utils::AlignUp(size, (size_t)D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, m_fenceValue);
         memcpy(m_dynamicConstantBufferAllocations[id].cpuAddr, data, size);
     }
@@ -402,42 +512,83 @@ void D3D12Core::InitialAssetsLoad()
     }
 
     // Create Command Lists
-    for (int32 i = 0; i < NUM_SWAP_CHAIN_BUFFERS; i++)
+    for (int32 i = 0; i < NUM_FRAMES_IN_FLIGHT; i++)
     {
-        m_device->CreateGraphicsCommandList(m_cmdAllocators[i].Get(), m_pipelineState.Get(), &m_cmdLists[i]);
+        m_device->CreateGraphicsCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, m_cmdAllocators[i].Get(), m_pipelineState.Get(), &m_cmdLists[i]);
+        m_device->CreateGraphicsCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, m_cmdAllocators[i].Get(), m_pipelineState.Get(), &m_endCmdLists[i]);
+
+        for (uint32 context = 0; context < NUM_RECORDING_CONTEXTS; context++)
+        {
+            RecordingContext& recordingContext = m_recordingContexts[context];
+            m_device->CreateGraphicsCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, recordingContext.cmdAllocators[i].Get(), m_pipelineState.Get(), &recordingContext.cmdLists[i]);
+        }
     }
+
+    uint32 white = 0xFFFFFFFF;
+    m_defaultTexture = TextureCreateInternal(1, 1, 4, &white, BindlessTextureSlotDefault);
 }
 
 void D3D12Core::BufferCreate(
     const D3D12_HEAP_PROPERTIES& heapProps,
     uint32 size,
     D3D12_HEAP_FLAGS heapFlags,
-    D3D12_RESOURCE_STATES initialState,
     void* initialData,
     ID3D12Resource** ppBuffer)
 {
-    m_device->CreateBuffer(heapProps, size, heapFlags, D3D12_RESOURCE_STATE_COPY_DEST, ppBuffer);
+    // Created in COMMON so the copy queue can promote it to COPY_DEST. It decays back to COMMON once the upload batch completes,
+    // and is promoted to whatever read state it's used in on the direct queue, so no barriers are needed on either queue.
+    m_device->CreateBuffer(heapProps, size, heapFlags, D3D12_RESOURCE_STATE_COMMON, ppBuffer);
 
-    UploadStream::Allocation uploadBufferAlloc = m_uploadStream->Allocate(size, m_fenceValue);
-    memcpy(uploadBufferAlloc.cpuAddr, initialData, size);
-    GetCurrentCmdList()->CopyBufferRegion(*ppBuffer, 0, uploadBufferAlloc.buffer, uploadBufferAlloc.bufferOffset, size);
-    if (initialState != D3D12_RESOURCE_STATE_COPY_DEST)
+    BufferUpload(*ppBuffer, 0, size, initialData);
+}
+
+void D3D12Core::BufferUpload(
+    ID3D12Resource* pBuffer,
+    uint64 offset,
+    uint32 size,
+    void* data)
+{
+    UploadStream::Allocation uploadBufferAlloc;
     {
-        D3D12_RESOURCE_TRANSITION_BARRIER transition;
-        transition.pResource = *ppBuffer;
-        transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        transition.StateAfter = initialState;
-        transition.Subresource = 0;
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
 
-        D3D12_RESOURCE_BARRIER barrier;
-        barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        barrier.Transition = transition;
+        // This thread could be anywhere between End submitting this frame's uploads and AdvanceFrame moving the fence value on,
+        // in which case the copy goes with the next frame. Tagging it with that frame's fence value covers both.
+        uploadBufferAlloc = m_uploadStream->Allocate(size, m_fenceValue + 1);
+        m_pUploadContext->GetCmdList()->CopyBufferRegion(pBuffer, offset, uploadBufferAlloc.buffer, uploadBufferAlloc.bufferOffset, size);
+        m_numUploadWrites++;
+    }
 
-        GetCurrentCmdList()->ResourceBarrier(1, &barrier);
+    // The copy can be recorded before the data's there since nothing is submitted until every write is done, see UploadsSubmit
+    memcpy(uploadBufferAlloc.cpuAddr, data, size);
+    UploadWriteEnd();
+}
+
+void D3D12Core::UploadWriteEnd(
+    void)
+{
+    std::lock_guard<std::mutex> lock(m_uploadMutex);
+    ASSERT(m_numUploadWrites > 0);
+    if (--m_numUploadWrites == 0)
+    {
+        m_uploadWritesDone.notify_all();
     }
 }
 
+uint64 D3D12Core::UploadsSubmit(
+    ID3D12CommandQueue* pQueue)
+{
+    std::unique_lock<std::mutex> lock(m_uploadMutex);
+    m_uploadWritesDone.wait(lock, [this]() { return m_numUploadWrites == 0; });
+
+    uint64 syncPoint = m_pUploadContext->Flush();
+    if (pQueue)
+    {
+        m_pUploadContext->QueueWait(pQueue);
+    }
+    return syncPoint;
+}
+
 void D3D12Core::Texture2DCreateInternal(
     const D3D12_HEAP_PROPERTIES& heapProps,
     uint32 width,
@@ -445,11 +596,11 @@ void D3D12Core::Texture2DCreateInternal(
     uint16 mipLevels,
     DXGI_FORMAT format,
     D3D12_HEAP_FLAGS heapFlags,
-    D3D12_RESOURCE_STATES initialState,
     void* initialData,
     ID3D12Resource** ppTexture)
 {
-    m_device->CreateTexture2D(heapProps, width, height, mipLevels, format, heapFlags, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_FLAG_NONE, nullptr, ppTexture);
+    // Same as buffers, textures without RT/DS flags are promoted from and decay to COMMON, see BufferCreate
+    m_device->CreateTexture2D(heapProps, width, height, mipLevels, format, heapFlags, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_FLAG_NONE, nullptr, ppTexture);
 
     uint32 rowPitch = width * GetDXGIFormatBPP(format) / 8;
     uint32 alignedRowPitch = Utils::AlignUp(rowPitch, (uint32)D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
@@ -461,120 +612,136 @@ void D3D12Core::Texture2DCreateInternal(
     footprint.Footprint.Format = format;
     footprint.Footprint.RowPitch = alignedRowPitch;
 
-    UploadStream::Allocation uploadBufferAlloc = m_uploadStream->AllocateAligned(slicePitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, m_fenceValue);
-    footprint.Offset = uploadBufferAlloc.bufferOffset;
-
-    for (uint32 i = 0; i < height; i++)
+    UploadStream::Allocation uploadBufferAlloc;
     {
-        memcpy((INT8*)uploadBufferAlloc.cpuAddr + i * alignedRowPitch, (INT8*)initialData + i * rowPitch, rowPitch);
-    }
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
 
-    D3D12_TEXTURE_COPY_LOCATION src;
-    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src.pResource = uploadBufferAlloc.buffer;
-    src.PlacedFootprint = footprint;
+        // See BufferUpload for the + 1
+        uploadBufferAlloc = m_uploadStream->AllocateAligned(slicePitch, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, m_fenceValue + 1);
+        footprint.Offset = uploadBufferAlloc.bufferOffset;
 
-    D3D12_TEXTURE_COPY_LOCATION dst;
-    dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-    dst.pResource = *ppTexture;
-    dst.SubresourceIndex = 0;
+        D3D12_TEXTURE_COPY_LOCATION src;
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.pResource = uploadBufferAlloc.buffer;
+        src.PlacedFootprint = footprint;
 
-    GetCurrentCmdList()->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        D3D12_TEXTURE_COPY_LOCATION dst;
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.pResource = *ppTexture;
+        dst.SubresourceIndex = 0;
 
-    if (initialState != D3D12_RESOURCE_STATE_COPY_DEST)
-    {
-        D3D12_RESOURCE_TRANSITION_BARRIER transition;
-        transition.pResource = *ppTexture;
-        transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        transition.StateAfter = initialState;
-        transition.Subresource = 0;
-
-        D3D12_RESOURCE_BARRIER barrier;
-        barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        barrier.Transition = transition;
+        m_pUploadContext->GetCmdList()->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        m_numUploadWrites++;
+    }
 
-        GetCurrentCmdList()->ResourceBarrier(1, &barrier);
+    // Same as BufferUpload, the rows are written outside the lock
+    for (uint32 i = 0; i < height; i++)
+    {
+        memcpy((INT8*)uploadBufferAlloc.cpuAddr + i * alignedRowPitch, (INT8*)initialData + i * rowPitch, rowPitch);
     }
+    UploadWriteEnd();
 }
 
 VertexBufferID D3D12Core::VertexBufferCreate(
     size_t vertexCount,
     Vertex* pVertexData)
 {
-    VertexBuffer vertexBuffer;
-
-    size_t vertsTotalSize = sizeof(Vertex) * vertexCount;
-
-    D3D12_HEAP_PROPERTIES heapProps = {};
-    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    // Insert first so the arena can be given the ID as the allocation's owner
+    VertexBufferID id = m_vertexBuffers.Insert(VertexBuffer());
+    if (id == VertexBufferIDInvalid)
+    {
+        EngineLog("VertexBufferCreate: Out of vertex buffer IDs\n");
+        return VertexBufferIDInvalid;
+    }
 
-    BufferCreate(heapProps, (uint32)vertsTotalSize, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, (void*)pVertexData, &vertexBuffer.pBuffer);
+    GeometryAllocation alloc;
+    ID3D12Resource* pBlockBuffer;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_geometryMutex);
 
-    vertexBuffer.view.BufferLocation = vertexBuffer.pBuffer->GetGPUVirtualAddress();
-    vertexBuffer.view.StrideInBytes = sizeof(Vertex);
-    vertexBuffer.view.SizeInBytes = (uint32)vertsTotalSize;
+        alloc = m_pVertexArena->Allocate((uint32)vertexCount, id);
+        m_vertexBuffers[id].alloc = alloc;
+        pBlockBuffer = m_pVertexArena->GetBlockBuffer(alloc.block);
+    }
 
-    vertexBuffer.vertexCount = vertexCount;
+    BufferUpload(
+        pBlockBuffer,
+        (uint64)alloc.offset * sizeof(Vertex),
+        (uint32)(sizeof(Vertex) * vertexCount),
+        (void*)pVertexData);
 
-    VertexBufferID id = m_vbidAllocator.AllocID();
-    m_vertexBuffers[id] = vertexBuffer;
     return id;
 }
 
 void D3D12Core::VertexBufferDestroy(
     VertexBufferID vbid)
 {
-    VertexBuffer& vertexBuffer = m_vertexBuffers[vbid];
-    vertexBuffer.pBuffer->Release();
-    m_vertexBuffers.erase(vbid);
-    m_vbidAllocator.FreeID(vbid);
+    std::lock_guard<std::mutex> lock(m_deferredDestroyMutex);
+    ASSERT(m_vertexBuffers.Contains(vbid));
+    m_deferredDestroys.push({ DeferredDestroyVertexBuffer, vbid, m_fenceValue });
 }
 
 IndexBufferID D3D12Core::IndexBufferCreate(
     size_t indexCount,
     uint32* pIndexData)
 {
-    IndexBuffer indexBuffer;
-
-    size_t indexTotalSize = sizeof(uint32) * indexCount;
-
-    D3D12_HEAP_PROPERTIES heapProps = {};
-    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-
-    BufferCreate(heapProps, (uint32)indexTotalSize, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, (void*)pIndexData, &indexBuffer.pBuffer);
+    IndexBufferID id = m_indexBuffers.Insert(IndexBuffer());
+    if (id == IndexBufferIDInvalid)
+    {
+        EngineLog("IndexBufferCreate: Out of index buffer IDs\n");
+        return IndexBufferIDInvalid;
+    }
 
-    indexBuffer.view.BufferLocation = indexBuffer.pBuffer->GetGPUVirtualAddress();
-    indexBuffer.view.SizeInBytes = sizeof(uint32) * (uint32)indexCount;
-    indexBuffer.view.Format = DXGI_FORMAT_R32_UINT;
+    GeometryAllocation alloc;
+    ID3D12Resource* pBlockBuffer;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_geometryMutex);
 
-    indexBuffer.indexCount = indexCount;
+        alloc = m_pIndexArena->Allocate((uint32)indexCount, id);
+        m_indexBuffers[id].alloc = alloc;
+        pBlockBuffer = m_pIndexArena->GetBlockBuffer(alloc.block);
+    }
 
+    BufferUpload(
+        pBlockBuffer,
+        (uint64)alloc.offset * sizeof(uint32),
+        (uint32)(sizeof(uint32) * indexCount),
+        (void*)pIndexData);
 
-    IndexBufferID id = m_ibidAllocator.AllocID();
-    m_indexBuffers[id] = indexBuffer;
     return id;
 }
 
 void D3D12Core::IndexBufferDestroy(
     IndexBufferID ibid)
 {
-    IndexBuffer& indexBuffer = m_indexBuffers[ibid];
-    indexBuffer.pBuffer->Release();
-    m_indexBuffers.erase(ibid);
-    m_ibidAllocator.FreeID(ibid);
+    std::lock_guard<std::mutex> lock(m_deferredDestroyMutex);
+    ASSERT(m_indexBuffers.Contains(ibid));
+    m_deferredDestroys.push({ DeferredDestroyIndexBuffer, ibid, m_fenceValue });
 }
 
-D3D12_CPU_DESCRIPTOR_HANDLE D3D12Core::AllocateCPUGeneralDescriptor(
-    void)
+uint32 D3D12Core::GeometryDefragment(
+    float maxOccupancy)
 {
-    D3D12_CPU_DESCRIPTOR_HANDLE curr = m_nextGeneralDescriptor;
-    m_nextGeneralDescriptor.ptr += m_generalDescriptorSize;
-    return curr;
+    std::unique_lock<std::shared_mutex> geometryLock(m_geometryMutex);
+    std::lock_guard<std::mutex> uploadLock(m_uploadMutex);
+
+    // The copies are uploads like any other, so the old ranges are retired the same way, see BufferUpload
+    uint64 syncPoint = m_fenceValue + 1;
+    uint32 numMoved = 0;
+
+    numMoved += m_pVertexArena->Defragment(m_pUploadContext->GetCmdList(), maxOccupancy, syncPoint,
+        [this](int32 owner, const GeometryAllocation& newAlloc)
+        {
+            m_vertexBuffers[(VertexBufferID)owner].alloc = newAlloc;
+        });
+
+    numMoved += m_pIndexArena->Defragment(m_pUploadContext->GetCmdList(), maxOccupancy, syncPoint,
+        [this](int32 owner, const GeometryAllocation& newAlloc)
+        {
+            m_indexBuffers[(IndexBufferID)owner].alloc = newAlloc;
+        });
+
+    return numMoved;
 }
 
 
@@ -609,32 +776,59 @@ TextureID D3D12Core::TextureCreate(
     int32 numChannels, 
     void* pTextureData)
 {
-    NativeTexture nativeTexture;
-
-    TextureID id = m_tidAllocator.AllocID();
-
-    // If a texture with this ID already exists, it's been 'freed' already exists, we can just reuse the descriptor
-    if (m_textures.find(id) != m_textures.end())
+    BindlessTextureSlot bindlessSlot = BindlessTextureSlotInvalid;
+#if USE_BINDLESS_TEXTURES
+    bindlessSlot = m_bindlessSlotAllocator.AllocID();
+    if (bindlessSlot == BindlessTextureSlotInvalid)
     {
-        nativeTexture = m_textures[id];
+        // Draws with the invalid ID get the default texture, see TextureBindForDraw
+        EngineLog("TextureCreate: Out of bindless texture slots\n");
+        return TextureIDInvalid;
     }
-    else
+#endif
+
+    return TextureCreateInternal(width, height, numChannels, pTextureData, bindlessSlot);
+}
+
+TextureID D3D12Core::TextureCreateInternal(
+    int32 width,
+    int32 height,
+    int32 numChannels,
+    void* pTextureData,
+    BindlessTextureSlot bindlessSlot)
+{
+    // Taken first so nothing has to be undone if the table's full
+    TextureID id = m_textures.Insert(NativeTexture());
+    if (id == TextureIDInvalid)
     {
-        nativeTexture.view = AllocateCPUGeneralDescriptor();
+        EngineLog("TextureCreate: Out of texture IDs\n");
+#if USE_BINDLESS_TEXTURES
+        if (bindlessSlot != BindlessTextureSlotDefault)
+        {
+            m_bindlessSlotAllocator.FreeID(bindlessSlot);
+        }
+#endif
+        return TextureIDInvalid;
     }
-    ASSERT(nativeTexture.pBuffer == nullptr);
 
+    // Everything from here on is thread safe on its own
+    NativeTexture& nativeTexture = m_textures[id];
+    nativeTexture.view = m_pGeneralDescriptorAllocator->Allocate();
 
     D3D12_HEAP_PROPERTIES heapProps = {};
     heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
     heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
     heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
 
-    Texture2DCreateInternal(heapProps, width, height, 1, sSelectTextureFormat(numChannels), D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, pTextureData, &nativeTexture.pBuffer);
+    Texture2DCreateInternal(heapProps, width, height, 1, sSelectTextureFormat(numChannels), D3D12_HEAP_FLAG_NONE, pTextureData, &nativeTexture.pBuffer);
 
-    m_device->CreateShaderResourceView(nativeTexture.pBuffer, NULL, nativeTexture.view);
+    m_device->CreateShaderResourceView(nativeTexture.pBuffer, NULL, nativeTexture.view.handle);
 
-    m_textures[id] = nativeTexture;
+#if USE_BINDLESS_TEXTURES
+    // Slots are only freed once the GPU is done with the last texture in them, so the descriptor is safe to overwrite
+    nativeTexture.bindlessSlot = bindlessSlot;
+    m_pDescriptorPool->PersistentDescriptorSet(nativeTexture.bindlessSlot, nativeTexture.view.handle);
+#endif
 
     return id;
 }
@@ -642,28 +836,118 @@ TextureID D3D12Core::TextureCreate(
 void D3D12Core::TextureDestroy(
     TextureID tid)
 {
-    // Intentionally do not remove the entry from the list of textures, we will reuse it (and the descriptor) for a texture allocated in the future
-    NativeTexture& nativeTexture = m_textures[tid];
-    nativeTexture.pBuffer->Release();
-    nativeTexture.pBuffer = nullptr;
-    m_tidAllocator.FreeID(tid);
+    std::lock_guard<std::mutex> lock(m_deferredDestroyMutex);
+    ASSERT(m_textures.Contains(tid));
+    m_deferredDestroys.push({ DeferredDestroyTexture, tid, m_fenceValue });
+}
+
+MaterialID D3D12Core::MaterialCreate(
+    const MaterialConstants& constants)
+{
+    std::lock_guard<std::mutex> lock(m_materialTableMutex);
+    return m_pMaterialTable->Create(constants);
+}
+
+void D3D12Core::MaterialUpdate(
+    MaterialID id,
+    const MaterialConstants& constants)
+{
+    std::lock_guard<std::mutex> lock(m_materialTableMutex);
+    m_pMaterialTable->Update(id, constants);
+}
+
+void D3D12Core::MaterialDestroy(
+    MaterialID id)
+{
+    // Nothing to defer, see MaterialTable::Destroy
+    std::lock_guard<std::mutex> lock(m_materialTableMutex);
+    m_pMaterialTable->Destroy(id);
+}
+
+void D3D12Core::DeferredDestroysProcess(
+    uint64 syncPoint)
+{
+    std::lock_guard<std::mutex> lock(m_deferredDestroyMutex);
+
+    while (!m_deferredDestroys.empty() && m_deferredDestroys.front().syncPoint < syncPoint)
+    {
+        const DeferredDestroy& destroy = m_deferredDestroys.front();
+        switch (destroy.type)
+        {
+            case DeferredDestroyVertexBuffer:
+            {
+                // Look the allocation up now rather than when the destroy was queued, defragmenting may have moved it since
+                VertexBufferID vbid = (VertexBufferID)destroy.id;
+                {
+                    std::unique_lock<std::shared_mutex> geometryLock(m_geometryMutex);
+                    m_pVertexArena->Free(m_vertexBuffers[vbid].alloc);
+                }
+                m_vertexBuffers.Remove(vbid);
+                break;
+            }
+
+            case DeferredDestroyIndexBuffer:
+            {
+                IndexBufferID ibid = (IndexBufferID)destroy.id;
+                {
+                    std::unique_lock<std::shared_mutex> geometryLock(m_geometryMutex);
+                    m_pIndexArena->Free(m_indexBuffers[ibid].alloc);
+                }
+                m_indexBuffers.Remove(ibid);
+                break;
+            }
+
+            case DeferredDestroyTexture:
+            {
+                TextureID tid = (TextureID)destroy.id;
+                NativeTexture& nativeTexture = m_textures[tid];
+                m_device->DestroyResource(nativeTexture.pBuffer);
+                m_pGeneralDescriptorAllocator->Free(nativeTexture.view);
+#if USE_BINDLESS_TEXTURES
+                if (nativeTexture.bindlessSlot != BindlessTextureSlotDefault)
+                {
+                    m_bindlessSlotAllocator.FreeID(nativeTexture.bindlessSlot);
+                }
+#endif
+                m_textures.Remove(tid);
+                break;
+            }
+
+            default:
+                ASSERT(false);
+        }
+
+        m_deferredDestroys.pop();
+    }
 }
 
 void D3D12Core::TextureBindForDraw(
+    uint32 context,
     TextureID tid,
     int32 slot)
 {
-    const NativeTexture& nativeTexture = m_textures[tid];
+    const NativeTexture& nativeTexture = m_textures.Get(tid != TextureIDInvalid ? tid : m_defaultTexture);
     ASSERT(nativeTexture.pBuffer);
 
-    m_pDescriptorPool->StageDescriptor(slot, nativeTexture.view);
+    RecordingContext& recordingContext = m_recordingContexts[context];
+
+#if USE_BINDLESS_TEXTURES
+    // Shaders only take the one texture index for now
+    ASSERT(slot == 0);
+    recordingContext.drawConstants.textureIndex = (uint32)nativeTexture.bindlessSlot;
+#else
+    recordingContext.pDescriptorPool->StageDescriptor(slot, nativeTexture.view.handle);
+#endif
 }
 
-void D3D12Core::CommandListExecute()
+void D3D12Core::CommandListExecute(
+    uint32 numCmdLists,
+    ID3D12CommandList* const* ppCmdLists)
 {
-    ASSERT_SUCCEEDED(GetCurrentCmdList()->Close());
-    ID3D12CommandList* cmdLists[] = { GetCurrentCmdList() };
-    m_cmdQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+    // Anything uploaded since the last submission has to land before these lists can use it
+    UploadsSubmit(m_cmdQueue.Get());
+
+    m_cmdQueue->ExecuteCommandLists(numCmdLists, ppCmdLists);
 }
 
 void D3D12Core::CommandListBegin()
@@ -675,6 +959,9 @@ void D3D12Core::CommandListBegin()
 
 void D3D12Core::WaitForGPU()
 {
+    // Make the direct queue wait on any outstanding uploads so its fence covers both queues
+    UploadsSubmit(m_cmdQueue.Get());
+
     const UINT64 fence = ++m_fenceValue;
     ASSERT_SUCCEEDED(m_cmdQueue->Signal(m_fence.Get(), fence));
 
@@ -690,22 +977,17 @@ void D3D12Core::Begin(
 {
     CommandListBegin();
 
-    GetCurrentCmdList()->SetGraphicsRootSignature(m_defaultRootSignature.Get());
-
-    uint32 rootParamIdx = 0;
-    GetCurrentCmdList()->SetGraphicsRootConstantBufferView(RSS_CBSTART + CBIDStatic, m_staticConstantBuffer->GetGPUVirtualAddress());
-
-
-    ID3D12DescriptorHeap* heaps[] = { m_pDescriptorPool->GetGPUDescriptorHeap() };
-    GetCurrentCmdList()->SetDescriptorHeaps(1, heaps);
-
-    GetCurrentCmdList()->RSSetViewports(1, &m_viewport);
-    GetCurrentCmdList()->RSSetScissorRects(1, &m_scissorRect);
+    // Before any draws so they see this frame's material changes
+    {
+        std::lock_guard<std::mutex> materialLock(m_materialTableMutex);
+        std::lock_guard<std::mutex> uploadLock(m_uploadMutex);
+        m_pMaterialTable->Flush(GetCurrentCmdList(), m_uploadStream, m_fenceValue);
+    }
 
     // Transition back buffer to rt
     {
         D3D12_RESOURCE_TRANSITION_BARRIER transition;
-        transition.pResource = m_renderTargets[m_frameIndex].Get();
+        transition.pResource = m_renderTargets[m_backBufferIndex].Get();
         transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
         transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
         transition.Subresource = 0;
@@ -718,43 +1000,155 @@ void D3D12Core::Begin(
         GetCurrentCmdList()->ResourceBarrier(1, &barrier);
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
-    rtvHandle.ptr = m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart().ptr + (UINT64)m_frameIndex * (UINT64)m_rtvDescriptorSize;
+    {
+        const float clearColor[] = { 86.0f / 255.0f, 0.0f / 255.0f, 94.0f / 255.0f, 1.0f };
+        GetCurrentCmdList()->ClearRenderTargetView(GetCurrentRTVHandle(), clearColor, 0, nullptr);
+        GetCurrentCmdList()->ClearDepthStencilView(m_dsvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    }
 
+    ASSERT_SUCCEEDED(GetCurrentCmdList()->Close());
+}
+
+void D3D12Core::RecordingContextBegin(
+    uint32 context)
+{
+    ASSERT(context < NUM_RECORDING_CONTEXTS);
+    RecordingContext& recordingContext = m_recordingContexts[context];
+
+    // Taken once for every draw the context records rather than draw by draw
+    recordingContext.geometryLock = std::shared_lock<std::shared_mutex>(m_geometryMutex);
+
+    ID3D12CommandAllocator* pCmdAllocator = recordingContext.cmdAllocators[m_frameIndex].Get();
+    ID3D12GraphicsCommandList* pCmdList = recordingContext.cmdLists[m_frameIndex].Get();
+    ASSERT_SUCCEEDED(pCmdAllocator->Reset());
+    ASSERT_SUCCEEDED(pCmdList->Reset(pCmdAllocator, m_pipelineState.Get()));
+
+    // Command lists don't inherit anything from the lists before them, so every context binds everything itself
+    CommandListStateCache& stateCache = recordingContext.stateCache;
+    stateCache.Reset(pCmdList, m_pipelineState.Get());
+
+    stateCache.SetGraphicsRootSignature(m_defaultRootSignature.Get());
+    stateCache.SetGraphicsRootConstantBufferView(RSS_CBSTART + CBIDStatic, m_staticConstantBuffer->GetGPUVirtualAddress());
+    stateCache.SetGraphicsRootShaderResourceView(RSS_MATERIALS, m_pMaterialTable->GetGPUVirtualAddress());
+
+    ID3D12DescriptorHeap* heaps[] = { recordingContext.pDescriptorPool->GetGPUDescriptorHeap() };
+    pCmdList->SetDescriptorHeaps(1, heaps);
+
+#if USE_BINDLESS_TEXTURES
+    stateCache.SetGraphicsRootDescriptorTable(RSS_SRVTABLE, recordingContext.pDescriptorPool->GetPersistentDescriptorTable());
+#endif
+
+    pCmdList->RSSetViewports(1, &m_viewport);
+    pCmdList->RSSetScissorRects(1, &m_scissorRect);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = GetCurrentRTVHandle();
     D3D12_CPU_DESCRIPTOR_HANDLE dsvHadle = m_dsvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+    pCmdList->OMSetRenderTargets(1, &rtvHandle, false, &dsvHadle);
 
-    GetCurrentCmdList()->OMSetRenderTargets(1, &rtvHandle, false, &dsvHadle);
+    stateCache.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    recordingContext.drawConstants = DrawConstants();
+}
+
+void D3D12Core::RecordingContextEnd(
+    uint32 context)
+{
+    RecordingContext& recordingContext = m_recordingContexts[context];
+    ASSERT_SUCCEEDED(recordingContext.cmdLists[m_frameIndex]->Close());
+    recordingContext.geometryLock.unlock();
+}
 
+ObjectConstants* D3D12Core::ObjectConstantsAllocate(
+    uint32 count)
+{
+    if (count == 0)
     {
-        const float clearColor[] = { 86.0f / 255.0f, 0.0f / 255.0f, 94.0f / 255.0f, 1.0f };
-        GetCurrentCmdList()->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-        GetCurrentCmdList()->ClearDepthStencilView(dsvHadle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-        GetCurrentCmdList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        m_numObjectConstants = 0;
+        return nullptr;
     }
+
+    std::lock_guard<std::mutex> lock(m_uploadMutex);
+    m_objectConstantsAllocation = m_uploadStream->AllocateAligned(count * sizeof(ObjectConstants), D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT, m_fenceValue);
+    m_numObjectConstants = count;
+    return (ObjectConstants*)m_objectConstantsAllocation.cpuAddr;
 }
 
 void D3D12Core::Draw(
+    uint32 context,
     VertexBufferID vbid,
-    IndexBufferID ibid)
+    IndexBufferID ibid,
+    uint32 objectIndex,
+    uint32 instanceCount)
 {
-    GetCurrentCmdList()->SetGraphicsRootDescriptorTable(RSS_SRVTABLE, m_pDescriptorPool->CommitStagedDescriptors());
+    ASSERT(instanceCount > 0);
+    ASSERT(objectIndex + instanceCount <= m_numObjectConstants);
+
+    RecordingContext& recordingContext = m_recordingContexts[context];
+    ASSERT(recordingContext.geometryLock.owns_lock());
+    CommandListStateCache& stateCache = recordingContext.stateCache;
+
+    stateCache.SetGraphicsRootShaderResourceView(RSS_OBJECTCONSTANTS, m_objectConstantsAllocation.GetGPUVirtualAddress());
+    recordingContext.drawConstants.objectIndex = objectIndex;
+
+    stateCache.SetGraphicsRoot32BitConstants(RSS_ROOTCONSTANTS, sizeof(DrawConstants) / sizeof(uint32), &recordingContext.drawConstants);
 
+#if !USE_BINDLESS_TEXTURES
+    if (recordingContext.pDescriptorPool->HasStagedDescriptors())
+    {
+        stateCache.SetGraphicsRootDescriptorTable(RSS_SRVTABLE, recordingContext.pDescriptorPool->CommitStagedDescriptors());
+    }
+#endif
+
+    // Only changes when the constant data does, see Renderer::ConstantDataSetEntry
     for (int32 i = CBIDStart; i < CBIDDynamicCount; i++)
     {
-        GetCurrentCmdList()->SetGraphicsRootConstantBufferView(RSS_CBSTART + i, m_dynamicConstantBufferAllocations[i].GetGPUVirtualAddress());
+        stateCache.SetGraphicsRootConstantBufferView(RSS_CBSTART + i, m_dynamicConstantBufferAllocations[i].GetGPUVirtualAddress());
     }
 
+    const GeometryAllocation& vertexAlloc = m_vertexBuffers.Get(vbid).alloc;
+    const GeometryAllocation& indexAlloc = m_indexBuffers.Get(ibid).alloc;
+
+    // Views always cover a whole arena block, so consecutive draws from the same block share them
+    D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+    vertexBufferView.BufferLocation = m_pVertexArena->GetBlockBuffer(vertexAlloc.block)->GetGPUVirtualAddress();
+    vertexBufferView.SizeInBytes = m_pVertexArena->GetBlockSizeInBytes(vertexAlloc.block);
+    vertexBufferView.StrideInBytes = sizeof(Vertex);
+    stateCache.IASetVertexBuffer(vertexBufferView);
+
+    D3D12_INDEX_BUFFER_VIEW indexBufferView;
+    indexBufferView.BufferLocation = m_pIndexArena->GetBlockBuffer(indexAlloc.block)->GetGPUVirtualAddress();
+    indexBufferView.SizeInBytes = m_pIndexArena->GetBlockSizeInBytes(indexAlloc.block);
+    indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    stateCache.IASetIndexBuffer(indexBufferView);
+
     // Draw
-    GetCurrentCmdList()->IASetVertexBuffers(0, 1, &m_vertexBuffers[vbid].view);
-    GetCurrentCmdList()->IASetIndexBuffer(&m_indexBuffers[ibid].view);
-    GetCurrentCmdList()->DrawIndexedInstanced((uint32)m_indexBuffers[ibid].indexCount, 1, 0, 0, 0);
+    recordingContext.cmdLists[m_frameIndex]->DrawIndexedInstanced(indexAlloc.count, instanceCount, indexAlloc.offset, (int32)vertexAlloc.offset, 0);
+}
+
+uint32 D3D12Core::GeometrySortKeyGet(
+    VertexBufferID vbid,
+    IndexBufferID ibid)
+{
+    std::shared_lock<std::shared_mutex> lock(m_geometryMutex);
+
+    uint32 vertexBlock = (uint32)m_vertexBuffers.Get(vbid).alloc.block;
+    uint32 indexBlock = (uint32)m_indexBuffers.Get(ibid).alloc.block;
+    ASSERT(vertexBlock < 256 && indexBlock < 256);
+
+    return (vertexBlock << 8) | indexBlock;
 }
 
-void D3D12Core::End()
+void D3D12Core::End(
+    uint32 numContexts)
 {
+    ASSERT(numContexts <= NUM_RECORDING_CONTEXTS);
+
+    ID3D12GraphicsCommandList* pEndCmdList = m_endCmdLists[m_frameIndex].Get();
+    ASSERT_SUCCEEDED(pEndCmdList->Reset(m_cmdAllocators[m_frameIndex].Get(), m_pipelineState.Get()));
+
     {
         D3D12_RESOURCE_TRANSITION_BARRIER transition;
-        transition.pResource = m_renderTargets[m_frameIndex].Get();
+        transition.pResource = m_renderTargets[m_backBufferIndex].Get();
         transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
         transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
         transition.Subresource = 0;
@@ -764,10 +1158,30 @@ void D3D12Core::End()
         barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
         barrier.Transition = transition;
 
-        GetCurrentCmdList()->ResourceBarrier(1, &barrier);
+        pEndCmdList->ResourceBarrier(1, &barrier);
+    }
+
+    ASSERT_SUCCEEDED(pEndCmdList->Close());
+
+    // Submitted together so the GPU runs them back to back, in the order the draws were split up in
+    ID3D12CommandList* cmdLists[NUM_RECORDING_CONTEXTS + 2];
+    uint32 numCmdLists = 0;
+    cmdLists[numCmdLists++] = GetCurrentCmdList();
+
+    m_lastFrameBindingStats = BindingStats();
+    for (uint32 context = 0; context < numContexts; context++)
+    {
+        RecordingContext& recordingContext = m_recordingContexts[context];
+        cmdLists[numCmdLists++] = recordingContext.cmdLists[m_frameIndex].Get();
+
+        const BindingStats& contextStats = recordingContext.stateCache.GetStats();
+        m_lastFrameBindingStats.bindsIssued += contextStats.bindsIssued;
+        m_lastFrameBindingStats.bindsSkipped += contextStats.bindsSkipped;
     }
 
-    CommandListExecute();
+    cmdLists[numCmdLists++] = pEndCmdList;
+
+    CommandListExecute(numCmdLists, cmdLists);
 }
 
 void D3D12Core::Present()
@@ -781,18 +1195,124 @@ void D3D12Core::AdvanceFrame(
     void)
 {
     m_pDescriptorPool->EndFrame(m_fenceValue);
+#if !USE_BINDLESS_TEXTURES
+    for (uint32 i = 1; i < NUM_RECORDING_CONTEXTS; i++)
+    {
+        m_recordingContexts[i].pDescriptorPool->EndFrame(m_fenceValue);
+    }
+#endif
 
     m_frameFenceValues[m_frameIndex] = ++m_fenceValue;
     ASSERT_SUCCEEDED(m_cmdQueue->Signal(m_fence.Get(), m_frameFenceValues[m_frameIndex]));
 
-    m_frameIndex = m_swapChain3->GetCurrentBackBufferIndex();
+    // Frames cycle through their resources on their own, the swap chain decides which back buffer is next
+    m_frameIndex = (m_frameIndex + 1) % NUM_FRAMES_IN_FLIGHT;
+    m_backBufferIndex = m_swapChain3->GetCurrentBackBufferIndex();
 
+    std::chrono::time_point<HighResClock> waitStart = HighResClock::now();
     if (m_fence->GetCompletedValue() < m_frameFenceValues[m_frameIndex])
     {
         ASSERT_SUCCEEDED(m_fence->SetEventOnCompletion(m_frameFenceValues[m_frameIndex], m_fenceEvent));
         WaitForSingleObject(m_fenceEvent, INFINITE);
     }
+    std::chrono::duration<float, std::milli> waitTime = HighResClock::now() - waitStart;
+    FrameWaitRecord(waitTime.count());
 
     m_pDescriptorPool->Reset(m_frameFenceValues[m_frameIndex]);
-    m_uploadStream->ResetAllocations(m_frameFenceValues[m_frameIndex]);
+#if !USE_BINDLESS_TEXTURES
+    for (uint32 i = 1; i < NUM_RECORDING_CONTEXTS; i++)
+    {
+        m_recordingContexts[i].pDescriptorPool->Reset(m_frameFenceValues[m_frameIndex]);
+    }
+#endif
+    {
+        std::unique_lock<std::shared_mutex> lock(m_geometryMutex);
+        m_pVertexArena->ResetRetired(m_frameFenceValues[m_frameIndex]);
+        m_pIndexArena->ResetRetired(m_frameFenceValues[m_frameIndex]);
+    }
+    DeferredDestroysProcess(m_frameFenceValues[m_frameIndex]);
+
+    {
+        std::lock_guard<std::mutex> lock(m_uploadMutex);
+        m_uploadStream->ResetAllocations(m_frameFenceValues[m_frameIndex]);
+        m_uploadStream->EndFrame();
+    }
+}
+
+uint64 D3D12Core::UploadFlush(
+    void)
+{
+    return UploadsSubmit(nullptr);
+}
+
+void D3D12Core::FrameWaitRecord(
+    float waitMs)
+{
+    m_frameStats.lastWaitMs = waitMs;
+    m_frameStats.totalWaitMs += waitMs;
+    m_frameStats.numFrames++;
+
+    if (!globals.fMeasureFrameWait)
+    {
+        return;
+    }
+
+    m_reportWaitMs += waitMs;
+    if (++m_reportFrames == FRAME_WAIT_REPORT_INTERVAL)
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "AdvanceFrame wait: %.3f ms average over %u frames (%u swap chain buffers, %u frames in flight)\n",
+            m_reportWaitMs / m_reportFrames, m_reportFrames, NUM_SWAP_CHAIN_BUFFERS, NUM_FRAMES_IN_FLIGHT);
+        EngineLog(message);
+
+        m_reportWaitMs = 0.0f;
+        m_reportFrames = 0;
+    }
+}
+
+void D3D12Core::FrameStatsGet(
+    FrameStats& statsOut)
+{
+    statsOut = m_frameStats;
+}
+
+void D3D12Core::BindingStatsGet(
+    BindingStats& statsOut)
+{
+    statsOut = m_lastFrameBindingStats;
+}
+
+void D3D12Core::DescriptorPoolStatsGet(
+    DescriptorPoolStats& statsOut)
+{
+    statsOut = m_pDescriptorPool->GetStats();
+#if !USE_BINDLESS_TEXTURES
+    for (uint32 i = 1; i < NUM_RECORDING_CONTEXTS; i++)
+    {
+        const DescriptorPoolStats& contextStats = m_recordingContexts[i].pDescriptorPool->GetStats();
+        statsOut.tableHits += contextStats.tableHits;
+        statsOut.tableMisses += contextStats.tableMisses;
+        statsOut.descriptorsCopied += contextStats.descriptorsCopied;
+    }
+#endif
+}
+
+void D3D12Core::GPUMemoryStatsGet(
+    GPUMemoryStats& statsOut)
+{
+    m_device->GetMemoryStats(statsOut);
+}
+
+void D3D12Core::UploadStreamStatsGet(
+    UploadStreamStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_uploadMutex);
+    statsOut = m_uploadStream->GetStats();
+}
+
+void D3D12Core::UploadStreamRetentionPolicySet(
+    const UploadStreamRetentionPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(m_uploadMutex);
+    m_uploadStream->SetRetentionPolicy(policy);
 }
\ No newline at end of file
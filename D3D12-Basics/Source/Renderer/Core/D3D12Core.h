@@ -1,9 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <dxgi1_6.h>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
 #include <vector>
 
-#include "Generic/IDAllocator.h"
+#include "Generic/ConcurrentIDAllocator.h"
+#include "Generic/ConcurrentSlotMap.h"
 
 #include "Renderer/VertexFormats.h"
 #include "Renderer/ConstantBuffers.h"
@@ -12,9 +18,23 @@
 #include "Renderer/Core/D3D12Header.h"
 #include "Renderer/Core/Device.h"
 #include "Renderer/Core/UploadStream.h"
+#include "Renderer/Core/D3D12UploadQueue.h"
+#include "Renderer/Core/UploadContext.h"
+#include "Renderer/Core/GeometryArena.h"
+#include "Renderer/Core/CommandListStateCache.h"
 #include "Renderer/Core/DescriptorPool.h"
+#include "Renderer/Core/DescriptorAllocator.h"
+#include "Renderer/Core/MaterialTable.h"
 
 
+// Defines /////////////////////////////////////////////////////////////////////////////////
+
+// How many threads can record draws for a frame at once, each into its own command list
+#define NUM_RECORDING_CONTEXTS 8
+
+// Frames between each frame wait report, see globals.fMeasureFrameWait
+#define FRAME_WAIT_REPORT_INTERVAL 256
+
 // Enums ///////////////////////////////////////////////////////////////////////////////////
 
 enum VertexBufferID : int32
@@ -32,28 +52,90 @@ enum TextureID : int32
     TextureIDInvalid = -1
 };
 
+// Index into the persistent region of the shader visible heap, see USE_BINDLESS_TEXTURES
+enum BindlessTextureSlot : int32
+{
+    BindlessTextureSlotInvalid = -1,
+    // Always holds the default texture, see D3D12Core::TextureBindForDraw
+    BindlessTextureSlotDefault = 0
+};
+
 // Structs /////////////////////////////////////////////////////////////////////////////////
 
+// Index and vertex buffers are ranges of one of the geometry arenas' blocks, the count is in the allocation
 struct IndexBuffer
 {
-    ID3D12Resource* pBuffer;
-    D3D12_INDEX_BUFFER_VIEW view;
-    size_t indexCount;
+    GeometryAllocation alloc;
 };
 
 struct VertexBuffer
 {
-    ID3D12Resource* pBuffer;
-    D3D12_VERTEX_BUFFER_VIEW view;
-    size_t vertexCount;
+    GeometryAllocation alloc;
 };
 
 struct NativeTexture
 {
     ID3D12Resource* pBuffer = nullptr;
-    D3D12_CPU_DESCRIPTOR_HANDLE view;
+    DescriptorAllocation view;
+    BindlessTextureSlot bindlessSlot = BindlessTextureSlotInvalid;
+};
+
+// Set through root constants for every draw, see DrawConstants in Shaders/ConstantBuffers.h
+struct DrawConstants
+{
+    // Index into the bindless texture table
+    uint32 textureIndex = 0;
+    // Index into this frame's object constants of the first instance, see D3D12Core::ObjectConstantsAllocate
+    uint32 objectIndex = 0;
+};
+
+// Everything one thread needs to record draws into its own command list, see D3D12Core::RecordingContextBegin
+struct RecordingContext
+{
+    ComPtr<ID3D12CommandAllocator> cmdAllocators[NUM_FRAMES_IN_FLIGHT];
+    ComPtr<ID3D12GraphicsCommandList> cmdLists[NUM_FRAMES_IN_FLIGHT];
+
+    CommandListStateCache stateCache;
+    DrawConstants drawConstants;
+
+    // Held from RecordingContextBegin to RecordingContextEnd, on the thread recording, so draws can look up geometry while other
+    // threads create, destroy or move it
+    std::shared_lock<std::shared_mutex> geometryLock;
+
+    // Shared when textures are bindless since draws only read the persistent table, otherwise each context stages and commits its
+    // own tables
+    DescriptorPool* pDescriptorPool = nullptr;
+};
+
+// Time AdvanceFrame spent blocked on the GPU finishing the frame NUM_FRAMES_IN_FLIGHT ago, which is how long the CPU sat idle
+// because it got too far ahead
+struct FrameStats
+{
+    float lastWaitMs = 0.0f;
+    float totalWaitMs = 0.0f;
+    uint64 numFrames = 0;
 };
 
+enum DeferredDestroyType : int32
+{
+    DeferredDestroyVertexBuffer,
+    DeferredDestroyIndexBuffer,
+    DeferredDestroyTexture
+};
+
+// Frames in flight can still be using anything destroyed this frame, so the memory, descriptor and ID are only given back once
+// the GPU has passed syncPoint
+struct DeferredDestroy
+{
+    DeferredDestroyType type;
+    int32 id;
+    uint64 syncPoint;
+};
+
+typedef ConcurrentSlotMap<VertexBufferID, VertexBuffer> VertexBufferMap;
+typedef ConcurrentSlotMap<IndexBufferID, IndexBuffer> IndexBufferMap;
+typedef ConcurrentSlotMap<TextureID, NativeTexture> TextureMap;
+
 // Classes /////////////////////////////////////////////////////////////////////////////////
 
 class D3D12Core
@@ -72,10 +154,18 @@ public:
         const D3D12_HEAP_PROPERTIES& heapProps,
         uint32 size,
         D3D12_HEAP_FLAGS heapFlags,
-        D3D12_RESOURCE_STATES initialState,
         void* initialData,
         ID3D12Resource** ppBuffer);
 
+    void BufferUpload(
+        ID3D12Resource* pBuffer,
+        uint64 offset,
+        uint32 size,
+        void* data);
+
+    // Resource creation and destruction is thread safe, so assets can be loaded from several threads at once, including while a
+    // frame is being recorded. Destroying something a frame being recorded still draws isn't, see Renderer::PipelineFlush. IDs are
+    // handed out without locking, and creates return an invalid ID once their table is full.
     VertexBufferID VertexBufferCreate(
         size_t vertexCount,
         Vertex* pVertexData);
@@ -99,17 +189,36 @@ public:
     void TextureDestroy(
        TextureID ibid);
 
+    MaterialID MaterialCreate(
+        const MaterialConstants& constants);
+
+    // Only re-uploaded if the constants actually changed
+    void MaterialUpdate(
+        MaterialID id,
+        const MaterialConstants& constants);
+
+    void MaterialDestroy(
+        MaterialID id);
+
+    // Every draw has to have its textures bound since recording contexts start from nothing. TextureIDInvalid binds a 1x1 white
+    // texture, so untextured materials just show their diffuse colour.
     void TextureBindForDraw(
+        uint32 context,
         TextureID tid,
         int32 slot);
 
+    // Packs geometry out of blocks less than maxOccupancy full, see GeometryArena::Defragment
+    uint32 GeometryDefragment(
+        float maxOccupancy);
+
     void ConstantBufferSetData(
         ConstantBufferID id,
         size_t size,
         void* data);
 
     void CommandListExecute(
-        void);
+        uint32 numCmdLists,
+        ID3D12CommandList* const* ppCmdLists);
 
     void CommandListBegin(
         void);
@@ -117,15 +226,38 @@ public:
     void WaitForGPU(
         void);
 
+    // Records the start of the frame, i.e. material uploads and clearing the render target, into the frame's own command list
     void Begin(
         void);
 
+    // Draws are recorded between these into one of NUM_RECORDING_CONTEXTS contexts. Different contexts can be recorded on different
+    // threads at the same time, between Begin and End.
+    void RecordingContextBegin(
+        uint32 context);
+
+    void RecordingContextEnd(
+        uint32 context);
+
+    // Returns space for count ObjectConstants, only valid for this frame. Write them all in one go before drawing and pass each draw
+    // the index of its first instance's element, the rest of its instances' must follow it. Call before RecordingContextBegin.
+    ObjectConstants* ObjectConstantsAllocate(
+        uint32 count);
+
     void Draw(
+        uint32 context,
+        VertexBufferID vbid,
+        IndexBufferID ibid,
+        uint32 objectIndex,
+        uint32 instanceCount);
+
+    // Identifies the arena blocks the buffers live in, draws with the same value can share vertex and index buffer views
+    uint32 GeometrySortKeyGet(
         VertexBufferID vbid,
         IndexBufferID ibid);
 
+    // Submits the frame's command list, then contexts 0 to numContexts - 1 in order, in one ExecuteCommandLists
     void End(
-        void);
+        uint32 numContexts);
 
     void Present(
         void);
@@ -133,10 +265,37 @@ public:
     void AdvanceFrame(
         void);
 
+    // Submits uploads recorded so far to the copy queue without waiting for the next frame to be executed
+    uint64 UploadFlush(
+        void);
+
+    // Bindings issued and skipped by the state cache over the last frame
+    void BindingStatsGet(
+        BindingStats& statsOut);
+
+    void FrameStatsGet(
+        FrameStats& statsOut);
+
+    void DescriptorPoolStatsGet(
+        DescriptorPoolStats& statsOut);
+
+    void GPUMemoryStatsGet(
+        GPUMemoryStats& statsOut);
+
+    void UploadStreamStatsGet(
+        UploadStreamStats& statsOut);
+
+    void UploadStreamRetentionPolicySet(
+        const UploadStreamRetentionPolicy& policy);
+
 private:
 
-    D3D12_CPU_DESCRIPTOR_HANDLE AllocateCPUGeneralDescriptor(
-        void);
+    TextureID TextureCreateInternal(
+        int32 width,
+        int32 height,
+        int32 numChannels,
+        void* pTextureData,
+        BindlessTextureSlot bindlessSlot);
 
     void Texture2DCreateInternal(
         const D3D12_HEAP_PROPERTIES& heapProps,
@@ -145,13 +304,27 @@ private:
         uint16 mipLevels,
         DXGI_FORMAT format,
         D3D12_HEAP_FLAGS heapFlags,
-        D3D12_RESOURCE_STATES initialState,
         void* initialData,
         ID3D12Resource** ppTexture);
 
     void CreateRootSignature(
         void);
 
+    // Called once a copy into staging memory BufferUpload or Texture2DCreateInternal recorded an upload for has been written
+    void UploadWriteEnd(
+        void);
+
+    // Waits for any staging memory still being written on other threads, then submits the uploads recorded so far. If pQueue is
+    // given it waits for them before running anything submitted to it after this.
+    uint64 UploadsSubmit(
+        ID3D12CommandQueue* pQueue);
+
+    void DeferredDestroysProcess(
+        uint64 syncPoint);
+
+    void FrameWaitRecord(
+        float waitMs);
+
     void ConstantBuffersInit(
         void);
 
@@ -160,21 +333,33 @@ private:
         return m_cmdLists[m_frameIndex].Get();
     }
 
+    D3D12_CPU_DESCRIPTOR_HANDLE GetCurrentRTVHandle()
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
+        rtvHandle.ptr = m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart().ptr + (UINT64)m_backBufferIndex * (UINT64)m_rtvDescriptorSize;
+        return rtvHandle;
+    }
+
 
     D3D12_VIEWPORT m_viewport;
     D3D12_RECT  m_scissorRect;
 
     Device* m_device;
     ComPtr<ID3D12CommandQueue> m_cmdQueue;
-    ComPtr<ID3D12CommandAllocator> m_cmdAllocators[NUM_SWAP_CHAIN_BUFFERS];
-    ComPtr<ID3D12GraphicsCommandList> m_cmdLists[NUM_SWAP_CHAIN_BUFFERS];
+    ComPtr<ID3D12CommandAllocator> m_cmdAllocators[NUM_FRAMES_IN_FLIGHT];
+    ComPtr<ID3D12GraphicsCommandList> m_cmdLists[NUM_FRAMES_IN_FLIGHT];
+    // Transitions the back buffer for present after every context's draws, recorded with m_cmdAllocators once m_cmdLists is closed
+    ComPtr<ID3D12GraphicsCommandList> m_endCmdLists[NUM_FRAMES_IN_FLIGHT];
+
+    RecordingContext m_recordingContexts[NUM_RECORDING_CONTEXTS];
 
     ComPtr<ID3D12DescriptorHeap> m_rtvDescriptorHeap;
     ComPtr<ID3D12Resource> m_renderTargets[NUM_SWAP_CHAIN_BUFFERS];
     uint32 m_rtvDescriptorSize;
 
     ComPtr<ID3D12DescriptorHeap> m_dsvDescriptorHeap;
-    ComPtr<ID3D12Resource> m_depthStencil;
+    // Placed by the device like any other default heap texture, so released through it too
+    ID3D12Resource* m_pDepthStencil = nullptr;
 
     ComPtr<ID3D12RootSignature> m_defaultRootSignature;
 
@@ -184,34 +369,73 @@ private:
     // we free the upload stream memory independent of the allocations it provides.
     UploadStream::Allocation m_dynamicConstantBufferAllocations[CBIDDynamicCount];
 
-    // 'General' i.e. CBV + SRV + UAV
-    ComPtr<ID3D12DescriptorHeap> m_generalDescriptorHeap;
-    uint32 m_generalDescriptorSize;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_nextGeneralDescriptor;
+    // This frame's ObjectConstants, bound as a root SRV
+    UploadStream::Allocation m_objectConstantsAllocation;
+    uint32 m_numObjectConstants;
+
+    // 'General' i.e. CBV + SRV + UAV, views are created here and copied into m_pDescriptorPool's heap to be used
+    DescriptorAllocator* m_pGeneralDescriptorAllocator;
 
     DescriptorPool* m_pDescriptorPool;
 
+    // Every material's constants, written to the GPU only when they change and bound as a root SRV
+    MaterialTable* m_pMaterialTable;
+
     ComPtr<ID3D12Resource> m_texture;
      
     ComPtr<ID3D12PipelineState> m_pipelineState;
 
     UploadStream* m_uploadStream;
+    D3D12UploadQueue* m_pUploadQueue;
+    UploadContext* m_pUploadContext;
+
+    GeometryArena* m_pVertexArena;
+    GeometryArena* m_pIndexArena;
+
+    // Summed over every context recorded last frame
+    BindingStats m_lastFrameBindingStats;
+
+    FrameStats m_frameStats;
+    // Wait time and frames since the last report, see globals.fMeasureFrameWait
+    float m_reportWaitMs = 0.0f;
+    uint32 m_reportFrames = 0;
+
+    // IDs handed out to the rest of the engine are handles into these
+    VertexBufferMap m_vertexBuffers;
+    IndexBufferMap m_indexBuffers;
+    TextureMap m_textures;
+
+    // Guards the geometry arenas and the allocations in the geometry tables, which defragmenting moves. Recording contexts share it.
+    std::shared_mutex m_geometryMutex;
+
+    std::mutex m_materialTableMutex;
+    std::mutex m_deferredDestroyMutex;
+
+    // Guards the upload stream and upload context's command list, for the render thread's per frame allocations as well as uploads.
+    // Staging memory for uploads is written outside it, m_numUploadWrites counts the writes still going so uploads aren't submitted
+    // before their data is there.
+    std::mutex m_uploadMutex;
+    std::condition_variable m_uploadWritesDone;
+    uint32 m_numUploadWrites = 0;
 
-    // TODO : Don't use unordered map because its bad 
-    IDAllocator<VertexBufferID> m_vbidAllocator = IDAllocator<VertexBufferID>(VertexBufferID(0));
-    std::unordered_map<VertexBufferID, VertexBuffer> m_vertexBuffers;
+    // Hands out every slot but BindlessTextureSlotDefault
+    ConcurrentIDAllocator<BindlessTextureSlot> m_bindlessSlotAllocator;
 
-    IDAllocator<IndexBufferID> m_ibidAllocator = IDAllocator<IndexBufferID>(IndexBufferID(0));
-    std::unordered_map<IndexBufferID, IndexBuffer> m_indexBuffers;
+    // Bound for draws without a texture, see TextureBindForDraw
+    TextureID m_defaultTexture = TextureIDInvalid;
 
-    IDAllocator<TextureID> m_tidAllocator = IDAllocator<TextureID>(TextureID(0));
-    std::unordered_map<TextureID, NativeTexture> m_textures;
+    // In fence order, so we can stop at the first one the GPU hasn't got past
+    std::queue<DeferredDestroy> m_deferredDestroys;
 
+    // Which of the per frame resources are being recorded into, and which back buffer is being drawn to. They only line up when
+    // NUM_FRAMES_IN_FLIGHT and NUM_SWAP_CHAIN_BUFFERS are the same.
     uint32 m_frameIndex = 0;
+    uint32 m_backBufferIndex = 0;
     HANDLE m_fenceEvent;
     ComPtr<ID3D12Fence> m_fence;
-    UINT64 m_fenceValue;
-    UINT64 m_frameFenceValues[NUM_SWAP_CHAIN_BUFFERS];
+    // Only changed by the thread rendering, but read when tagging uploads and destroys on any thread
+    std::atomic<UINT64> m_fenceValue;
+    UINT64 m_frameFenceValues[NUM_FRAMES_IN_FLIGHT];
 
     // DXGI
     ComPtr<IDXGIFactory2> m_dxgiFactory2;
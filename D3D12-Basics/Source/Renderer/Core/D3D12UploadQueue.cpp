@@ -0,0 +1,74 @@
+#include "D3D12UploadQueue.h"
+
+#include "Device.h"
+
+D3D12UploadQueue::D3D12UploadQueue(
+    Device* pDevice)
+{
+    ASSERT(pDevice);
+    m_pDevice = pDevice;
+
+    D3D12_COMMAND_QUEUE_DESC desc = {};
+    desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    m_pDevice->CreateCommandQueue(desc, m_copyQueue.GetAddressOf());
+
+    for (int32 i = 0; i < UPLOAD_CONTEXT_NUM_BATCHES; i++)
+    {
+        m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, &m_cmdAllocators[i]);
+    }
+
+    // Created open, but the first batch resets it anyway
+    m_pDevice->CreateGraphicsCommandList(D3D12_COMMAND_LIST_TYPE_COPY, m_cmdAllocators[0].Get(), nullptr, &m_cmdList);
+    ASSERT_SUCCEEDED(m_cmdList->Close());
+
+    m_pDevice->CreateFence(0, &m_fence);
+    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    ASSERT(m_fenceEvent);
+}
+
+D3D12UploadQueue::~D3D12UploadQueue()
+{
+    CloseHandle(m_fenceEvent);
+}
+
+ID3D12GraphicsCommandList* D3D12UploadQueue::BatchBegin(
+    uint32 batch)
+{
+    ASSERT_SUCCEEDED(m_cmdAllocators[batch]->Reset());
+    ASSERT_SUCCEEDED(m_cmdList->Reset(m_cmdAllocators[batch].Get(), nullptr));
+    return m_cmdList.Get();
+}
+
+void D3D12UploadQueue::BatchSubmit(
+    uint32 batch,
+    uint64 fenceValue)
+{
+    (void)batch;
+
+    ASSERT_SUCCEEDED(m_cmdList->Close());
+    ID3D12CommandList* cmdLists[] = { m_cmdList.Get() };
+    m_copyQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+
+    ASSERT_SUCCEEDED(m_copyQueue->Signal(m_fence.Get(), fenceValue));
+}
+
+void D3D12UploadQueue::QueueWait(
+    ID3D12CommandQueue* pQueue,
+    uint64 fenceValue)
+{
+    ASSERT_SUCCEEDED(pQueue->Wait(m_fence.Get(), fenceValue));
+}
+
+uint64 D3D12UploadQueue::GetFenceCompletedValue(
+    void)
+{
+    return m_fence->GetCompletedValue();
+}
+
+void D3D12UploadQueue::FenceWait(
+    uint64 fenceValue)
+{
+    ASSERT_SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+    WaitForSingleObject(m_fenceEvent, INFINITE);
+}
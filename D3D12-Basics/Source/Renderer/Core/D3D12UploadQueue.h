@@ -0,0 +1,42 @@
+#pragma once
+#include "D3D12Header.h"
+#include "UploadContext.h"
+
+class Device;
+
+// UploadContext's copy queue, with a command list shared by every batch and an allocator for each
+class D3D12UploadQueue : public UploadQueue
+{
+public:
+    D3D12UploadQueue(
+        Device* pDevice);
+
+    ~D3D12UploadQueue();
+
+    ID3D12GraphicsCommandList* BatchBegin(
+        uint32 batch) override;
+
+    void BatchSubmit(
+        uint32 batch,
+        uint64 fenceValue) override;
+
+    void QueueWait(
+        ID3D12CommandQueue* pQueue,
+        uint64 fenceValue) override;
+
+    uint64 GetFenceCompletedValue(
+        void) override;
+
+    void FenceWait(
+        uint64 fenceValue) override;
+
+private:
+    Device* m_pDevice;
+
+    ComPtr<ID3D12CommandQueue> m_copyQueue;
+    ComPtr<ID3D12GraphicsCommandList> m_cmdList;
+    ComPtr<ID3D12CommandAllocator> m_cmdAllocators[UPLOAD_CONTEXT_NUM_BATCHES];
+
+    HANDLE m_fenceEvent;
+    ComPtr<ID3D12Fence> m_fence;
+};
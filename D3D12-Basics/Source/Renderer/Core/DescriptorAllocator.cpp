@@ -0,0 +1,96 @@
+#include "DescriptorAllocator.h"
+
+#include "Device.h"
+
+DescriptorAllocator::DescriptorAllocator(
+    Device* pDevice,
+    D3D12_DESCRIPTOR_HEAP_TYPE type,
+    uint32 descriptorsPerPage) :
+    m_allocator(descriptorsPerPage)
+{
+    ASSERT(descriptorsPerPage > 0);
+    m_pDevice = pDevice;
+    m_type = type;
+    m_descriptorsPerPage = descriptorsPerPage;
+    m_descriptorSize = 0;
+
+    CreatePageHeap(0);
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+}
+
+void DescriptorAllocator::CreatePageHeap(
+    int32 page)
+{
+    if (page >= (int32)m_pageHeaps.size())
+    {
+        m_pageHeaps.resize(page + 1);
+    }
+
+    PageHeap& pageHeap = m_pageHeaps[page];
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.NumDescriptors = m_allocator.GetPageSize(page);
+    desc.Type = m_type;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    m_pDevice->CreateDescriptorHeap(desc, &pageHeap.heap, m_descriptorSize);
+    pageHeap.start = pageHeap.heap->GetCPUDescriptorHandleForHeapStart();
+}
+
+DescriptorAllocation DescriptorAllocator::Allocate(
+    uint32 count)
+{
+    ASSERT(count > 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    DescriptorAllocation alloc;
+    int32 page;
+    uint32 offset;
+    if (m_allocator.Allocate(count, page, offset))
+    {
+        CreatePageHeap(page);
+    }
+
+    alloc.handle.ptr = m_pageHeaps[page].start.ptr + (SIZE_T)offset * m_descriptorSize;
+    alloc.count = count;
+    alloc.page = page;
+    return alloc;
+}
+
+void DescriptorAllocator::Free(
+    DescriptorAllocation& alloc)
+{
+    if (alloc.IsNull())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    PageHeap& pageHeap = m_pageHeaps[alloc.page];
+    ASSERT(pageHeap.heap);
+    uint32 offset = (uint32)((alloc.handle.ptr - pageHeap.start.ptr) / m_descriptorSize);
+    if (m_allocator.Free(alloc.page, offset, alloc.count))
+    {
+        pageHeap = PageHeap();
+    }
+
+    alloc = DescriptorAllocation();
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetHandle(
+    const DescriptorAllocation& alloc,
+    uint32 index)
+{
+    ASSERT(index < alloc.count);
+    return { alloc.handle.ptr + (SIZE_T)index * m_descriptorSize };
+}
+
+void DescriptorAllocator::GetStats(
+    DescriptorAllocatorStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_allocator.GetStats(statsOut.numPages, statsOut.descriptorsAllocated, statsOut.descriptorsFree);
+}
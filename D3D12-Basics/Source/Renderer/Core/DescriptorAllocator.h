@@ -0,0 +1,81 @@
+#pragma once
+#include "D3D12Header.h"
+
+#include "Generic/PagedOffsetAllocator.h"
+
+#include <mutex>
+#include <vector>
+
+class Device;
+
+// A contiguous range of descriptors from one of an allocator's pages
+struct DescriptorAllocation
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = { 0 };
+    uint32 count = 0;
+    int32 page = -1;
+
+    bool IsNull()
+    {
+        return count == 0;
+    }
+};
+
+struct DescriptorAllocatorStats
+{
+    uint32 numPages = 0;
+    uint32 descriptorsAllocated = 0;
+    uint32 descriptorsFree = 0;
+};
+
+// Allocates descriptors out of non shader visible heaps, for views which are created once and copied into the shader visible heap
+// when used. Heaps ('pages') are added as they're needed, and ranges bigger than a page get a page of their own, see
+// PagedOffsetAllocator. Thread safe.
+// Frees are immediate, so it's up to the caller not to free anything which still has to be copied from.
+class DescriptorAllocator
+{
+public:
+    DescriptorAllocator(
+        Device* pDevice,
+        D3D12_DESCRIPTOR_HEAP_TYPE type,
+        uint32 descriptorsPerPage);
+
+    ~DescriptorAllocator();
+
+    DescriptorAllocation Allocate(
+        uint32 count = 1);
+
+    void Free(
+        DescriptorAllocation& alloc);
+
+    // Handle of the index'th descriptor in alloc
+    D3D12_CPU_DESCRIPTOR_HANDLE GetHandle(
+        const DescriptorAllocation& alloc,
+        uint32 index);
+
+    void GetStats(
+        DescriptorAllocatorStats& statsOut);
+
+private:
+    struct PageHeap
+    {
+        ComPtr<ID3D12DescriptorHeap> heap;
+        D3D12_CPU_DESCRIPTOR_HANDLE start = { 0 };
+    };
+
+    void CreatePageHeap(
+        int32 page);
+
+    Device* m_pDevice;
+
+    D3D12_DESCRIPTOR_HEAP_TYPE m_type;
+    uint32 m_descriptorSize;
+    uint32 m_descriptorsPerPage;
+
+    PagedOffsetAllocator m_allocator;
+
+    // Indexed by DescriptorAllocation::page, released pages leave an empty heap behind
+    std::vector<PageHeap> m_pageHeaps;
+
+    std::mutex m_mutex;
+};
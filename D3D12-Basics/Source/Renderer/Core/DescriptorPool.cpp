@@ -6,15 +6,17 @@ DescriptorPool::DescriptorPool(
     Device* pDevice,
     D3D12_DESCRIPTOR_HEAP_TYPE type,
     uint32 maxResidentDescriptors,
-    uint32 numSlots)
+    uint32 numSlots,
+    uint32 numPersistentDescriptors)
 {
     m_pDevice = pDevice;
     m_type = type;
     m_maxSlots = numSlots;
     m_maxResidentDescriptors = maxResidentDescriptors;
+    m_numPersistentDescriptors = numPersistentDescriptors;
 
     D3D12_DESCRIPTOR_HEAP_DESC gpuPoolDesc = {};
-    gpuPoolDesc.NumDescriptors = maxResidentDescriptors;
+    gpuPoolDesc.NumDescriptors = m_numPersistentDescriptors + m_maxResidentDescriptors;
     gpuPoolDesc.Type = m_type;
     gpuPoolDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     m_pDevice->CreateDescriptorHeap(gpuPoolDesc, &m_gpuPool, m_descriptorSize);
@@ -25,17 +27,27 @@ DescriptorPool::DescriptorPool(
     cpuPoolDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     m_pDevice->CreateDescriptorHeap(cpuPoolDesc, &m_cpuPool);
 
-    m_lastStagedSlot = -1;
+    m_stagedHandles.resize(m_maxSlots);
+    ClearStaged();
 
-    m_head = 0;
-    m_currTail = 0;
+    // The ring starts after the persistent region
+    m_head = m_numPersistentDescriptors;
+    m_currTail = m_numPersistentDescriptors;
+}
+
+void DescriptorPool::PersistentDescriptorSet(
+    uint32 index,
+    D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+    ASSERT(index < m_numPersistentDescriptors);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE dest = { m_gpuPool->GetCPUDescriptorHandleForHeapStart().ptr + index * m_descriptorSize };
+    m_pDevice->GetNativeDevice()->CopyDescriptorsSimple(1, dest, handle, m_type);
 }
 
 void DescriptorPool::Reset(
     uint64 syncPoint)
 {
-    ASSERT(m_lastStagedSlot == -1);
-
     if (m_tails.empty())
     {
         return;
@@ -59,8 +71,27 @@ void DescriptorPool::Reset(
 void DescriptorPool::EndFrame(
     uint64 syncPoint)
 {
-    ASSERT(m_lastStagedSlot == -1);
     m_tails.emplace(m_currTail, syncPoint);
+
+    // The last committed table belongs to this frame, and descriptors behind the staged handles may be rewritten once it's done
+    ClearStaged();
+    m_committedTables.clear();
+    m_committedHandles.clear();
+
+    m_lastFrameStats = m_frameStats;
+    m_frameStats = DescriptorPoolStats();
+}
+
+void DescriptorPool::ClearStaged(
+    void)
+{
+    for (D3D12_CPU_DESCRIPTOR_HANDLE& handle : m_stagedHandles)
+    {
+        handle.ptr = 0;
+    }
+    m_numStagedSlots = 0;
+    m_fStagedChanged = false;
+    m_lastCommitted.ptr = 0;
 }
 
 
@@ -68,22 +99,53 @@ void DescriptorPool::StageDescriptor(
     int32 slot,
     D3D12_CPU_DESCRIPTOR_HANDLE handle)
 {
+    ASSERT(slot >= 0 && slot < (int32)m_maxSlots);
+    if (m_stagedHandles[slot].ptr == handle.ptr)
+    {
+        return;
+    }
+
     D3D12_CPU_DESCRIPTOR_HANDLE dest = { m_cpuPool->GetCPUDescriptorHandleForHeapStart().ptr + slot * m_descriptorSize };
     m_pDevice->GetNativeDevice()->CopyDescriptorsSimple(1, dest, handle, m_type);
-    m_lastStagedSlot = std::max(slot, m_lastStagedSlot);
+
+    m_stagedHandles[slot] = handle;
+    m_numStagedSlots = std::max((uint32)slot + 1, m_numStagedSlots);
+    m_fStagedChanged = true;
 }
 
 D3D12_GPU_DESCRIPTOR_HANDLE DescriptorPool::CommitStagedDescriptors(
     void)
 {
-    ASSERT(m_lastStagedSlot >= 0);
+    ASSERT(m_numStagedSlots > 0);
+    if (!m_fStagedChanged)
+    {
+        m_frameStats.tableHits++;
+        return m_lastCommitted;
+    }
+
+    uint32 descriptorsToCommit = m_numStagedSlots;
+    m_fStagedChanged = false;
+
+    // Reuse a table committed earlier this frame if one has exactly the same handles
+    uint64 hash = Utils::Hash(m_stagedHandles.data(), descriptorsToCommit * sizeof(D3D12_CPU_DESCRIPTOR_HANDLE));
+    auto range = m_committedTables.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++)
+    {
+        const CommittedTable& table = it->second;
+        if (table.numHandles == descriptorsToCommit &&
+            memcmp(&m_committedHandles[table.firstHandle], m_stagedHandles.data(), descriptorsToCommit * sizeof(D3D12_CPU_DESCRIPTOR_HANDLE)) == 0)
+        {
+            m_frameStats.tableHits++;
+            m_lastCommitted = table.gpuHandle;
+            return m_lastCommitted;
+        }
+    }
 
-    uint32 descriptorsToCommit = m_lastStagedSlot + 1;
     // Wrap back around if we've reached the end
-    if (m_currTail + descriptorsToCommit >= m_maxResidentDescriptors)
+    if (m_currTail + descriptorsToCommit >= m_numPersistentDescriptors + m_maxResidentDescriptors)
     {
-        ASSERT(m_head != 0);
-        m_currTail = 0;
+        ASSERT(m_head != m_numPersistentDescriptors);
+        m_currTail = m_numPersistentDescriptors;
     }
 
     // Descriptor Pool out of memory
@@ -95,7 +157,17 @@ D3D12_GPU_DESCRIPTOR_HANDLE DescriptorPool::CommitStagedDescriptors(
 
     m_pDevice->GetNativeDevice()->CopyDescriptorsSimple(descriptorsToCommit, dest, m_cpuPool->GetCPUDescriptorHandleForHeapStart(), m_type);
     m_currTail += descriptorsToCommit;
-    m_lastStagedSlot = -1;
-    
-    return { m_gpuPool->GetGPUDescriptorHandleForHeapStart().ptr + gpuStartOffset };
+
+    m_lastCommitted = { m_gpuPool->GetGPUDescriptorHandleForHeapStart().ptr + gpuStartOffset };
+
+    CommittedTable table;
+    table.gpuHandle = m_lastCommitted;
+    table.firstHandle = (uint32)m_committedHandles.size();
+    table.numHandles = descriptorsToCommit;
+    m_committedHandles.insert(m_committedHandles.end(), m_stagedHandles.begin(), m_stagedHandles.begin() + descriptorsToCommit);
+    m_committedTables.emplace(hash, table);
+
+    m_frameStats.tableMisses++;
+    m_frameStats.descriptorsCopied += descriptorsToCommit;
+    return m_lastCommitted;
 }
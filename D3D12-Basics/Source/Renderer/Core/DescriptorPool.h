@@ -2,10 +2,22 @@
 #include "D3D12Header.h"
 
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 class Device;
 
+struct DescriptorPoolStats
+{
+    // Commits which found an identical table already committed this frame, and ones which had to copy out a new one
+    uint32 tableHits = 0;
+    uint32 tableMisses = 0;
+    uint32 descriptorsCopied = 0;
+};
+
 // Naive descriptor pool, not set up for multi-frame synchronisation. Will improve on this later
+// The first numPersistentDescriptors of the shader visible heap are set aside for descriptors which are written once and left there
+// (e.g. bindless textures), tables are committed into a ring over the rest.
 class DescriptorPool
 {
 public:
@@ -13,15 +25,36 @@ public:
         Device* pDevice,
         D3D12_DESCRIPTOR_HEAP_TYPE type,
         uint32 maxResidentDescriptors,
-        uint32 numSlots);
+        uint32 numSlots,
+        uint32 numPersistentDescriptors = 0);
+
+    // Copies handle into the persistent region. Nothing tracks whether the GPU is still reading the old descriptor, so only
+    // overwrite an index once whatever used it has been retired.
+    void PersistentDescriptorSet(
+        uint32 index,
+        D3D12_CPU_DESCRIPTOR_HANDLE handle);
+
+    // The whole persistent region as one table, persistent descriptor i is at index i
+    D3D12_GPU_DESCRIPTOR_HANDLE GetPersistentDescriptorTable(
+        void)
+    {
+        ASSERT(m_numPersistentDescriptors > 0);
+        return m_gpuPool->GetGPUDescriptorHandleForHeapStart();
+    }
 
     void StageDescriptor(
         int32 slot,
         D3D12_CPU_DESCRIPTOR_HANDLE handle);
 
+    // Returns the last committed table if nothing has changed since, rather than copying out an identical one
     D3D12_GPU_DESCRIPTOR_HANDLE CommitStagedDescriptors(
         void);
 
+    bool HasStagedDescriptors()
+    {
+        return m_numStagedSlots > 0;
+    }
+
     void Reset(
         uint64 syncPoint);
 
@@ -33,17 +66,32 @@ public:
         return m_gpuPool.Get();
     }
 
+    // Stats for the last frame that was ended
+    const DescriptorPoolStats& GetStats()
+    {
+        return m_lastFrameStats;
+    }
+
 
 private:
+    void ClearStaged(
+        void);
+
     Device* m_pDevice;
 
     D3D12_DESCRIPTOR_HEAP_TYPE m_type;
     uint32 m_descriptorSize;
     uint32 m_maxSlots;
     uint32 m_maxResidentDescriptors;
+    uint32 m_numPersistentDescriptors;
 
     ComPtr<ID3D12DescriptorHeap> m_cpuPool;
-    int32 m_lastStagedSlot;
+
+    // What was last copied into each slot of the cpu pool. Slots stay staged across commits until the end of the frame.
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_stagedHandles;
+    uint32 m_numStagedSlots;
+    bool m_fStagedChanged;
+    D3D12_GPU_DESCRIPTOR_HANDLE m_lastCommitted;
 
     ComPtr<ID3D12DescriptorHeap> m_gpuPool;
     uint32 m_head;
@@ -60,5 +108,21 @@ private:
     };
 
     std::queue<Tail> m_tails;
+
+    // Tables committed this frame, keyed on a hash of their staged handles. Cleared at EndFrame since the tables are only
+    // guaranteed to stay resident until the frame that committed them completes.
+    struct CommittedTable
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+        // Range of m_committedHandles holding the handles the table was made from, to rule out hash collisions
+        uint32 firstHandle;
+        uint32 numHandles;
+    };
+
+    std::unordered_multimap<uint64, CommittedTable> m_committedTables;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_committedHandles;
+
+    DescriptorPoolStats m_frameStats;
+    DescriptorPoolStats m_lastFrameStats;
 };
 
@@ -10,6 +10,13 @@ Device::Device()
 {
     // Create Device
     ASSERT_SUCCEEDED(D3D12CreateDevice(NULL, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&m_device)));
+
+    m_pMemoryAllocator = new GPUMemoryAllocator(m_device.Get());
+}
+
+Device::~Device()
+{
+    delete m_pMemoryAllocator;
 }
 
 void Device::CreateCommandQueue(
@@ -20,11 +27,12 @@ void Device::CreateCommandQueue(
 }
 
 void Device::CreateGraphicsCommandList(
+    D3D12_COMMAND_LIST_TYPE type,
     ID3D12CommandAllocator* cmdAllocator,
     ID3D12PipelineState* pipelineState,
     ID3D12GraphicsCommandList** ppCmdList)
 {
-    ASSERT_SUCCEEDED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, cmdAllocator, pipelineState, IID_PPV_ARGS(ppCmdList)));
+    ASSERT_SUCCEEDED(m_device->CreateCommandList(0, type, cmdAllocator, pipelineState, IID_PPV_ARGS(ppCmdList)));
     ASSERT_SUCCEEDED((*ppCmdList)->Close());
 }
 
@@ -118,14 +126,7 @@ void Device::CreateBuffer(
     resourceDesc.SampleDesc.Quality = 0;
     resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 
-    ASSERT_SUCCEEDED(m_device->CreateCommittedResource(
-        &heapProps,
-        heapFlags,
-        &resourceDesc,
-        initialState, // Required starting state of upload buffer
-        nullptr,
-        IID_PPV_ARGS(ppBuffer)
-    ));
+    CreateResource(heapProps, heapFlags, resourceDesc, initialState, nullptr, ppBuffer);
 
 #ifdef _DEBUG
     //std::wstringstream ws;
@@ -160,22 +161,89 @@ void Device::CreateTexture2D(
     desc.SampleDesc.Quality = 0;
     desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 
+    CreateResource(heapProps, heapFlags, desc, initialState, clearValue, ppTexture);
+
+#ifdef _DEBUG
+    //std::wstringstream ws;
+    //ws << "Texture " << m_debugResourceIndex++;
+    //(*ppTexture)->SetName(ws.str().c_str());
+#endif
+}
+
+void Device::CreateResource(
+    const D3D12_HEAP_PROPERTIES& heapProps,
+    D3D12_HEAP_FLAGS heapFlags,
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue,
+    ID3D12Resource** ppResource)
+{
+    // Upload and readback buffers are already pooled in large pages by their owners, so only default heap resources are placed.
+    // Anything with special heap flags (shared etc) or too big for a heap gets a committed resource.
+    if (heapProps.Type == D3D12_HEAP_TYPE_DEFAULT && heapFlags == D3D12_HEAP_FLAG_NONE)
+    {
+        GPUMemoryCategory category = GPUMemoryCategoryTexture;
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            category = GPUMemoryCategoryBuffer;
+        }
+        else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+        {
+            category = GPUMemoryCategoryRenderTarget;
+        }
+
+        D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+        std::lock_guard<std::mutex> lock(m_placedResourcesMutex);
+
+        GPUMemoryAllocation alloc;
+        if (m_pMemoryAllocator->Allocate(heapProps.Type, category, info, alloc))
+        {
+            ASSERT_SUCCEEDED(m_device->CreatePlacedResource(
+                alloc.pHeap,
+                alloc.offset,
+                &desc,
+                initialState,
+                clearValue,
+                IID_PPV_ARGS(ppResource)
+            ));
+
+            m_placedResources[*ppResource] = alloc;
+            return;
+        }
+    }
+
     ASSERT_SUCCEEDED(m_device->CreateCommittedResource(
         &heapProps,
         heapFlags,
         &desc,
-        initialState, // Required starting state of upload buffer
+        initialState,
         clearValue,
-        IID_PPV_ARGS(ppTexture)
+        IID_PPV_ARGS(ppResource)
     ));
+}
 
-#ifdef _DEBUG
-    //std::wstringstream ws;
-    //ws << "Texture " << m_debugResourceIndex++;
-    //(*ppTexture)->SetName(ws.str().c_str());
-#endif
+void Device::DestroyResource(
+    ID3D12Resource* pResource)
+{
+    std::lock_guard<std::mutex> lock(m_placedResourcesMutex);
+
+    auto it = m_placedResources.find(pResource);
+    if (it != m_placedResources.end())
+    {
+        m_pMemoryAllocator->Free(it->second);
+        m_placedResources.erase(it);
+    }
+
+    pResource->Release();
 }
 
+void Device::GetMemoryStats(
+    GPUMemoryStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_placedResourcesMutex);
+    m_pMemoryAllocator->GetStats(statsOut);
+}
 
 ID3D12Device* Device::GetNativeDevice(
     void)
@@ -4,17 +4,24 @@
 #include <wrl/client.h>
 using Microsoft::WRL::ComPtr;
 
+#include <mutex>
+#include <unordered_map>
+
+#include "Renderer/Core/GPUMemoryAllocator.h"
+
 class Device
 {
 public:
 
     Device();
+    ~Device();
 
     void CreateCommandQueue(
         const D3D12_COMMAND_QUEUE_DESC& desc,
         ID3D12CommandQueue** ppCmdQueue);
 
     void CreateGraphicsCommandList(
+        D3D12_COMMAND_LIST_TYPE type,
         ID3D12CommandAllocator* cmdAllocator,
         ID3D12PipelineState* pipelineState,
         ID3D12GraphicsCommandList** ppCmdList);
@@ -82,12 +89,33 @@ public:
         D3D12_CLEAR_VALUE* clearValue,
         ID3D12Resource** ppTexture);
 
+    // Default heap buffers and textures are placed in one of the memory allocator's heaps, so must be released through here
+    // rather than with Release. Fine to call on committed resources too.
+    void DestroyResource(
+        ID3D12Resource* pResource);
+
+    void GetMemoryStats(
+        GPUMemoryStats& statsOut);
+
     ID3D12Device* GetNativeDevice(
         void);
 
 private:
+    void CreateResource(
+        const D3D12_HEAP_PROPERTIES& heapProps,
+        D3D12_HEAP_FLAGS heapFlags,
+        const D3D12_RESOURCE_DESC& desc,
+        D3D12_RESOURCE_STATES initialState,
+        const D3D12_CLEAR_VALUE* clearValue,
+        ID3D12Resource** ppResource);
+
     ComPtr<ID3D12Device> m_device;
 
+    GPUMemoryAllocator* m_pMemoryAllocator;
+    std::unordered_map<ID3D12Resource*, GPUMemoryAllocation> m_placedResources;
+    // Guards the two above, resources can be created from loader threads
+    std::mutex m_placedResourcesMutex;
+
 #ifdef _DEBUG
     uint32 m_debugResourceIndex = 0;
 #endif
@@ -0,0 +1,179 @@
+#include "GPUMemoryAllocator.h"
+
+#include <algorithm>
+
+static D3D12_HEAP_FLAGS sGetHeapFlags(
+    GPUMemoryCategory category)
+{
+    switch (category)
+    {
+        case GPUMemoryCategoryBuffer:
+            return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+        case GPUMemoryCategoryTexture:
+            return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+        case GPUMemoryCategoryRenderTarget:
+            return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+        default:
+            ASSERT(false);
+            return D3D12_HEAP_FLAG_NONE;
+    }
+}
+
+GPUMemoryAllocator::GPUMemoryAllocator(
+    ID3D12Device* pDevice,
+    uint64 heapSize)
+{
+    ASSERT(pDevice);
+    m_pDevice = pDevice;
+    m_heapSize = heapSize;
+}
+
+GPUMemoryAllocator::~GPUMemoryAllocator()
+{
+    for (int32 heapType = 0; heapType < _countof(m_pools); heapType++)
+    {
+        for (Pool& pool : m_pools[heapType])
+        {
+            for (Heap* pHeap : pool)
+            {
+                delete pHeap;
+            }
+        }
+    }
+}
+
+GPUMemoryAllocator::Pool& GPUMemoryAllocator::GetPool(
+    D3D12_HEAP_TYPE heapType,
+    GPUMemoryCategory category)
+{
+    ASSERT(heapType >= D3D12_HEAP_TYPE_DEFAULT && heapType <= D3D12_HEAP_TYPE_READBACK);
+    ASSERT(category >= 0 && category < GPUMemoryCategoryCount);
+    return m_pools[heapType - D3D12_HEAP_TYPE_DEFAULT][category];
+}
+
+int32 GPUMemoryAllocator::CreateHeap(
+    D3D12_HEAP_TYPE heapType,
+    GPUMemoryCategory category)
+{
+    Heap* pHeap = new Heap(m_heapSize);
+
+    D3D12_HEAP_DESC desc = {};
+    desc.SizeInBytes = m_heapSize;
+    desc.Properties.Type = heapType;
+    desc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    desc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    desc.Flags = sGetHeapFlags(category);
+    ASSERT_SUCCEEDED(m_pDevice->CreateHeap(&desc, IID_PPV_ARGS(&pHeap->heap)));
+
+    Pool& pool = GetPool(heapType, category);
+    auto it = std::find(pool.begin(), pool.end(), nullptr);
+    if (it != pool.end())
+    {
+        *it = pHeap;
+        return (int32)(it - pool.begin());
+    }
+
+    pool.push_back(pHeap);
+    return (int32)pool.size() - 1;
+}
+
+bool GPUMemoryAllocator::Allocate(
+    D3D12_HEAP_TYPE heapType,
+    GPUMemoryCategory category,
+    const D3D12_RESOURCE_ALLOCATION_INFO& info,
+    GPUMemoryAllocation& allocOut)
+{
+    // Buddy blocks are aligned to their size, so covering the alignment covers everything (i.e. 4MB MSAA alignment)
+    uint64 size = std::max(info.SizeInBytes, info.Alignment);
+    if (size > m_heapSize)
+    {
+        return false;
+    }
+
+    Pool& pool = GetPool(heapType, category);
+
+    int32 heap = -1;
+    for (int32 i = 0; i < (int32)pool.size(); i++)
+    {
+        if (pool[i] && pool[i]->allocator.Allocate(size, allocOut.offset))
+        {
+            heap = i;
+            break;
+        }
+    }
+
+    if (heap == -1)
+    {
+        heap = CreateHeap(heapType, category);
+        bool fAllocated = pool[heap]->allocator.Allocate(size, allocOut.offset);
+        ASSERT(fAllocated);
+    }
+
+    Heap* pHeap = pool[heap];
+    pHeap->bytesRequested += info.SizeInBytes;
+
+    allocOut.pHeap = pHeap->heap.Get();
+    allocOut.size = info.SizeInBytes;
+    allocOut.heapType = heapType;
+    allocOut.category = category;
+    allocOut.heap = heap;
+    return true;
+}
+
+void GPUMemoryAllocator::Free(
+    const GPUMemoryAllocation& alloc)
+{
+    Pool& pool = GetPool(alloc.heapType, alloc.category);
+    Heap* pHeap = pool[alloc.heap];
+    ASSERT(pHeap && pHeap->heap.Get() == alloc.pHeap);
+
+    pHeap->allocator.Free(alloc.offset);
+    pHeap->bytesRequested -= alloc.size;
+
+    // Give empty heaps back, but hang on to one per pool so we don't thrash creating and destroying them
+    if (pHeap->allocator.IsEmpty())
+    {
+        uint32 numHeaps = (uint32)std::count_if(pool.begin(), pool.end(), [](Heap* p) { return p != nullptr; });
+        if (numHeaps > 1)
+        {
+            delete pHeap;
+            pool[alloc.heap] = nullptr;
+        }
+    }
+}
+
+void GPUMemoryAllocator::GetStats(
+    GPUMemoryStats& statsOut)
+{
+    statsOut.heaps.clear();
+
+    for (int32 heapType = 0; heapType < _countof(m_pools); heapType++)
+    {
+        for (int32 category = 0; category < GPUMemoryCategoryCount; category++)
+        {
+            for (Heap* pHeap : m_pools[heapType][category])
+            {
+                if (!pHeap)
+                {
+                    continue;
+                }
+
+                GPUMemoryHeapStats stats;
+                stats.heapType = (D3D12_HEAP_TYPE)(heapType + D3D12_HEAP_TYPE_DEFAULT);
+                stats.category = (GPUMemoryCategory)category;
+                stats.size = pHeap->allocator.GetSize();
+                stats.bytesAllocated = pHeap->allocator.GetAllocatedSize();
+                stats.bytesRequested = pHeap->bytesRequested;
+                stats.largestFreeBlock = pHeap->allocator.GetLargestFreeBlock();
+                stats.numAllocations = pHeap->allocator.GetAllocationCount();
+                stats.fragmentation = pHeap->allocator.GetFragmentation();
+
+                statsOut.heaps.push_back(stats);
+            }
+        }
+    }
+}
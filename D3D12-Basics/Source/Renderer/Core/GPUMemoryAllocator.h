@@ -0,0 +1,100 @@
+#pragma once
+#include "D3D12Header.h"
+
+#include "Generic/BuddyAllocator.h"
+
+#include <vector>
+
+#define GPU_MEMORY_HEAP_SIZE _64MB
+#define GPU_MEMORY_MIN_BLOCK_SIZE D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+
+// Resource heap tier 1 can't mix these in a single heap, so keep them apart regardless of tier
+enum GPUMemoryCategory : int32
+{
+    GPUMemoryCategoryBuffer,
+    GPUMemoryCategoryTexture,
+    GPUMemoryCategoryRenderTarget, // Render target and depth stencil textures
+    GPUMemoryCategoryCount
+};
+
+struct GPUMemoryHeapStats
+{
+    D3D12_HEAP_TYPE heapType;
+    GPUMemoryCategory category;
+    uint64 size = 0;
+    // Sum of the buddy blocks handed out, and of what was actually asked for. The difference is lost to rounding up to a power of two.
+    uint64 bytesAllocated = 0;
+    uint64 bytesRequested = 0;
+    uint64 largestFreeBlock = 0;
+    uint32 numAllocations = 0;
+    // 1 - largest free block / total free, 0 when all the free space is in one block
+    float fragmentation = 0.0f;
+};
+
+struct GPUMemoryStats
+{
+    std::vector<GPUMemoryHeapStats> heaps;
+};
+
+struct GPUMemoryAllocation
+{
+    ID3D12Heap* pHeap = nullptr;
+    uint64 offset = 0;
+    uint64 size = 0;
+
+    D3D12_HEAP_TYPE heapType;
+    GPUMemoryCategory category;
+    int32 heap = -1;
+};
+
+// Carves placed resources out of large ID3D12Heaps, with a pool of heaps per heap type and resource category. Each heap is split up
+// with a buddy allocator. Requests bigger than a heap fail and should fall back to a committed resource.
+class GPUMemoryAllocator
+{
+public:
+    GPUMemoryAllocator(
+        ID3D12Device* pDevice,
+        uint64 heapSize = GPU_MEMORY_HEAP_SIZE);
+
+    ~GPUMemoryAllocator();
+
+    bool Allocate(
+        D3D12_HEAP_TYPE heapType,
+        GPUMemoryCategory category,
+        const D3D12_RESOURCE_ALLOCATION_INFO& info,
+        GPUMemoryAllocation& allocOut);
+
+    void Free(
+        const GPUMemoryAllocation& alloc);
+
+    void GetStats(
+        GPUMemoryStats& statsOut);
+
+private:
+    struct Heap
+    {
+        Heap(uint64 size) :
+            allocator(size, GPU_MEMORY_MIN_BLOCK_SIZE) {}
+
+        ComPtr<ID3D12Heap> heap;
+        BuddyAllocator allocator;
+        uint64 bytesRequested = 0;
+    };
+
+    // Indexed by GPUMemoryAllocation::heap, released heaps leave a nullptr behind to be reused
+    typedef std::vector<Heap*> Pool;
+
+    Pool& GetPool(
+        D3D12_HEAP_TYPE heapType,
+        GPUMemoryCategory category);
+
+    int32 CreateHeap(
+        D3D12_HEAP_TYPE heapType,
+        GPUMemoryCategory category);
+
+    ID3D12Device* m_pDevice;
+    uint64 m_heapSize;
+
+    // Default, upload and readback. Custom heaps aren't pooled.
+    Pool m_pools[3][GPUMemoryCategoryCount];
+};
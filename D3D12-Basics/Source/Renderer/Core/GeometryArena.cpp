@@ -0,0 +1,227 @@
+#include "GeometryArena.h"
+
+#include "Device.h"
+
+#include <algorithm>
+
+GeometryArena::GeometryArena(
+    Device* pDevice,
+    uint32 stride,
+    uint32 blockSize)
+{
+    ASSERT(pDevice && stride > 0 && blockSize >= stride);
+    m_pDevice = pDevice;
+    m_stride = stride;
+    m_blockSize = blockSize / stride;
+}
+
+GeometryArena::~GeometryArena()
+{
+    for (int32 i = 0; i < (int32)m_blocks.size(); i++)
+    {
+        if (m_blocks[i])
+        {
+            DestroyBlock(i);
+        }
+    }
+}
+
+int32 GeometryArena::CreateBlock(
+    uint32 size)
+{
+    Block* pBlock = new Block(size);
+
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+    // COMMON so uploads and defragmenting on the copy queue can promote it, see D3D12Core::BufferCreate
+    m_pDevice->CreateBuffer(heapProps, (size_t)size * m_stride, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, &pBlock->pBuffer);
+
+    auto it = std::find(m_blocks.begin(), m_blocks.end(), nullptr);
+    if (it != m_blocks.end())
+    {
+        *it = pBlock;
+        return (int32)(it - m_blocks.begin());
+    }
+
+    m_blocks.push_back(pBlock);
+    return (int32)m_blocks.size() - 1;
+}
+
+void GeometryArena::DestroyBlock(
+    int32 block)
+{
+    m_pDevice->DestroyResource(m_blocks[block]->pBuffer);
+    delete m_blocks[block];
+    m_blocks[block] = nullptr;
+}
+
+bool GeometryArena::AllocateFromBlock(
+    int32 block,
+    uint32 count,
+    int32 owner,
+    GeometryAllocation& allocOut)
+{
+    Block* pBlock = m_blocks[block];
+    if (!pBlock || pBlock->fRetired || !pBlock->allocator.Allocate(count, allocOut.offset))
+    {
+        return false;
+    }
+
+    allocOut.block = block;
+    allocOut.count = count;
+    pBlock->allocations[allocOut.offset] = std::make_pair(count, owner);
+    return true;
+}
+
+GeometryAllocation GeometryArena::Allocate(
+    uint32 count,
+    int32 owner)
+{
+    GeometryAllocation alloc;
+    for (int32 i = 0; i < (int32)m_blocks.size(); i++)
+    {
+        if (AllocateFromBlock(i, count, owner, alloc))
+        {
+            return alloc;
+        }
+    }
+
+    bool fAllocated = AllocateFromBlock(CreateBlock(std::max(count, m_blockSize)), count, owner, alloc);
+    ASSERT(fAllocated);
+    return alloc;
+}
+
+void GeometryArena::Free(
+    const GeometryAllocation& alloc)
+{
+    Block* pBlock = m_blocks[alloc.block];
+    ASSERT(pBlock && pBlock->allocations.count(alloc.offset));
+
+    pBlock->allocations.erase(alloc.offset);
+    pBlock->allocator.Free(alloc.offset, alloc.count);
+}
+
+uint32 GeometryArena::Defragment(
+    ID3D12GraphicsCommandList* pCmdList,
+    float maxOccupancy,
+    uint64 syncPoint,
+    const RelocateCallback& relocate)
+{
+    // Sources are the sparse blocks, emptiest first. Everything else is a destination. A block is never both, otherwise we'd need a
+    // barrier between copying into it and copying back out of it.
+    std::vector<int32> sources;
+    std::vector<int32> destinations;
+    for (int32 i = 0; i < (int32)m_blocks.size(); i++)
+    {
+        Block* pBlock = m_blocks[i];
+        if (!pBlock || pBlock->fRetired)
+        {
+            continue;
+        }
+
+        float occupancy = (float)pBlock->allocator.GetUsedSize() / (float)pBlock->allocator.GetSize();
+        (occupancy < maxOccupancy ? sources : destinations).push_back(i);
+    }
+
+    auto fnUsedLess = [this](int32 a, int32 b) { return m_blocks[a]->allocator.GetUsedSize() < m_blocks[b]->allocator.GetUsedSize(); };
+    std::sort(sources.begin(), sources.end(), fnUsedLess);
+
+    // If every block is sparse, pack into the fullest of them
+    if (destinations.empty() && !sources.empty())
+    {
+        destinations.push_back(sources.back());
+        sources.pop_back();
+    }
+
+    uint32 numMoved = 0;
+    for (int32 src : sources)
+    {
+        Block* pSrcBlock = m_blocks[src];
+        for (auto it = pSrcBlock->allocations.begin(); it != pSrcBlock->allocations.end();)
+        {
+            uint32 srcOffset = it->first;
+            uint32 count = it->second.first;
+            int32 owner = it->second.second;
+
+            GeometryAllocation newAlloc;
+            bool fAllocated = false;
+            for (int32 dst : destinations)
+            {
+                if (AllocateFromBlock(dst, count, owner, newAlloc))
+                {
+                    fAllocated = true;
+                    break;
+                }
+            }
+
+            if (!fAllocated)
+            {
+                it++;
+                continue;
+            }
+
+            pCmdList->CopyBufferRegion(
+                m_blocks[newAlloc.block]->pBuffer, (uint64)newAlloc.offset * m_stride,
+                pSrcBlock->pBuffer, (uint64)srcOffset * m_stride,
+                (uint64)count * m_stride);
+
+            relocate(owner, newAlloc);
+            numMoved++;
+
+            // Draws already recorded can still be reading the old range, so it only becomes free again once syncPoint completes
+            it = pSrcBlock->allocations.erase(it);
+            m_retired.push_back({ src, srcOffset, count, syncPoint });
+        }
+
+        // There's always at least one destination, so this never leaves us without any blocks
+        if (pSrcBlock->allocations.empty())
+        {
+            pSrcBlock->fRetired = true;
+            m_retired.push_back({ src, 0, 0, syncPoint });
+        }
+    }
+
+    return numMoved;
+}
+
+void GeometryArena::ResetRetired(
+    uint64 syncPoint)
+{
+    for (auto it = m_retired.begin(); it != m_retired.end();)
+    {
+        if (it->syncPoint >= syncPoint)
+        {
+            it++;
+            continue;
+        }
+
+        Block* pBlock = m_blocks[it->block];
+        if (it->count == 0)
+        {
+            DestroyBlock(it->block);
+        }
+        else if (pBlock && !pBlock->fRetired)
+        {
+            pBlock->allocator.Free(it->offset, it->count);
+        }
+
+        it = m_retired.erase(it);
+    }
+}
+
+ID3D12Resource* GeometryArena::GetBlockBuffer(
+    int32 block)
+{
+    ASSERT(m_blocks[block]);
+    return m_blocks[block]->pBuffer;
+}
+
+uint32 GeometryArena::GetBlockSizeInBytes(
+    int32 block)
+{
+    ASSERT(m_blocks[block]);
+    return m_blocks[block]->allocator.GetSize() * m_stride;
+}
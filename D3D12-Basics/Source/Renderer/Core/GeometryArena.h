@@ -0,0 +1,113 @@
+#pragma once
+#include "D3D12Header.h"
+
+#include "Generic/OffsetAllocator.h"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
+class Device;
+
+// A range of elements (vertices or indices) within one of an arena's blocks
+struct GeometryAllocation
+{
+    int32 block = -1;
+    uint32 offset = 0;
+    uint32 count = 0;
+};
+
+// Sub-allocates geometry out of a few large default heap buffers ('blocks') rather than creating a committed resource per mesh.
+// Everything is in units of elements of a fixed stride, so an allocation's offset can be used directly as a base vertex / start index
+// with a view over the whole block. Requests bigger than a block get a block of their own.
+class GeometryArena
+{
+public:
+    // Called for every allocation moved by Defragment, owner is whatever was passed to Allocate
+    typedef std::function<void(int32 owner, const GeometryAllocation& newAlloc)> RelocateCallback;
+
+    GeometryArena(
+        Device* pDevice,
+        uint32 stride,
+        uint32 blockSize);
+
+    ~GeometryArena();
+
+    GeometryAllocation Allocate(
+        uint32 count,
+        int32 owner);
+
+    void Free(
+        const GeometryAllocation& alloc);
+
+    // Moves allocations out of blocks less than maxOccupancy full into the fuller ones, recording the copies into pCmdList (a copy queue list).
+    // Blocks which end up empty are released, and moved-from ranges are reused, only once syncPoint has completed. Returns the number of allocations moved.
+    uint32 Defragment(
+        ID3D12GraphicsCommandList* pCmdList,
+        float maxOccupancy,
+        uint64 syncPoint,
+        const RelocateCallback& relocate);
+
+    // syncPoint is the last completed fence value, anything Defragment left behind with a sync point before it is released
+    void ResetRetired(
+        uint64 syncPoint);
+
+    ID3D12Resource* GetBlockBuffer(
+        int32 block);
+
+    uint32 GetBlockSizeInBytes(
+        int32 block);
+
+    uint32 GetStride(
+        void)
+    {
+        return m_stride;
+    }
+
+private:
+    struct Block
+    {
+        Block(uint32 size) :
+            allocator(size) {}
+
+        ID3D12Resource* pBuffer = nullptr;
+        OffsetAllocator allocator;
+
+        // Offset -> (count, owner) for every live allocation, so Defragment knows what there is to move
+        std::map<uint32, std::pair<uint32, int32>> allocations;
+
+        bool fRetired = false;
+    };
+
+    // Either a range of a block or, if count is 0, a whole block waiting for the GPU to be done with it
+    struct Retired
+    {
+        int32 block;
+        uint32 offset;
+        uint32 count;
+        uint64 syncPoint;
+    };
+
+    int32 CreateBlock(
+        uint32 size);
+
+    void DestroyBlock(
+        int32 block);
+
+    bool AllocateFromBlock(
+        int32 block,
+        uint32 count,
+        int32 owner,
+        GeometryAllocation& allocOut);
+
+    Device* m_pDevice;
+
+    uint32 m_stride;
+    uint32 m_blockSize;
+
+    // Indexed by GeometryAllocation::block, released blocks leave a nullptr behind to be reused
+    std::vector<Block*> m_blocks;
+
+    std::list<Retired> m_retired;
+};
@@ -0,0 +1,138 @@
+#include "MaterialTable.h"
+
+#include "Device.h"
+
+#include "Engine.h"
+
+#include <algorithm>
+
+MaterialTable::MaterialTable(
+    Device* pDevice,
+    uint32 capacity)
+{
+    m_pDevice = pDevice;
+    m_capacity = capacity;
+
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+    // Buffers are promoted out of COMMON by the first copy, see Flush
+    m_pDevice->CreateBuffer(heapProps, m_capacity * sizeof(MaterialConstants), D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_COMMON, &m_pBuffer);
+
+    m_constants.resize(m_capacity);
+    m_dirty.resize(m_capacity, false);
+}
+
+MaterialTable::~MaterialTable()
+{
+    m_pDevice->DestroyResource(m_pBuffer);
+}
+
+MaterialID MaterialTable::Create(
+    const MaterialConstants& constants)
+{
+    MaterialID id = m_idAllocator.AllocID();
+    if ((uint32)id >= m_capacity)
+    {
+        // Handed back so the allocator doesn't keep counting up past the table
+        m_idAllocator.FreeID(id);
+        EngineLog("MaterialTable::Create: Out of material IDs\n");
+        return MaterialIDInvalid;
+    }
+
+    m_constants[id] = constants;
+    MarkDirty(id);
+    return id;
+}
+
+void MaterialTable::Update(
+    MaterialID id,
+    const MaterialConstants& constants)
+{
+    if ((uint32)id >= m_capacity)
+    {
+        EngineLog("MaterialTable::Update: Invalid material ID\n");
+        return;
+    }
+
+    if (memcmp(&m_constants[id], &constants, sizeof(MaterialConstants)) != 0)
+    {
+        m_constants[id] = constants;
+        MarkDirty(id);
+    }
+}
+
+void MaterialTable::Destroy(
+    MaterialID id)
+{
+    // The entry is left as it is, it'll be overwritten when the ID is reused
+    m_idAllocator.FreeID(id);
+}
+
+void MaterialTable::MarkDirty(
+    MaterialID id)
+{
+    if (!m_dirty[id])
+    {
+        m_dirty[id] = true;
+        m_dirtyIDs.push_back(id);
+    }
+}
+
+uint32 MaterialTable::Flush(
+    ID3D12GraphicsCommandList* pCmdList,
+    UploadStream* pUploadStream,
+    uint64 syncPoint)
+{
+    uint32 numDirty = (uint32)m_dirtyIDs.size();
+    if (numDirty == 0)
+    {
+        return 0;
+    }
+
+    // Sorted so neighbouring entries can go in one copy
+    std::sort(m_dirtyIDs.begin(), m_dirtyIDs.end());
+
+    UploadStream::Allocation alloc = pUploadStream->Allocate(numDirty * sizeof(MaterialConstants), syncPoint);
+    MaterialConstants* pDest = (MaterialConstants*)alloc.cpuAddr;
+
+    uint32 runStart = 0;
+    for (uint32 i = 0; i < numDirty; i++)
+    {
+        MaterialID id = m_dirtyIDs[i];
+        pDest[i] = m_constants[id];
+        m_dirty[id] = false;
+
+        bool fRunEnds = i + 1 == numDirty || m_dirtyIDs[i + 1] != id + 1;
+        if (fRunEnds)
+        {
+            uint32 runLength = i + 1 - runStart;
+            pCmdList->CopyBufferRegion(
+                m_pBuffer,
+                (uint64)m_dirtyIDs[runStart] * sizeof(MaterialConstants),
+                alloc.buffer,
+                alloc.bufferOffset + runStart * sizeof(MaterialConstants),
+                runLength * sizeof(MaterialConstants));
+            runStart = i + 1;
+        }
+    }
+    m_dirtyIDs.clear();
+
+    // The copy promoted the buffer to COPY_DEST, it decays back to COMMON when the list is done
+    D3D12_RESOURCE_TRANSITION_BARRIER transition;
+    transition.pResource = m_pBuffer;
+    transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+    D3D12_RESOURCE_BARRIER barrier;
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.Transition = transition;
+
+    pCmdList->ResourceBarrier(1, &barrier);
+
+    return numDirty;
+}
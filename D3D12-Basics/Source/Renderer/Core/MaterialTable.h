@@ -0,0 +1,70 @@
+#pragma once
+#include "D3D12Header.h"
+
+#include "Generic/IDAllocator.h"
+
+#include "Renderer/ConstantBuffers.h"
+#include "Renderer/Core/UploadStream.h"
+
+#include <vector>
+
+class Device;
+
+enum MaterialID : int32
+{
+    MaterialIDInvalid = -1
+};
+
+// Every material's constants, kept in one default heap buffer for the shaders to index with MaterialID. The buffer is only written
+// when a material is created or changed, and then only the entries which changed.
+class MaterialTable
+{
+public:
+    MaterialTable(
+        Device* pDevice,
+        uint32 capacity);
+
+    ~MaterialTable();
+
+    // Returns MaterialIDInvalid if the table is full
+    MaterialID Create(
+        const MaterialConstants& constants);
+
+    void Update(
+        MaterialID id,
+        const MaterialConstants& constants);
+
+    // The ID can be reused straight away, whatever reuses it is only copied in at the next Flush which is ordered after any frame
+    // still reading the old entry
+    void Destroy(
+        MaterialID id);
+
+    // Records copies of every dirty entry into pCmdList (a direct list, so they're ordered after previous frames' draws which might
+    // read the old values) and leaves the buffer readable by shaders. Returns the number of entries uploaded.
+    uint32 Flush(
+        ID3D12GraphicsCommandList* pCmdList,
+        UploadStream* pUploadStream,
+        uint64 syncPoint);
+
+    D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress(
+        void)
+    {
+        return m_pBuffer->GetGPUVirtualAddress();
+    }
+
+private:
+    void MarkDirty(
+        MaterialID id);
+
+    Device* m_pDevice;
+
+    uint32 m_capacity;
+    ID3D12Resource* m_pBuffer;
+
+    // CPU copy of the buffer, so dirty entries can be uploaded in one go at Flush
+    std::vector<MaterialConstants> m_constants;
+    std::vector<bool> m_dirty;
+    std::vector<MaterialID> m_dirtyIDs;
+
+    IDAllocator<MaterialID> m_idAllocator = IDAllocator<MaterialID>(MaterialID(0));
+};
@@ -0,0 +1,79 @@
+#include "UploadContext.h"
+
+UploadContext::UploadContext(
+    UploadQueue* pQueue)
+{
+    ASSERT(pQueue);
+    m_pQueue = pQueue;
+
+    m_pCmdList = nullptr;
+    for (int32 i = 0; i < UPLOAD_CONTEXT_NUM_BATCHES; i++)
+    {
+        m_batchSyncPoints[i] = 0;
+    }
+    m_batchIndex = 0;
+    m_fRecording = false;
+
+    m_fenceValue = 0;
+    m_queueWaitValue = 0;
+}
+
+UploadContext::~UploadContext()
+{
+    WaitForIdle();
+}
+
+ID3D12GraphicsCommandList* UploadContext::GetCmdList(
+    void)
+{
+    if (!m_fRecording)
+    {
+        // Only stalls if we've got more than UPLOAD_CONTEXT_NUM_BATCHES batches in flight
+        WaitForSyncPoint(m_batchSyncPoints[m_batchIndex]);
+
+        m_pCmdList = m_pQueue->BatchBegin(m_batchIndex);
+        m_fRecording = true;
+    }
+
+    return m_pCmdList;
+}
+
+uint64 UploadContext::Flush(
+    void)
+{
+    if (m_fRecording)
+    {
+        m_pQueue->BatchSubmit(m_batchIndex, ++m_fenceValue);
+        m_batchSyncPoints[m_batchIndex] = m_fenceValue;
+
+        m_batchIndex = (m_batchIndex + 1) % UPLOAD_CONTEXT_NUM_BATCHES;
+        m_fRecording = false;
+    }
+
+    return m_fenceValue;
+}
+
+void UploadContext::QueueWait(
+    ID3D12CommandQueue* pQueue)
+{
+    if (m_queueWaitValue < m_fenceValue)
+    {
+        m_pQueue->QueueWait(pQueue, m_fenceValue);
+        m_queueWaitValue = m_fenceValue;
+    }
+}
+
+void UploadContext::WaitForIdle(
+    void)
+{
+    WaitForSyncPoint(Flush());
+}
+
+void UploadContext::WaitForSyncPoint(
+    uint64 syncPoint)
+{
+    if (m_pQueue->GetFenceCompletedValue() < syncPoint)
+    {
+        m_pQueue->FenceWait(syncPoint);
+    }
+}
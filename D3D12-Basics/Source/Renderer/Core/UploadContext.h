@@ -0,0 +1,81 @@
+#pragma once
+
+struct ID3D12CommandQueue;
+struct ID3D12GraphicsCommandList;
+
+// Number of batches that can be in flight on the copy queue before we have to wait for one to reuse its allocator
+#define UPLOAD_CONTEXT_NUM_BATCHES 3
+
+// The copy queue, its fence and one command allocator per batch, as UploadContext uses them. D3D12UploadQueue is the real one, tests
+// record the calls instead.
+class UploadQueue
+{
+public:
+    virtual ~UploadQueue() {}
+
+    // Resets batch's allocator, which the GPU has to be done with, and reopens the command list on it
+    virtual ID3D12GraphicsCommandList* BatchBegin(
+        uint32 batch) = 0;
+
+    // Closes the command list and executes it, then signals the fence to fenceValue once it's done
+    virtual void BatchSubmit(
+        uint32 batch,
+        uint64 fenceValue) = 0;
+
+    // GPU side wait on pQueue until the fence reaches fenceValue
+    virtual void QueueWait(
+        ID3D12CommandQueue* pQueue,
+        uint64 fenceValue) = 0;
+
+    virtual uint64 GetFenceCompletedValue(
+        void) = 0;
+
+    // Blocks until the fence reaches fenceValue
+    virtual void FenceWait(
+        uint64 fenceValue) = 0;
+};
+
+// Records resource uploads on a dedicated copy queue, so loading can overlap rendering on the direct queue.
+// Copies are batched into a single command list until Flush. A queue that wants to use the uploaded resources must QueueWait first,
+// after which they've decayed to COMMON and get implicitly promoted to whatever read state they're used in.
+class UploadContext
+{
+public:
+    UploadContext(
+        UploadQueue* pQueue);
+
+    ~UploadContext();
+
+    // Command list for the current batch, opened on first use
+    ID3D12GraphicsCommandList* GetCmdList(
+        void);
+
+    // Submits the current batch if anything has been recorded. Returns the sync point of the last submitted batch.
+    uint64 Flush(
+        void);
+
+    // GPU side wait on pQueue for every batch submitted so far. Does nothing if nothing's been submitted since the last wait, which
+    // isn't tracked per queue, so only one queue should use this.
+    void QueueWait(
+        ID3D12CommandQueue* pQueue);
+
+    // Submits anything pending and blocks until the copy queue is idle
+    void WaitForIdle(
+        void);
+
+private:
+    void WaitForSyncPoint(
+        uint64 syncPoint);
+
+    UploadQueue* m_pQueue;
+
+    ID3D12GraphicsCommandList* m_pCmdList;
+
+    // Sync point of the last batch recorded with each allocator
+    uint64 m_batchSyncPoints[UPLOAD_CONTEXT_NUM_BATCHES];
+    uint32 m_batchIndex;
+    bool m_fRecording;
+
+    uint64 m_fenceValue;
+    uint64 m_queueWaitValue;
+};
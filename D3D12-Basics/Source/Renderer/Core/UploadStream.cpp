@@ -1,15 +1,30 @@
 #include "UploadStream.h"
 
-UploadStream::UploadStream(Device* device, size_t pageSize)
+UploadStream::UploadStream(Device* device, size_t pageSize, Mode mode)
 {
     assert(device != nullptr);
     m_device = device;
     m_pageSize = pageSize;
+    m_mode = mode;
+    m_pRing = nullptr;
+    m_dedicatedPagesInUse = 0;
 
-    AllocatePage();
+    if (m_mode == ModeRing)
+    {
+        m_pRing = new Ring(m_pageSize, CreateUploadBuffer(m_pageSize));
+    }
+    else
+    {
+        AcquirePage();
+    }
 }
 
-UploadStream::Page& UploadStream::AllocatePage()
+UploadStream::~UploadStream()
+{
+    delete m_pRing;
+}
+
+ID3D12Resource* UploadStream::CreateUploadBuffer(size_t size)
 {
     D3D12_HEAP_PROPERTIES props = {};
     props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -17,12 +32,56 @@ UploadStream::Page& UploadStream::AllocatePage()
     props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
 
     ID3D12Resource* buffer;
-    m_device->CreateBuffer(props, m_pageSize, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, &buffer);
+    m_device->CreateBuffer(props, size, D3D12_HEAP_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, &buffer);
+
+    m_frameStats.pagesCreated++;
+    return buffer;
+}
+
+UploadStream::Page& UploadStream::AcquirePage()
+{
+    if (m_freePages.empty())
+    {
+        m_pages.emplace_back(m_pageSize, CreateUploadBuffer(m_pageSize));
+    }
+    else
+    {
+        m_pages.splice(m_pages.end(), m_freePages, m_freePages.begin());
+    }
 
-    m_pages.emplace_back(m_pageSize, buffer);
+    m_pageHistory.Update((uint32)m_pages.size());
     return m_pages.back();
 }
 
+UploadStream::Allocation UploadStream::AllocateDedicated(size_t size, size_t align, uint64 syncPoint)
+{
+    // Take the smallest free block that fits, otherwise create a new one
+    Page* pBlock = nullptr;
+    for (Page& block : m_dedicatedPages)
+    {
+        if (block.IsEmpty() && block.GetSize() >= size && (!pBlock || block.GetSize() < pBlock->GetSize()))
+        {
+            pBlock = &block;
+        }
+    }
+
+    if (!pBlock)
+    {
+        // Buffers are 64KB aligned anyway, so round up to that to give the block a better chance of being reused
+        size_t blockSize = Utils::AlignUp(size, (size_t)_64KB);
+        m_dedicatedPages.emplace_back(blockSize, CreateUploadBuffer(blockSize));
+        pBlock = &m_dedicatedPages.back();
+    }
+
+    Allocation alloc;
+    bool fAllocated = pBlock->Allocate(size, align, syncPoint, alloc);
+    ASSERT(fAllocated);
+
+    m_dedicatedHistory.Update(++m_dedicatedPagesInUse);
+    m_frameStats.bytesWasted += pBlock->GetFreeSize();
+    return alloc;
+}
+
 UploadStream::Allocation UploadStream::Allocate(size_t size, uint64 syncPoint)
 {
     return AllocateAligned(size, 1, syncPoint);
@@ -30,39 +89,114 @@ UploadStream::Allocation UploadStream::Allocate(size_t size, uint64 syncPoint)
 
 UploadStream::Allocation UploadStream::AllocateAligned(size_t size, size_t align, uint64 syncPoint)
 {
-    Page& page = m_pages.back();
+    m_frameStats.bytesAllocated += size;
+
+    if (size > m_pageSize)
+    {
+        return AllocateDedicated(size, align, syncPoint);
+    }
+
     Allocation alloc;
-    if (!page.Allocate(size, align, syncPoint, alloc))
+    if (m_mode == ModeRing)
     {
-        page = AllocatePage();
-        assert(page.Allocate(size, align, syncPoint, alloc));
+        size_t wasted = 0;
+        bool fAllocated = m_pRing->Allocate(size, align, syncPoint, alloc, wasted);
+        m_frameStats.bytesWasted += wasted;
+
+        // If the GPU is far enough behind that the ring is full, spill into a dedicated block rather than stalling
+        if (!fAllocated)
+        {
+            return AllocateDedicated(size, align, syncPoint);
+        }
+        return alloc;
+    }
+
+    Page* pPage = &m_pages.back();
+    if (!pPage->Allocate(size, align, syncPoint, alloc))
+    {
+        m_frameStats.bytesWasted += pPage->GetFreeSize();
+
+        pPage = &AcquirePage();
+        bool fAllocated = pPage->Allocate(size, align, syncPoint, alloc);
+        ASSERT(fAllocated);
     }
     return alloc;
 }
 
 void UploadStream::ResetAllocations(uint64 syncPoint)
 {
-    // Find the last page with page.syncPoint <= syncPoint, reset begin -> firstNotReset - 1 and stick them at the end of the list
-    auto firstNotReset = m_pages.begin();
-    for (firstNotReset; firstNotReset != m_pages.end(); firstNotReset++)
+    for (Page& block : m_dedicatedPages)
     {
-        if (firstNotReset->GetSyncPoint() > syncPoint || firstNotReset->IsEmpty())
+        if (!block.IsEmpty() && block.GetSyncPoint() < syncPoint)
+        {
+            block.Reset();
+            m_dedicatedPagesInUse--;
+        }
+    }
+
+    if (m_mode == ModeRing)
+    {
+        m_pRing->Reset(syncPoint);
+        return;
+    }
+
+    // Pages are in allocation order so we can stop at the first one still in use. The current page is reset in place rather than freed.
+    while (!m_pages.empty() && m_pages.front().GetSyncPoint() < syncPoint)
+    {
+        m_pages.front().Reset();
+        if (m_pages.size() == 1)
         {
             break;
         }
+        m_freePages.splice(m_freePages.end(), m_pages, m_pages.begin());
+    }
+}
+
+void UploadStream::EndFrame()
+{
+    uint32 pagesTarget = std::max(m_retentionPolicy.minPages, m_pageHistory.EndFrame((uint32)m_pages.size(), m_retentionPolicy.peakWindowFrames));
+    while (!m_freePages.empty() && m_pages.size() + m_freePages.size() > pagesTarget)
+    {
+        m_freePages.pop_back();
+        m_frameStats.pagesDestroyed++;
+    }
+
+    uint32 dedicatedTarget = std::max(m_retentionPolicy.minPages, m_dedicatedHistory.EndFrame(m_dedicatedPagesInUse, m_retentionPolicy.peakWindowFrames));
+    for (auto it = m_dedicatedPages.begin(); it != m_dedicatedPages.end() && m_dedicatedPages.size() > dedicatedTarget;)
+    {
+        if (it->IsEmpty())
+        {
+            it = m_dedicatedPages.erase(it);
+            m_frameStats.pagesDestroyed++;
+        }
         else
         {
-            firstNotReset->Reset();
+            it++;
         }
     }
 
-    if (firstNotReset == m_pages.begin())
+    m_frameStats.pagesLive = (uint32)(m_pages.size() + m_freePages.size() + m_dedicatedPages.size()) + (m_pRing ? 1 : 0);
+
+    m_lastFrameStats = m_frameStats;
+    m_frameStats = UploadStreamStats();
+}
+
+uint32 UploadStream::PeakHistory::EndFrame(uint32 inUse, uint32 windowFrames)
+{
+    m_peaks.push_back(m_currPeak);
+    while (m_peaks.size() > std::max(windowFrames, 1u))
     {
-        // First element has a higher syncPoint, syncPoint is monotonically increasing so no later elements are resettable either
-        return;
+        m_peaks.pop_front();
     }
 
-    m_pages.splice(m_pages.end(), m_pages, m_pages.begin(), firstNotReset);
+    m_currPeak = inUse;
+
+    uint32 peak = 0;
+    for (uint32 framePeak : m_peaks)
+    {
+        peak = std::max(peak, framePeak);
+    }
+    return peak;
 }
 
 UploadStream::Page::Page(size_t _pageSize, ID3D12Resource* _pageBuffer)
@@ -70,7 +204,8 @@ UploadStream::Page::Page(size_t _pageSize, ID3D12Resource* _pageBuffer)
     m_pageSize = _pageSize;
     m_offset = 0;
     m_syncPoint = 0;
-    m_pageBuffer = ComPtr<ID3D12Resource>(_pageBuffer);
+    // Take ownership of the reference from creation, otherwise the buffer is never freed when the page is
+    m_pageBuffer.Attach(_pageBuffer);
 
     D3D12_RANGE range = {0,0};
     m_pageBuffer->Map(0, &range, &m_cpuAddr);
@@ -102,4 +237,105 @@ bool UploadStream::Page::Allocate(size_t size, size_t align, uint64 syncPoint, A
     m_syncPoint = std::max(m_syncPoint, syncPoint);
 
     return true;
-}
\ No newline at end of file
+}
+
+UploadStream::Ring::Ring(size_t _ringSize, ID3D12Resource* _ringBuffer)
+{
+    m_ringSize = _ringSize;
+    m_head = 0;
+    m_tail = 0;
+    m_totalAllocated = 0;
+    m_totalFreed = 0;
+    m_ringBuffer.Attach(_ringBuffer);
+
+    D3D12_RANGE range = {0,0};
+    m_ringBuffer->Map(0, &range, &m_cpuAddr);
+}
+
+UploadStream::Ring::~Ring()
+{
+    m_ringBuffer->Unmap(0, nullptr);
+}
+
+bool UploadStream::Ring::Allocate(size_t size, size_t align, uint64 syncPoint, Allocation& allocOut, size_t& wastedOut)
+{
+    if (m_totalAllocated == m_totalFreed)
+    {
+        // Nothing in flight, start again from the front so we don't wrap for no reason
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    size_t used = (size_t)(m_totalAllocated - m_totalFreed);
+    if (used == m_ringSize)
+    {
+        return false;
+    }
+
+    size_t alignedOffset = Utils::AlignUp(m_tail, align);
+    size_t offset;
+    size_t padding;
+
+    if (m_tail > m_head || used == 0)
+    {
+        // Free space is [tail, end) and [0, head)
+        if (alignedOffset + size <= m_ringSize)
+        {
+            offset = alignedOffset;
+            padding = alignedOffset - m_tail;
+        }
+        else if (size <= m_head)
+        {
+            // Skip whatever is left at the end, offset 0 satisfies any alignment
+            offset = 0;
+            padding = m_ringSize - m_tail;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Wrapped, free space is [tail, head)
+        if (alignedOffset + size > m_head)
+        {
+            return false;
+        }
+        offset = alignedOffset;
+        padding = alignedOffset - m_tail;
+    }
+
+    allocOut.buffer = m_ringBuffer.Get();
+    allocOut.cpuAddr = (void*)((INT8*)m_cpuAddr + offset);
+    allocOut.bufferOffset = offset;
+
+    // Only count the space skipped when wrapping, not alignment padding
+    wastedOut = offset == 0 ? padding : 0;
+
+    m_tail = offset + size;
+    m_totalAllocated += padding + size;
+
+    // Sync points only ever increase, so we only need to extend the newest tail or start a new one
+    if (!m_tails.empty() && m_tails.back().syncPoint >= syncPoint)
+    {
+        m_tails.back().offset = m_tail;
+        m_tails.back().totalAllocated = m_totalAllocated;
+    }
+    else
+    {
+        m_tails.emplace(m_tail, m_totalAllocated, syncPoint);
+    }
+
+    return true;
+}
+
+void UploadStream::Ring::Reset(uint64 syncPoint)
+{
+    while (!m_tails.empty() && m_tails.front().syncPoint < syncPoint)
+    {
+        m_head = m_tails.front().offset;
+        m_totalFreed = m_tails.front().totalAllocated;
+        m_tails.pop();
+    }
+}
@@ -5,16 +5,46 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 
+#include <deque>
 #include <list>
+#include <queue>
 
 using Microsoft::WRL::ComPtr;
 
-// For now, this will just be a page based linear allocator
-// Maybe it would be worth having pages which allocate linearly that are stored in a heap, but this will be fine to start (or that's too slow)
-// Having a 'destruction queue' or something like that could be interesting
+// Counters for a single frame, see UploadStream::EndFrame
+struct UploadStreamStats
+{
+    uint64 bytesAllocated = 0;
+    // Space skipped at the end of a page or when the ring wraps, plus the unused tail of dedicated blocks
+    uint64 bytesWasted = 0;
+    // Every upload buffer currently held, in use or idle. Includes the ring and dedicated blocks.
+    uint32 pagesLive = 0;
+    uint32 pagesCreated = 0;
+    uint32 pagesDestroyed = 0;
+};
+
+// Idle pages are released once we're holding more than max(minPages, peak pages in use over the last peakWindowFrames frames)
+// Applied separately to regular pages and to dedicated blocks
+struct UploadStreamRetentionPolicy
+{
+    uint32 minPages = 1;
+    uint32 peakWindowFrames = 120;
+};
+
+// Upload memory allocator with two modes:
+//  - Paged: a list of linear allocators ('pages'), each recycled once the GPU is done with everything allocated from it
+//  - Ring: a single persistently mapped ring buffer, the tail is recorded per sync point so space is handed back as fences complete
+// In either mode, requests which don't fit in a page (or in a full ring) get a dedicated block. Dedicated blocks are pooled and
+// reused once their fence completes, rather than stranding a mostly empty page.
 class UploadStream
 {
 public:
+    enum Mode
+    {
+        ModePaged,
+        ModeRing
+    };
+
     struct Allocation
     {
         // Afaik you have to have a pointer to the buffer itself to be able to copy from it, so allocations must track the resource they came from
@@ -27,14 +57,30 @@ public:
             return buffer->GetGPUVirtualAddress() + bufferOffset;
         }
     };
-    
-    UploadStream(Device* device, size_t pageSize = _32MB);
+
+    UploadStream(Device* device, size_t pageSize = _32MB, Mode mode = ModePaged);
+    ~UploadStream();
 
     Allocation Allocate(size_t size, uint64 syncPoint);
     Allocation AllocateAligned(size_t size, size_t align, uint64 syncPoint);
 
+    // syncPoint is the last completed fence value, anything allocated with a sync point before it is freed
     void ResetAllocations(uint64 syncPoint);
 
+    // Trims idle pages according to the retention policy and starts a new set of stats
+    void EndFrame();
+
+    void SetRetentionPolicy(const UploadStreamRetentionPolicy& policy)
+    {
+        m_retentionPolicy = policy;
+    }
+
+    // Stats for the last frame that was ended
+    const UploadStreamStats& GetStats()
+    {
+        return m_lastFrameStats;
+    }
+
 
 private:
     class Page
@@ -53,6 +99,16 @@ private:
             return m_syncPoint;
         }
 
+        size_t GetSize()
+        {
+            return m_pageSize;
+        }
+
+        size_t GetFreeSize()
+        {
+            return m_pageSize - m_offset;
+        }
+
         bool IsEmpty()
         {
             return m_offset == 0;
@@ -67,11 +123,86 @@ private:
 
     };
 
+    class Ring
+    {
+    public:
+        Ring() = delete;
+        Ring(size_t _ringSize, ID3D12Resource* _ringBuffer);
+        ~Ring();
+
+        bool Allocate(size_t size, size_t align, uint64 syncPoint, Allocation& allocOut, size_t& wastedOut);
+
+        void Reset(uint64 syncPoint);
+
+    private:
+        // Where the tail was after the last allocation for a given sync point. Once that sync point has completed, the head can move up to it.
+        struct Tail
+        {
+            Tail(size_t _offset, uint64 _totalAllocated, uint64 _syncPoint) :
+                offset(_offset),
+                totalAllocated(_totalAllocated),
+                syncPoint(_syncPoint) {}
+
+            size_t offset;
+            uint64 totalAllocated;
+            uint64 syncPoint;
+        };
+
+        ComPtr<ID3D12Resource> m_ringBuffer;
+        void* m_cpuAddr;
+        size_t m_ringSize;
+
+        size_t m_head;
+        size_t m_tail;
+
+        // Running totals (including any padding skipped when wrapping) so we don't have to disambiguate head == tail
+        uint64 m_totalAllocated;
+        uint64 m_totalFreed;
+
+        std::queue<Tail> m_tails;
+    };
+
+    // Peak number of pages in use per frame, over a sliding window of frames
+    class PeakHistory
+    {
+    public:
+        void Update(uint32 inUse)
+        {
+            m_currPeak = std::max(m_currPeak, inUse);
+        }
+
+        // Records the current frame's peak, starts the next frame at inUse and returns the peak over the window
+        uint32 EndFrame(uint32 inUse, uint32 windowFrames);
+
+    private:
+        std::deque<uint32> m_peaks;
+        uint32 m_currPeak = 0;
+    };
+
     Device* m_device;
 
-    Page& AllocatePage();
+    ID3D12Resource* CreateUploadBuffer(size_t size);
+
+    Page& AcquirePage();
+
+    Allocation AllocateDedicated(size_t size, size_t align, uint64 syncPoint);
 
+    Mode m_mode;
+
+    // Pages with live allocations in allocation order, the back is the one currently being allocated from
     std::list<Page> m_pages;
+    std::list<Page> m_freePages;
+    Ring* m_pRing;
+
+    std::list<Page> m_dedicatedPages;
+    uint32 m_dedicatedPagesInUse;
+
     size_t m_pageSize;
-};
 
+    UploadStreamRetentionPolicy m_retentionPolicy;
+    PeakHistory m_pageHistory;
+    PeakHistory m_dedicatedHistory;
+
+    UploadStreamStats m_frameStats;
+    UploadStreamStats m_lastFrameStats;
+};
@@ -0,0 +1,79 @@
+#include "DrawList.h"
+
+#include "Generic/RadixSort.h"
+
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock HighResClock;
+
+static uint64 sGetKeyField(
+    uint64 key,
+    uint32 shift,
+    uint32 bits)
+{
+    return (key >> shift) & ((1ull << bits) - 1);
+}
+
+uint64 DrawList::MakeKey(
+    uint32 pipeline,
+    uint32 material,
+    uint32 geometry,
+    float viewDepth)
+{
+    ASSERT(pipeline < (1u << DRAW_KEY_PIPELINE_BITS));
+    ASSERT(material < (1u << DRAW_KEY_MATERIAL_BITS));
+    ASSERT(geometry < (1u << DRAW_KEY_GEOMETRY_BITS));
+
+    // Positive floats sort the same as their bit patterns, so keeping the top bits quantises with more precision up close
+    uint32 depthBits = 0;
+    if (viewDepth > 0.0f)
+    {
+        memcpy(&depthBits, &viewDepth, sizeof(depthBits));
+    }
+    uint64 depth = depthBits >> (32 - DRAW_KEY_DEPTH_BITS);
+
+    return ((uint64)pipeline << DRAW_KEY_PIPELINE_SHIFT) |
+        ((uint64)material << DRAW_KEY_MATERIAL_SHIFT) |
+        ((uint64)geometry << DRAW_KEY_GEOMETRY_SHIFT) |
+        (depth << DRAW_KEY_DEPTH_SHIFT);
+}
+
+void DrawList::Clear(
+    void)
+{
+    m_keys.clear();
+    m_indices.clear();
+}
+
+void DrawList::Add(
+    uint64 key,
+    uint32 index)
+{
+    m_keys.push_back(key);
+    m_indices.push_back(index);
+}
+
+void DrawList::Sort(
+    DrawListStats& statsOut)
+{
+    uint32 count = Size();
+    m_tempKeys.resize(count);
+    m_tempIndices.resize(count);
+
+    std::chrono::time_point<HighResClock> start = HighResClock::now();
+    RadixSort::SortKeyValues(m_keys.data(), m_indices.data(), m_tempKeys.data(), m_tempIndices.data(), count);
+    std::chrono::duration<float, std::milli> sortTime = HighResClock::now() - start;
+
+    statsOut = DrawListStats();
+    statsOut.numDraws = count;
+    statsOut.sortTimeMs = sortTime.count();
+
+    for (uint32 i = 1; i < count; i++)
+    {
+        uint64 prev = m_keys[i - 1];
+        uint64 curr = m_keys[i];
+        statsOut.pipelineChanges += sGetKeyField(prev, DRAW_KEY_PIPELINE_SHIFT, DRAW_KEY_PIPELINE_BITS) != sGetKeyField(curr, DRAW_KEY_PIPELINE_SHIFT, DRAW_KEY_PIPELINE_BITS);
+        statsOut.materialChanges += sGetKeyField(prev, DRAW_KEY_MATERIAL_SHIFT, DRAW_KEY_MATERIAL_BITS) != sGetKeyField(curr, DRAW_KEY_MATERIAL_SHIFT, DRAW_KEY_MATERIAL_BITS);
+        statsOut.geometryChanges += sGetKeyField(prev, DRAW_KEY_GEOMETRY_SHIFT, DRAW_KEY_GEOMETRY_BITS) != sGetKeyField(curr, DRAW_KEY_GEOMETRY_SHIFT, DRAW_KEY_GEOMETRY_BITS);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+// Sort key layout, most significant first. Draws are grouped by the state that's most expensive to change, and only then ordered
+// front to back, so early-Z still gets most of the benefit without breaking up the groups.
+#define DRAW_KEY_PIPELINE_BITS 4
+#define DRAW_KEY_MATERIAL_BITS 20
+#define DRAW_KEY_GEOMETRY_BITS 16
+#define DRAW_KEY_DEPTH_BITS 24
+
+#define DRAW_KEY_DEPTH_SHIFT 0
+#define DRAW_KEY_GEOMETRY_SHIFT (DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS)
+#define DRAW_KEY_MATERIAL_SHIFT (DRAW_KEY_GEOMETRY_SHIFT + DRAW_KEY_GEOMETRY_BITS)
+#define DRAW_KEY_PIPELINE_SHIFT (DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS)
+
+struct DrawListStats
+{
+    uint32 numDraws = 0;
+    // Draw calls actually issued, after identical draws have been collapsed into instanced ones
+    uint32 numDrawCalls = 0;
+    // How often consecutive draws differ in each part of the key, i.e. the state changes the sorted order costs
+    uint32 pipelineChanges = 0;
+    uint32 materialChanges = 0;
+    uint32 geometryChanges = 0;
+    float sortTimeMs = 0.0f;
+    // Renderables outside the camera's frustum or hidden by occluders, which never made it into the list
+    uint32 numCulled = 0;
+    float cullTimeMs = 0.0f;
+    // Renderables inside the frustum which were hidden, and the occluders drawn to find them
+    uint32 numOccluded = 0;
+    uint32 numOccluders = 0;
+    float occlusionTimeMs = 0.0f;
+    // Triangles in the list once each renderable's LOD has been picked
+    uint32 numTriangles = 0;
+};
+
+// Draws for one frame, as a sort key and the index of whatever is being drawn
+class DrawList
+{
+public:
+    static uint64 MakeKey(
+        uint32 pipeline,
+        uint32 material,
+        uint32 geometry,
+        float viewDepth);
+
+    void Clear(
+        void);
+
+    void Add(
+        uint64 key,
+        uint32 index);
+
+    // Radix sorts the draws by key, then fills in the state change counts of statsOut for the sorted order
+    void Sort(
+        DrawListStats& statsOut);
+
+    uint32 Size()
+    {
+        return (uint32)m_keys.size();
+    }
+
+    uint64 GetKey(
+        uint32 i)
+    {
+        return m_keys[i];
+    }
+
+    uint32 GetIndex(
+        uint32 i)
+    {
+        return m_indices[i];
+    }
+
+private:
+    std::vector<uint64> m_keys;
+    std::vector<uint32> m_indices;
+
+    std::vector<uint64> m_tempKeys;
+    std::vector<uint32> m_tempIndices;
+};
@@ -0,0 +1,260 @@
+#include "FrustumCulling.h"
+
+#include <cmath>
+#include <immintrin.h>
+
+static Vector4 sNormalisePlane(
+    float a,
+    float b,
+    float c,
+    float d)
+{
+    float invLength = 1.0f / sqrtf(a * a + b * b + c * c);
+    return Vector4(a * invLength, b * invLength, c * invLength, d * invLength);
+}
+
+void Frustum::FromViewProj(
+    const Matrix4x4& matViewProj,
+    Frustum& frustumOut)
+{
+    // Gribb and Hartmann: clip space x is row 0 dotted with the position and w is row 3, so -w <= x is (row 3 + row 0) . pos >= 0
+    // and so on for the other planes. Depth only goes from 0 to w, so the near plane is just row 2.
+    const Matrix4x4& m = matViewProj;
+    frustumOut.planes[FrustumPlaneLeft] = sNormalisePlane(m._41 + m._11, m._42 + m._12, m._43 + m._13, m._44 + m._14);
+    frustumOut.planes[FrustumPlaneRight] = sNormalisePlane(m._41 - m._11, m._42 - m._12, m._43 - m._13, m._44 - m._14);
+    frustumOut.planes[FrustumPlaneBottom] = sNormalisePlane(m._41 + m._21, m._42 + m._22, m._43 + m._23, m._44 + m._24);
+    frustumOut.planes[FrustumPlaneTop] = sNormalisePlane(m._41 - m._21, m._42 - m._22, m._43 - m._23, m._44 - m._24);
+    frustumOut.planes[FrustumPlaneNear] = sNormalisePlane(m._31, m._32, m._33, m._34);
+    frustumOut.planes[FrustumPlaneFar] = sNormalisePlane(m._41 - m._31, m._42 - m._32, m._43 - m._33, m._44 - m._34);
+}
+
+void CullingBounds::Clear(
+    void)
+{
+    boxCentreX.clear();
+    boxCentreY.clear();
+    boxCentreZ.clear();
+    boxExtentX.clear();
+    boxExtentY.clear();
+    boxExtentZ.clear();
+    sphereCentreX.clear();
+    sphereCentreY.clear();
+    sphereCentreZ.clear();
+    sphereRadius.clear();
+}
+
+void CullingBounds::Add(
+    const Vector3& boundsMin,
+    const Vector3& boundsMax,
+    const Vector3& sphereCentre,
+    float radius)
+{
+    boxCentreX.push_back((boundsMin.x + boundsMax.x) * 0.5f);
+    boxCentreY.push_back((boundsMin.y + boundsMax.y) * 0.5f);
+    boxCentreZ.push_back((boundsMin.z + boundsMax.z) * 0.5f);
+    boxExtentX.push_back((boundsMax.x - boundsMin.x) * 0.5f);
+    boxExtentY.push_back((boundsMax.y - boundsMin.y) * 0.5f);
+    boxExtentZ.push_back((boundsMax.z - boundsMin.z) * 0.5f);
+    sphereCentreX.push_back(sphereCentre.x);
+    sphereCentreY.push_back(sphereCentre.y);
+    sphereCentreZ.push_back(sphereCentre.z);
+    sphereRadius.push_back(radius);
+}
+
+bool FrustumCulling::IsVisible(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32 index)
+{
+    bool fOutside = false;
+    for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+    {
+        const Vector4& p = frustum.planes[plane];
+
+        // The box's extents projected onto the plane normal give how far it reaches towards the plane from its centre. Summed in the
+        // same order as sCullSIMD, so bounds touching a plane get the same answer whichever path tests them.
+        float boxDistance = (p.x * bounds.boxCentreX[index] + p.y * bounds.boxCentreY[index]) + (p.z * bounds.boxCentreZ[index] + p.w);
+        float boxRadius = fabsf(p.x) * bounds.boxExtentX[index] + fabsf(p.y) * bounds.boxExtentY[index] + fabsf(p.z) * bounds.boxExtentZ[index];
+        float sphereDistance = (p.x * bounds.sphereCentreX[index] + p.y * bounds.sphereCentreY[index]) + (p.z * bounds.sphereCentreZ[index] + p.w);
+
+        fOutside |= boxDistance + boxRadius < 0.0f;
+        fOutside |= sphereDistance + bounds.sphereRadius[index] < 0.0f;
+    }
+    return !fOutside;
+}
+
+uint32 FrustumCulling::CullScalar(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32 first,
+    uint32 end,
+    uint32* pVisibleOut)
+{
+    uint32 numVisible = 0;
+    for (uint32 i = first; i < end; i++)
+    {
+        pVisibleOut[numVisible] = i;
+        numVisible += IsVisible(frustum, bounds, i);
+    }
+    return numVisible;
+}
+
+#if USE_SIMD_FRUSTUM_CULLING
+#if defined(__AVX2__)
+
+#define CULL_LANES 8
+
+static uint32 sCullSIMD(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32 end,
+    uint32* pVisibleOut)
+{
+    // Every plane's components broadcast across a register once, rather than for every group of renderables
+    __m256 planeX[FrustumPlaneCount], planeY[FrustumPlaneCount], planeZ[FrustumPlaneCount], planeW[FrustumPlaneCount];
+    __m256 absPlaneX[FrustumPlaneCount], absPlaneY[FrustumPlaneCount], absPlaneZ[FrustumPlaneCount];
+    for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+    {
+        const Vector4& p = frustum.planes[plane];
+        planeX[plane] = _mm256_set1_ps(p.x);
+        planeY[plane] = _mm256_set1_ps(p.y);
+        planeZ[plane] = _mm256_set1_ps(p.z);
+        planeW[plane] = _mm256_set1_ps(p.w);
+        absPlaneX[plane] = _mm256_set1_ps(fabsf(p.x));
+        absPlaneY[plane] = _mm256_set1_ps(fabsf(p.y));
+        absPlaneZ[plane] = _mm256_set1_ps(fabsf(p.z));
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32 numVisible = 0;
+    for (uint32 i = 0; i < end; i += CULL_LANES)
+    {
+        __m256 boxCentreX = _mm256_loadu_ps(&bounds.boxCentreX[i]);
+        __m256 boxCentreY = _mm256_loadu_ps(&bounds.boxCentreY[i]);
+        __m256 boxCentreZ = _mm256_loadu_ps(&bounds.boxCentreZ[i]);
+        __m256 boxExtentX = _mm256_loadu_ps(&bounds.boxExtentX[i]);
+        __m256 boxExtentY = _mm256_loadu_ps(&bounds.boxExtentY[i]);
+        __m256 boxExtentZ = _mm256_loadu_ps(&bounds.boxExtentZ[i]);
+        __m256 sphereCentreX = _mm256_loadu_ps(&bounds.sphereCentreX[i]);
+        __m256 sphereCentreY = _mm256_loadu_ps(&bounds.sphereCentreY[i]);
+        __m256 sphereCentreZ = _mm256_loadu_ps(&bounds.sphereCentreZ[i]);
+        __m256 sphereRadius = _mm256_loadu_ps(&bounds.sphereRadius[i]);
+
+        __m256 outside = zero;
+        for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+        {
+            __m256 boxDistance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planeX[plane], boxCentreX), _mm256_mul_ps(planeY[plane], boxCentreY)),
+                _mm256_add_ps(_mm256_mul_ps(planeZ[plane], boxCentreZ), planeW[plane]));
+            __m256 boxRadius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(absPlaneX[plane], boxExtentX), _mm256_mul_ps(absPlaneY[plane], boxExtentY)),
+                _mm256_mul_ps(absPlaneZ[plane], boxExtentZ));
+            __m256 sphereDistance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planeX[plane], sphereCentreX), _mm256_mul_ps(planeY[plane], sphereCentreY)),
+                _mm256_add_ps(_mm256_mul_ps(planeZ[plane], sphereCentreZ), planeW[plane]));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(boxDistance, boxRadius), zero, _CMP_LT_OQ));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(sphereDistance, sphereRadius), zero, _CMP_LT_OQ));
+        }
+
+        // Every lane's index is written, but the count only moves past the visible ones
+        uint32 visibleMask = ~(uint32)_mm256_movemask_ps(outside);
+        for (uint32 lane = 0; lane < CULL_LANES; lane++)
+        {
+            pVisibleOut[numVisible] = i + lane;
+            numVisible += (visibleMask >> lane) & 1;
+        }
+    }
+    return numVisible;
+}
+
+#else
+
+#define CULL_LANES 4
+
+static uint32 sCullSIMD(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32 end,
+    uint32* pVisibleOut)
+{
+    // Every plane's components broadcast across a register once, rather than for every group of renderables
+    __m128 planeX[FrustumPlaneCount], planeY[FrustumPlaneCount], planeZ[FrustumPlaneCount], planeW[FrustumPlaneCount];
+    __m128 absPlaneX[FrustumPlaneCount], absPlaneY[FrustumPlaneCount], absPlaneZ[FrustumPlaneCount];
+    for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+    {
+        const Vector4& p = frustum.planes[plane];
+        planeX[plane] = _mm_set1_ps(p.x);
+        planeY[plane] = _mm_set1_ps(p.y);
+        planeZ[plane] = _mm_set1_ps(p.z);
+        planeW[plane] = _mm_set1_ps(p.w);
+        absPlaneX[plane] = _mm_set1_ps(fabsf(p.x));
+        absPlaneY[plane] = _mm_set1_ps(fabsf(p.y));
+        absPlaneZ[plane] = _mm_set1_ps(fabsf(p.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32 numVisible = 0;
+    for (uint32 i = 0; i < end; i += CULL_LANES)
+    {
+        __m128 boxCentreX = _mm_loadu_ps(&bounds.boxCentreX[i]);
+        __m128 boxCentreY = _mm_loadu_ps(&bounds.boxCentreY[i]);
+        __m128 boxCentreZ = _mm_loadu_ps(&bounds.boxCentreZ[i]);
+        __m128 boxExtentX = _mm_loadu_ps(&bounds.boxExtentX[i]);
+        __m128 boxExtentY = _mm_loadu_ps(&bounds.boxExtentY[i]);
+        __m128 boxExtentZ = _mm_loadu_ps(&bounds.boxExtentZ[i]);
+        __m128 sphereCentreX = _mm_loadu_ps(&bounds.sphereCentreX[i]);
+        __m128 sphereCentreY = _mm_loadu_ps(&bounds.sphereCentreY[i]);
+        __m128 sphereCentreZ = _mm_loadu_ps(&bounds.sphereCentreZ[i]);
+        __m128 sphereRadius = _mm_loadu_ps(&bounds.sphereRadius[i]);
+
+        __m128 outside = zero;
+        for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+        {
+            __m128 boxDistance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[plane], boxCentreX), _mm_mul_ps(planeY[plane], boxCentreY)),
+                _mm_add_ps(_mm_mul_ps(planeZ[plane], boxCentreZ), planeW[plane]));
+            __m128 boxRadius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(absPlaneX[plane], boxExtentX), _mm_mul_ps(absPlaneY[plane], boxExtentY)),
+                _mm_mul_ps(absPlaneZ[plane], boxExtentZ));
+            __m128 sphereDistance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[plane], sphereCentreX), _mm_mul_ps(planeY[plane], sphereCentreY)),
+                _mm_add_ps(_mm_mul_ps(planeZ[plane], sphereCentreZ), planeW[plane]));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(boxDistance, boxRadius), zero));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(sphereDistance, sphereRadius), zero));
+        }
+
+        // Every lane's index is written, but the count only moves past the visible ones
+        uint32 visibleMask = ~(uint32)_mm_movemask_ps(outside);
+        for (uint32 lane = 0; lane < CULL_LANES; lane++)
+        {
+            pVisibleOut[numVisible] = i + lane;
+            numVisible += (visibleMask >> lane) & 1;
+        }
+    }
+    return numVisible;
+}
+
+#endif
+#endif
+
+uint32 FrustumCulling::Cull(
+    const Frustum& frustum,
+    const CullingBounds& bounds,
+    uint32* pVisibleOut)
+{
+    uint32 count = bounds.Size();
+    uint32 numVisible = 0;
+    uint32 first = 0;
+
+#if USE_SIMD_FRUSTUM_CULLING
+    // Whole groups only, the remainder goes through the scalar path rather than reading past the end of the arrays
+    first = count - count % CULL_LANES;
+    numVisible = sCullSIMD(frustum, bounds, first, pVisibleOut);
+#endif
+
+    return numVisible + CullScalar(frustum, bounds, first, count, pVisibleOut + numVisible);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+// Tests four renderables at a time with SSE, or eight with AVX2 when the compiler's allowed to use it (/arch:AVX2)
+#define USE_SIMD_FRUSTUM_CULLING 1
+
+enum FrustumPlane : int32
+{
+    FrustumPlaneLeft,
+    FrustumPlaneRight,
+    FrustumPlaneBottom,
+    FrustumPlaneTop,
+    FrustumPlaneNear,
+    FrustumPlaneFar,
+    FrustumPlaneCount
+};
+
+struct Frustum
+{
+    // Normalised, with the inside where dot(plane.xyz, pos) + plane.w >= 0
+    Vector4 planes[FrustumPlaneCount];
+
+    // Planes of the clip volume of a column vector view projection matrix (see Camera::GetViewProjMatrix) with depth from 0 to w
+    static void FromViewProj(
+        const Matrix4x4& matViewProj,
+        Frustum& frustumOut);
+};
+
+// World space bounds of every renderable in a scene, with each component in its own array so they can be loaded several renderables
+// at a time. Each has both an AABB and a bounding sphere, since either can be the tighter fit depending on the mesh's shape and how
+// the plane cuts it.
+struct CullingBounds
+{
+    std::vector<float> boxCentreX;
+    std::vector<float> boxCentreY;
+    std::vector<float> boxCentreZ;
+    std::vector<float> boxExtentX;
+    std::vector<float> boxExtentY;
+    std::vector<float> boxExtentZ;
+
+    std::vector<float> sphereCentreX;
+    std::vector<float> sphereCentreY;
+    std::vector<float> sphereCentreZ;
+    std::vector<float> sphereRadius;
+
+    uint32 Size() const
+    {
+        return (uint32)boxCentreX.size();
+    }
+
+    void Clear(
+        void);
+
+    void Add(
+        const Vector3& boundsMin,
+        const Vector3& boundsMax,
+        const Vector3& sphereCentre,
+        float radius);
+};
+
+namespace FrustumCulling
+{
+    // Writes the indices of the bounds which are at least partly inside the frustum to pVisibleOut (which has to have room for all of
+    // them) in ascending order, and returns how many there are. Bounds are culled if either their box or their sphere is entirely
+    // outside any one plane, so some bounds which only cross a corner of the frustum are let through.
+    uint32 Cull(
+        const Frustum& frustum,
+        const CullingBounds& bounds,
+        uint32* pVisibleOut);
+
+    // Same test as Cull for a single renderable
+    bool IsVisible(
+        const Frustum& frustum,
+        const CullingBounds& bounds,
+        uint32 index);
+
+    // One renderable at a time, Cull uses this when SIMD is off and for whatever's left over at the end
+    uint32 CullScalar(
+        const Frustum& frustum,
+        const CullingBounds& bounds,
+        uint32 first,
+        uint32 end,
+        uint32* pVisibleOut);
+}
@@ -0,0 +1,461 @@
+#include "MeshSimplify.h"
+
+#include "Generic/Utils.h"
+#include "Renderer/VertexFormats.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Position, normal and UV
+#define QUADRIC_DIMENSIONS 8
+#define QUADRIC_MATRIX_SIZE (QUADRIC_DIMENSIONS * (QUADRIC_DIMENSIONS + 1) / 2)
+
+// Error of a point v against a set of triangles, as the sum of each one's weighted squared distance to v: v.Av + 2b.v + c. A is
+// symmetric so only its upper triangle is kept, row by row.
+struct Quadric
+{
+    double a[QUADRIC_MATRIX_SIZE];
+    double b[QUADRIC_DIMENSIONS];
+    double c;
+    double weight;
+};
+
+struct Collapse
+{
+    uint32 from;
+    uint32 to;
+    float error;
+};
+
+static double sDot(
+    const double* pA,
+    const double* pB)
+{
+    double dot = 0.0;
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        dot += pA[i] * pB[i];
+    }
+    return dot;
+}
+
+// Adds the quadric of the plane through p, q and r, spanning all of the dimensions' space. The triangle's two edges are turned into
+// an orthonormal basis e1 and e2, and the distance to the plane is whatever's left of v - p once it's projected onto them.
+static void sQuadricAddTriangle(
+    const double* pP,
+    const double* pQ,
+    const double* pR,
+    double weight,
+    Quadric& quadric)
+{
+    double e1[QUADRIC_DIMENSIONS];
+    double e2[QUADRIC_DIMENSIONS];
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        e1[i] = pQ[i] - pP[i];
+        e2[i] = pR[i] - pP[i];
+    }
+
+    double length1 = sqrt(sDot(e1, e1));
+    if (length1 <= DBL_EPSILON)
+    {
+        return;
+    }
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        e1[i] /= length1;
+    }
+
+    double along = sDot(e2, e1);
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        e2[i] -= along * e1[i];
+    }
+    double length2 = sqrt(sDot(e2, e2));
+    if (length2 <= DBL_EPSILON)
+    {
+        return;
+    }
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        e2[i] /= length2;
+    }
+
+    // A = I - e1e1 - e2e2, b = (p.e1)e1 + (p.e2)e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+    double pDotE1 = sDot(pP, e1);
+    double pDotE2 = sDot(pP, e2);
+    uint32 element = 0;
+    for (uint32 row = 0; row < QUADRIC_DIMENSIONS; row++)
+    {
+        for (uint32 column = row; column < QUADRIC_DIMENSIONS; column++)
+        {
+            double identity = row == column ? 1.0 : 0.0;
+            quadric.a[element++] += weight * (identity - e1[row] * e1[column] - e2[row] * e2[column]);
+        }
+        quadric.b[row] += weight * (pDotE1 * e1[row] + pDotE2 * e2[row] - pP[row]);
+    }
+    quadric.c += weight * (sDot(pP, pP) - pDotE1 * pDotE1 - pDotE2 * pDotE2);
+    quadric.weight += weight;
+}
+
+static void sQuadricAdd(
+    const Quadric& source,
+    Quadric& quadric)
+{
+    for (uint32 i = 0; i < QUADRIC_MATRIX_SIZE; i++)
+    {
+        quadric.a[i] += source.a[i];
+    }
+    for (uint32 i = 0; i < QUADRIC_DIMENSIONS; i++)
+    {
+        quadric.b[i] += source.b[i];
+    }
+    quadric.c += source.c;
+    quadric.weight += source.weight;
+}
+
+// Mean squared distance, so it doesn't depend on how finely the triangles were cut
+static double sQuadricError(
+    const Quadric& quadric,
+    const double* pV)
+{
+    if (quadric.weight <= 0.0)
+    {
+        return 0.0;
+    }
+
+    double error = quadric.c;
+    uint32 element = 0;
+    for (uint32 row = 0; row < QUADRIC_DIMENSIONS; row++)
+    {
+        error += quadric.a[element++] * pV[row] * pV[row];
+        for (uint32 column = row + 1; column < QUADRIC_DIMENSIONS; column++)
+        {
+            error += 2.0 * quadric.a[element++] * pV[row] * pV[column];
+        }
+        error += 2.0 * quadric.b[row] * pV[row];
+    }
+
+    // Rounding can take it just below zero
+    return std::max(error, 0.0) / quadric.weight;
+}
+
+// Whether moving from onto to turns any of from's triangles which survive the collapse over, either from how it was or from the
+// normals of its corners. Small turns from many collapses add up, so only checking the first lets a triangle end up side on or
+// facing away from the surface it's shading.
+static bool sCollapseFlips(
+    const double* pPoints,
+    const std::vector<uint32>& indices,
+    const std::vector<uint32>& triangleOffsets,
+    const std::vector<uint32>& vertexTriangles,
+    uint32 from,
+    uint32 to)
+{
+    for (uint32 adjacent = triangleOffsets[from]; adjacent < triangleOffsets[from + 1]; adjacent++)
+    {
+        const uint32* pTriangle = &indices[3 * vertexTriangles[adjacent]];
+        if (pTriangle[0] == to || pTriangle[1] == to || pTriangle[2] == to)
+        {
+            continue;
+        }
+
+        double before[3][3];
+        double after[3][3];
+        for (uint32 corner = 0; corner < 3; corner++)
+        {
+            const double* pPoint = &pPoints[QUADRIC_DIMENSIONS * pTriangle[corner]];
+            const double* pMoved = &pPoints[QUADRIC_DIMENSIONS * (pTriangle[corner] == from ? to : pTriangle[corner])];
+            for (uint32 axis = 0; axis < 3; axis++)
+            {
+                before[corner][axis] = pPoint[axis];
+                after[corner][axis] = pMoved[axis];
+            }
+        }
+
+        double normals[2][3];
+        double (*pCorners[2])[3] = { before, after };
+        for (uint32 i = 0; i < 2; i++)
+        {
+            double (*c)[3] = pCorners[i];
+            double u[3] = { c[1][0] - c[0][0], c[1][1] - c[0][1], c[1][2] - c[0][2] };
+            double v[3] = { c[2][0] - c[0][0], c[2][1] - c[0][1], c[2][2] - c[0][2] };
+            normals[i][0] = u[1] * v[2] - u[2] * v[1];
+            normals[i][1] = u[2] * v[0] - u[0] * v[2];
+            normals[i][2] = u[0] * v[1] - u[1] * v[0];
+        }
+
+        double dot = normals[0][0] * normals[1][0] + normals[0][1] * normals[1][1] + normals[0][2] * normals[1][2];
+        if (dot <= 0.0)
+        {
+            return true;
+        }
+
+        // Has to stay within about 87 degrees of the corners' normals, which are only used for direction
+        double cornerNormal[3] = { 0.0, 0.0, 0.0 };
+        for (uint32 corner = 0; corner < 3; corner++)
+        {
+            const double* pMoved = &pPoints[QUADRIC_DIMENSIONS * (pTriangle[corner] == from ? to : pTriangle[corner])];
+            for (uint32 axis = 0; axis < 3; axis++)
+            {
+                cornerNormal[axis] += pMoved[3 + axis];
+            }
+        }
+        double facing = normals[1][0] * cornerNormal[0] + normals[1][1] * cornerNormal[1] + normals[1][2] * cornerNormal[2];
+        double lengths = sqrt((normals[1][0] * normals[1][0] + normals[1][1] * normals[1][1] + normals[1][2] * normals[1][2]) *
+            (cornerNormal[0] * cornerNormal[0] + cornerNormal[1] * cornerNormal[1] + cornerNormal[2] * cornerNormal[2]));
+        if (facing <= 0.05 * lengths)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+float MeshSimplify::Simplify(
+    const Vertex* pVerts,
+    uint32 numVerts,
+    const uint32* pIndices,
+    uint32 numIndices,
+    uint32 targetIndices,
+    float maxError,
+    std::vector<uint32>& indicesOut)
+{
+    ASSERT((numIndices % 3) == 0);
+
+    indicesOut.assign(pIndices, pIndices + numIndices);
+    if (numIndices <= targetIndices || numVerts == 0)
+    {
+        return 0.0f;
+    }
+
+    // Positions are scaled to the unit cube so the attribute weights mean the same whatever the mesh's size
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32 vert = 0; vert < numVerts; vert++)
+    {
+        for (uint32 axis = 0; axis < 3; axis++)
+        {
+            boundsMin[axis] = std::min(boundsMin[axis], pVerts[vert].pos[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], pVerts[vert].pos[axis]);
+        }
+    }
+    float scale = std::max(std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]), boundsMax[2] - boundsMin[2]);
+    if (scale <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    std::vector<double> points(QUADRIC_DIMENSIONS * numVerts);
+    for (uint32 vert = 0; vert < numVerts; vert++)
+    {
+        double* pPoint = &points[QUADRIC_DIMENSIONS * vert];
+        for (uint32 axis = 0; axis < 3; axis++)
+        {
+            pPoint[axis] = (pVerts[vert].pos[axis] - boundsMin[axis]) / scale;
+            pPoint[3 + axis] = pVerts[vert].normal[axis] * SIMPLIFY_NORMAL_WEIGHT;
+        }
+        pPoint[6] = pVerts[vert].uv[0] * SIMPLIFY_UV_WEIGHT;
+        pPoint[7] = pVerts[vert].uv[1] * SIMPLIFY_UV_WEIGHT;
+    }
+
+    // Vertices sharing a position are split across a seam, and lock each other in place. Hashed on the position's bits since only
+    // exact copies count.
+    std::vector<bool> locked(numVerts, false);
+    std::vector<uint32> positionVerts(numVerts);
+    {
+        std::unordered_map<uint64, uint32> firstVertAtPosition;
+        for (uint32 vert = 0; vert < numVerts; vert++)
+        {
+            uint64 hash = Utils::Hash(pVerts[vert].pos, sizeof(pVerts[vert].pos));
+            auto it = firstVertAtPosition.find(hash);
+            if (it == firstVertAtPosition.end())
+            {
+                firstVertAtPosition[hash] = vert;
+                positionVerts[vert] = vert;
+            }
+            else if (memcmp(pVerts[it->second].pos, pVerts[vert].pos, sizeof(pVerts[vert].pos)) == 0)
+            {
+                positionVerts[vert] = it->second;
+                locked[vert] = true;
+                locked[it->second] = true;
+            }
+            else
+            {
+                positionVerts[vert] = vert;
+            }
+        }
+    }
+
+    // Edges between positions with only one triangle are on an open edge of the mesh. Each is counted from both ends so the key
+    // doesn't depend on which way round the triangle has it.
+    {
+        std::unordered_map<uint64, uint32> edgeTriangles;
+        for (uint32 i = 0; i < numIndices; i++)
+        {
+            uint32 a = positionVerts[pIndices[i]];
+            uint32 b = positionVerts[pIndices[i - i % 3 + (i + 1) % 3]];
+            edgeTriangles[((uint64)std::min(a, b) << 32) | std::max(a, b)]++;
+        }
+        for (auto it = edgeTriangles.begin(); it != edgeTriangles.end(); it++)
+        {
+            if (it->second == 1)
+            {
+                locked[(uint32)(it->first >> 32)] = true;
+                locked[(uint32)it->first] = true;
+            }
+        }
+        for (uint32 vert = 0; vert < numVerts; vert++)
+        {
+            locked[vert] = locked[vert] || locked[positionVerts[vert]];
+        }
+    }
+
+    // Every vertex starts with the quadrics of its triangles, weighted by their area so big flat areas aren't drowned out
+    std::vector<Quadric> quadrics(numVerts);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+    for (uint32 i = 0; i < numIndices; i += 3)
+    {
+        const double* pP = &points[QUADRIC_DIMENSIONS * pIndices[i]];
+        const double* pQ = &points[QUADRIC_DIMENSIONS * pIndices[i + 1]];
+        const double* pR = &points[QUADRIC_DIMENSIONS * pIndices[i + 2]];
+
+        double u[3] = { pQ[0] - pP[0], pQ[1] - pP[1], pQ[2] - pP[2] };
+        double v[3] = { pR[0] - pP[0], pR[1] - pP[1], pR[2] - pP[2] };
+        double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+        double area = 0.5 * sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+        Quadric triangle;
+        memset(&triangle, 0, sizeof(triangle));
+        sQuadricAddTriangle(pP, pQ, pR, area, triangle);
+        for (uint32 corner = 0; corner < 3; corner++)
+        {
+            sQuadricAdd(triangle, quadrics[pIndices[i + corner]]);
+        }
+    }
+
+    std::vector<uint32>& indices = indicesOut;
+    std::vector<uint32> triangleOffsets(numVerts + 1);
+    std::vector<uint32> vertexTriangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint32> remap(numVerts);
+    std::vector<uint32> touchedPass(numVerts, 0);
+
+    float maxErrorSq = (maxError / scale) * (maxError / scale);
+    float resultErrorSq = 0.0f;
+
+    // Each pass works out every edge's cheapest collapse, then makes as many of them as it can in order of cost, skipping any near
+    // one already made since their quadrics and triangles have changed
+    for (uint32 pass = 1; indices.size() > targetIndices; pass++)
+    {
+        uint32 numTriangles = (uint32)indices.size() / 3;
+
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32 i = 0; i < (uint32)indices.size(); i++)
+        {
+            triangleOffsets[indices[i] + 1]++;
+        }
+        for (uint32 vert = 0; vert < numVerts; vert++)
+        {
+            triangleOffsets[vert + 1] += triangleOffsets[vert];
+        }
+        vertexTriangles.resize(indices.size());
+        {
+            std::vector<uint32> nextSlot(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (uint32 i = 0; i < (uint32)indices.size(); i++)
+            {
+                vertexTriangles[nextSlot[indices[i]]++] = i / 3;
+            }
+        }
+
+        // Interior edges are in two triangles, once each way round, so each is only looked at from the one where it goes up
+        collapses.clear();
+        for (uint32 i = 0; i < (uint32)indices.size(); i++)
+        {
+            uint32 a = indices[i];
+            uint32 b = indices[i - i % 3 + (i + 1) % 3];
+            if (a > b || (locked[a] && locked[b]))
+            {
+                continue;
+            }
+
+            Quadric merged = quadrics[a];
+            sQuadricAdd(quadrics[b], merged);
+            float errorOntoB = locked[a] ? FLT_MAX : (float)sQuadricError(merged, &points[QUADRIC_DIMENSIONS * b]);
+            float errorOntoA = locked[b] ? FLT_MAX : (float)sQuadricError(merged, &points[QUADRIC_DIMENSIONS * a]);
+
+            Collapse collapse;
+            collapse.from = errorOntoB <= errorOntoA ? a : b;
+            collapse.to = errorOntoB <= errorOntoA ? b : a;
+            collapse.error = std::min(errorOntoB, errorOntoA);
+            if (collapse.error <= maxErrorSq)
+            {
+                collapses.push_back(collapse);
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.error < b.error;
+        });
+
+        uint32 maxRemoved = std::min(numTriangles - targetIndices / 3, std::max((uint32)(numTriangles * SIMPLIFY_MAX_PASS_REDUCTION), 1u));
+
+        for (uint32 vert = 0; vert < numVerts; vert++)
+        {
+            remap[vert] = vert;
+        }
+
+        uint32 numRemoved = 0;
+        for (auto it = collapses.begin(); it != collapses.end() && numRemoved < maxRemoved; it++)
+        {
+            if (touchedPass[it->from] == pass || touchedPass[it->to] == pass)
+            {
+                continue;
+            }
+            if (sCollapseFlips(points.data(), indices, triangleOffsets, vertexTriangles, it->from, it->to))
+            {
+                continue;
+            }
+
+            remap[it->from] = it->to;
+            sQuadricAdd(quadrics[it->from], quadrics[it->to]);
+            resultErrorSq = std::max(resultErrorSq, it->error);
+
+            // Nothing else this pass can touch the triangles around from, they're about to change
+            for (uint32 adjacent = triangleOffsets[it->from]; adjacent < triangleOffsets[it->from + 1]; adjacent++)
+            {
+                const uint32* pTriangle = &indices[3 * vertexTriangles[adjacent]];
+                touchedPass[pTriangle[0]] = pass;
+                touchedPass[pTriangle[1]] = pass;
+                touchedPass[pTriangle[2]] = pass;
+                numRemoved += (pTriangle[0] == it->to || pTriangle[1] == it->to || pTriangle[2] == it->to) ? 1 : 0;
+            }
+        }
+
+        if (numRemoved == 0)
+        {
+            break;
+        }
+
+        uint32 numKept = 0;
+        for (uint32 i = 0; i < (uint32)indices.size(); i += 3)
+        {
+            uint32 a = remap[indices[i]];
+            uint32 b = remap[indices[i + 1]];
+            uint32 c = remap[indices[i + 2]];
+            if (a != b && b != c && c != a)
+            {
+                indices[numKept++] = a;
+                indices[numKept++] = b;
+                indices[numKept++] = c;
+            }
+        }
+        indices.resize(numKept);
+    }
+
+    return sqrtf(resultErrorSq) * scale;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+struct Vertex;
+
+// How much a unit of difference in normal or UV costs next to the same distance between positions, which are scaled so the mesh's
+// longest side is 1
+#define SIMPLIFY_NORMAL_WEIGHT 0.25f
+#define SIMPLIFY_UV_WEIGHT 0.5f
+
+// Largest part of the triangles left which one pass of collapses tries to remove, the rest wait for the quadrics to be updated
+#define SIMPLIFY_MAX_PASS_REDUCTION 0.25f
+
+namespace MeshSimplify
+{
+    // Reduces the triangle list pIndices to at most targetIndices indices, or as close as it can get without any collapse costing
+    // more than maxError, by collapsing edges cheapest first. The cost of a collapse is the quadric error of the merged vertex's
+    // position, normal and UV against every triangle it came from (Garland and Heckbert's generalised quadrics), so sharp features
+    // and attribute boundaries are kept the longest.
+    //
+    // Vertices are only ever moved onto a neighbour, so the result indexes the same vertices and can share their buffer. Vertices on
+    // an open edge of the mesh or on a seam, where another vertex has the same position, never move so the result doesn't crack.
+    //
+    // Returns the error of the most expensive collapse, scaled back to the positions' units. Attributes count towards it as their
+    // weighted difference, so it's at least as far as the surface has moved.
+    float Simplify(
+        const Vertex* pVerts,
+        uint32 numVerts,
+        const uint32* pIndices,
+        uint32 numIndices,
+        uint32 targetIndices,
+        float maxError,
+        std::vector<uint32>& indicesOut);
+}
@@ -0,0 +1,570 @@
+#include "OcclusionCulling.h"
+
+#include "Generic/JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+// Bounds tested by each job in Cull
+#define OCCLUSION_TESTS_PER_JOB 64
+
+#define OCCLUSION_TILES_X (OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_HEIGHT)
+#define OCCLUSION_NUM_TILES (OCCLUSION_TILES_X * OCCLUSION_TILES_Y)
+#define OCCLUSION_TILE_PIXELS (OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT)
+
+static_assert((OCCLUSION_TILE_WIDTH % 4) == 0, "Occlusion tiles are drawn four pixels at a time");
+
+// Clip space position of pos, using the rows of a column vector matrix
+static Vector4 sTransform(
+    const Vector3& pos,
+    const Matrix4x4& m)
+{
+    return Vector4(
+        m._11 * pos.x + m._12 * pos.y + m._13 * pos.z + m._14,
+        m._21 * pos.x + m._22 * pos.y + m._23 * pos.z + m._24,
+        m._31 * pos.x + m._32 * pos.y + m._33 * pos.z + m._34,
+        m._41 * pos.x + m._42 * pos.y + m._43 * pos.z + m._44);
+}
+
+// Which of the left, right, bottom, top and far planes pos is outside of
+static uint32 sOutcode(
+    const Vector4& pos)
+{
+    return (pos.x < -pos.w ? 1 : 0) |
+        (pos.x > pos.w ? 2 : 0) |
+        (pos.y < -pos.w ? 4 : 0) |
+        (pos.y > pos.w ? 8 : 0) |
+        (pos.z > pos.w ? 16 : 0);
+}
+
+static float sHorizontalMin(
+    __m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+static float sHorizontalMax(
+    __m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+static uint32 sTileIndex(
+    uint32 x,
+    uint32 y)
+{
+    return (y / OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILES_X + x / OCCLUSION_TILE_WIDTH;
+}
+
+OcclusionBuffer::OcclusionBuffer()
+{
+    m_depth.resize(OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT, 1.0f);
+    for (uint32 level = 1; level < OCCLUSION_NUM_LEVELS; level++)
+    {
+        uint32 size = (OCCLUSION_BUFFER_WIDTH >> level) * (OCCLUSION_BUFFER_HEIGHT >> level);
+        m_minDepth[level].resize(size, 1.0f);
+        m_maxDepth[level].resize(size, 1.0f);
+    }
+
+    m_matViewProj = Matrix4x4::Identity;
+    m_numTrianglesDrawn = 0;
+}
+
+void OcclusionBuffer::OccludersDraw(
+    const Matrix4x4& matViewProj,
+    const OccluderMesh* const* ppOccluders,
+    const Matrix4x4* pMatWorlds,
+    uint32 numOccluders,
+    JobSystem& jobSystem)
+{
+    m_matViewProj = matViewProj;
+
+    if (m_workerBins.size() < jobSystem.GetNumWorkers())
+    {
+        m_workerBins.resize(jobSystem.GetNumWorkers());
+    }
+    for (auto it = m_workerBins.begin(); it != m_workerBins.end(); it++)
+    {
+        it->triangles.clear();
+        for (uint32 tile = 0; tile < OCCLUSION_NUM_TILES; tile++)
+        {
+            it->tileTriangles[tile].clear();
+        }
+    }
+
+    // Each worker bins into its own lists, so setting up doesn't need any synchronisation
+    jobSystem.ParallelFor(0, numOccluders, 1, [&](uint32 first, uint32 end)
+    {
+        WorkerBins& bins = m_workerBins[jobSystem.GetWorkerIndex()];
+        for (uint32 i = first; i < end; i++)
+        {
+            OccluderSetup(*ppOccluders[i], matViewProj * pMatWorlds[i], bins);
+        }
+    });
+
+    m_numTrianglesDrawn = 0;
+    for (auto it = m_workerBins.begin(); it != m_workerBins.end(); it++)
+    {
+        m_numTrianglesDrawn += (uint32)it->triangles.size();
+    }
+
+    jobSystem.ParallelFor(0, OCCLUSION_NUM_TILES, 1, [&](uint32 first, uint32 end)
+    {
+        for (uint32 tile = first; tile < end; tile++)
+        {
+            TileDraw(tile);
+            TileLevelsBuild(tile);
+        }
+    });
+
+    // Only a handful of texels are left by now, not worth another round of jobs
+    for (uint32 level = OCCLUSION_TILE_LEVELS + 1; level < OCCLUSION_NUM_LEVELS; level++)
+    {
+        uint32 width = OCCLUSION_BUFFER_WIDTH >> level;
+        uint32 height = OCCLUSION_BUFFER_HEIGHT >> level;
+        uint32 prevWidth = width * 2;
+        const float* pPrevMin = m_minDepth[level - 1].data();
+        const float* pPrevMax = m_maxDepth[level - 1].data();
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            for (uint32 x = 0; x < width; x++)
+            {
+                uint32 prev = 2 * y * prevWidth + 2 * x;
+                m_minDepth[level][y * width + x] = std::min(std::min(pPrevMin[prev], pPrevMin[prev + 1]),
+                    std::min(pPrevMin[prev + prevWidth], pPrevMin[prev + prevWidth + 1]));
+                m_maxDepth[level][y * width + x] = std::max(std::max(pPrevMax[prev], pPrevMax[prev + 1]),
+                    std::max(pPrevMax[prev + prevWidth], pPrevMax[prev + prevWidth + 1]));
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::OccluderSetup(
+    const OccluderMesh& occluder,
+    const Matrix4x4& matWorldViewProj,
+    WorkerBins& bins)
+{
+    std::vector<Vector4>& clipPositions = bins.clipPositions;
+    clipPositions.resize(occluder.positions.size());
+    for (uint32 i = 0; i < (uint32)occluder.positions.size(); i++)
+    {
+        clipPositions[i] = sTransform(occluder.positions[i], matWorldViewProj);
+    }
+
+    for (uint32 i = 0; i + 2 < (uint32)occluder.indices.size(); i += 3)
+    {
+        Vector4 clip[3] = {
+            clipPositions[occluder.indices[i]],
+            clipPositions[occluder.indices[i + 1]],
+            clipPositions[occluder.indices[i + 2]] };
+
+        if (sOutcode(clip[0]) & sOutcode(clip[1]) & sOutcode(clip[2]))
+        {
+            continue;
+        }
+
+        uint32 numBehind = (clip[0].z < 0.0f ? 1 : 0) + (clip[1].z < 0.0f ? 1 : 0) + (clip[2].z < 0.0f ? 1 : 0);
+        if (numBehind == 0)
+        {
+            TriangleBin(clip, bins);
+            continue;
+        }
+        if (numBehind == 3)
+        {
+            continue;
+        }
+
+        // Cut off whatever's behind the near plane, which leaves a triangle or a quad
+        Vector4 clipped[4];
+        uint32 numClipped = 0;
+        for (uint32 vert = 0; vert < 3; vert++)
+        {
+            const Vector4& a = clip[vert];
+            const Vector4& b = clip[(vert + 1) % 3];
+            if (a.z >= 0.0f)
+            {
+                clipped[numClipped++] = a;
+            }
+            if ((a.z >= 0.0f) != (b.z >= 0.0f))
+            {
+                float t = a.z / (a.z - b.z);
+                clipped[numClipped++] = Vector4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t);
+            }
+        }
+
+        for (uint32 vert = 1; vert + 1 < numClipped; vert++)
+        {
+            Vector4 fan[3] = { clipped[0], clipped[vert], clipped[vert + 1] };
+            TriangleBin(fan, bins);
+        }
+    }
+}
+
+void OcclusionBuffer::TriangleBin(
+    const Vector4* pClip,
+    WorkerBins& bins)
+{
+    float x[3];
+    float y[3];
+    float z[3];
+    for (uint32 vert = 0; vert < 3; vert++)
+    {
+        float invW = 1.0f / pClip[vert].w;
+        x[vert] = (pClip[vert].x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+        y[vert] = (0.5f - pClip[vert].y * invW * 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+        z[vert] = pClip[vert].z * invW;
+    }
+
+    // Occluders are drawn from both sides, so back facing triangles are turned around rather than dropped
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f)
+    {
+        return;
+    }
+    if (area < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    // Pixels whose centres are inside the triangle's bounds
+    float minX = std::min(std::min(x[0], x[1]), x[2]);
+    float maxX = std::max(std::max(x[0], x[1]), x[2]);
+    float minY = std::min(std::min(y[0], y[1]), y[2]);
+    float maxY = std::max(std::max(y[0], y[1]), y[2]);
+    // Clamped before they're converted, triangles clipped by the near plane can reach far beyond the screen
+    int32 pixelX0 = (int32)ceilf(std::max(minX - 0.5f, 0.0f));
+    int32 pixelX1 = (int32)floorf(std::min(maxX - 0.5f, (float)(OCCLUSION_BUFFER_WIDTH - 1)));
+    int32 pixelY0 = (int32)ceilf(std::max(minY - 0.5f, 0.0f));
+    int32 pixelY1 = (int32)floorf(std::min(maxY - 0.5f, (float)(OCCLUSION_BUFFER_HEIGHT - 1)));
+    if (pixelX0 > pixelX1 || pixelY0 > pixelY1)
+    {
+        return;
+    }
+
+    Triangle triangle;
+    for (uint32 vert = 0; vert < 3; vert++)
+    {
+        triangle.x[vert] = x[vert];
+        triangle.y[vert] = y[vert];
+    }
+    triangle.depthDx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depthDy = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+    triangle.depth0 = z[0] - triangle.depthDx * x[0] - triangle.depthDy * y[0];
+
+    uint32 index = (uint32)bins.triangles.size();
+    bins.triangles.push_back(triangle);
+
+    for (int32 tileY = pixelY0 / OCCLUSION_TILE_HEIGHT; tileY <= pixelY1 / OCCLUSION_TILE_HEIGHT; tileY++)
+    {
+        for (int32 tileX = pixelX0 / OCCLUSION_TILE_WIDTH; tileX <= pixelX1 / OCCLUSION_TILE_WIDTH; tileX++)
+        {
+            bins.tileTriangles[tileY * OCCLUSION_TILES_X + tileX].push_back(index);
+        }
+    }
+}
+
+void OcclusionBuffer::TileDraw(
+    uint32 tile)
+{
+    float* pTileDepth = &m_depth[tile * OCCLUSION_TILE_PIXELS];
+    for (uint32 i = 0; i < OCCLUSION_TILE_PIXELS; i++)
+    {
+        pTileDepth[i] = 1.0f;
+    }
+
+    int32 tileX0 = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+    int32 tileY0 = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (auto itBins = m_workerBins.begin(); itBins != m_workerBins.end(); itBins++)
+    {
+        const std::vector<uint32>& tileTriangles = itBins->tileTriangles[tile];
+        for (uint32 i = 0; i < (uint32)tileTriangles.size(); i++)
+        {
+            const Triangle& triangle = itBins->triangles[tileTriangles[i]];
+
+            // Rows and groups of four pixels in this tile which the triangle's bounds touch
+            float minX = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+            float maxX = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+            float minY = std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]);
+            float maxY = std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]);
+            int32 x0 = (int32)ceilf(std::max(minX - 0.5f, (float)tileX0)) & ~3;
+            int32 x1 = (int32)floorf(std::min(maxX - 0.5f, (float)(tileX0 + OCCLUSION_TILE_WIDTH - 1)));
+            int32 y0 = (int32)ceilf(std::max(minY - 0.5f, (float)tileY0));
+            int32 y1 = (int32)floorf(std::min(maxY - 0.5f, (float)(tileY0 + OCCLUSION_TILE_HEIGHT - 1)));
+
+            // Each edge function is positive on the inside of the edge from vertex n to vertex n + 1, so a pixel is covered when all
+            // three are. They're linear in x and y, as is depth, so stepping a pixel just adds a constant.
+            __m128 edgeDx[3];
+            __m128 edgeDy[3];
+            __m128 edgeRow[3];
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x0), laneOffsets);
+            __m128 py = _mm_set1_ps((float)y0 + 0.5f);
+            for (uint32 edge = 0; edge < 3; edge++)
+            {
+                uint32 next = (edge + 1) % 3;
+                float a = triangle.y[edge] - triangle.y[next];
+                float b = triangle.x[next] - triangle.x[edge];
+                float c = -a * triangle.x[edge] - b * triangle.y[edge];
+                edgeDx[edge] = _mm_set1_ps(a * 4.0f);
+                edgeDy[edge] = _mm_set1_ps(b);
+                edgeRow[edge] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), px), _mm_mul_ps(_mm_set1_ps(b), py)), _mm_set1_ps(c));
+            }
+            __m128 depthDx = _mm_set1_ps(triangle.depthDx * 4.0f);
+            __m128 depthDy = _mm_set1_ps(triangle.depthDy);
+            __m128 depthRow = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthDx), px),
+                _mm_mul_ps(_mm_set1_ps(triangle.depthDy), py)), _mm_set1_ps(triangle.depth0));
+
+            for (int32 y = y0; y <= y1; y++)
+            {
+                __m128 e0 = edgeRow[0];
+                __m128 e1 = edgeRow[1];
+                __m128 e2 = edgeRow[2];
+                __m128 depth = depthRow;
+                float* pRow = pTileDepth + (y - tileY0) * OCCLUSION_TILE_WIDTH - tileX0;
+
+                for (int32 x = x0; x <= x1; x += 4)
+                {
+                    __m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (_mm_movemask_ps(covered))
+                    {
+                        __m128 old = _mm_loadu_ps(pRow + x);
+                        __m128 nearest = _mm_min_ps(old, depth);
+                        _mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, old)));
+                    }
+
+                    e0 = _mm_add_ps(e0, edgeDx[0]);
+                    e1 = _mm_add_ps(e1, edgeDx[1]);
+                    e2 = _mm_add_ps(e2, edgeDx[2]);
+                    depth = _mm_add_ps(depth, depthDx);
+                }
+
+                edgeRow[0] = _mm_add_ps(edgeRow[0], edgeDy[0]);
+                edgeRow[1] = _mm_add_ps(edgeRow[1], edgeDy[1]);
+                edgeRow[2] = _mm_add_ps(edgeRow[2], edgeDy[2]);
+                depthRow = _mm_add_ps(depthRow, depthDy);
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::TileLevelsBuild(
+    uint32 tile)
+{
+    uint32 tileX0 = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+    uint32 tileY0 = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+
+    for (uint32 level = 1; level <= OCCLUSION_TILE_LEVELS; level++)
+    {
+        uint32 width = OCCLUSION_BUFFER_WIDTH >> level;
+        uint32 prevWidth = width * 2;
+
+        for (uint32 y = tileY0 >> level; y < (tileY0 + OCCLUSION_TILE_HEIGHT) >> level; y++)
+        {
+            for (uint32 x = tileX0 >> level; x < (tileX0 + OCCLUSION_TILE_WIDTH) >> level; x++)
+            {
+                float minDepth;
+                float maxDepth;
+                if (level == 1)
+                {
+                    float d00 = DepthGet(2 * x, 2 * y);
+                    float d10 = DepthGet(2 * x + 1, 2 * y);
+                    float d01 = DepthGet(2 * x, 2 * y + 1);
+                    float d11 = DepthGet(2 * x + 1, 2 * y + 1);
+                    minDepth = std::min(std::min(d00, d10), std::min(d01, d11));
+                    maxDepth = std::max(std::max(d00, d10), std::max(d01, d11));
+                }
+                else
+                {
+                    const float* pPrevMin = m_minDepth[level - 1].data();
+                    const float* pPrevMax = m_maxDepth[level - 1].data();
+                    uint32 prev = 2 * y * prevWidth + 2 * x;
+                    minDepth = std::min(std::min(pPrevMin[prev], pPrevMin[prev + 1]),
+                        std::min(pPrevMin[prev + prevWidth], pPrevMin[prev + prevWidth + 1]));
+                    maxDepth = std::max(std::max(pPrevMax[prev], pPrevMax[prev + 1]),
+                        std::max(pPrevMax[prev + prevWidth], pPrevMax[prev + prevWidth + 1]));
+                }
+
+                m_minDepth[level][y * width + x] = minDepth;
+                m_maxDepth[level][y * width + x] = maxDepth;
+            }
+        }
+    }
+}
+
+float OcclusionBuffer::DepthGet(
+    uint32 x,
+    uint32 y) const
+{
+    ASSERT(x < OCCLUSION_BUFFER_WIDTH && y < OCCLUSION_BUFFER_HEIGHT);
+    return m_depth[sTileIndex(x, y) * OCCLUSION_TILE_PIXELS + (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH];
+}
+
+bool OcclusionBuffer::IsVisible(
+    const CullingBounds& bounds,
+    uint32 index) const
+{
+    // The box's corners, four at a time with the first four on its near z face
+    const __m128 signX = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    const __m128 signY = _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+    __m128 cornerX = _mm_add_ps(_mm_set1_ps(bounds.boxCentreX[index]), _mm_mul_ps(signX, _mm_set1_ps(bounds.boxExtentX[index])));
+    __m128 cornerY = _mm_add_ps(_mm_set1_ps(bounds.boxCentreY[index]), _mm_mul_ps(signY, _mm_set1_ps(bounds.boxExtentY[index])));
+    __m128 cornerZ[2] = {
+        _mm_set1_ps(bounds.boxCentreZ[index] - bounds.boxExtentZ[index]),
+        _mm_set1_ps(bounds.boxCentreZ[index] + bounds.boxExtentZ[index]) };
+
+    const Matrix4x4& m = m_matViewProj;
+    __m128 minX = _mm_set1_ps(FLT_MAX);
+    __m128 maxX = _mm_set1_ps(-FLT_MAX);
+    __m128 minY = _mm_set1_ps(FLT_MAX);
+    __m128 maxY = _mm_set1_ps(-FLT_MAX);
+    __m128 minZ = _mm_set1_ps(FLT_MAX);
+    for (uint32 face = 0; face < 2; face++)
+    {
+        __m128 clipX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._11), cornerX), _mm_mul_ps(_mm_set1_ps(m._12), cornerY)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._13), cornerZ[face]), _mm_set1_ps(m._14)));
+        __m128 clipY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._21), cornerX), _mm_mul_ps(_mm_set1_ps(m._22), cornerY)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._23), cornerZ[face]), _mm_set1_ps(m._24)));
+        __m128 clipZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._31), cornerX), _mm_mul_ps(_mm_set1_ps(m._32), cornerY)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._33), cornerZ[face]), _mm_set1_ps(m._34)));
+        __m128 clipW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._41), cornerX), _mm_mul_ps(_mm_set1_ps(m._42), cornerY)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m._43), cornerZ[face]), _mm_set1_ps(m._44)));
+
+        // Anything reaching behind the near plane can't be projected, and is too close to be worth hiding anyway
+        if (_mm_movemask_ps(_mm_cmplt_ps(clipZ, _mm_setzero_ps())))
+        {
+            return true;
+        }
+
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), clipW);
+        minX = _mm_min_ps(minX, _mm_mul_ps(clipX, invW));
+        maxX = _mm_max_ps(maxX, _mm_mul_ps(clipX, invW));
+        minY = _mm_min_ps(minY, _mm_mul_ps(clipY, invW));
+        maxY = _mm_max_ps(maxY, _mm_mul_ps(clipY, invW));
+        minZ = _mm_min_ps(minZ, _mm_mul_ps(clipZ, invW));
+    }
+
+    float ndcMinX = sHorizontalMin(minX);
+    float ndcMaxX = sHorizontalMax(maxX);
+    float ndcMinY = sHorizontalMin(minY);
+    float ndcMaxY = sHorizontalMax(maxY);
+    float depth = sHorizontalMin(minZ);
+
+    // Nothing outside the screen can be seen anyway, so the rectangle is clamped to it before it's turned into the pixels it touches.
+    // Screen y goes down while clip space y goes up.
+    if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+    {
+        return true;
+    }
+    ndcMinX = std::max(ndcMinX, -1.0f);
+    ndcMaxX = std::min(ndcMaxX, 1.0f);
+    ndcMinY = std::max(ndcMinY, -1.0f);
+    ndcMaxY = std::min(ndcMaxY, 1.0f);
+    int32 pixelX0 = (int32)floorf((ndcMinX * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH);
+    int32 pixelX1 = std::min((int32)floorf((ndcMaxX * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH), OCCLUSION_BUFFER_WIDTH - 1);
+    int32 pixelY0 = (int32)floorf((0.5f - ndcMaxY * 0.5f) * OCCLUSION_BUFFER_HEIGHT);
+    int32 pixelY1 = std::min((int32)floorf((0.5f - ndcMinY * 0.5f) * OCCLUSION_BUFFER_HEIGHT), OCCLUSION_BUFFER_HEIGHT - 1);
+
+    // Start from the finest level the rectangle covers no more than 2x2 texels of
+    uint32 level = 0;
+    while (level + 1 < OCCLUSION_NUM_LEVELS &&
+        ((pixelX1 >> level) - (pixelX0 >> level) > 1 || (pixelY1 >> level) - (pixelY0 >> level) > 1))
+    {
+        level++;
+    }
+
+    return RectIsVisible(level, pixelX0 >> level, pixelY0 >> level, pixelX1 >> level, pixelY1 >> level,
+        pixelX0, pixelY0, pixelX1, pixelY1, depth);
+}
+
+bool OcclusionBuffer::RectIsVisible(
+    uint32 level,
+    int32 x0,
+    int32 y0,
+    int32 x1,
+    int32 y1,
+    int32 pixelX0,
+    int32 pixelY0,
+    int32 pixelX1,
+    int32 pixelY1,
+    float depth) const
+{
+    uint32 width = OCCLUSION_BUFFER_WIDTH >> level;
+    for (int32 y = y0; y <= y1; y++)
+    {
+        for (int32 x = x0; x <= x1; x++)
+        {
+            float minDepth;
+            float maxDepth;
+            if (level == 0)
+            {
+                minDepth = maxDepth = DepthGet(x, y);
+            }
+            else
+            {
+                minDepth = m_minDepth[level][y * width + x];
+                maxDepth = m_maxDepth[level][y * width + x];
+            }
+
+            // Behind everything drawn here, or in front of it all
+            if (depth > maxDepth)
+            {
+                continue;
+            }
+            if (depth <= minDepth)
+            {
+                return true;
+            }
+
+            // Somewhere in between, so look at the texels under this one which the rectangle covers
+            uint32 child = level - 1;
+            if (RectIsVisible(child,
+                std::max(2 * x, pixelX0 >> child), std::max(2 * y, pixelY0 >> child),
+                std::min(2 * x + 1, pixelX1 >> child), std::min(2 * y + 1, pixelY1 >> child),
+                pixelX0, pixelY0, pixelX1, pixelY1, depth))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+uint32 OcclusionBuffer::Cull(
+    const CullingBounds& bounds,
+    const uint32* pCandidates,
+    uint32 numCandidates,
+    uint32* pVisibleOut,
+    JobSystem& jobSystem)
+{
+    m_visibleFlags.resize(numCandidates);
+    jobSystem.ParallelFor(0, numCandidates, OCCLUSION_TESTS_PER_JOB, [&](uint32 first, uint32 end)
+    {
+        for (uint32 i = first; i < end; i++)
+        {
+            m_visibleFlags[i] = IsVisible(bounds, pCandidates[i]) ? 1 : 0;
+        }
+    });
+
+    uint32 numVisible = 0;
+    for (uint32 i = 0; i < numCandidates; i++)
+    {
+        pVisibleOut[numVisible] = pCandidates[i];
+        numVisible += m_visibleFlags[i];
+    }
+    return numVisible;
+}
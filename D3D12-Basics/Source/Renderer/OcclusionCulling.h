@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Renderer/FrustumCulling.h"
+
+#include <vector>
+
+class JobSystem;
+
+// Size of the depth buffer occluders are drawn into, both have to be powers of two and multiples of the tile size
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+// Each tile is drawn by one job, and is stored contiguously so that job's writes stay together
+#define OCCLUSION_TILE_WIDTH 32
+#define OCCLUSION_TILE_HEIGHT 16
+// Levels of the depth hierarchy built inside each tile, the rest are built from the tiles' last level once they're all done
+#define OCCLUSION_TILE_LEVELS 4
+// Levels down to a single texel of the shorter side
+#define OCCLUSION_NUM_LEVELS 8
+
+// Meshes with more triangles than this aren't kept as occluders, they'd cost more to draw than they're likely to save
+#define OCCLUSION_MAX_OCCLUDER_TRIANGLES 4096
+// Occluders drawn each frame, the ones which look biggest from the camera are picked first
+#define OCCLUSION_MAX_OCCLUDERS 32
+// Bounding sphere radius over view depth an occluder needs before it's worth drawing
+#define OCCLUSION_MIN_OCCLUDER_SIZE 0.1f
+
+static_assert((OCCLUSION_BUFFER_WIDTH % OCCLUSION_TILE_WIDTH) == 0 && (OCCLUSION_BUFFER_HEIGHT % OCCLUSION_TILE_HEIGHT) == 0,
+    "Occlusion buffer has to be made of whole tiles");
+static_assert((OCCLUSION_TILE_HEIGHT >> OCCLUSION_TILE_LEVELS) >= 1 && (OCCLUSION_TILE_WIDTH >> OCCLUSION_TILE_LEVELS) >= 1,
+    "Occlusion tiles are too small for their levels");
+static_assert((OCCLUSION_BUFFER_HEIGHT >> (OCCLUSION_NUM_LEVELS - 1)) == 1, "Occlusion levels have to end at one texel high");
+
+// Object space triangles of a mesh, kept on the CPU so it can be drawn as an occluder
+struct OccluderMesh
+{
+    std::vector<Vector3> positions;
+    std::vector<uint32> indices;
+};
+
+// Low resolution depth buffer drawn on the CPU from a few big occluders, which bounds are then tested against to find whatever's
+// hidden behind them.
+//
+// Occluders are transformed and clipped in parallel, and their triangles binned by the tiles they touch. Then every tile is drawn by
+// its own job with SSE, four pixels at a time, and the job builds the tile's part of a hierarchy of each 2x2 texel's nearest and
+// furthest depth. Bounds are tested against the coarsest level their screen rectangle fits in, and only texels which neither
+// definitely hide nor definitely show them are looked at more closely.
+//
+// Depth is z / w, from 0 at the near plane to 1 at the far plane.
+class OcclusionBuffer
+{
+public:
+    OcclusionBuffer();
+
+    // Clears the buffer and draws each occluder with ppOccluders[i] placed by pMatWorlds[i]. matViewProj is a column vector view
+    // projection matrix, see Camera::GetViewProjMatrix.
+    void OccludersDraw(
+        const Matrix4x4& matViewProj,
+        const OccluderMesh* const* ppOccluders,
+        const Matrix4x4* pMatWorlds,
+        uint32 numOccluders,
+        JobSystem& jobSystem);
+
+    // False if the object's box is entirely behind what's been drawn. Boxes crossing the near plane are always visible, as are ones
+    // entirely off screen, which frustum culling should have dropped already.
+    bool IsVisible(
+        const CullingBounds& bounds,
+        uint32 index) const;
+
+    // Writes the objects in pCandidates which IsVisible keeps to pVisibleOut, in the same order, and returns how many there are.
+    // pVisibleOut can be pCandidates.
+    uint32 Cull(
+        const CullingBounds& bounds,
+        const uint32* pCandidates,
+        uint32 numCandidates,
+        uint32* pVisibleOut,
+        JobSystem& jobSystem);
+
+    // Depth of a pixel, for debugging
+    float DepthGet(
+        uint32 x,
+        uint32 y) const;
+
+    uint32 GetNumTrianglesDrawn() const
+    {
+        return m_numTrianglesDrawn;
+    }
+
+private:
+    // Screen space triangle, with depth given as a plane so it only has to be worked out once
+    struct Triangle
+    {
+        float x[3];
+        float y[3];
+        float depthDx;
+        float depthDy;
+        float depth0;
+    };
+
+    // Triangles set up by one worker, and which of them touch each tile
+    struct WorkerBins
+    {
+        // Scratch space for the occluder being set up
+        std::vector<Vector4> clipPositions;
+
+        std::vector<Triangle> triangles;
+        std::vector<uint32> tileTriangles[(OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_WIDTH) * (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_HEIGHT)];
+    };
+
+    void OccluderSetup(
+        const OccluderMesh& occluder,
+        const Matrix4x4& matWorldViewProj,
+        WorkerBins& bins);
+
+    void TriangleBin(
+        const Vector4* pClip,
+        WorkerBins& bins);
+
+    void TileDraw(
+        uint32 tile);
+
+    void TileLevelsBuild(
+        uint32 tile);
+
+    bool RectIsVisible(
+        uint32 level,
+        int32 x0,
+        int32 y0,
+        int32 x1,
+        int32 y1,
+        int32 pixelX0,
+        int32 pixelY0,
+        int32 pixelX1,
+        int32 pixelY1,
+        float depth) const;
+
+    Matrix4x4 m_matViewProj;
+
+    // Level 0, tile by tile
+    std::vector<float> m_depth;
+
+    // Levels 1 and up, row by row. Level 0's are both m_depth.
+    std::vector<float> m_minDepth[OCCLUSION_NUM_LEVELS];
+    std::vector<float> m_maxDepth[OCCLUSION_NUM_LEVELS];
+
+    std::vector<WorkerBins> m_workerBins;
+    std::vector<uint32> m_visibleFlags;
+    uint32 m_numTrianglesDrawn;
+};
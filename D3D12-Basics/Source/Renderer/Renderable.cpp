@@ -1,13 +1,68 @@
 #include "Renderable.h"
 
 #include "Engine.h"
+#include "Renderer/OcclusionCulling.h"
 #include "Renderer/Core/D3D12Core.h"
 
+#include <algorithm>
+#include <cfloat>
+
+Renderable::Renderable(const Renderable& source, const Matrix4x4& _matWorld) :
+    vbid(source.vbid),
+    ibid(source.ibid),
+    pMaterial(source.pMaterial),
+    matWorld(_matWorld * source.matWorld),
+    pOccluder(source.pOccluder),
+    fOwnsGeometry(false)
+{
+    numLods = source.numLods;
+    for (uint32 lod = 0; lod < numLods; lod++)
+    {
+        lods[lod] = source.lods[lod];
+    }
+
+    // World matrices transform column vectors like the shaders do, but Transform multiplies a row vector by the matrix
+    Matrix4x4 matTransform;
+    _matWorld.Transpose(matTransform);
+
+    // Bounds of the transformed corners, so it still contains the mesh though it may be looser than the original
+    boundsMin = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+    boundsMax = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32 corner = 0; corner < 8; corner++)
+    {
+        Vector3 pos(
+            (corner & 1) ? source.boundsMax.x : source.boundsMin.x,
+            (corner & 2) ? source.boundsMax.y : source.boundsMin.y,
+            (corner & 4) ? source.boundsMax.z : source.boundsMin.z);
+        pos = Vector3::Transform(pos, matTransform);
+        boundsMin = Vector3::Min(boundsMin, pos);
+        boundsMax = Vector3::Max(boundsMax, pos);
+    }
+
+    // Scaled by the longest basis vector, which is exact as long as there's no shear
+    float maxScaleSq = 0.0f;
+    for (uint32 axis = 0; axis < 3; axis++)
+    {
+        Vector3 basis(_matWorld.m[0][axis], _matWorld.m[1][axis], _matWorld.m[2][axis]);
+        maxScaleSq = std::max(maxScaleSq, basis.LengthSquared());
+    }
+    sphereCentre = Vector3::Transform(source.sphereCentre, matTransform);
+    sphereRadius = source.sphereRadius * sqrtf(maxScaleSq);
+}
+
 Renderable::~Renderable()
 {
     ASSERT(vbid != VertexBufferIDInvalid);
     ASSERT(ibid != IndexBufferIDInvalid);
 
-    g_pRenderer->VertexBufferDestroy(vbid);
-    g_pRenderer->IndexBufferDestroy(ibid);
+    if (fOwnsGeometry)
+    {
+        g_pRenderer->VertexBufferDestroy(vbid);
+        g_pRenderer->IndexBufferDestroy(ibid);
+        for (uint32 lod = 1; lod < numLods; lod++)
+        {
+            g_pRenderer->IndexBufferDestroy(lods[lod].ibid);
+        }
+        delete pOccluder;
+    }
 }
\ No newline at end of file
@@ -4,22 +4,70 @@
 
 enum VertexBufferID;
 enum IndexBufferID;
+struct OccluderMesh;
 struct Vertex;
 
+// Levels of detail a renderable can have, including the full mesh
+#define RENDERABLE_MAX_LODS 4
+
+// The mesh with some of its triangles collapsed away, drawn from the same vertex buffer with its own index buffer
+struct RenderableLod
+{
+    IndexBufferID ibid;
+    uint32 numIndices;
+
+    // How far the simplified surface can be from the full mesh, relative to the bounding sphere's radius
+    float error;
+};
+
 // For now, a renderable is just a mesh. Later it will have material information and whatever else information is required to draw it
 class Renderable
 {
 public:
-    Renderable(VertexBufferID _vbid, IndexBufferID _ibid, const Material& _material) :
+    Renderable(VertexBufferID _vbid, IndexBufferID _ibid, uint32 _numIndices, const Material* _pMaterial, const Vector3& _boundsMin,
+        const Vector3& _boundsMax, const Vector3& _sphereCentre, float _sphereRadius) :
         vbid(_vbid),
         ibid(_ibid),
-        material(_material){};
+        pMaterial(_pMaterial),
+        boundsMin(_boundsMin),
+        boundsMax(_boundsMax),
+        sphereCentre(_sphereCentre),
+        sphereRadius(_sphereRadius)
+    {
+        lods[0].ibid = _ibid;
+        lods[0].numIndices = _numIndices;
+        lods[0].error = 0.0f;
+    };
+
+    // Another instance of source's mesh and material, placed by matWorld relative to it. Shares source's buffers, LODs and occluder,
+    // so source has to outlive it.
+    Renderable(const Renderable& source, const Matrix4x4& _matWorld);
 
     ~Renderable();
 
     VertexBufferID vbid;
     IndexBufferID ibid;
 
-    Material material;
+    // Owned by the scene, which shares one between every renderable using it
+    const Material* pMaterial;
+
+    Matrix4x4 matWorld;
+
+    // World space AABB of the mesh
+    Vector3 boundsMin;
+    Vector3 boundsMax;
+
+    // World space bounding sphere of the mesh, tighter than the AABB's for meshes which aren't box shaped
+    Vector3 sphereCentre;
+    float sphereRadius;
+
+    // The mesh's triangles on the CPU, or null if it's too detailed to be worth drawing into the occlusion buffer
+    const OccluderMesh* pOccluder = nullptr;
+
+    // lods[0] is the full mesh in ibid, and each one after has fewer triangles and more error than the one before
+    RenderableLod lods[RENDERABLE_MAX_LODS];
+    uint32 numLods = 1;
 private:
+    // Instances leave destroying the buffers to the renderable they came from
+    bool fOwnsGeometry = true;
 };
\ No newline at end of file
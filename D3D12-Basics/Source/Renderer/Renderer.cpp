@@ -1,37 +1,202 @@
 #include "Renderer.h"
 
 #include "Camera.h"
+#include "Engine.h"
 #include "Scene.h"
 
+#include "Generic/JobSystem.h"
+
 #include "Renderer/ConstantBuffers.h"
+#include "Renderer/BVH.h"
+#include "Renderer/DrawList.h"
+#include "Renderer/FrustumCulling.h"
+#include "Renderer/OcclusionCulling.h"
 #include "Renderer/Renderable.h"
 #include "Renderer/Texture.h"
 #include "Renderer/Core/D3D12Core.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Draws of the same vertex buffer, index buffer and material are issued as one instanced draw
+#define USE_INSTANCED_BATCHING 1
+
+// Culls by walking the scene's BVH rather than testing every renderable
+#define USE_BVH_CULLING 1
+
+// Draws the biggest simple meshes into a depth buffer on the CPU and drops whatever they hide
+#define USE_OCCLUSION_CULLING 1
+
+// Draws each renderable with its coarsest LOD whose error is too small to see, rather than always with the full mesh
+#define USE_LOD_SELECTION 1
+// Error a LOD can have on screen, as a fraction of the screen's height. About a pixel at 1080p.
+#define LOD_MAX_SCREEN_ERROR 0.001f
+
+// Fewer draws than this aren't worth handing to another worker
+#define MIN_BATCHES_PER_RECORDING_CONTEXT 256
+
+typedef std::chrono::high_resolution_clock HighResClock;
+
 size_t g_cbSizes[CBIDCount] = {
    sizeof(CBCommon),
    sizeof(CBStatic),
 };
 
+// Instances drawObjects[firstObject] to drawObjects[firstObject + instanceCount - 1] in one draw
+struct DrawBatch
+{
+    uint32 firstObject;
+    uint32 instanceCount;
+};
+
+// Everything a frame reads which the simulation might change, copied when the frame is handed over so the simulation can carry on
+// with the next frame while the render thread works on this one. Only the camera and transforms are copied, the scene, its
+// renderables and their materials are read as they are while the frame renders, so changing any of those needs PipelineFlush first.
+struct RenderPacket
+{
+    Matrix4x4 matView;
+    Matrix4x4 matProj;
+    const Scene* pScene;
+
+    // Indexed like the scene's renderables
+    std::vector<Matrix4x4> matWorlds;
+
+    // Copies of the scene's, only made again when the scene's bounds version moves on from boundsVersion
+    CullingBounds bounds;
+    BVH bvh;
+    uint64 boundsVersion = 0;
+};
+
 struct RenderContext
 {    
+    // Set by the simulation, only read when a packet is filled
     const Camera* pCamera;
     const Scene* pScene;
 
+    // Frames between the simulation and the render thread. Packet n is packets[n % packets.size()], and there's one more packet
+    // than the pipeline depth so the simulation always has one to fill. Only the counters and fRenderThreadQuit need packetMutex.
+    uint32 pipelineDepth;
+    std::vector<RenderPacket> packets;
+    uint64 numPacketsSubmitted;
+    uint64 numPacketsCompleted;
+    bool fRenderThreadQuit;
+    std::mutex packetMutex;
+    std::condition_variable packetCondition;
+    std::thread renderThread;
+
+    // Stats of the last frame rendered, copied when it's finished so they can be read from any thread. Need packetMutex.
+    BindingStats completedBindingStats;
+    DrawListStats completedDrawListStats;
+    FrameStats completedFrameStats;
+    DescriptorPoolStats completedDescriptorPoolStats;
+
+    // The packet being rendered, everything from here down is only touched by whichever thread renders
+    const RenderPacket* pPacket;
+
     ConstantData* pConstantData[CBIDCount];
     uint32 dirtyCBFlags;
+
+    DrawList drawList;
+    DrawListStats drawListStats;
+
+    // Renderables at least partly inside the frustum, and not hidden by an occluder
+    std::vector<uint32> visibleObjects;
+
+    OcclusionBuffer occlusionBuffer;
+    // Visible renderables with occluders, and how big they look
+    std::vector<std::pair<float, uint32>> occluderCandidates;
+    std::vector<const OccluderMesh*> pOccluders;
+    std::vector<Matrix4x4> occluderWorlds;
+
+    // Index buffer of the LOD each visible renderable is drawn with, indexed like the scene's renderables
+    std::vector<IndexBufferID> drawIbids;
+
+    // Renderable indices in the order their ObjectConstants are written, so every batch's instances are consecutive
+    std::vector<uint32> drawObjects;
+    std::vector<DrawBatch> drawBatches;
+
+    uint32 maxRecordingContexts;
 };
 
+// Distance from the camera to the centre of the bounding sphere. matView has been transposed for the shader, so the view space
+// position comes from its columns.
+static float sViewDistance(
+    const CullingBounds& bounds,
+    uint32 index,
+    const Matrix4x4& matView)
+{
+    float viewX = bounds.sphereCentreX[index] * matView._11 + bounds.sphereCentreY[index] * matView._21 + bounds.sphereCentreZ[index] * matView._31 + matView._41;
+    float viewY = bounds.sphereCentreX[index] * matView._12 + bounds.sphereCentreY[index] * matView._22 + bounds.sphereCentreZ[index] * matView._32 + matView._42;
+    float viewZ = bounds.sphereCentreX[index] * matView._13 + bounds.sphereCentreY[index] * matView._23 + bounds.sphereCentreZ[index] * matView._33 + matView._43;
+    return sqrtf(viewX * viewX + viewY * viewY + viewZ * viewZ);
+}
+
+// The coarsest of the renderable's LODs whose error, seen from the nearest point of its bounding sphere, covers no more than
+// LOD_MAX_SCREEN_ERROR of the screen's height
+static uint32 sLodSelect(
+    const Renderable& renderable,
+    const CullingBounds& bounds,
+    uint32 index,
+    const Matrix4x4& matView,
+    const Matrix4x4& matProj)
+{
+#if USE_LOD_SELECTION
+    float distance = sViewDistance(bounds, index, matView) - bounds.sphereRadius[index];
+    if (distance <= 0.0f)
+    {
+        return 0;
+    }
+
+    // Something size high at distance covers size * _22 / distance of the -1 to 1 clip space height, so half that of the screen
+    float screenScale = bounds.sphereRadius[index] * matProj._22 * 0.5f / distance;
+    for (uint32 lod = renderable.numLods - 1; lod > 0; lod--)
+    {
+        if (renderable.lods[lod].error * screenScale <= LOD_MAX_SCREEN_ERROR)
+        {
+            return lod;
+        }
+    }
+#endif
+    return 0;
+}
+
 Renderer::Renderer()
 {
     m_core = new D3D12Core();
     m_context = new RenderContext();
 
+    m_context->maxRecordingContexts = std::min(g_pJobSystem->GetNumWorkers(), (uint32)NUM_RECORDING_CONTEXTS);
+
     ConstantDataInitialise();
+
+    m_context->pipelineDepth = globals.renderPipelineDepth;
+    m_context->packets.resize(m_context->pipelineDepth + 1);
+    m_context->numPacketsSubmitted = 0;
+    m_context->numPacketsCompleted = 0;
+    m_context->fRenderThreadQuit = false;
+    if (m_context->pipelineDepth > 0)
+    {
+        m_context->renderThread = std::thread(&Renderer::RenderThreadMain, this);
+    }
 }
 
 Renderer::~Renderer()
 {
+    if (m_context->renderThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_context->packetMutex);
+            m_context->fRenderThreadQuit = true;
+        }
+        m_context->packetCondition.notify_all();
+        m_context->renderThread.join();
+    }
+
     ConstantDataDispose();
 
     delete m_context;
@@ -60,8 +225,13 @@ void Renderer::ConstantDataSetEntry(
     const ConstantDataEntry& entry,
     const void* data)
 {
-    Utils::SetBit32(entry.id, m_context->dirtyCBFlags);
-    memcpy(m_context->pConstantData[entry.id] + entry.offset, data, entry.size);
+    // Only dirty the buffer if the data actually changes, otherwise we'd allocate and bind a new copy of identical data for every draw
+    INT8* pDest = (INT8*)m_context->pConstantData[entry.id] + entry.offset;
+    if (memcmp(pDest, data, entry.size) != 0)
+    {
+        memcpy(pDest, data, entry.size);
+        Utils::SetBit32(entry.id, m_context->dirtyCBFlags);
+    }
 }
 
 void Renderer::ConstantDataFlush(
@@ -118,6 +288,12 @@ void Renderer::IndexBufferDestroy(IndexBufferID ibid)
     m_core->IndexBufferDestroy(ibid);
 }
 
+uint32 Renderer::GeometryDefragment(
+    float maxOccupancy)
+{
+    return m_core->GeometryDefragment(maxOccupancy);
+}
+
 TextureID Renderer::TextureCreate(
     int32 width,
     int32 height,
@@ -133,6 +309,71 @@ void Renderer::TextureDestroy(
     m_core->TextureDestroy(tid);
 }
 
+MaterialID Renderer::MaterialCreate(
+    const MaterialConstants& constants)
+{
+    return m_core->MaterialCreate(constants);
+}
+
+void Renderer::MaterialUpdate(
+    MaterialID id,
+    const MaterialConstants& constants)
+{
+    m_core->MaterialUpdate(id, constants);
+}
+
+void Renderer::MaterialDestroy(
+    MaterialID id)
+{
+    m_core->MaterialDestroy(id);
+}
+
+void Renderer::BindingStatsGet(
+    BindingStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_context->packetMutex);
+    statsOut = m_context->completedBindingStats;
+}
+
+void Renderer::DrawListStatsGet(
+    DrawListStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_context->packetMutex);
+    statsOut = m_context->completedDrawListStats;
+}
+
+void Renderer::FrameStatsGet(
+    FrameStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_context->packetMutex);
+    statsOut = m_context->completedFrameStats;
+}
+
+void Renderer::DescriptorPoolStatsGet(
+    DescriptorPoolStats& statsOut)
+{
+    std::lock_guard<std::mutex> lock(m_context->packetMutex);
+    statsOut = m_context->completedDescriptorPoolStats;
+}
+
+void Renderer::GPUMemoryStatsGet(
+    GPUMemoryStats& statsOut)
+{
+    m_core->GPUMemoryStatsGet(statsOut);
+}
+
+void Renderer::UploadStatsGet(
+    UploadStreamStats& statsOut)
+{
+    m_core->UploadStreamStatsGet(statsOut);
+}
+
+void Renderer::UploadRetentionPolicySet(
+    const UploadStreamRetentionPolicy& policy)
+{
+    m_core->UploadStreamRetentionPolicySet(policy);
+}
+
 void Renderer::Render()
 {
     if (!m_context->pCamera)
@@ -140,71 +381,445 @@ void Renderer::Render()
         return;
     }
 
+    // The packet to fill was handed over packets.size() frames ago, so this is where the simulation waits if it gets too far ahead
+    uint32 numPackets = (uint32)m_context->packets.size();
+    RenderPacket* pPacket;
+    {
+        std::unique_lock<std::mutex> lock(m_context->packetMutex);
+        m_context->packetCondition.wait(lock, [&]()
+        {
+            return m_context->numPacketsSubmitted - m_context->numPacketsCompleted < numPackets;
+        });
+        pPacket = &m_context->packets[m_context->numPacketsSubmitted % numPackets];
+    }
+
+    RenderPacketFill(*pPacket);
+
+    if (m_context->pipelineDepth == 0)
+    {
+        RenderPacketExecute(*pPacket);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_context->packetMutex);
+        m_context->numPacketsSubmitted++;
+    }
+    m_context->packetCondition.notify_all();
+}
+
+void Renderer::PipelineFlush(
+    void)
+{
+    std::unique_lock<std::mutex> lock(m_context->packetMutex);
+    m_context->packetCondition.wait(lock, [&]()
+    {
+        return m_context->numPacketsCompleted == m_context->numPacketsSubmitted;
+    });
+}
+
+void Renderer::RenderThreadMain(
+    void)
+{
+    // Recording is spread over the job system, which only takes jobs from its own workers
+    g_pJobSystem->AttachThread();
+
+    uint32 numPackets = (uint32)m_context->packets.size();
+    while (true)
+    {
+        const RenderPacket* pPacket;
+        {
+            // Everything already handed over is still rendered when quitting
+            std::unique_lock<std::mutex> lock(m_context->packetMutex);
+            m_context->packetCondition.wait(lock, [&]()
+            {
+                return m_context->numPacketsCompleted < m_context->numPacketsSubmitted || m_context->fRenderThreadQuit;
+            });
+
+            if (m_context->numPacketsCompleted == m_context->numPacketsSubmitted)
+            {
+                return;
+            }
+            pPacket = &m_context->packets[m_context->numPacketsCompleted % numPackets];
+        }
+
+        RenderPacketExecute(*pPacket);
+
+        {
+            std::lock_guard<std::mutex> lock(m_context->packetMutex);
+            m_context->numPacketsCompleted++;
+        }
+        m_context->packetCondition.notify_all();
+    }
+}
+
+void Renderer::RenderPacketFill(
+    RenderPacket& packet)
+{
+    m_context->pCamera->GetViewMatrix(packet.matView);
+    m_context->pCamera->GetProjMatrix(packet.matProj);
+
+    packet.pScene = m_context->pScene;
+    packet.matWorlds.clear();
+    if (!packet.pScene)
+    {
+        return;
+    }
+
+    const std::vector<Renderable*>& pRenderables = packet.pScene->m_pRenderables;
+    packet.matWorlds.resize(pRenderables.size());
+    for (uint32 i = 0; i < (uint32)pRenderables.size(); i++)
+    {
+        packet.matWorlds[i] = pRenderables[i]->matWorld;
+    }
+
+    // Already laid out for culling, so it's copied a whole array at a time, and only when it's changed since this packet was last used
+    if (packet.boundsVersion != packet.pScene->m_boundsVersion)
+    {
+        packet.bounds = packet.pScene->m_bounds;
+        packet.bvh = packet.pScene->m_bvh;
+        packet.boundsVersion = packet.pScene->m_boundsVersion;
+    }
+}
+
+void Renderer::RenderPacketExecute(
+    const RenderPacket& packet)
+{
+    m_context->pPacket = &packet;
+
     Matrix4x4 matView;
-    m_context->pCamera->GetViewMatrix(matView);
-    matView.Transpose(matView);
+    packet.matView.Transpose(matView);
     ConstantDataSetEntry(CBSTATIC_ENTRY(matView), &matView);
 
     Matrix4x4 matProj;
-    m_context->pCamera->GetProjMatrix(matProj);
-    matProj.Transpose(matProj);
+    packet.matProj.Transpose(matProj);
     ConstantDataSetEntry(CBSTATIC_ENTRY(matProj), &matProj);
 
     Vector3 directionalLight(1, 1, -1);
     directionalLight.Normalize();
-    ConstantDataSetEntry(CBSTATIC_ENTRY(directionalLight), &directionalLight);
+    ConstantDataSetEntry(CBCOMMON_ENTRY(directionalLight), &directionalLight);
+
+    // Dynamic constant buffer allocations are only good for the frame they were made in, so have to be made again every frame
+    for (int32 id = CBIDStart; id < CBIDDynamicCount; id++)
+    {
+        Utils::SetBit32(id, m_context->dirtyCBFlags);
+    }
     ConstantDataFlush();
 
+    std::vector<uint32>& drawObjects = m_context->drawObjects;
+    std::vector<DrawBatch>& drawBatches = m_context->drawBatches;
+    drawObjects.clear();
+    drawBatches.clear();
+    if (packet.pScene)
+    {
+        DrawListBuild(matView);
+        DrawBatchesBuild();
+
+        // Everything that changes per instance is written here in draw order, in one allocation, rather than flushed draw by draw
+        ObjectConstants* pObjectConstants = m_core->ObjectConstantsAllocate((uint32)drawObjects.size());
+        for (uint32 i = 0; i < (uint32)drawObjects.size(); i++)
+        {
+            packet.matWorlds[drawObjects[i]].Transpose(pObjectConstants[i].matWorld);
+            pObjectConstants[i].materialIndex = (uint32)packet.pScene->m_pRenderables[drawObjects[i]]->pMaterial->id;
+        }
+    }
+
     m_core->Begin();
 
-    if (m_context->pScene)
+    // Contiguous chunks, one per context, so submitting the contexts in order keeps the sorted draw order
+    uint32 numBatches = (uint32)drawBatches.size();
+    uint32 numContexts = (numBatches + MIN_BATCHES_PER_RECORDING_CONTEXT - 1) / MIN_BATCHES_PER_RECORDING_CONTEXT;
+    numContexts = std::max(1u, std::min(numContexts, m_context->maxRecordingContexts));
+
+    g_pJobSystem->ParallelFor(0, numContexts, 1, [&](uint32 firstContext, uint32 endContext)
     {
-        for (int32 i = 0; i < m_context->pScene->m_pRenderables.size(); i++)
+        for (uint32 context = firstContext; context < endContext; context++)
         {
-            const Renderable* pRenderable = m_context->pScene->m_pRenderables[i];
+            uint32 firstBatch = (uint32)((uint64)numBatches * context / numContexts);
+            uint32 endBatch = (uint32)((uint64)numBatches * (context + 1) / numContexts);
+            DrawBatchesRecord(context, firstBatch, endBatch);
+        }
+    });
 
-            float specular = 0.5f;
-            ConstantDataSetEntry(CBCOMMON_ENTRY(specular), &specular);
+    m_core->End(numContexts);
 
-            float specularHardness = 10.0f;
-            ConstantDataSetEntry(CBCOMMON_ENTRY(specularHardness), &specularHardness);
+    m_core->Present();
 
-            const Material& material = pRenderable->material;
+    m_context->pPacket = nullptr;
 
-            ConstantDataSetEntry(CBCOMMON_ENTRY(diffuse), &material.diffuse);
-            
-            ConstantDataFlush();
+    {
+        std::lock_guard<std::mutex> lock(m_context->packetMutex);
+        m_context->completedDrawListStats = m_context->drawListStats;
+        m_core->BindingStatsGet(m_context->completedBindingStats);
+        m_core->FrameStatsGet(m_context->completedFrameStats);
+        m_core->DescriptorPoolStatsGet(m_context->completedDescriptorPoolStats);
+    }
+}
 
-            if (material.diffuseTexture)
-            {
-                m_core->TextureBindForDraw(material.diffuseTexture->GetID(), 0);
-            }
+void Renderer::DrawBatchesRecord(
+    uint32 context,
+    uint32 firstBatch,
+    uint32 endBatch)
+{
+    m_core->RecordingContextBegin(context);
 
-            m_core->Draw(pRenderable->vbid, pRenderable->ibid);
-        }
+    for (uint32 i = firstBatch; i < endBatch; i++)
+    {
+        const DrawBatch& batch = m_context->drawBatches[i];
+
+        // Every instance shares the first one's mesh and material
+        const Renderable* pRenderable = m_context->pPacket->pScene->m_pRenderables[m_context->drawObjects[batch.firstObject]];
+        const Material* pMaterial = pRenderable->pMaterial;
+
+        // Always bound, the context would otherwise keep whatever the batch before it used
+        m_core->TextureBindForDraw(context, pMaterial->diffuseTexture ? pMaterial->diffuseTexture->GetID() : TextureIDInvalid, 0);
+
+        IndexBufferID ibid = m_context->drawIbids[m_context->drawObjects[batch.firstObject]];
+        m_core->Draw(context, pRenderable->vbid, ibid, batch.firstObject, batch.instanceCount);
     }
 
-    m_core->End();
+    m_core->RecordingContextEnd(context);
+}
+
+void Renderer::DrawListBuild(
+    const Matrix4x4& matView)
+{
+    const RenderPacket& packet = *m_context->pPacket;
+    const std::vector<Renderable*>& pRenderables = packet.pScene->m_pRenderables;
+    const CullingBounds& bounds = packet.bounds;
+
+    // Anything outside the frustum is dropped before it costs a sort key
+    Frustum frustum;
+    Frustum::FromViewProj(packet.matProj * packet.matView, frustum);
+
+    std::vector<uint32>& visibleObjects = m_context->visibleObjects;
+    visibleObjects.resize(bounds.Size());
+
+    std::chrono::time_point<HighResClock> cullStart = HighResClock::now();
+#if USE_BVH_CULLING
+    uint32 numVisible = packet.bvh.QueryFrustum(frustum, bounds, visibleObjects.data());
+#else
+    uint32 numVisible = FrustumCulling::Cull(frustum, bounds, visibleObjects.data());
+#endif
+    std::chrono::duration<float, std::milli> cullTime = HighResClock::now() - cullStart;
+
+    uint32 numInFrustum = numVisible;
+    uint32 numOccluders = 0;
+    std::chrono::time_point<HighResClock> occlusionStart = HighResClock::now();
+#if USE_OCCLUSION_CULLING
+    numVisible = OcclusionCull(matView, numVisible, numOccluders);
+#endif
+    std::chrono::duration<float, std::milli> occlusionTime = HighResClock::now() - occlusionStart;
+
+    DrawList& drawList = m_context->drawList;
+    drawList.Clear();
+
+    std::vector<IndexBufferID>& drawIbids = m_context->drawIbids;
+    drawIbids.resize(pRenderables.size());
+    uint32 numTriangles = 0;
+
+    for (uint32 visible = 0; visible < numVisible; visible++)
+    {
+        uint32 i = visibleObjects[visible];
+        const Renderable* pRenderable = pRenderables[i];
 
-    m_core->Present();
+        const RenderableLod& lod = pRenderable->lods[sLodSelect(*pRenderable, bounds, i, matView, packet.matProj)];
+        drawIbids[i] = lod.ibid;
+        numTriangles += lod.numIndices / 3;
+
+        // Everything is opaque and uses the one pipeline for now
+        uint32 pipeline = 0;
+
+        // Material IDs are allocated densely from 0 so always fit the key
+        uint32 material = (uint32)pRenderable->pMaterial->id;
+
+        uint32 geometry = m_core->GeometrySortKeyGet(pRenderable->vbid, lod.ibid);
 
+        // View space depth of the centre of the bounds. matView has already been transposed for the shader, hence the third column
+        float viewDepth = bounds.boxCentreX[i] * matView._13 + bounds.boxCentreY[i] * matView._23 + bounds.boxCentreZ[i] * matView._33 + matView._43;
+
+        drawList.Add(DrawList::MakeKey(pipeline, material, geometry, viewDepth), i);
+    }
+
+    drawList.Sort(m_context->drawListStats);
+    m_context->drawListStats.numCulled = bounds.Size() - numVisible;
+    m_context->drawListStats.cullTimeMs = cullTime.count();
+    m_context->drawListStats.numOccluded = numInFrustum - numVisible;
+    m_context->drawListStats.numOccluders = numOccluders;
+    m_context->drawListStats.occlusionTimeMs = occlusionTime.count();
+    m_context->drawListStats.numTriangles = numTriangles;
 }
 
-void Renderer::FlushGPU()
+uint32 Renderer::OcclusionCull(
+    const Matrix4x4& matView,
+    uint32 numVisible,
+    uint32& numOccludersOut)
 {
-    m_core->WaitForGPU();
+    const RenderPacket& packet = *m_context->pPacket;
+    const std::vector<Renderable*>& pRenderables = packet.pScene->m_pRenderables;
+    const CullingBounds& bounds = packet.bounds;
+    std::vector<uint32>& visibleObjects = m_context->visibleObjects;
+
+    // How big each occluder looks is its radius over its distance from the camera, anything the camera's inside of is as big as
+    // they come
+    std::vector<std::pair<float, uint32>>& candidates = m_context->occluderCandidates;
+    candidates.clear();
+    for (uint32 visible = 0; visible < numVisible; visible++)
+    {
+        uint32 i = visibleObjects[visible];
+        if (!pRenderables[i]->pOccluder)
+        {
+            continue;
+        }
+
+        float distance = sViewDistance(bounds, i, matView);
+        float size = distance > bounds.sphereRadius[i] ? bounds.sphereRadius[i] / distance : FLT_MAX;
+
+        if (size >= OCCLUSION_MIN_OCCLUDER_SIZE)
+        {
+            candidates.push_back(std::make_pair(size, i));
+        }
+    }
+
+    numOccludersOut = 0;
+    if (candidates.empty())
+    {
+        return numVisible;
+    }
+
+    uint32 numOccluders = std::min((uint32)candidates.size(), (uint32)OCCLUSION_MAX_OCCLUDERS);
+    std::partial_sort(candidates.begin(), candidates.begin() + numOccluders, candidates.end(),
+        [](const std::pair<float, uint32>& a, const std::pair<float, uint32>& b)
+    {
+        return a.first > b.first;
+    });
+
+    m_context->pOccluders.resize(numOccluders);
+    m_context->occluderWorlds.resize(numOccluders);
+    for (uint32 occluder = 0; occluder < numOccluders; occluder++)
+    {
+        m_context->pOccluders[occluder] = pRenderables[candidates[occluder].second]->pOccluder;
+        m_context->occluderWorlds[occluder] = packet.matWorlds[candidates[occluder].second];
+    }
+
+    OcclusionBuffer& occlusionBuffer = m_context->occlusionBuffer;
+    occlusionBuffer.OccludersDraw(packet.matProj * packet.matView, m_context->pOccluders.data(), m_context->occluderWorlds.data(),
+        numOccluders, *g_pJobSystem);
+    numOccludersOut = numOccluders;
+
+    return occlusionBuffer.Cull(bounds, visibleObjects.data(), numVisible, visibleObjects.data(), *g_pJobSystem);
 }
 
-void Renderer::UploadBegin(
+void Renderer::DrawBatchesBuild(
     void)
 {
-    m_core->Begin();
+    DrawList& drawList = m_context->drawList;
+    const std::vector<Renderable*>& pRenderables = m_context->pPacket->pScene->m_pRenderables;
+    const std::vector<IndexBufferID>& drawIbids = m_context->drawIbids;
+    std::vector<uint32>& drawObjects = m_context->drawObjects;
+    std::vector<DrawBatch>& drawBatches = m_context->drawBatches;
+
+    drawObjects.reserve(drawList.Size());
+
+#if USE_INSTANCED_BATCHING
+    // Batchable draws have the same key down to the geometry, so they're all within one run of those keys. The run is grouped by
+    // buffers, keeping front to back order within each group, and then the groups are put back in order of their nearest draw.
+    std::vector<uint32> run;
+    std::vector<DrawBatch> runBatches;
+    std::vector<uint32> runBatchFirstDraws;
+    std::vector<uint32> batchOrder;
+
+    uint32 runStart = 0;
+    for (uint32 i = 0; i < drawList.Size(); i++)
+    {
+        bool fRunEnds = i + 1 == drawList.Size() ||
+            (drawList.GetKey(i) >> DRAW_KEY_GEOMETRY_SHIFT) != (drawList.GetKey(i + 1) >> DRAW_KEY_GEOMETRY_SHIFT);
+        if (!fRunEnds)
+        {
+            continue;
+        }
+
+        run.clear();
+        for (uint32 draw = runStart; draw <= i; draw++)
+        {
+            run.push_back(draw);
+        }
+
+        std::sort(run.begin(), run.end(), [&](uint32 a, uint32 b)
+        {
+            const Renderable* pA = pRenderables[drawList.GetIndex(a)];
+            const Renderable* pB = pRenderables[drawList.GetIndex(b)];
+            if (pA->vbid != pB->vbid)
+            {
+                return pA->vbid < pB->vbid;
+            }
+            if (drawIbids[drawList.GetIndex(a)] != drawIbids[drawList.GetIndex(b)])
+            {
+                return drawIbids[drawList.GetIndex(a)] < drawIbids[drawList.GetIndex(b)];
+            }
+            return a < b;
+        });
+
+        // Object indices are relative to the run until the batches are reordered
+        runBatches.clear();
+        runBatchFirstDraws.clear();
+        for (uint32 j = 0; j < (uint32)run.size(); j++)
+        {
+            const Renderable* pRenderable = pRenderables[drawList.GetIndex(run[j])];
+            const Renderable* pPrev = j > 0 ? pRenderables[drawList.GetIndex(run[j - 1])] : nullptr;
+            if (pPrev && pPrev->vbid == pRenderable->vbid &&
+                drawIbids[drawList.GetIndex(run[j - 1])] == drawIbids[drawList.GetIndex(run[j])])
+            {
+                runBatches.back().instanceCount++;
+            }
+            else
+            {
+                runBatches.push_back({ j, 1 });
+                runBatchFirstDraws.push_back(run[j]);
+            }
+        }
+
+        batchOrder.resize(runBatches.size());
+        for (uint32 j = 0; j < (uint32)batchOrder.size(); j++)
+        {
+            batchOrder[j] = j;
+        }
+        std::sort(batchOrder.begin(), batchOrder.end(), [&](uint32 a, uint32 b)
+        {
+            return runBatchFirstDraws[a] < runBatchFirstDraws[b];
+        });
+
+        for (uint32 j = 0; j < (uint32)batchOrder.size(); j++)
+        {
+            const DrawBatch& runBatch = runBatches[batchOrder[j]];
+            drawBatches.push_back({ (uint32)drawObjects.size(), runBatch.instanceCount });
+            for (uint32 instance = 0; instance < runBatch.instanceCount; instance++)
+            {
+                drawObjects.push_back(drawList.GetIndex(run[runBatch.firstObject + instance]));
+            }
+        }
+
+        runStart = i + 1;
+    }
+#else
+    for (uint32 i = 0; i < drawList.Size(); i++)
+    {
+        drawBatches.push_back({ i, 1 });
+        drawObjects.push_back(drawList.GetIndex(i));
+    }
+#endif
+
+    m_context->drawListStats.numDrawCalls = (uint32)drawBatches.size();
 }
 
-void Renderer::UploadEnd(
-    void)
+void Renderer::FlushGPU()
 {
-    m_core->End();
+    PipelineFlush();
+    m_core->WaitForGPU();
+}
 
-    m_core->AdvanceFrame();
+void Renderer::UploadFlush(
+    void)
+{
+    m_core->UploadFlush();
 }
\ No newline at end of file
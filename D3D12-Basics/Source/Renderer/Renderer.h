@@ -5,14 +5,27 @@ class Scene;
 struct RenderConstants;
 struct RenderConstantEntry;
 struct RenderContext;
+struct RenderPacket;
 struct ConstantDataEntry;
 struct Vertex;
+struct UploadStreamStats;
+struct GPUMemoryStats;
+struct BindingStats;
+struct DescriptorPoolStats;
+struct DrawListStats;
+struct FrameStats;
+struct MaterialConstants;
+struct UploadStreamRetentionPolicy;
 
 enum VertexBufferID;
 enum IndexBufferID;
 enum TextureID;
+enum MaterialID : int32;
 
 #define NUM_SWAP_CHAIN_BUFFERS 2
+// Frames the CPU can record ahead of the GPU, independently of how many back buffers there are. Each frame's command allocators,
+// upload memory and descriptors are only reused once the GPU has finished the frame this many frames ago.
+#define NUM_FRAMES_IN_FLIGHT 2
 // For now assume all shaders are in the same file
 #define SHADER_FILE L"../Shaders/Shaders.hlsl"
 
@@ -22,16 +35,21 @@ public:
     Renderer();
     ~Renderer();
 
+    // Snapshots the camera and the scene's transforms into a render packet and hands it to the render thread, which renders it while
+    // the caller gets on with the next frame. Waits if the render thread is already globals.renderPipelineDepth frames behind, and
+    // renders on the calling thread when that's 0.
     void Render(
         void);
 
-    void FlushGPU(
+    // Waits for the render thread to finish every frame handed to it
+    void PipelineFlush(
         void);
 
-    void UploadBegin(
+    void FlushGPU(
         void);
 
-    void UploadEnd(
+    // Kicks off any pending uploads on the copy queue. Uploads are otherwise submitted with the next frame.
+    void UploadFlush(
         void);
 
     void ConstantDataSetEntry(
@@ -44,9 +62,13 @@ public:
     void CameraSet(
         const Camera* pCamera);
 
+    // Frames already handed over keep drawing the old scene, so call PipelineFlush before destroying it. The same goes for adding,
+    // removing or changing a scene's renderables or materials, anything besides transforms, which frames read as they render.
     void SceneSet(
         const Scene* pScene);
 
+    // Creating and destroying resources is thread safe, including while a frame renders. Destroying something a frame already
+    // handed over still draws isn't, so call PipelineFlush before destroying anything a scene has used.
     VertexBufferID VertexBufferCreate(
         size_t  numVerts, 
         Vertex* pData);
@@ -61,6 +83,10 @@ public:
     void IndexBufferDestroy(
         IndexBufferID ibid);
 
+    // Moves geometry out of arena blocks less than maxOccupancy full so they can be released. Returns the number of buffers moved.
+    uint32 GeometryDefragment(
+        float maxOccupancy);
+
     TextureID TextureCreate(
         int32 width, 
         int32 height,
@@ -70,8 +96,79 @@ public:
     void TextureDestroy(
         TextureID tid);
 
+    // Materials live on the GPU for as long as they exist, so only creating or changing one costs any upload. Returns an invalid ID
+    // if there are already as many materials as the renderer has room for.
+    MaterialID MaterialCreate(
+        const MaterialConstants& constants);
+
+    void MaterialUpdate(
+        MaterialID id,
+        const MaterialConstants& constants);
+
+    void MaterialDestroy(
+        MaterialID id);
+
+    // Stats are of the last frame the render thread finished, call PipelineFlush first to include every frame handed over
+
+    // How many bindings the last frame issued, and how many were skipped because they were already bound
+    void BindingStatsGet(
+        BindingStats& statsOut);
+
+    // Draw count, sort cost and the state changes left after sorting for the last frame
+    void DrawListStatsGet(
+        DrawListStats& statsOut);
+
+    // How long the CPU waited on the GPU at the end of the last frame, see globals.fMeasureFrameWait
+    void FrameStatsGet(
+        FrameStats& statsOut);
+
+    // Descriptor table reuse over the last frame
+    void DescriptorPoolStatsGet(
+        DescriptorPoolStats& statsOut);
+
+    // Usage and fragmentation of every heap placed resources are allocated from
+    void GPUMemoryStatsGet(
+        GPUMemoryStats& statsOut);
+
+    // Upload stream stats for the last completed frame, use these to tune the page size and retention policy
+    void UploadStatsGet(
+        UploadStreamStats& statsOut);
+
+    void UploadRetentionPolicySet(
+        const UploadStreamRetentionPolicy& policy);
+
 private:
 
+    void RenderThreadMain(
+        void);
+
+    void RenderPacketFill(
+        RenderPacket& packet);
+
+    void RenderPacketExecute(
+        const RenderPacket& packet);
+
+    // Sorts the scene's renderables into the order they'll be drawn in this frame
+    void DrawListBuild(
+        const Matrix4x4& matView);
+
+    // Drops the first numVisible of visibleObjects which are hidden behind the biggest occluders among them, and returns how many
+    // are left
+    uint32 OcclusionCull(
+        const Matrix4x4& matView,
+        uint32 numVisible,
+        uint32& numOccludersOut);
+
+    // Collapses draws of the same mesh and material in the sorted draw list into instanced draws
+    void DrawBatchesBuild(
+        void);
+
+    // Records drawBatches[firstBatch] up to but not including drawBatches[endBatch] into one of the core's recording contexts
+    void DrawBatchesRecord(
+        uint32 context,
+        uint32 firstBatch,
+        uint32 endBatch);
+
     void ConstantDataInitialise();
     void ConstantDataDispose();
 
@@ -2,9 +2,18 @@
 
 #include "Engine.h"
 
+#include "Generic/JobSystem.h"
+
+#include "Renderer/MeshSimplify.h"
+#include "Renderer/OcclusionCulling.h"
 #include "Renderer/VertexFormats.h"
 #include "Renderer/Renderable.h"
 #include "Renderer/Texture.h"
+#include "Renderer/ConstantBuffers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 
 #include <assimp/postprocess.h>
 #include <assimp/Importer.hpp>
@@ -12,15 +21,26 @@
 
 #define TEXTURE_DIR_PATH "../Data/Textures/"
 
+// Each LOD aims for this fraction of the previous one's triangles
+#define LOD_TRIANGLE_RATIO 0.5f
+// LODs stop before they'd have fewer triangles than this, the draw costs more than the triangles by then
+#define LOD_MIN_TRIANGLES 128
+// Most error a LOD can have, relative to the mesh's bounding sphere radius
+#define LOD_MAX_ERROR 0.25f
+// A LOD which can't get below this fraction of the previous one's triangles isn't worth another index buffer
+#define LOD_MAX_TRIANGLES_KEPT 0.8f
+
 #define ASSIMP_DEFAULT_IMPORT_FLAGS  aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_MakeLeftHanded | aiProcess_FlipWindingOrder
 
 const float constDefaultVertexNormal[] = { 0.0f, 0.0f, 1.0f };
 const float constDefaultVertexColour[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 const float constDefaultUV[] = { 0.0f, 0.0f };
 
+static std::atomic<uint64> s_nextBoundsVersion(1);
+
 Scene::Scene()
 {
-
+    m_boundsVersion = 0;
 }
 
 Scene::~Scene()
@@ -30,12 +50,46 @@ Scene::~Scene()
         delete *it;
     }
 
+    for (auto it = m_pMaterials.begin(); it != m_pMaterials.end(); it++)
+    {
+        g_pRenderer->MaterialDestroy((*it)->id);
+        delete *it;
+    }
+
     for (auto it = m_textures.begin(); it != m_textures.end(); it++)
     {
         delete it->second;
     }
 }
 
+void Scene::BoundsUpdate(
+    void)
+{
+    m_bounds.Clear();
+    for (auto it = m_pRenderables.begin(); it != m_pRenderables.end(); it++)
+    {
+        m_bounds.Add((*it)->boundsMin, (*it)->boundsMax, (*it)->sphereCentre, (*it)->sphereRadius);
+    }
+
+    m_bvh.Build(m_bounds);
+    m_boundsVersion = s_nextBoundsVersion++;
+}
+
+void Scene::BoundsRefit(
+    void)
+{
+    ASSERT(m_bounds.Size() == (uint32)m_pRenderables.size());
+
+    m_bounds.Clear();
+    for (auto it = m_pRenderables.begin(); it != m_pRenderables.end(); it++)
+    {
+        m_bounds.Add((*it)->boundsMin, (*it)->boundsMax, (*it)->sphereCentre, (*it)->sphereRadius);
+    }
+
+    m_bvh.Refit(m_bounds);
+    m_boundsVersion = s_nextBoundsVersion++;
+}
+
 Texture* Scene::GetOrCreateTextureFromPath(
     const std::string& filePath)
 {
@@ -46,136 +100,346 @@ Texture* Scene::GetOrCreateTextureFromPath(
     return m_textures[filePath];
 }
 
-
-Scene* Scene::Load(
-    const char* fileName)
+Material* Scene::GetOrCreateMaterial(
+    const Material& material)
 {
-    Assimp::Importer importer;
+    // Names aren't compared, exporters often give identical materials different names
+    for (auto it = m_pMaterials.begin(); it != m_pMaterials.end(); it++)
+    {
+        Material* pExisting = *it;
+        if (pExisting->diffuse.x == material.diffuse.x &&
+            pExisting->diffuse.y == material.diffuse.y &&
+            pExisting->diffuse.z == material.diffuse.z &&
+            pExisting->specular == material.specular &&
+            pExisting->specularHardness == material.specularHardness &&
+            pExisting->diffuseTexture == material.diffuseTexture)
+        {
+            return pExisting;
+        }
+    }
 
-    const aiScene* pAssimpScene = importer.ReadFile(fileName, ASSIMP_DEFAULT_IMPORT_FLAGS);
+    Material* pMaterial = new Material(material);
 
-    if (!pAssimpScene || !pAssimpScene->HasMeshes())
+    MaterialConstants constants;
+    constants.diffuse = pMaterial->diffuse;
+    constants.specular = pMaterial->specular;
+    constants.specularHardness = pMaterial->specularHardness;
+    pMaterial->id = g_pRenderer->MaterialCreate(constants);
+    if ((int32)pMaterial->id < 0)
     {
+        delete pMaterial;
         return nullptr;
     }
 
-    Scene* pScene = new Scene();
+    m_pMaterials.push_back(pMaterial);
+    return pMaterial;
+}
 
-    pScene->m_pRenderables.reserve(pAssimpScene->mNumMeshes);
 
-    for (uint32 idxMesh = 0; idxMesh < pAssimpScene->mNumMeshes; idxMesh++)
+// Adds LODs to the renderable until they'd have too few triangles, too much error, or not enough fewer triangles than the last. Each
+// is simplified from the full mesh rather than the LOD before, so errors don't build up.
+static void sLodsBuild(
+    const std::vector<Vertex>& verts,
+    const std::vector<uint32>& indices,
+    Renderable& renderable)
+{
+    std::vector<uint32> lodIndices;
+    for (uint32 lod = 1; lod < RENDERABLE_MAX_LODS; lod++)
     {
-        if (!pAssimpScene->mMeshes[idxMesh])
+        const RenderableLod& prevLod = renderable.lods[lod - 1];
+        uint32 targetIndices = (uint32)(prevLod.numIndices * LOD_TRIANGLE_RATIO) / 3 * 3;
+        if (targetIndices / 3 < LOD_MIN_TRIANGLES)
         {
-            continue;
+            break;
         }
 
-        aiMesh& assimpMesh = *pAssimpScene->mMeshes[idxMesh];
-
-        if (!assimpMesh.HasPositions())
+        float error = MeshSimplify::Simplify(verts.data(), (uint32)verts.size(), indices.data(), (uint32)indices.size(), targetIndices,
+            LOD_MAX_ERROR * renderable.sphereRadius, lodIndices);
+        if (lodIndices.size() > prevLod.numIndices * LOD_MAX_TRIANGLES_KEPT)
         {
-            continue;
+            break;
         }
 
-        std::vector<Vertex> verts;
-        verts.reserve(assimpMesh.mNumVertices);
-        for (uint32 idxVert = 0; idxVert < assimpMesh.mNumVertices; idxVert++)
+        IndexBufferID ibid = g_pRenderer->IndexBufferCreate(lodIndices.size(), lodIndices.data());
+        if ((int32)ibid < 0)
         {
-            Vertex vertex;
-            static_assert(sizeof(vertex.pos) == sizeof(assimpMesh.mVertices[0]), "Vertex sizes does not match");
-            memcpy(&vertex.pos[0], &assimpMesh.mVertices[idxVert], sizeof(vertex.pos));
+            break;
+        }
 
-            if (assimpMesh.HasNormals())
-            {
-                static_assert(sizeof(vertex.normal) == sizeof(assimpMesh.mNormals[0]), "Normal sizes does not match");
-                memcpy(&vertex.normal, (void*)&assimpMesh.mNormals[idxVert], sizeof(vertex.normal));
-            }
-            else
-            {
-                static_assert(sizeof(vertex.normal) == sizeof(constDefaultVertexNormal), "Default normal size does not match");
-                memcpy(&vertex.normal, (void*)constDefaultVertexNormal, sizeof(vertex.normal));
-            }
+        RenderableLod& newLod = renderable.lods[lod];
+        newLod.ibid = ibid;
+        newLod.numIndices = (uint32)lodIndices.size();
+        newLod.error = renderable.sphereRadius > 0.0f ? error / renderable.sphereRadius : 0.0f;
+        renderable.numLods = lod + 1;
+    }
+}
 
-            if (assimpMesh.HasVertexColors(0))
-            {
-                static_assert(sizeof(vertex.col) == sizeof(assimpMesh.mColors[0][0]), "Colour sizes does not match");
-                memcpy(&vertex.col, (void*)&assimpMesh.mColors[0][idxVert], sizeof(vertex.col));
-            }
-            else
-            {
-                static_assert(sizeof(vertex.col) == sizeof(constDefaultVertexColour), "Default colour size does not match");
-                memcpy(&vertex.col, (void*)constDefaultVertexColour, sizeof(vertex.col));
-            }
+// Creates the mesh's buffers and a renderable for them, or returns nullptr if the mesh can't be drawn, which includes having no
+// material. Thread safe, so meshes can be loaded in parallel.
+static Renderable* sRenderableLoad(
+    const aiMesh& assimpMesh,
+    const Material* pMaterial)
+{
+    if (!assimpMesh.HasPositions() || !pMaterial)
+    {
+        return nullptr;
+    }
 
-            if (assimpMesh.HasTextureCoords(0))
-            {
-                ASSERT(sizeof(vertex.uv) == assimpMesh.mNumUVComponents[0]*sizeof(vertex.uv[0]));
-                memcpy(&vertex.uv, (void*)&assimpMesh.mTextureCoords[0][idxVert], sizeof(vertex.uv));
-            }
-            else
-            {
-                static_assert(sizeof(vertex.uv) == sizeof(constDefaultUV), "Default UV size does not match");
-                memcpy(&vertex.uv, (void*)constDefaultUV, sizeof(vertex.uv));
-            }
+    std::vector<Vertex> verts;
+    verts.reserve(assimpMesh.mNumVertices);
 
-            verts.push_back(vertex);
+    Vector3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vector3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32 idxVert = 0; idxVert < assimpMesh.mNumVertices; idxVert++)
+    {
+        Vertex vertex;
+        static_assert(sizeof(vertex.pos) == sizeof(assimpMesh.mVertices[0]), "Vertex sizes does not match");
+        memcpy(&vertex.pos[0], &assimpMesh.mVertices[idxVert], sizeof(vertex.pos));
+
+        Vector3 pos(vertex.pos[0], vertex.pos[1], vertex.pos[2]);
+        boundsMin = Vector3::Min(boundsMin, pos);
+        boundsMax = Vector3::Max(boundsMax, pos);
+
+        if (assimpMesh.HasNormals())
+        {
+            static_assert(sizeof(vertex.normal) == sizeof(assimpMesh.mNormals[0]), "Normal sizes does not match");
+            memcpy(&vertex.normal, (void*)&assimpMesh.mNormals[idxVert], sizeof(vertex.normal));
+        }
+        else
+        {
+            static_assert(sizeof(vertex.normal) == sizeof(constDefaultVertexNormal), "Default normal size does not match");
+            memcpy(&vertex.normal, (void*)constDefaultVertexNormal, sizeof(vertex.normal));
         }
 
-        bool allFacesValid = verts.size();
-        
-        std::vector<uint32> indices;
-        indices.reserve(3 * assimpMesh.mNumFaces);
-        for (uint32 idxFace = 0; idxFace < assimpMesh.mNumFaces; idxFace++)
+        if (assimpMesh.HasVertexColors(0))
         {
-            if (assimpMesh.mFaces[idxFace].mNumIndices != 3)
-            {
-                // Require that meshes are triangulated before being loaded.
-                allFacesValid = false;
-                continue;
-            }
+            static_assert(sizeof(vertex.col) == sizeof(assimpMesh.mColors[0][0]), "Colour sizes does not match");
+            memcpy(&vertex.col, (void*)&assimpMesh.mColors[0][idxVert], sizeof(vertex.col));
+        }
+        else
+        {
+            static_assert(sizeof(vertex.col) == sizeof(constDefaultVertexColour), "Default colour size does not match");
+            memcpy(&vertex.col, (void*)constDefaultVertexColour, sizeof(vertex.col));
+        }
 
-            indices.push_back(assimpMesh.mFaces[idxFace].mIndices[0]);
-            indices.push_back(assimpMesh.mFaces[idxFace].mIndices[1]);
-            indices.push_back(assimpMesh.mFaces[idxFace].mIndices[2]);
+        if (assimpMesh.HasTextureCoords(0))
+        {
+            ASSERT(sizeof(vertex.uv) == assimpMesh.mNumUVComponents[0]*sizeof(vertex.uv[0]));
+            memcpy(&vertex.uv, (void*)&assimpMesh.mTextureCoords[0][idxVert], sizeof(vertex.uv));
         }
+        else
+        {
+            static_assert(sizeof(vertex.uv) == sizeof(constDefaultUV), "Default UV size does not match");
+            memcpy(&vertex.uv, (void*)constDefaultUV, sizeof(vertex.uv));
+        }
+
+        verts.push_back(vertex);
+    }
 
-        if (!allFacesValid || !verts.size() || !indices.size() || (indices.size() % 3) != 0 )
+    // Centred on the AABB, so it's never bigger than the AABB's own bounding sphere and usually smaller
+    Vector3 sphereCentre = (boundsMin + boundsMax) * 0.5f;
+    float sphereRadiusSq = 0.0f;
+    for (uint32 idxVert = 0; idxVert < (uint32)verts.size(); idxVert++)
+    {
+        Vector3 pos(verts[idxVert].pos[0], verts[idxVert].pos[1], verts[idxVert].pos[2]);
+        sphereRadiusSq = std::max(sphereRadiusSq, Vector3::DistanceSquared(pos, sphereCentre));
+    }
+
+    bool allFacesValid = verts.size();
+    
+    std::vector<uint32> indices;
+    indices.reserve(3 * assimpMesh.mNumFaces);
+    for (uint32 idxFace = 0; idxFace < assimpMesh.mNumFaces; idxFace++)
+    {
+        if (assimpMesh.mFaces[idxFace].mNumIndices != 3)
         {
+            // Require that meshes are triangulated before being loaded.
+            allFacesValid = false;
             continue;
         }
 
-        VertexBufferID vbid = g_pRenderer->VertexBufferCreate(verts.size(), verts.data());
-        IndexBufferID ibid = g_pRenderer->IndexBufferCreate(indices.size(), indices.data());
+        indices.push_back(assimpMesh.mFaces[idxFace].mIndices[0]);
+        indices.push_back(assimpMesh.mFaces[idxFace].mIndices[1]);
+        indices.push_back(assimpMesh.mFaces[idxFace].mIndices[2]);
+    }
+
+    if (!allFacesValid || !verts.size() || !indices.size() || (indices.size() % 3) != 0 )
+    {
+        return nullptr;
+    }
 
-        Material material;
-        if (pAssimpScene->HasMaterials())
+    VertexBufferID vbid = g_pRenderer->VertexBufferCreate(verts.size(), verts.data());
+    IndexBufferID ibid = g_pRenderer->IndexBufferCreate(indices.size(), indices.data());
+    if ((int32)vbid < 0 || (int32)ibid < 0)
+    {
+        // Out of buffer IDs, which the renderer will have logged. The enums are only forward declared here, so check the sign.
+        if ((int32)vbid >= 0)
         {
-            const aiMaterial* pAssimpMaterial = pAssimpScene->mMaterials[assimpMesh.mMaterialIndex]; 
-            aiString aiMaterialName;
-            pAssimpMaterial->Get(AI_MATKEY_NAME, aiMaterialName);
-            strcpy_s(material.name, aiMaterialName.C_Str());
+            g_pRenderer->VertexBufferDestroy(vbid);
+        }
+        if ((int32)ibid >= 0)
+        {
+            g_pRenderer->IndexBufferDestroy(ibid);
+        }
+        return nullptr;
+    }
 
-            aiColor3D color(0.f, 0.f, 0.f);
-            pAssimpMaterial->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-            material.diffuse = { color.r, color.g, color.b};
+    Renderable* pRenderable = new Renderable(vbid, ibid, (uint32)indices.size(), pMaterial, boundsMin, boundsMax, sphereCentre,
+        sqrtf(sphereRadiusSq));
 
-            if (pAssimpMaterial->GetTextureCount(aiTextureType_DIFFUSE))
+    sLodsBuild(verts, indices, *pRenderable);
+
+    // Simple meshes keep their triangles so they can hide whatever's behind them
+    if (indices.size() / 3 <= OCCLUSION_MAX_OCCLUDER_TRIANGLES)
+    {
+        OccluderMesh* pOccluder = new OccluderMesh();
+        pOccluder->positions.reserve(verts.size());
+        for (uint32 idxVert = 0; idxVert < (uint32)verts.size(); idxVert++)
+        {
+            pOccluder->positions.push_back(Vector3(verts[idxVert].pos[0], verts[idxVert].pos[1], verts[idxVert].pos[2]));
+        }
+        pOccluder->indices = std::move(indices);
+        pRenderable->pOccluder = pOccluder;
+    }
+
+    return pRenderable;
+}
+
+Material* Scene::MaterialLoad(
+    const aiMaterial* pAssimpMaterial)
+{
+    Material material;
+    if (pAssimpMaterial)
+    {
+        aiString aiMaterialName;
+        pAssimpMaterial->Get(AI_MATKEY_NAME, aiMaterialName);
+        strcpy_s(material.name, aiMaterialName.C_Str());
+
+        aiColor3D color(0.f, 0.f, 0.f);
+        pAssimpMaterial->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+        material.diffuse = { color.r, color.g, color.b};
+
+        if (pAssimpMaterial->GetTextureCount(aiTextureType_DIFFUSE))
+        {
+            aiString assimpTexName;
+            pAssimpMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &assimpTexName);
+
+            std::string texPath = TEXTURE_DIR_PATH;
+            texPath.append(assimpTexName.C_Str());
+
+            material.diffuseTexture = GetOrCreateTextureFromPath(texPath.c_str());
+        }
+    }
+
+    return GetOrCreateMaterial(material);
+}
+
+Scene* Scene::Load(
+    const char* fileName)
+{
+    Assimp::Importer importer;
+
+    const aiScene* pAssimpScene = importer.ReadFile(fileName, ASSIMP_DEFAULT_IMPORT_FLAGS);
+
+    if (!pAssimpScene || !pAssimpScene->HasMeshes())
+    {
+        return nullptr;
+    }
+
+    Scene* pScene = new Scene();
+
+    // Materials are shared between meshes and deduplicated, so they're loaded up front on this thread
+    std::vector<const Material*> pMeshMaterials(pAssimpScene->mNumMeshes);
+    {
+        std::vector<Material*> pAssimpMaterials(pAssimpScene->mNumMaterials, nullptr);
+        for (uint32 idxMesh = 0; idxMesh < pAssimpScene->mNumMeshes; idxMesh++)
+        {
+            const aiMesh* pAssimpMesh = pAssimpScene->mMeshes[idxMesh];
+            if (!pAssimpMesh || !pAssimpScene->HasMaterials())
             {
-                aiString assimpTexName;
-                pAssimpMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &assimpTexName);
+                pMeshMaterials[idxMesh] = pScene->MaterialLoad(nullptr);
+                continue;
+            }
 
-                std::string texPath = TEXTURE_DIR_PATH;
-                texPath.append(assimpTexName.C_Str());
+            uint32 idxMaterial = pAssimpMesh->mMaterialIndex;
+            if (!pAssimpMaterials[idxMaterial])
+            {
+                pAssimpMaterials[idxMaterial] = pScene->MaterialLoad(pAssimpScene->mMaterials[idxMaterial]);
+            }
+            pMeshMaterials[idxMesh] = pAssimpMaterials[idxMaterial];
+        }
+    }
 
-                material.diffuseTexture = pScene->GetOrCreateTextureFromPath(texPath.c_str());
+    // Meshes are independent of each other, so build their buffers in parallel. Each goes in its own slot to keep the file's order.
+    std::vector<Renderable*> pRenderables(pAssimpScene->mNumMeshes, nullptr);
+    g_pJobSystem->ParallelFor(0, pAssimpScene->mNumMeshes, 1, [&](uint32 firstMesh, uint32 endMesh)
+    {
+        for (uint32 idxMesh = firstMesh; idxMesh < endMesh; idxMesh++)
+        {
+            if (pAssimpScene->mMeshes[idxMesh])
+            {
+                pRenderables[idxMesh] = sRenderableLoad(*pAssimpScene->mMeshes[idxMesh], pMeshMaterials[idxMesh]);
             }
         }
+    });
+
+    pScene->m_pRenderables.reserve(pAssimpScene->mNumMeshes);
+    for (uint32 idxMesh = 0; idxMesh < pAssimpScene->mNumMeshes; idxMesh++)
+    {
+        if (pRenderables[idxMesh])
+        {
+            pScene->m_pRenderables.push_back(pRenderables[idxMesh]);
+        }
+    }
+
+    // Every node placing each mesh, with the node's transform from the root. Assimp's matrices transform column vectors, like ours.
+    std::vector<std::vector<aiMatrix4x4>> meshNodeTransforms(pAssimpScene->mNumMeshes);
+    std::vector<std::pair<const aiNode*, aiMatrix4x4>> nodeStack;
+    if (pAssimpScene->mRootNode)
+    {
+        nodeStack.push_back({ pAssimpScene->mRootNode, aiMatrix4x4() });
+    }
+    while (!nodeStack.empty())
+    {
+        const aiNode* pNode = nodeStack.back().first;
+        aiMatrix4x4 matNode = nodeStack.back().second * pNode->mTransformation;
+        nodeStack.pop_back();
+
+        for (uint32 i = 0; i < pNode->mNumMeshes; i++)
+        {
+            meshNodeTransforms[pNode->mMeshes[i]].push_back(matNode);
+        }
+        for (uint32 i = 0; i < pNode->mNumChildren; i++)
+        {
+            nodeStack.push_back({ pNode->mChildren[i], matNode });
+        }
+    }
 
-        Renderable* pRenderable = new Renderable(vbid, ibid, material);
-        ASSERT(pRenderable);
+    // Meshes are drawn as they are in the file, so the first node placing a mesh keeps it where it's always been drawn. Any other
+    // node placing it adds an instance sharing its buffers, where that node puts it relative to the first, which draws batch.
+    for (uint32 idxMesh = 0; idxMesh < pAssimpScene->mNumMeshes; idxMesh++)
+    {
+        const std::vector<aiMatrix4x4>& matNodes = meshNodeTransforms[idxMesh];
+        if (!pRenderables[idxMesh] || matNodes.size() < 2)
+        {
+            continue;
+        }
 
-        pScene->m_pRenderables.push_back(pRenderable);
+        aiMatrix4x4 matFirstInverse = matNodes[0];
+        matFirstInverse.Inverse();
+        for (uint32 i = 1; i < (uint32)matNodes.size(); i++)
+        {
+            aiMatrix4x4 m = matFirstInverse * matNodes[i];
+            Matrix4x4 matInstance(
+                m.a1, m.a2, m.a3, m.a4,
+                m.b1, m.b2, m.b3, m.b4,
+                m.c1, m.c2, m.c3, m.c4,
+                m.d1, m.d2, m.d3, m.d4);
+            pScene->m_pRenderables.push_back(new Renderable(*pRenderables[idxMesh], matInstance));
+        }
     }
 
+    pScene->BoundsUpdate();
+
     return pScene;
 }
\ No newline at end of file
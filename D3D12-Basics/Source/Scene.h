@@ -2,8 +2,13 @@
 #include <vector>
 #include <unordered_map>
 
+#include "Renderer/BVH.h"
+#include "Renderer/FrustumCulling.h"
+
 class Renderable;
 class Texture;
+struct Material;
+struct aiMaterial;
 
 class Scene
 {
@@ -13,12 +18,35 @@ public:
 
     ~Scene();
 
+    // Rebuilds m_bounds and m_bvh from the renderables, has to be called whenever they're added or removed
+    void BoundsUpdate(
+        void);
+
+    // Updates m_bounds and refits m_bvh, for when renderables have only moved
+    void BoundsRefit(
+        void);
+
     std::vector<Renderable*> m_pRenderables;
+    // Bounds of m_pRenderables, in the same order, and a hierarchy over them
+    CullingBounds m_bounds;
+    BVH m_bvh;
+    // Changes whenever the bounds do, and is never the same for two scenes, so copies can tell whether they're stale
+    uint64 m_boundsVersion;
+    std::vector<Material*> m_pMaterials;
     std::unordered_map<std::string, Texture*> m_textures;
 private:
     Scene();
     
     Texture* GetOrCreateTextureFromPath(
         const std::string& filePath);
+
+    // Reads the material's properties, or uses the defaults if pAssimpMaterial is null. Returns nullptr like GetOrCreateMaterial.
+    Material* MaterialLoad(
+        const aiMaterial* pAssimpMaterial);
+
+    // Returns an existing material with the same properties if there is one, so each distinct material is only uploaded once.
+    // Returns nullptr if the renderer is out of material IDs, meshes using it aren't loaded.
+    Material* GetOrCreateMaterial(
+        const Material& material);
 };
 
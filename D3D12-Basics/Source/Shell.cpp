@@ -31,6 +31,16 @@ static void sParseCmdLine()
                 globals.fD3DDebug = true;
                 globals.fGPUValidation = true;
             }
+
+            if (wcscmp(plpArgs[i], L"-measureframewait") == 0)
+            {
+                globals.fMeasureFrameWait = true;
+            }
+
+            if (wcscmp(plpArgs[i], L"-pipelinedepth") == 0 && i + 1 < nNumArgs)
+            {
+                globals.renderPipelineDepth = (uint32)_wtoi(plpArgs[++i]);
+            }
         }
     }
 }
@@ -0,0 +1,145 @@
+#include "Test.h"
+
+#include "Renderer/BVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Objects are spread this far apart on average, so bigger scenes are bigger worlds and the camera sees about as many of them
+#define OBJECT_SPACING 10.0f
+#define FAR_PLANE 300.0f
+#define NUM_RAYS 100000
+
+// Camera at the middle of the world looking along one axis, 90 degrees across
+static Frustum sFrustum(
+    uint32 axis)
+{
+    const float nearPlane = 0.1f;
+
+    // Rows pick out the camera's right, up and forward axes, forward being +/- x, y or z
+    float sign = (axis & 1) ? -1.0f : 1.0f;
+    uint32 forward = axis / 2;
+    uint32 right = (forward + 1) % 3;
+    uint32 up = (forward + 2) % 3;
+
+    Matrix4x4 matView(
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
+    matView.m[0][right] = sign;
+    matView.m[1][up] = 1.0f;
+    matView.m[2][forward] = sign;
+
+    Matrix4x4 matProj;
+    matProj._33 = FAR_PLANE / (FAR_PLANE - nearPlane);
+    matProj._34 = -nearPlane * FAR_PLANE / (FAR_PLANE - nearPlane);
+    matProj._43 = 1.0f;
+    matProj._44 = 0.0f;
+
+    Frustum frustum;
+    Frustum::FromViewProj(matProj * matView, frustum);
+    return frustum;
+}
+
+// Build, refit after everything has moved a little, frustum queries from the middle of the world looking along each axis against
+// culling every object with FrustumCulling::Cull, and rays from the middle in random directions
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    printf("objects  build ms  refit ms  visible  QueryFrustum ms  Cull ms  ns per QueryRay  depth\n");
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 3.0f);
+
+    for (uint32 numObjects : { 10000u, 100000u, 1000000u })
+    {
+        float halfWorld = 0.5f * OBJECT_SPACING * cbrtf((float)numObjects);
+        CullingBounds bounds;
+        for (uint32 i = 0; i < numObjects; i++)
+        {
+            Vector3 centre(unit(rng) * halfWorld, unit(rng) * halfWorld, unit(rng) * halfWorld);
+            float e = extent(rng);
+            Vector3 offset(e, e, e);
+            bounds.Add(centre - offset, centre + offset, centre, e * 1.75f);
+        }
+
+        // Enough repeats to take a while at every size, best of them
+        uint32 numRepeats = std::max(1000000u / numObjects, 2u);
+
+        BVH bvh;
+        double buildMs = 1e30;
+        for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+        {
+            Timer timer;
+            bvh.Build(bounds);
+            buildMs = std::min(buildMs, timer.ElapsedMs());
+        }
+
+        double refitMs = 1e30;
+        for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+        {
+            for (uint32 i = 0; i < numObjects; i++)
+            {
+                bounds.boxCentreX[i] += 0.1f;
+                bounds.sphereCentreX[i] += 0.1f;
+            }
+            Timer timer;
+            bvh.Refit(bounds);
+            refitMs = std::min(refitMs, timer.ElapsedMs());
+        }
+
+        std::vector<uint32> results(numObjects);
+        uint32 numVisible = 0;
+        double queryMs = 0.0;
+        double cullMs = 0.0;
+        for (uint32 axis = 0; axis < 6; axis++)
+        {
+            Frustum frustum = sFrustum(axis);
+
+            uint32 numResults = 0;
+            Timer queryTimer;
+            for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+            {
+                numResults = bvh.QueryFrustum(frustum, bounds, results.data());
+            }
+            queryMs += queryTimer.ElapsedMs() / numRepeats;
+
+            uint32 numCulled = 0;
+            Timer cullTimer;
+            for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+            {
+                numCulled = FrustumCulling::Cull(frustum, bounds, results.data());
+            }
+            cullMs += cullTimer.ElapsedMs() / numRepeats;
+
+            CHECK(numResults == numCulled);
+            numVisible += numResults;
+        }
+
+        std::vector<Vector3> directions(NUM_RAYS);
+        for (Vector3& direction : directions)
+        {
+            direction = Vector3(unit(rng), unit(rng), unit(rng));
+        }
+        uint32 numHits = 0;
+        Timer rayTimer;
+        for (const Vector3& direction : directions)
+        {
+            uint32 object;
+            float distance;
+            numHits += bvh.QueryRay(Vector3(), direction, FLT_MAX, bounds, object, distance);
+        }
+        double rayNs = rayTimer.ElapsedMs() * 1e6 / NUM_RAYS;
+        CHECK(numHits > 0);
+
+        printf("%7u  %8.2f  %8.3f  %7u  %15.3f  %7.3f  %15.1f  %5u\n", numObjects, buildMs, refitMs, numVisible / 6, queryMs / 6,
+            cullMs / 6, rayNs, bvh.GetDepth());
+    }
+    return 0;
+}
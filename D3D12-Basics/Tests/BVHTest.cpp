@@ -0,0 +1,178 @@
+#include "Test.h"
+
+#include "Renderer/BVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static void sBoxAdd(
+    CullingBounds& bounds,
+    const Vector3& centre,
+    float extent)
+{
+    Vector3 offset(extent, extent, extent);
+    bounds.Add(centre - offset, centre + offset, centre, extent * 1.75f);
+}
+
+// Perspective camera at the origin looking down +z, 90 degrees across
+static Frustum sFrustum(
+    float farPlane)
+{
+    const float nearPlane = 0.1f;
+
+    Matrix4x4 matViewProj;
+    matViewProj._33 = farPlane / (farPlane - nearPlane);
+    matViewProj._34 = -nearPlane * farPlane / (farPlane - nearPlane);
+    matViewProj._43 = 1.0f;
+    matViewProj._44 = 0.0f;
+
+    Frustum frustum;
+    Frustum::FromViewProj(matViewProj, frustum);
+    return frustum;
+}
+
+// Every query has to find what testing each object on its own finds
+static void sQueriesCheck(
+    const BVH& bvh,
+    const CullingBounds& bounds,
+    const Frustum& frustum,
+    const Vector3& sphereCentre,
+    float sphereRadius)
+{
+    uint32 numObjects = bounds.Size();
+    std::vector<uint32> expected(numObjects);
+    std::vector<uint32> results(numObjects);
+
+    uint32 numExpected = FrustumCulling::CullScalar(frustum, bounds, 0, numObjects, expected.data());
+    uint32 numResults = bvh.QueryFrustum(frustum, bounds, results.data());
+    std::sort(results.begin(), results.begin() + numResults);
+    CHECK(numResults == numExpected);
+    CHECK(std::equal(results.begin(), results.begin() + numResults, expected.begin()));
+
+    numExpected = 0;
+    for (uint32 object = 0; object < numObjects; object++)
+    {
+        float dx = std::max(fabsf(sphereCentre.x - bounds.boxCentreX[object]) - bounds.boxExtentX[object], 0.0f);
+        float dy = std::max(fabsf(sphereCentre.y - bounds.boxCentreY[object]) - bounds.boxExtentY[object], 0.0f);
+        float dz = std::max(fabsf(sphereCentre.z - bounds.boxCentreZ[object]) - bounds.boxExtentZ[object], 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= sphereRadius * sphereRadius)
+        {
+            expected[numExpected++] = object;
+        }
+    }
+    numResults = bvh.QuerySphere(sphereCentre, sphereRadius, bounds, results.data());
+    std::sort(results.begin(), results.begin() + numResults);
+    CHECK(numResults == numExpected);
+    CHECK(std::equal(results.begin(), results.begin() + numResults, expected.begin()));
+
+    // Along the x axis, through every object whose box straddles y = z = 0
+    Vector3 origin(-1.0f, 0.0f, 0.0f);
+    Vector3 direction(1.0f, 0.0f, 0.0f);
+    float nearest = FLT_MAX;
+    for (uint32 object = 0; object < numObjects; object++)
+    {
+        if (fabsf(bounds.boxCentreY[object]) <= bounds.boxExtentY[object] && fabsf(bounds.boxCentreZ[object]) <= bounds.boxExtentZ[object])
+        {
+            nearest = std::min(nearest, std::max(bounds.boxCentreX[object] - bounds.boxExtentX[object] - origin.x, 0.0f));
+        }
+    }
+    uint32 hitObject;
+    float hitDistance;
+    bool fHit = bvh.QueryRay(origin, direction, FLT_MAX, bounds, hitObject, hitDistance);
+    CHECK(fHit == (nearest < FLT_MAX));
+    if (fHit)
+    {
+        CHECK(hitDistance == nearest);
+    }
+}
+
+// Ordinary scattered objects
+static void sTestRandom(
+    void)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 3.0f);
+
+    CullingBounds bounds;
+    for (uint32 i = 0; i < 20000; i++)
+    {
+        sBoxAdd(bounds, Vector3(position(rng), position(rng), position(rng)), extent(rng));
+    }
+
+    BVH bvh;
+    bvh.Build(bounds);
+    printf("Random tree is %u levels deep\n", bvh.GetDepth());
+    CHECK(bvh.GetDepth() <= BVH_MAX_BUILD_DEPTH);
+    sQueriesCheck(bvh, bounds, sFrustum(60.0f), Vector3(10.0f, -5.0f, 20.0f), 25.0f);
+
+    // Move everything a little and refit
+    for (uint32 i = 0; i < bounds.Size(); i++)
+    {
+        bounds.boxCentreX[i] += 2.0f;
+        bounds.sphereCentreX[i] += 2.0f;
+    }
+    bvh.Refit(bounds);
+    sQueriesCheck(bvh, bounds, sFrustum(60.0f), Vector3(10.0f, -5.0f, 20.0f), 25.0f);
+}
+
+// Badly spread out objects: spaced further apart each time along one axis, bunched up towards one end of another so every split
+// only takes a slice off the top, and a cluster all in the same place. The tree has to stay within the depth cap, so queries'
+// stacks can't overflow, and still find the same objects.
+static void sTestDegenerate(
+    void)
+{
+    CullingBounds bounds;
+    float x = 1.0f;
+    for (uint32 i = 0; i < 3000; i++)
+    {
+        sBoxAdd(bounds, Vector3(x, 0.0f, 1.0f), 0.25f);
+        x = x * 1.02f + 0.6f;
+    }
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (uint32 i = 0; i < 100000; i++)
+    {
+        sBoxAdd(bounds, Vector3(0.0f, 1000.0f * powf(unit(rng), 20.0f), 2.0f), 1e-4f);
+    }
+
+    for (uint32 i = 0; i < 500; i++)
+    {
+        sBoxAdd(bounds, Vector3(5.0f, 0.0f, 5.0f), 1.0f);
+    }
+
+    BVH bvh;
+    bvh.Build(bounds);
+    printf("Degenerate tree is %u levels deep\n", bvh.GetDepth());
+    CHECK(bvh.GetDepth() <= BVH_MAX_BUILD_DEPTH);
+    sQueriesCheck(bvh, bounds, sFrustum(1e6f), Vector3(5.0f, 0.0f, 5.0f), 3.0f);
+    sQueriesCheck(bvh, bounds, sFrustum(50.0f), Vector3(0.0f, 0.0f, 2.0f), 0.01f);
+}
+
+static void sTestEmpty(
+    void)
+{
+    CullingBounds bounds;
+    BVH bvh;
+    bvh.Build(bounds);
+    CHECK(bvh.IsEmpty());
+    sQueriesCheck(bvh, bounds, sFrustum(100.0f), Vector3(), 1.0f);
+
+    sBoxAdd(bounds, Vector3(0.0f, 0.0f, 10.0f), 1.0f);
+    bvh.Build(bounds);
+    CHECK(bvh.GetNumNodes() == 1);
+    sQueriesCheck(bvh, bounds, sFrustum(100.0f), Vector3(), 1.0f);
+}
+
+int main()
+{
+    sTestEmpty();
+    sTestRandom();
+    sTestDegenerate();
+    printf("BVHTest passed\n");
+    return 0;
+}
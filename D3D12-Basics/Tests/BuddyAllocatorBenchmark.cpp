@@ -0,0 +1,67 @@
+#include "Test.h"
+
+#include "Generic/BuddyAllocator.h"
+
+#include <random>
+#include <vector>
+
+#define HEAP_SIZE _64MB
+#define MIN_BLOCK_SIZE _64KB
+#define NUM_LIVE 128
+#define NUM_ITERATIONS 1000000
+
+// Steady state churn through one heap, with sizes like the textures and buffers Scene::Load creates. Reports the cost of an
+// allocate and free pair, and the stats GPUMemoryAllocator::GetStats would show for the heap at the end.
+int main()
+{
+    BuddyAllocator allocator(HEAP_SIZE, MIN_BLOCK_SIZE);
+    std::mt19937 rng(1);
+
+    std::vector<uint64> sizes(NUM_ITERATIONS);
+    for (uint64& size : sizes)
+    {
+        size = 1 + rng() % ((rng() % 32) == 0 ? _MB(2) : _KB(128));
+    }
+
+    std::vector<uint64> live;
+    std::vector<uint64> liveSizes;
+    uint64 bytesRequested = 0;
+    uint32 numFailed = 0;
+
+    Timer timer;
+    for (uint32 i = 0; i < NUM_ITERATIONS; i++)
+    {
+        if (live.size() == NUM_LIVE)
+        {
+            size_t index = rng() % live.size();
+            allocator.Free(live[index]);
+            bytesRequested -= liveSizes[index];
+            live[index] = live.back();
+            live.pop_back();
+            liveSizes[index] = liveSizes.back();
+            liveSizes.pop_back();
+        }
+
+        uint64 offset;
+        if (allocator.Allocate(sizes[i], offset))
+        {
+            live.push_back(offset);
+            liveSizes.push_back(sizes[i]);
+            bytesRequested += sizes[i];
+        }
+        else
+        {
+            numFailed++;
+        }
+    }
+    double ms = timer.ElapsedMs();
+
+    printf("%u allocate/free pairs in %.1fms, %.1fns each, %u failed\n", NUM_ITERATIONS, ms, ms * 1e6 / NUM_ITERATIONS, numFailed);
+    printf("%u allocations, %.1fMB allocated for %.1fMB requested, largest free block %.1fMB, fragmentation %.2f\n",
+        allocator.GetAllocationCount(),
+        allocator.GetAllocatedSize() / (1024.0 * 1024.0),
+        bytesRequested / (1024.0 * 1024.0),
+        allocator.GetLargestFreeBlock() / (1024.0 * 1024.0),
+        allocator.GetFragmentation());
+    return 0;
+}
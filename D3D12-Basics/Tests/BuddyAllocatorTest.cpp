@@ -0,0 +1,148 @@
+#include "Test.h"
+
+#include "Generic/BuddyAllocator.h"
+
+#include <random>
+#include <vector>
+
+#define HEAP_SIZE _64MB
+#define MIN_BLOCK_SIZE _64KB
+
+// Splits, merges and the stats GPUMemoryAllocator::GetStats reports for each heap
+static void sTestStats()
+{
+    BuddyAllocator allocator(HEAP_SIZE, MIN_BLOCK_SIZE);
+    CHECK(allocator.IsEmpty());
+    CHECK(allocator.GetLargestFreeBlock() == HEAP_SIZE);
+    CHECK(allocator.GetFragmentation() == 0.0f);
+
+    // Rounded up to a power of two, so 3MB takes a 4MB block and anything under the minimum takes a whole minimum block
+    CHECK(allocator.GetAllocationSize(_MB(3)) == _MB(4));
+    CHECK(allocator.GetAllocationSize(1) == MIN_BLOCK_SIZE);
+
+    uint64 a, b, c;
+    CHECK(allocator.Allocate(_MB(3), a));
+    CHECK(allocator.Allocate(1, b));
+    CHECK(allocator.Allocate(_MB(16), c));
+    CHECK(allocator.GetAllocationCount() == 3);
+    CHECK(allocator.GetAllocatedSize() == _MB(4) + MIN_BLOCK_SIZE + _MB(16));
+
+    // Every block is aligned to its size
+    CHECK((a % _MB(4)) == 0 && (b % MIN_BLOCK_SIZE) == 0 && (c % _MB(16)) == 0);
+
+    // Lowest blocks are split first, so the top 32MB half is still whole
+    CHECK(allocator.GetLargestFreeBlock() == _MB(32));
+    uint64 freeSize = HEAP_SIZE - allocator.GetAllocatedSize();
+    CHECK(allocator.GetFragmentation() == 1.0f - (float)_MB(32) / (float)freeSize);
+
+    allocator.Free(b);
+    allocator.Free(a);
+    CHECK(allocator.GetAllocatedSize() == _MB(16));
+    allocator.Free(c);
+
+    // Everything merges back into the one block
+    CHECK(allocator.IsEmpty());
+    CHECK(allocator.GetAllocatedSize() == 0);
+    CHECK(allocator.GetLargestFreeBlock() == HEAP_SIZE);
+    CHECK(allocator.GetFragmentation() == 0.0f);
+}
+
+static void sTestExhaustion()
+{
+    BuddyAllocator allocator(HEAP_SIZE, MIN_BLOCK_SIZE);
+
+    uint64 offset;
+    CHECK(!allocator.Allocate(0, offset));
+    CHECK(!allocator.Allocate(HEAP_SIZE + 1, offset));
+
+    std::vector<uint64> offsets;
+    while (allocator.Allocate(MIN_BLOCK_SIZE, offset))
+    {
+        offsets.push_back(offset);
+    }
+    CHECK(offsets.size() == HEAP_SIZE / MIN_BLOCK_SIZE);
+    CHECK(allocator.GetLargestFreeBlock() == 0);
+    CHECK(allocator.GetFragmentation() == 0.0f);
+
+    // Freeing every other block leaves half the heap free, but nothing bigger than one block
+    for (size_t i = 0; i < offsets.size(); i += 2)
+    {
+        allocator.Free(offsets[i]);
+    }
+    CHECK(allocator.GetLargestFreeBlock() == MIN_BLOCK_SIZE);
+    CHECK(!allocator.Allocate(MIN_BLOCK_SIZE * 2, offset));
+    CHECK(allocator.GetFragmentation() == 1.0f - (float)MIN_BLOCK_SIZE / (float)(HEAP_SIZE / 2));
+
+    for (size_t i = 1; i < offsets.size(); i += 2)
+    {
+        allocator.Free(offsets[i]);
+    }
+    CHECK(allocator.IsEmpty());
+    CHECK(allocator.GetLargestFreeBlock() == HEAP_SIZE);
+}
+
+// Random allocations and frees, checked against a map of which minimum blocks are in use
+static void sTestRandom()
+{
+    BuddyAllocator allocator(HEAP_SIZE, MIN_BLOCK_SIZE);
+    std::vector<bool> used(HEAP_SIZE / MIN_BLOCK_SIZE, false);
+    std::vector<std::pair<uint64, uint64>> live;
+    std::mt19937 rng(5);
+    uint64 allocatedSize = 0;
+
+    for (uint32 i = 0; i < 100000; i++)
+    {
+        if ((rng() & 1) && !live.empty())
+        {
+            size_t index = rng() % live.size();
+            std::pair<uint64, uint64> alloc = live[index];
+            live[index] = live.back();
+            live.pop_back();
+
+            allocator.Free(alloc.first);
+            allocatedSize -= alloc.second;
+            for (uint64 block = alloc.first / MIN_BLOCK_SIZE; block < (alloc.first + alloc.second) / MIN_BLOCK_SIZE; block++)
+            {
+                used[block] = false;
+            }
+        }
+        else
+        {
+            uint64 size = 1 + rng() % ((rng() % 20) == 0 ? _MB(8) : _KB(300));
+            uint64 offset;
+            if (allocator.Allocate(size, offset))
+            {
+                uint64 blockSize = allocator.GetAllocationSize(size);
+                CHECK((offset % blockSize) == 0);
+                for (uint64 block = offset / MIN_BLOCK_SIZE; block < (offset + blockSize) / MIN_BLOCK_SIZE; block++)
+                {
+                    CHECK(!used[block]);
+                    used[block] = true;
+                }
+                live.push_back({ offset, blockSize });
+                allocatedSize += blockSize;
+            }
+        }
+
+        CHECK(allocator.GetAllocatedSize() == allocatedSize);
+        CHECK(allocator.GetAllocationCount() == live.size());
+        float fragmentation = allocator.GetFragmentation();
+        CHECK(fragmentation >= 0.0f && fragmentation < 1.0f);
+    }
+
+    for (const std::pair<uint64, uint64>& alloc : live)
+    {
+        allocator.Free(alloc.first);
+    }
+    CHECK(allocator.IsEmpty());
+    CHECK(allocator.GetLargestFreeBlock() == HEAP_SIZE);
+}
+
+int main()
+{
+    sTestStats();
+    sTestExhaustion();
+    sTestRandom();
+    printf("BuddyAllocatorTest passed\n");
+    return 0;
+}
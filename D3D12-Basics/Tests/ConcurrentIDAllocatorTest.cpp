@@ -0,0 +1,222 @@
+#include "Test.h"
+
+#include "Generic/ConcurrentIDAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Same as D3D12Core.h's, which can't be included without D3D
+enum BindlessTextureSlot : int32
+{
+    BindlessTextureSlotInvalid = -1
+};
+
+// SRV_MAX_ALLOCATED, the size of the persistent region
+#define BINDLESS_TEXTURE_CAPACITY 4096
+
+// Every slot in the region is handed out once before any are reused, and freed slots come back before new ones
+static void sTestBindlessSlots()
+{
+    ConcurrentIDAllocator<BindlessTextureSlot> allocator(BindlessTextureSlot(0), BINDLESS_TEXTURE_CAPACITY);
+
+    std::vector<BindlessTextureSlot> slots;
+    for (uint32 i = 0; i < BINDLESS_TEXTURE_CAPACITY; i++)
+    {
+        BindlessTextureSlot slot = allocator.AllocID();
+        CHECK(slot == (BindlessTextureSlot)i);
+        slots.push_back(slot);
+    }
+
+    // Freed slots are reused most recent first
+    allocator.FreeID(slots[10]);
+    allocator.FreeID(slots[20]);
+    CHECK(allocator.AllocID() == slots[20]);
+    CHECK(allocator.AllocID() == slots[10]);
+}
+
+// Textures created and destroyed over many frames, like streaming in and out of a scene. Destroys are deferred a few frames as they are
+// by DeferredDestroysProcess. Live textures never share a slot, and the slots used never run past the live peak.
+static void sTestBindlessSlotRecycling()
+{
+    const uint32 framesInFlight = 3;
+    const uint32 maxLive = 1000;
+
+    ConcurrentIDAllocator<BindlessTextureSlot> allocator(BindlessTextureSlot(0), BINDLESS_TEXTURE_CAPACITY);
+    std::vector<bool> used(BINDLESS_TEXTURE_CAPACITY, false);
+    std::vector<BindlessTextureSlot> live;
+    std::vector<std::vector<BindlessTextureSlot>> pendingDestroys(framesInFlight);
+    std::mt19937 rng(3);
+    int32 highestSlot = -1;
+    uint32 peakHeld = 0;
+
+    for (uint32 frame = 0; frame < 10000; frame++)
+    {
+        // Whatever was destroyed framesInFlight frames ago is finished with on the GPU
+        std::vector<BindlessTextureSlot>& retired = pendingDestroys[frame % framesInFlight];
+        for (BindlessTextureSlot slot : retired)
+        {
+            CHECK(used[slot]);
+            used[slot] = false;
+            allocator.FreeID(slot);
+        }
+        retired.clear();
+
+        uint32 numCreates = rng() % 8;
+        for (uint32 i = 0; i < numCreates && live.size() < maxLive; i++)
+        {
+            BindlessTextureSlot slot = allocator.AllocID();
+            CHECK(slot >= 0 && slot < BINDLESS_TEXTURE_CAPACITY);
+            CHECK(!used[slot]);
+            used[slot] = true;
+            live.push_back(slot);
+            highestSlot = std::max(highestSlot, (int32)slot);
+        }
+
+        uint32 numDestroys = rng() % 8;
+        for (uint32 i = 0; i < numDestroys && !live.empty(); i++)
+        {
+            size_t index = rng() % live.size();
+            retired.push_back(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        uint32 numHeld = (uint32)live.size();
+        for (const std::vector<BindlessTextureSlot>& pending : pendingDestroys)
+        {
+            numHeld += (uint32)pending.size();
+        }
+        peakHeld = std::max(peakHeld, numHeld);
+    }
+
+    // Freed slots are always reused before new ones, so the region only grows as far as the most slots ever held at once
+    CHECK((uint32)highestSlot < peakHeld);
+}
+
+// Threads creating and destroying textures at once, as scene loading does from the job system
+static void sTestConcurrentRecycling()
+{
+    const uint32 numThreads = 8;
+    const uint32 slotsPerThread = BINDLESS_TEXTURE_CAPACITY / numThreads;
+
+    ConcurrentIDAllocator<BindlessTextureSlot> allocator(BindlessTextureSlot(0), BINDLESS_TEXTURE_CAPACITY);
+    std::vector<std::atomic<uint32>> owners(BINDLESS_TEXTURE_CAPACITY);
+    for (std::atomic<uint32>& owner : owners)
+    {
+        owner.store(0);
+    }
+    std::atomic<bool> failed(false);
+
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            std::mt19937 rng(t);
+            std::vector<BindlessTextureSlot> held;
+            for (uint32 i = 0; i < 200000; i++)
+            {
+                if (held.size() < slotsPerThread && (held.empty() || (rng() & 1)))
+                {
+                    BindlessTextureSlot slot = allocator.AllocID();
+                    uint32 expected = 0;
+                    if (slot < 0 || slot >= BINDLESS_TEXTURE_CAPACITY || !owners[slot].compare_exchange_strong(expected, t + 1))
+                    {
+                        failed = true;
+                        return;
+                    }
+                    held.push_back(slot);
+                }
+                else
+                {
+                    size_t index = rng() % held.size();
+                    BindlessTextureSlot slot = held[index];
+                    held[index] = held.back();
+                    held.pop_back();
+                    owners[slot].store(0);
+                    allocator.FreeID(slot);
+                }
+            }
+            for (BindlessTextureSlot slot : held)
+            {
+                owners[slot].store(0);
+                allocator.FreeID(slot);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+
+    // Everything went back, so the whole region can be taken again without any slot coming up twice
+    std::vector<bool> seen(BINDLESS_TEXTURE_CAPACITY, false);
+    for (uint32 i = 0; i < BINDLESS_TEXTURE_CAPACITY; i++)
+    {
+        BindlessTextureSlot slot = allocator.AllocID();
+        CHECK(slot >= 0 && slot < BINDLESS_TEXTURE_CAPACITY);
+        CHECK(!seen[slot]);
+        seen[slot] = true;
+    }
+}
+
+// Running out gives the invalid slot rather than one past the region, however many threads are asking
+static void sTestExhaustion()
+{
+    const uint32 numThreads = 8;
+
+    ConcurrentIDAllocator<BindlessTextureSlot> allocator(BindlessTextureSlot(1), BINDLESS_TEXTURE_CAPACITY - 1);
+    std::vector<std::atomic<uint32>> taken(BINDLESS_TEXTURE_CAPACITY);
+    for (std::atomic<uint32>& count : taken)
+    {
+        count.store(0);
+    }
+    std::atomic<uint32> numInvalid(0);
+    std::atomic<bool> failed(false);
+
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (uint32 i = 0; i < BINDLESS_TEXTURE_CAPACITY; i++)
+            {
+                BindlessTextureSlot slot = allocator.AllocID();
+                if (slot == BindlessTextureSlotInvalid)
+                {
+                    numInvalid++;
+                }
+                else if (slot < 1 || slot >= BINDLESS_TEXTURE_CAPACITY || taken[slot]++ != 0)
+                {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+    CHECK(numInvalid == numThreads * BINDLESS_TEXTURE_CAPACITY - (BINDLESS_TEXTURE_CAPACITY - 1));
+
+    // Still out, until one comes back
+    CHECK(allocator.AllocID() == BindlessTextureSlotInvalid);
+    allocator.FreeID(BindlessTextureSlot(7));
+    CHECK(allocator.AllocID() == BindlessTextureSlot(7));
+    CHECK(allocator.AllocID() == BindlessTextureSlotInvalid);
+}
+
+int main()
+{
+    sTestBindlessSlots();
+    sTestExhaustion();
+    sTestBindlessSlotRecycling();
+    sTestConcurrentRecycling();
+    printf("ConcurrentIDAllocatorTest passed\n");
+    return 0;
+}
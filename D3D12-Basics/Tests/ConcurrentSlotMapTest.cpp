@@ -0,0 +1,170 @@
+#include "Test.h"
+
+#include "Generic/ConcurrentSlotMap.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+enum TestHandle : int32
+{
+    TestHandleInvalid = -1
+};
+
+struct TestValue
+{
+    uint32 owner = 0;
+    uint32 serial = 0;
+};
+
+typedef ConcurrentSlotMap<TestHandle, TestValue> TestMap;
+
+static void sTestBasics()
+{
+    TestMap map(4);
+
+    TestHandle a = map.Insert({ 1, 1 });
+    TestHandle b = map.Insert({ 2, 2 });
+    CHECK(a != TestHandleInvalid && b != TestHandleInvalid && a != b);
+    CHECK(map.Contains(a) && map.Get(a).serial == 1);
+    CHECK(map[b].serial == 2);
+    CHECK(!map.Contains(TestHandleInvalid));
+
+    // The slot is reused, but under a new generation so the old handle is caught
+    map.Remove(a);
+    CHECK(!map.Contains(a));
+    TestHandle c = map.Insert({ 3, 3 });
+    typedef SlotMap<TestHandle, TestValue> HandleLayout;
+    CHECK(HandleLayout::GetIndex(c) == HandleLayout::GetIndex(a));
+    CHECK(c != a && !map.Contains(a) && map.Contains(c));
+    CHECK(map[c].serial == 3);
+}
+
+// Inserts fail once every slot is taken, and work again once one is freed
+static void sTestExhaustion()
+{
+    const uint32 capacity = 100;
+    TestMap map(capacity);
+
+    std::vector<TestHandle> handles;
+    for (uint32 i = 0; i < capacity; i++)
+    {
+        TestHandle handle = map.Insert({ 0, i });
+        CHECK(handle != TestHandleInvalid);
+        handles.push_back(handle);
+    }
+    CHECK(map.Insert({}) == TestHandleInvalid);
+    CHECK(map.Insert({}) == TestHandleInvalid);
+
+    map.Remove(handles[50]);
+    TestHandle handle = map.Insert({ 0, 1000 });
+    CHECK(handle != TestHandleInvalid && map[handle].serial == 1000);
+    CHECK(map.Insert({}) == TestHandleInvalid);
+
+    for (uint32 i = 0; i < capacity; i++)
+    {
+        if (i != 50)
+        {
+            CHECK(map[handles[i]].serial == i);
+        }
+    }
+}
+
+// Threads inserting, reading and removing at once with the map close to full, as loading a scene on the job system while another is
+// unloaded does. Every handle has to find the value it was inserted with, no live handle can be shared and a full map only fails the
+// insert.
+static void sTestStress()
+{
+    const uint32 numThreads = 8;
+    const uint32 capacity = 1024;
+    const uint32 maxHeldPerThread = 160;
+
+    TestMap map(capacity);
+    std::atomic<bool> failed(false);
+    std::atomic<uint32> numFull(0);
+
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            std::mt19937 rng(t);
+            std::vector<std::pair<TestHandle, uint32>> held;
+            for (uint32 serial = 0; serial < 200000; serial++)
+            {
+                if (held.size() < maxHeldPerThread && (rng() % 3) != 0)
+                {
+                    TestHandle handle = map.Insert({ t, serial });
+                    if (handle == TestHandleInvalid)
+                    {
+                        numFull++;
+                        continue;
+                    }
+                    held.push_back({ handle, serial });
+                }
+                else if (!held.empty())
+                {
+                    size_t index = rng() % held.size();
+                    std::pair<TestHandle, uint32> entry = held[index];
+                    held[index] = held.back();
+                    held.pop_back();
+
+                    if (!map.Contains(entry.first) || map[entry.first].owner != t || map[entry.first].serial != entry.second)
+                    {
+                        failed = true;
+                        return;
+                    }
+                    map.Remove(entry.first);
+                    if (map.Contains(entry.first))
+                    {
+                        failed = true;
+                        return;
+                    }
+                }
+
+                // Check one of ours at random, any other thread's insert into the same slot would show up here
+                if (!held.empty())
+                {
+                    const std::pair<TestHandle, uint32>& entry = held[rng() % held.size()];
+                    const TestValue& value = map[entry.first];
+                    if (value.owner != t || value.serial != entry.second)
+                    {
+                        failed = true;
+                        return;
+                    }
+                }
+            }
+
+            for (const std::pair<TestHandle, uint32>& entry : held)
+            {
+                map.Remove(entry.first);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+
+    // 8 threads can hold up to 1280 between them, so some inserts should have found the map full
+    printf("%u inserts found the map full\n", numFull.load());
+    CHECK(numFull > 0);
+
+    // Everything was removed, so every slot can be taken again
+    for (uint32 i = 0; i < capacity; i++)
+    {
+        CHECK(map.Insert({}) != TestHandleInvalid);
+    }
+    CHECK(map.Insert({}) == TestHandleInvalid);
+}
+
+int main()
+{
+    sTestBasics();
+    sTestExhaustion();
+    sTestStress();
+    printf("ConcurrentSlotMapTest passed\n");
+    return 0;
+}
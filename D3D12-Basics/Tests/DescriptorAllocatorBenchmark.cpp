@@ -0,0 +1,97 @@
+#include "Test.h"
+
+#include "Generic/PagedOffsetAllocator.h"
+
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// CPU_DESCRIPTOR_PAGE_SIZE
+#define PAGE_SIZE 1024
+#define NUM_LIVE_PER_THREAD 512
+#define NUM_OPERATIONS 2000000
+
+// DescriptorAllocator without the heaps, which is everything it does under its lock
+class DescriptorAllocatorCore
+{
+public:
+    DescriptorAllocatorCore() :
+        m_allocator(PAGE_SIZE) {}
+
+    void Allocate(uint32 count, int32& pageOut, uint32& offsetOut)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allocator.Allocate(count, pageOut, offsetOut);
+    }
+
+    void Free(int32 page, uint32 offset, uint32 count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allocator.Free(page, offset, count);
+    }
+
+    void GetStats(uint32& numPagesOut, uint32& usedOut, uint32& freeOut)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allocator.GetStats(numPagesOut, usedOut, freeOut);
+    }
+
+private:
+    PagedOffsetAllocator m_allocator;
+    std::mutex m_mutex;
+};
+
+// Each thread keeps NUM_LIVE_PER_THREAD texture views alive and replaces a random one at a time, as streaming textures in and out does.
+// NUM_OPERATIONS allocate/free pairs are split between the threads.
+static void sRun(uint32 numThreads)
+{
+    DescriptorAllocatorCore allocator;
+
+    Timer timer;
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&allocator, numThreads, t]()
+        {
+            std::mt19937 rng(t);
+            std::vector<std::pair<int32, uint32>> live(NUM_LIVE_PER_THREAD);
+            for (std::pair<int32, uint32>& alloc : live)
+            {
+                allocator.Allocate(1, alloc.first, alloc.second);
+            }
+
+            for (uint32 i = 0; i < NUM_OPERATIONS / numThreads; i++)
+            {
+                std::pair<int32, uint32>& alloc = live[rng() % NUM_LIVE_PER_THREAD];
+                allocator.Free(alloc.first, alloc.second, 1);
+                allocator.Allocate(1, alloc.first, alloc.second);
+            }
+
+            for (std::pair<int32, uint32>& alloc : live)
+            {
+                allocator.Free(alloc.first, alloc.second, 1);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    double ms = timer.ElapsedMs();
+
+    uint32 numPages, used, free;
+    allocator.GetStats(numPages, used, free);
+    printf("%u threads: %.1fms, %.1fns per allocate/free pair, %.1fM pairs/s, %u pages left\n",
+        numThreads, ms, ms * 1e6 / NUM_OPERATIONS, NUM_OPERATIONS / (ms * 1e3), numPages);
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    for (uint32 numThreads = 1; numThreads <= 8; numThreads *= 2)
+    {
+        sRun(numThreads);
+    }
+    return 0;
+}
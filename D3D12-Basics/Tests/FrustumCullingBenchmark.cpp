@@ -0,0 +1,89 @@
+#include "Test.h"
+
+#include "Renderer/FrustumCulling.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Every run culls about this many objects in total, however many there are per call
+#define NUM_OBJECTS_CULLED 20000000
+
+// Same camera as OcclusionCullingTest, at the origin looking down +z, 90 degrees across
+static Frustum sFrustum(
+    void)
+{
+    const float nearPlane = 0.1f;
+    const float farPlane = 1000.0f;
+
+    Matrix4x4 matViewProj;
+    matViewProj._33 = farPlane / (farPlane - nearPlane);
+    matViewProj._34 = -nearPlane * farPlane / (farPlane - nearPlane);
+    matViewProj._43 = 1.0f;
+    matViewProj._44 = 0.0f;
+
+    Frustum frustum;
+    Frustum::FromViewProj(matViewProj, frustum);
+    return frustum;
+}
+
+// Objects per ms through CullScalar on its own and through Cull, which does as much as it can SIMD. The build decides whether that's
+// SSE or AVX2, the same way it does in the engine.
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+#if defined(__AVX2__)
+    printf("Cull is using AVX2, 8 lanes\n");
+#else
+    printf("Cull is using SSE, 4 lanes\n");
+#endif
+    printf("objects  visible  CullScalar       Cull  speedup  (objects per ms)\n");
+
+    Frustum frustum = sFrustum();
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 10.0f);
+
+    for (uint32 numObjects : { 1000u, 10000u, 100000u, 1000000u })
+    {
+        CullingBounds bounds;
+        for (uint32 i = 0; i < numObjects; i++)
+        {
+            Vector3 centre(position(rng), position(rng), position(rng));
+            Vector3 halfSize(extent(rng), extent(rng), extent(rng));
+            bounds.Add(centre - halfSize, centre + halfSize, centre, sqrtf(halfSize.Dot(halfSize)));
+        }
+
+        std::vector<uint32> visible(numObjects);
+        uint32 numRepeats = std::max(NUM_OBJECTS_CULLED / numObjects, 1u);
+
+        // Best of a few runs of numRepeats calls each
+        double scalarMs = 1e30;
+        double simdMs = 1e30;
+        uint32 numScalarVisible = 0;
+        uint32 numVisible = 0;
+        for (uint32 run = 0; run < 3; run++)
+        {
+            Timer scalarTimer;
+            for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+            {
+                numScalarVisible = FrustumCulling::CullScalar(frustum, bounds, 0, numObjects, visible.data());
+            }
+            scalarMs = std::min(scalarMs, scalarTimer.ElapsedMs());
+
+            Timer simdTimer;
+            for (uint32 repeat = 0; repeat < numRepeats; repeat++)
+            {
+                numVisible = FrustumCulling::Cull(frustum, bounds, visible.data());
+            }
+            simdMs = std::min(simdMs, simdTimer.ElapsedMs());
+        }
+        CHECK(numVisible == numScalarVisible);
+
+        double scalarRate = (double)numObjects * numRepeats / scalarMs;
+        double simdRate = (double)numObjects * numRepeats / simdMs;
+        printf("%7u  %7u  %10.0f  %9.0f  %6.2fx\n", numObjects, numVisible, scalarRate, simdRate, simdRate / scalarRate);
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "Test.h"
+
+#include "Renderer/FrustumCulling.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Column vector view projection with depth from 0 to w for a camera at eye, turned by yaw about y then pitch about x from looking
+// down +z
+static Matrix4x4 sViewProj(
+    const Vector3& eye,
+    float yaw,
+    float pitch,
+    float fovY,
+    float aspect,
+    float nearPlane,
+    float farPlane)
+{
+    // Rows are the camera's right, up and forward axes in world space
+    float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+    Vector3 right(cy, 0.0f, -sy);
+    Vector3 up(sy * sp, cp, cy * sp);
+    Vector3 forward(sy * cp, -sp, cy * cp);
+
+    Matrix4x4 matView(
+        right.x, right.y, right.z, -right.Dot(eye),
+        up.x, up.y, up.z, -up.Dot(eye),
+        forward.x, forward.y, forward.z, -forward.Dot(eye),
+        0.0f, 0.0f, 0.0f, 1.0f);
+
+    float yScale = 1.0f / tanf(fovY * 0.5f);
+    Matrix4x4 matProj(
+        yScale / aspect, 0.0f, 0.0f, 0.0f,
+        0.0f, yScale, 0.0f, 0.0f,
+        0.0f, 0.0f, farPlane / (farPlane - nearPlane), -nearPlane * farPlane / (farPlane - nearPlane),
+        0.0f, 0.0f, 1.0f, 0.0f);
+
+    return matProj * matView;
+}
+
+// Cull on every count up to a few groups of lanes (whatever CULL_LANES is) and some bigger ones, so the SIMD path and the scalar
+// remainder both run on their own and together. It has to find exactly what CullScalar does, in the same order, without writing
+// past the end of the output.
+static void sCullCheck(
+    const Frustum& frustum,
+    const CullingBounds& allBounds,
+    uint32& numVisibleTotal,
+    uint32& numTestedTotal)
+{
+    std::vector<uint32> counts;
+    for (uint32 count = 0; count <= 35; count++)
+    {
+        counts.push_back(count);
+    }
+    for (uint32 count : { 1000u, 1001u, 1007u, allBounds.Size() })
+    {
+        counts.push_back(count);
+    }
+
+    const uint32 sentinel = 0xDEADBEEF;
+    for (uint32 count : counts)
+    {
+        CullingBounds bounds = allBounds;
+        for (std::vector<float>* pArray : { &bounds.boxCentreX, &bounds.boxCentreY, &bounds.boxCentreZ, &bounds.boxExtentX,
+            &bounds.boxExtentY, &bounds.boxExtentZ, &bounds.sphereCentreX, &bounds.sphereCentreY, &bounds.sphereCentreZ,
+            &bounds.sphereRadius })
+        {
+            pArray->resize(count);
+        }
+
+        std::vector<uint32> expected(count + 1, sentinel);
+        std::vector<uint32> visible(count + 1, sentinel);
+        uint32 numExpected = FrustumCulling::CullScalar(frustum, bounds, 0, count, expected.data());
+        uint32 numVisible = FrustumCulling::Cull(frustum, bounds, visible.data());
+
+        CHECK(numVisible == numExpected);
+        for (uint32 i = 0; i < numVisible; i++)
+        {
+            CHECK(visible[i] == expected[i]);
+            CHECK(i == 0 || visible[i] > visible[i - 1]);
+        }
+        CHECK(visible[count] == sentinel);
+
+        numVisibleTotal += numVisible;
+        numTestedTotal += count;
+    }
+}
+
+// Boxes and spheres scattered around and through the frustum, lots of them crossing its planes, seen from random cameras
+static void sTestRandom(
+    void)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> extent(0.01f, 5.0f);
+    std::uniform_real_distribution<float> angle(-F_PI, F_PI);
+    std::uniform_real_distribution<float> fov(20.0f * F_DEG_TO_RAD, 120.0f * F_DEG_TO_RAD);
+
+    uint32 numVisible = 0;
+    uint32 numTested = 0;
+    for (uint32 camera = 0; camera < 50; camera++)
+    {
+        Vector3 eye(unit(rng) * 50.0f, unit(rng) * 50.0f, unit(rng) * 50.0f);
+        float farPlane = 20.0f + 200.0f * (unit(rng) + 1.0f);
+        Frustum frustum;
+        Frustum::FromViewProj(sViewProj(eye, angle(rng), angle(rng) * 0.5f, fov(rng), 1.0f + unit(rng) * 0.5f, 0.1f, farPlane), frustum);
+
+        CullingBounds bounds;
+        for (uint32 i = 0; i < 5000; i++)
+        {
+            Vector3 centre = eye + Vector3(unit(rng), unit(rng), unit(rng)) * 100.0f;
+            Vector3 halfSize(extent(rng), extent(rng), extent(rng));
+            // Sphere around the box, sometimes tighter than its corners like a mesh's would be
+            float radius = sqrtf(halfSize.Dot(halfSize)) * (0.6f + 0.4f * (unit(rng) + 1.0f) * 0.5f);
+            bounds.Add(centre - halfSize, centre + halfSize, centre, radius);
+        }
+
+        // Points which sit exactly on a plane, so the comparisons tie
+        for (uint32 plane = 0; plane < FrustumPlaneCount; plane++)
+        {
+            const Vector4& p = frustum.planes[plane];
+            Vector3 onPlane(-p.x * p.w, -p.y * p.w, -p.z * p.w);
+            bounds.Add(onPlane, onPlane, onPlane, 0.0f);
+        }
+
+        sCullCheck(frustum, bounds, numVisible, numTested);
+    }
+
+    // Both answers have to be exercised
+    printf("%u of %u bounds visible\n", numVisible, numTested);
+    CHECK(numVisible > numTested / 20 && numVisible < numTested - numTested / 20);
+}
+
+// Everything inside, everything outside, and nothing at all
+static void sTestAllOrNothing(
+    void)
+{
+    Frustum frustum;
+    Frustum::FromViewProj(sViewProj(Vector3(), 0.0f, 0.0f, 90.0f * F_DEG_TO_RAD, 1.0f, 0.1f, 100.0f), frustum);
+
+    CullingBounds inside;
+    CullingBounds outside;
+    for (uint32 i = 0; i < 37; i++)
+    {
+        Vector3 centre(0.0f, 0.0f, 10.0f + i);
+        inside.Add(centre - Vector3(1, 1, 1), centre + Vector3(1, 1, 1), centre, 1.0f);
+        centre.z = -10.0f - i;
+        outside.Add(centre - Vector3(1, 1, 1), centre + Vector3(1, 1, 1), centre, 1.0f);
+    }
+
+    std::vector<uint32> visible(38);
+    CHECK(FrustumCulling::Cull(frustum, inside, visible.data()) == 37);
+    for (uint32 i = 0; i < 37; i++)
+    {
+        CHECK(visible[i] == i);
+    }
+    CHECK(FrustumCulling::Cull(frustum, outside, visible.data()) == 0);
+    CHECK(FrustumCulling::Cull(frustum, CullingBounds(), visible.data()) == 0);
+}
+
+int main()
+{
+    sTestAllOrNothing();
+    sTestRandom();
+
+    printf("FrustumCullingTest passed\n");
+    return 0;
+}
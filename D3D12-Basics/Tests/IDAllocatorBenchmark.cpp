@@ -0,0 +1,124 @@
+#include "Test.h"
+
+#include "Generic/ConcurrentIDAllocator.h"
+#include "Generic/IDAllocator.h"
+
+#include <list>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define NUM_LIVE 4096
+#define NUM_OPERATIONS 20000000
+#define MAX_BURST 256u
+
+enum BenchmarkID : int32
+{
+    BenchmarkIDInvalid = -1
+};
+
+// IDAllocator as it was before SimpleDequeue became a ring buffer, allocating a node for every freed ID. std::list does the same.
+class NodeIDAllocator
+{
+public:
+    NodeIDAllocator(BenchmarkID initialID) :
+        m_nextID(initialID) {}
+
+    BenchmarkID AllocID()
+    {
+        if (!m_unusedIDs.empty())
+        {
+            BenchmarkID id = m_unusedIDs.back();
+            m_unusedIDs.pop_back();
+            return id;
+        }
+        return (BenchmarkID)(m_nextID++);
+    }
+
+    void FreeID(BenchmarkID id)
+    {
+        m_unusedIDs.push_back(id);
+    }
+
+private:
+    std::list<BenchmarkID> m_unusedIDs;
+    int32 m_nextID;
+};
+
+// Keeps NUM_LIVE IDs allocated and churns through NUM_OPERATIONS frees and allocations. Each step frees a run of random live IDs and
+// then allocates the same number back, like a scene's resources being replaced. Bursts of one stay within the inline freed IDs,
+// longer ones have to go to the heap. Returns ns per operation.
+template <typename Allocator>
+static double sChurn(
+    Allocator& allocator,
+    uint32 maxBurst)
+{
+    std::vector<BenchmarkID> live(NUM_LIVE);
+    for (BenchmarkID& id : live)
+    {
+        id = allocator.AllocID();
+    }
+
+    // Random numbers are made up front so only the allocator is timed
+    std::mt19937 rng(1);
+    std::vector<uint32> bursts;
+    std::vector<uint32> indices;
+    for (uint32 numOperations = 0; numOperations < NUM_OPERATIONS; )
+    {
+        uint32 burst = 1 + rng() % maxBurst;
+        bursts.push_back(burst);
+        for (uint32 i = 0; i < burst; i++)
+        {
+            indices.push_back(rng() % NUM_LIVE);
+        }
+        numOperations += burst * 2;
+    }
+
+    Timer timer;
+    uint32 next = 0;
+    uint32 numOperations = 0;
+    for (uint32 burst : bursts)
+    {
+        // Frees swap the freed ID to the end of live, so the allocations below can refill the tail
+        for (uint32 i = 0; i < burst; i++)
+        {
+            uint32 index = indices[next + i] % (NUM_LIVE - i);
+            allocator.FreeID(live[index]);
+            std::swap(live[index], live[NUM_LIVE - 1 - i]);
+        }
+        for (uint32 i = 0; i < burst; i++)
+        {
+            live[NUM_LIVE - burst + i] = allocator.AllocID();
+        }
+        next += burst;
+        numOperations += burst * 2;
+    }
+    double ms = timer.ElapsedMs();
+
+    // Every live ID has to still be distinct
+    std::vector<bool> seen(NUM_LIVE + MAX_BURST, false);
+    for (BenchmarkID id : live)
+    {
+        CHECK((uint32)id < seen.size() && !seen[id]);
+        seen[id] = true;
+    }
+    return ms * 1e6 / numOperations;
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    printf("max burst  node dequeue  IDAllocator  ConcurrentIDAllocator  (ns per alloc or free, %u live IDs)\n", NUM_LIVE);
+    for (uint32 maxBurst : { 1u, 16u, MAX_BURST })
+    {
+        NodeIDAllocator nodeAllocator((BenchmarkID)0);
+        IDAllocator<BenchmarkID> allocator((BenchmarkID)0);
+        ConcurrentIDAllocator<BenchmarkID> concurrentAllocator((BenchmarkID)0, NUM_LIVE + MAX_BURST);
+
+        double nodeNs = sChurn(nodeAllocator, maxBurst);
+        double ns = sChurn(allocator, maxBurst);
+        double concurrentNs = sChurn(concurrentAllocator, maxBurst);
+        printf("%9u  %12.1f  %11.1f  %21.1f\n", maxBurst, nodeNs, ns, concurrentNs);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "Test.h"
+
+#include "Generic/JobSystem.h"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#define NUM_ELEMENTS (1 << 20)
+#define NUM_REPEATS 20
+#define NUM_EMPTY_JOBS 1000000
+
+// Stands in for culling or transforming one object, enough arithmetic that it isn't bound by memory
+static float sWork(
+    float x)
+{
+    for (uint32 i = 0; i < 16; i++)
+    {
+        x = x * 0.999f + sqrtf(x + 1.0f);
+    }
+    return x;
+}
+
+static double sParallelForMs(
+    JobSystem& jobSystem,
+    std::vector<float>& values,
+    uint32 grainSize)
+{
+    Timer timer;
+    for (uint32 repeat = 0; repeat < NUM_REPEATS; repeat++)
+    {
+        jobSystem.ParallelFor(0, (uint32)values.size(), grainSize, [&](uint32 first, uint32 last)
+        {
+            for (uint32 i = first; i < last; i++)
+            {
+                values[i] = sWork(values[i]);
+            }
+        });
+    }
+    return timer.ElapsedMs() / NUM_REPEATS;
+}
+
+static void sEmptyJob(
+    const void*)
+{
+}
+
+// Cost of queuing, running and counting a job which does nothing
+static double sEmptyJobNs(
+    JobSystem& jobSystem)
+{
+    Timer timer;
+    for (uint32 i = 0; i < NUM_EMPTY_JOBS; i += 1024)
+    {
+        JobCounter counter;
+        for (uint32 j = 0; j < 1024; j++)
+        {
+            jobSystem.Run(&sEmptyJob, nullptr, 0, &counter);
+        }
+        jobSystem.Wait(&counter);
+    }
+    return timer.ElapsedMs() * 1e6 / NUM_EMPTY_JOBS;
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    std::vector<float> values(NUM_ELEMENTS, 1.0f);
+
+    // Same work on one thread without the job system, what the speedups are measured against
+    Timer timer;
+    for (uint32 repeat = 0; repeat < NUM_REPEATS; repeat++)
+    {
+        for (float& value : values)
+        {
+            value = sWork(value);
+        }
+    }
+    double serialMs = timer.ElapsedMs() / NUM_REPEATS;
+    printf("serial: %.2f ms per pass over %u elements\n", serialMs, NUM_ELEMENTS);
+
+    printf("workers  grain  ms per pass  speedup  ns per empty job\n");
+    for (uint32 numWorkers = 1; numWorkers <= 8; numWorkers *= 2)
+    {
+        JobSystem jobSystem(numWorkers);
+        double emptyJobNs = sEmptyJobNs(jobSystem);
+        for (uint32 grainSize : { 64u, 1024u, 16384u })
+        {
+            double ms = sParallelForMs(jobSystem, values, grainSize);
+            printf("%7u  %5u  %11.2f  %7.2f  %16.1f\n", numWorkers, grainSize, ms, serialMs / ms, emptyJobNs);
+        }
+    }
+
+    // Keeps the work from being optimised away
+    printf("checksum %f\n", values[0]);
+    return 0;
+}
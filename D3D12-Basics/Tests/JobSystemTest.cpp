@@ -0,0 +1,264 @@
+#include "Test.h"
+
+#include "Generic/JobSystem.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Every index of every range is visited exactly once, whatever the grain size, including ranges smaller than a grain
+static void sTestParallelFor(
+    JobSystem& jobSystem)
+{
+    const uint32 ranges[][3] = {
+        { 0, 1, 1 },
+        { 0, 7, 64 },
+        { 5, 1000, 1 },
+        { 0, 100000, 64 },
+        { 17, 65553, 1000 },
+        { 0, 4096, 0 },
+    };
+
+    for (const uint32* pRange : ranges)
+    {
+        uint32 begin = pRange[0];
+        uint32 end = pRange[1];
+        uint32 grainSize = pRange[2];
+
+        std::vector<std::atomic<uint32>> visits(end);
+        std::atomic<bool> fTooBig(false);
+        jobSystem.ParallelFor(begin, end, grainSize, [&](uint32 first, uint32 last)
+        {
+            if (last - first > (grainSize > 0 ? grainSize : 1))
+            {
+                fTooBig = true;
+            }
+            for (uint32 i = first; i < last; i++)
+            {
+                visits[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+        CHECK(!fTooBig);
+        for (uint32 i = 0; i < end; i++)
+        {
+            CHECK(visits[i].load() == (i >= begin ? 1u : 0u));
+        }
+    }
+
+    // Empty ranges don't call the function at all
+    bool fCalled = false;
+    jobSystem.ParallelFor(10, 10, 1, [&](uint32, uint32) { fCalled = true; });
+    jobSystem.ParallelFor(10, 5, 1, [&](uint32, uint32) { fCalled = true; });
+    CHECK(!fCalled);
+}
+
+// ParallelFor from inside a ParallelFor, as recording does from inside a frame's jobs
+static void sTestNestedParallelFor(
+    JobSystem& jobSystem)
+{
+    const uint32 outer = 64;
+    const uint32 inner = 1000;
+
+    std::vector<std::atomic<uint32>> visits(outer * inner);
+    jobSystem.ParallelFor(0, outer, 1, [&](uint32 first, uint32 last)
+    {
+        for (uint32 i = first; i < last; i++)
+        {
+            jobSystem.ParallelFor(0, inner, 16, [&, i](uint32 innerFirst, uint32 innerLast)
+            {
+                for (uint32 j = innerFirst; j < innerLast; j++)
+                {
+                    visits[i * inner + j].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+    });
+
+    for (uint32 i = 0; i < outer * inner; i++)
+    {
+        CHECK(visits[i].load() == 1);
+    }
+}
+
+struct TreeJobData
+{
+    JobSystem* pJobSystem;
+    std::atomic<uint32>* pNumLeaves;
+    uint32 depth;
+};
+
+// Splits in two until depth runs out, each level waiting on its children so workers have to run jobs from inside Wait
+static void sTreeJob(
+    const void* pData)
+{
+    TreeJobData data = *(const TreeJobData*)pData;
+    if (data.depth == 0)
+    {
+        data.pNumLeaves->fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    JobCounter children;
+    TreeJobData child = data;
+    child.depth--;
+    data.pJobSystem->Run(&sTreeJob, &child, sizeof(child), &children);
+    data.pJobSystem->Run(&sTreeJob, &child, sizeof(child), &children);
+    data.pJobSystem->Wait(&children);
+}
+
+static void sTestDependentJobs(
+    JobSystem& jobSystem)
+{
+    for (uint32 depth : { 0u, 1u, 8u, 14u })
+    {
+        std::atomic<uint32> numLeaves(0);
+        TreeJobData data = { &jobSystem, &numLeaves, depth };
+
+        JobCounter counter;
+        jobSystem.Run(&sTreeJob, &data, sizeof(data), &counter);
+        jobSystem.Wait(&counter);
+        CHECK(counter.IsDone());
+        CHECK(numLeaves.load() == (1u << depth));
+    }
+}
+
+struct CountJobData
+{
+    std::atomic<uint32>* pCount;
+};
+
+static void sCountJob(
+    const void* pData)
+{
+    ((const CountJobData*)pData)->pCount->fetch_add(1, std::memory_order_relaxed);
+}
+
+// More jobs queued at once than a worker's pool holds, so the ones whose pool slot is still in use have to go on the heap
+static void sTestPoolOverflow(
+    JobSystem& jobSystem)
+{
+    const uint32 numJobs = JOB_POOL_SIZE * 3 + 5;
+
+    std::atomic<uint32> count(0);
+    CountJobData data = { &count };
+
+    JobCounter counter;
+    for (uint32 i = 0; i < numJobs; i++)
+    {
+        jobSystem.Run(&sCountJob, &data, sizeof(data), &counter);
+    }
+    jobSystem.Wait(&counter);
+    CHECK(count.load() == numJobs);
+}
+
+// Threads attached after the job system is created can run and wait on jobs like worker 0, which is how the render thread records
+static void sTestAttachedThreads(
+    void)
+{
+    const uint32 numAttached = 2;
+    JobSystem jobSystem(3, numAttached);
+    CHECK(jobSystem.GetNumWorkers() == 3 + numAttached);
+
+    std::vector<std::atomic<uint32>> visits(numAttached * 50000);
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numAttached; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            jobSystem.AttachThread();
+            CHECK(jobSystem.GetWorkerIndex() >= 3);
+
+            for (uint32 rep = 0; rep < 10; rep++)
+            {
+                jobSystem.ParallelFor(t * 50000, (t + 1) * 50000, 128, [&](uint32 first, uint32 last)
+                {
+                    for (uint32 i = first; i < last; i++)
+                    {
+                        visits[i].fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+            }
+        });
+    }
+
+    // Worker 0 works on its own ranges at the same time
+    sTestParallelFor(jobSystem);
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    for (std::atomic<uint32>& count : visits)
+    {
+        CHECK(count.load() == 10);
+    }
+}
+
+// Many short frames of mixed work with pauses between them, so workers keep going to sleep and being woken by the next frame's
+// jobs. A job queued without waking anyone, or a counter released early, hangs or fails here.
+static void sTestStress(
+    void)
+{
+    std::mt19937 rng(1234);
+    for (uint32 numWorkers : { 2u, 4u, 8u })
+    {
+        JobSystem jobSystem(numWorkers);
+
+        for (uint32 frame = 0; frame < 300; frame++)
+        {
+            uint32 count = 1 + rng() % 20000;
+            uint32 grainSize = 1 + rng() % 512;
+
+            std::atomic<uint64> sum(0);
+            jobSystem.ParallelFor(0, count, grainSize, [&](uint32 first, uint32 last)
+            {
+                uint64 localSum = 0;
+                for (uint32 i = first; i < last; i++)
+                {
+                    localSum += i;
+                }
+                sum.fetch_add(localSum, std::memory_order_relaxed);
+            });
+            CHECK(sum.load() == (uint64)count * (count - 1) / 2);
+
+            std::atomic<uint32> numLeaves(0);
+            TreeJobData data = { &jobSystem, &numLeaves, (uint32)(rng() % 8) };
+            JobCounter counter;
+            jobSystem.Run(&sTreeJob, &data, sizeof(data), &counter);
+            jobSystem.Wait(&counter);
+            CHECK(numLeaves.load() == (1u << data.depth));
+
+            // Long enough now and then for every worker to fall asleep
+            if ((frame % 16) == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+    }
+}
+
+int main()
+{
+    {
+        JobSystem jobSystem(4);
+        sTestParallelFor(jobSystem);
+        sTestNestedParallelFor(jobSystem);
+        sTestDependentJobs(jobSystem);
+        sTestPoolOverflow(jobSystem);
+    }
+
+    // A single worker has nobody to steal from and runs everything in Wait
+    {
+        JobSystem jobSystem(1);
+        sTestParallelFor(jobSystem);
+        sTestDependentJobs(jobSystem);
+    }
+
+    sTestAttachedThreads();
+    sTestStress();
+
+    printf("JobSystemTest passed\n");
+    return 0;
+}
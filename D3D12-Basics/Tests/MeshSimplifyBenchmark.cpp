@@ -0,0 +1,263 @@
+#include "Test.h"
+
+#include "Renderer/MeshSimplify.h"
+#include "Renderer/VertexFormats.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Most points of the original surface measured against the simplified one, spread evenly over it
+#define MAX_SAMPLES 4000
+
+struct Mesh
+{
+    std::vector<Vertex> verts;
+    std::vector<uint32> indices;
+};
+
+static Vertex sVertex(
+    const Vector3& pos,
+    const Vector3& normal,
+    float u,
+    float v)
+{
+    Vertex vert;
+    vert.pos[0] = pos.x;
+    vert.pos[1] = pos.y;
+    vert.pos[2] = pos.z;
+    vert.normal[0] = normal.x;
+    vert.normal[1] = normal.y;
+    vert.normal[2] = normal.z;
+    vert.uv[0] = u;
+    vert.uv[1] = v;
+    return vert;
+}
+
+static Vector3 sPosition(
+    const Vertex& vert)
+{
+    return Vector3(vert.pos[0], vert.pos[1], vert.pos[2]);
+}
+
+// Same as MeshSimplifyTest's, a unit UV sphere with a seam down u = 0 and a vertex per column at each pole
+static Mesh sSphere(
+    uint32 rings,
+    uint32 segments)
+{
+    Mesh mesh;
+    for (uint32 ring = 0; ring <= rings; ring++)
+    {
+        float theta = F_PI * ring / rings;
+        for (uint32 segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * F_PI * segment / segments;
+            Vector3 pos(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            if (ring == 0 || ring == rings)
+            {
+                pos = Vector3(0.0f, ring == 0 ? 1.0f : -1.0f, 0.0f);
+            }
+            mesh.verts.push_back(sVertex(pos, pos, (float)segment / segments, (float)ring / rings));
+        }
+    }
+
+    for (uint32 ring = 0; ring < rings; ring++)
+    {
+        for (uint32 segment = 0; segment < segments; segment++)
+        {
+            uint32 a = ring * (segments + 1) + segment;
+            uint32 b = a + segments + 1;
+            if (ring != 0)
+            {
+                uint32 triangle[3] = { a, a + 1, b };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            }
+            if (ring != rings - 1)
+            {
+                uint32 triangle[3] = { a + 1, b + 1, b };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            }
+        }
+    }
+    return mesh;
+}
+
+// Same as MeshSimplifyTest's, a square heightfield of rolling hills with some noise on top
+static Mesh sTerrain(
+    uint32 quads,
+    float size,
+    float roughness,
+    uint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    std::vector<float> heights((quads + 1) * (quads + 1));
+    for (uint32 z = 0; z <= quads; z++)
+    {
+        for (uint32 x = 0; x <= quads; x++)
+        {
+            float fx = size * x / quads;
+            float fz = size * z / quads;
+            heights[z * (quads + 1) + x] = roughness * (sinf(fx) * cosf(fz * 0.7f) + 0.1f * noise(rng));
+        }
+    }
+
+    Mesh mesh;
+    float step = size / quads;
+    for (uint32 z = 0; z <= quads; z++)
+    {
+        for (uint32 x = 0; x <= quads; x++)
+        {
+            float left = heights[z * (quads + 1) + (x > 0 ? x - 1 : x)];
+            float right = heights[z * (quads + 1) + (x < quads ? x + 1 : x)];
+            float back = heights[(z > 0 ? z - 1 : z) * (quads + 1) + x];
+            float front = heights[(z < quads ? z + 1 : z) * (quads + 1) + x];
+            Vector3 normal(left - right, 2.0f * step, back - front);
+            normal = normal * (1.0f / normal.Length());
+
+            Vector3 pos(x * step, heights[z * (quads + 1) + x], z * step);
+            mesh.verts.push_back(sVertex(pos, normal, (float)x / quads, (float)z / quads));
+        }
+    }
+
+    for (uint32 z = 0; z < quads; z++)
+    {
+        for (uint32 x = 0; x < quads; x++)
+        {
+            uint32 a = z * (quads + 1) + x;
+            uint32 c = a + quads + 1;
+            uint32 quad[6] = { a, c, a + 1, a + 1, c, c + 1 };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+// Closest point to p on triangle abc, from Ericson's Real-Time Collision Detection, 5.1.5
+static Vector3 sClosestPointOnTriangle(
+    const Vector3& p,
+    const Vector3& a,
+    const Vector3& b,
+    const Vector3& c)
+{
+    Vector3 ab = b - a;
+    Vector3 ac = c - a;
+    Vector3 ap = p - a;
+    float d1 = ab.Dot(ap);
+    float d2 = ac.Dot(ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        return a;
+    }
+
+    Vector3 bp = p - b;
+    float d3 = ab.Dot(bp);
+    float d4 = ac.Dot(bp);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        return b;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    Vector3 cp = p - c;
+    float d5 = ab.Dot(cp);
+    float d6 = ac.Dot(cp);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        return c;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Furthest any of the original mesh's vertices and triangle centres are from the simplified surface. Only a one way distance, but
+// the simplified mesh's vertices are all original ones, so it can only be far from the original where the original's points show it.
+static float sDeviationMeasure(
+    const Mesh& mesh,
+    const std::vector<uint32>& indices)
+{
+    std::vector<Vector3> samples;
+    for (const Vertex& vert : mesh.verts)
+    {
+        samples.push_back(sPosition(vert));
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        Vector3 sum = sPosition(mesh.verts[mesh.indices[i]]) + sPosition(mesh.verts[mesh.indices[i + 1]]) +
+            sPosition(mesh.verts[mesh.indices[i + 2]]);
+        samples.push_back(sum * (1.0f / 3.0f));
+    }
+
+    float maxDistanceSq = 0.0f;
+    size_t stride = std::max(samples.size() / MAX_SAMPLES, (size_t)1);
+    for (size_t sample = 0; sample < samples.size(); sample += stride)
+    {
+        const Vector3& p = samples[sample];
+        float distanceSq = FLT_MAX;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            Vector3 closest = sClosestPointOnTriangle(p, sPosition(mesh.verts[indices[i]]), sPosition(mesh.verts[indices[i + 1]]),
+                sPosition(mesh.verts[indices[i + 2]]));
+            Vector3 offset = p - closest;
+            distanceSq = std::min(distanceSq, offset.Dot(offset));
+        }
+        maxDistanceSq = std::max(maxDistanceSq, distanceSq);
+    }
+    return sqrtf(maxDistanceSq);
+}
+
+// Simplifies to half, a quarter and an eighth of the triangles with no limit on error, reporting how long it took, the error Simplify
+// gave back and how far the surface has really moved
+static void sRun(
+    const char* pName,
+    const Mesh& mesh)
+{
+    uint32 numIndices = (uint32)mesh.indices.size();
+    for (uint32 divisor : { 2u, 4u, 8u })
+    {
+        uint32 target = numIndices / divisor / 3 * 3;
+        std::vector<uint32> indices;
+
+        Timer timer;
+        float error = MeshSimplify::Simplify(mesh.verts.data(), (uint32)mesh.verts.size(), mesh.indices.data(), numIndices, target,
+            FLT_MAX, indices);
+        double ms = timer.ElapsedMs();
+        CHECK(indices.size() <= target);
+
+        float deviation = sDeviationMeasure(mesh, indices);
+        printf("%-8s  %6u -> %6u  %6.1f%%  %8.2f  %14.5f  %18.5f\n", pName, numIndices / 3, (uint32)indices.size() / 3,
+            100.0f * indices.size() / numIndices, ms, error, deviation);
+    }
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    printf("mesh      triangles          kept        ms  reported error  measured deviation\n");
+
+    sRun("sphere", sSphere(64, 128));
+    sRun("terrain", sTerrain(150, 10.0f, 0.5f, 2));
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include "Test.h"
+
+#include "Renderer/MeshSimplify.h"
+#include "Renderer/VertexFormats.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+struct Mesh
+{
+    std::vector<Vertex> verts;
+    std::vector<uint32> indices;
+};
+
+static Vertex sVertex(
+    const Vector3& pos,
+    const Vector3& normal,
+    float u,
+    float v)
+{
+    Vertex vert;
+    vert.pos[0] = pos.x;
+    vert.pos[1] = pos.y;
+    vert.pos[2] = pos.z;
+    vert.normal[0] = normal.x;
+    vert.normal[1] = normal.y;
+    vert.normal[2] = normal.z;
+    vert.uv[0] = u;
+    vert.uv[1] = v;
+    return vert;
+}
+
+static Vector3 sPosition(
+    const Vertex& vert)
+{
+    return Vector3(vert.pos[0], vert.pos[1], vert.pos[2]);
+}
+
+// Unit UV sphere. The column at u = 0 is repeated at u = 1, and each pole has a vertex per column, so both are seams.
+static Mesh sSphere(
+    uint32 rings,
+    uint32 segments)
+{
+    Mesh mesh;
+    for (uint32 ring = 0; ring <= rings; ring++)
+    {
+        float theta = F_PI * ring / rings;
+        for (uint32 segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * F_PI * segment / segments;
+            Vector3 pos(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            // Poles exactly on the axis, so their copies really do share a position
+            if (ring == 0 || ring == rings)
+            {
+                pos = Vector3(0.0f, ring == 0 ? 1.0f : -1.0f, 0.0f);
+            }
+            mesh.verts.push_back(sVertex(pos, pos, (float)segment / segments, (float)ring / rings));
+        }
+    }
+
+    for (uint32 ring = 0; ring < rings; ring++)
+    {
+        for (uint32 segment = 0; segment < segments; segment++)
+        {
+            uint32 a = ring * (segments + 1) + segment;
+            uint32 b = a + segments + 1;
+            if (ring != 0)
+            {
+                uint32 triangle[3] = { a, a + 1, b };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            }
+            if (ring != rings - 1)
+            {
+                uint32 triangle[3] = { a + 1, b + 1, b };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            }
+        }
+    }
+    return mesh;
+}
+
+// Square heightfield from 0 to size in x and z, with an open edge all the way round. Flat if roughness is 0.
+static Mesh sTerrain(
+    uint32 quads,
+    float size,
+    float roughness,
+    uint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    std::vector<float> heights((quads + 1) * (quads + 1));
+    for (uint32 z = 0; z <= quads; z++)
+    {
+        for (uint32 x = 0; x <= quads; x++)
+        {
+            float fx = size * x / quads;
+            float fz = size * z / quads;
+            heights[z * (quads + 1) + x] = roughness * (sinf(fx) * cosf(fz * 0.7f) + 0.1f * noise(rng));
+        }
+    }
+
+    Mesh mesh;
+    float step = size / quads;
+    for (uint32 z = 0; z <= quads; z++)
+    {
+        for (uint32 x = 0; x <= quads; x++)
+        {
+            float left = heights[z * (quads + 1) + (x > 0 ? x - 1 : x)];
+            float right = heights[z * (quads + 1) + (x < quads ? x + 1 : x)];
+            float back = heights[(z > 0 ? z - 1 : z) * (quads + 1) + x];
+            float front = heights[(z < quads ? z + 1 : z) * (quads + 1) + x];
+            Vector3 normal(left - right, 2.0f * step, back - front);
+            normal = normal * (1.0f / normal.Length());
+
+            Vector3 pos(x * step, heights[z * (quads + 1) + x], z * step);
+            mesh.verts.push_back(sVertex(pos, normal, (float)x / quads, (float)z / quads));
+        }
+    }
+
+    for (uint32 z = 0; z < quads; z++)
+    {
+        for (uint32 x = 0; x < quads; x++)
+        {
+            uint32 a = z * (quads + 1) + x;
+            uint32 c = a + quads + 1;
+            uint32 quad[6] = { a, c, a + 1, a + 1, c, c + 1 };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+// Every edge with how many triangles it's in, by the vertices it joins after going through remap
+static std::map<std::pair<uint32, uint32>, uint32> sEdgesGet(
+    const std::vector<uint32>& indices,
+    const std::vector<uint32>& remap)
+{
+    std::map<std::pair<uint32, uint32>, uint32> edges;
+    for (uint32 i = 0; i < (uint32)indices.size(); i++)
+    {
+        uint32 a = remap[indices[i]];
+        uint32 b = remap[indices[i - i % 3 + (i + 1) % 3]];
+        edges[{ std::min(a, b), std::max(a, b) }]++;
+    }
+    return edges;
+}
+
+// The result has to be a triangle list of the mesh's vertices with no triangle collapsed to nothing, or turned side on or away from
+// the normals of its corners.
+//
+// Vertices on a seam, where other vertices have the same position, and on an open edge, one with only one triangle once vertices
+// at the same position count as one, are locked in place. Their positions have to still be used, the open edges have to be exactly
+// the same, and the edges along the seams have to still be there, so there can't be any cracks.
+static void sResultCheck(
+    const Mesh& mesh,
+    const std::vector<uint32>& indices)
+{
+    uint32 numVerts = (uint32)mesh.verts.size();
+    CHECK((indices.size() % 3) == 0);
+    for (uint32 i = 0; i < (uint32)indices.size(); i += 3)
+    {
+        uint32 a = indices[i];
+        uint32 b = indices[i + 1];
+        uint32 c = indices[i + 2];
+        CHECK(a < numVerts && b < numVerts && c < numVerts);
+        CHECK(a != b && b != c && c != a);
+
+        Vector3 p = sPosition(mesh.verts[a]);
+        Vector3 faceNormal = (sPosition(mesh.verts[b]) - p).Cross(sPosition(mesh.verts[c]) - p);
+        Vector3 vertexNormals(0.0f, 0.0f, 0.0f);
+        for (uint32 corner = 0; corner < 3; corner++)
+        {
+            const float* pNormal = mesh.verts[indices[i + corner]].normal;
+            vertexNormals = vertexNormals + Vector3(pNormal[0], pNormal[1], pNormal[2]);
+        }
+        CHECK(faceNormal.Dot(vertexNormals) > 0.0f);
+    }
+
+    std::vector<uint32> identity(numVerts);
+    std::vector<uint32> positionVerts(numVerts);
+    std::vector<bool> seam(numVerts, false);
+    {
+        std::map<std::tuple<float, float, float>, uint32> firstVertAtPosition;
+        for (uint32 vert = 0; vert < numVerts; vert++)
+        {
+            identity[vert] = vert;
+            auto inserted = firstVertAtPosition.insert({ std::make_tuple(mesh.verts[vert].pos[0], mesh.verts[vert].pos[1],
+                mesh.verts[vert].pos[2]), vert });
+            positionVerts[vert] = inserted.first->second;
+            if (!inserted.second)
+            {
+                seam[vert] = true;
+                seam[inserted.first->second] = true;
+            }
+        }
+    }
+    std::vector<bool> locked(seam);
+
+    std::map<std::pair<uint32, uint32>, uint32> openBefore = sEdgesGet(mesh.indices, positionVerts);
+    std::map<std::pair<uint32, uint32>, uint32> openAfter = sEdgesGet(indices, positionVerts);
+    for (auto* pEdges : { &openBefore, &openAfter })
+    {
+        for (auto it = pEdges->begin(); it != pEdges->end(); )
+        {
+            it = it->second == 1 ? std::next(it) : pEdges->erase(it);
+        }
+    }
+    CHECK(openBefore == openAfter);
+
+    for (auto it = openBefore.begin(); it != openBefore.end(); it++)
+    {
+        locked[it->first.first] = true;
+        locked[it->first.second] = true;
+    }
+    for (uint32 vert = 0; vert < numVerts; vert++)
+    {
+        locked[vert] = locked[vert] || locked[positionVerts[vert]];
+    }
+
+    // By position, since a copy at a seam can lose its last triangle to a collapse beside it without anything moving
+    std::vector<bool> usedBefore(numVerts, false);
+    std::vector<bool> usedAfter(numVerts, false);
+    for (uint32 index : mesh.indices)
+    {
+        usedBefore[positionVerts[index]] = true;
+    }
+    for (uint32 index : indices)
+    {
+        usedAfter[positionVerts[index]] = true;
+    }
+    for (uint32 vert = 0; vert < numVerts; vert++)
+    {
+        CHECK(!locked[vert] || usedAfter[vert] == usedBefore[vert]);
+    }
+
+    // Edges along a seam join two positions with more than one vertex at them, and have to still be there
+    std::map<std::pair<uint32, uint32>, uint32> edgesBefore = sEdgesGet(mesh.indices, positionVerts);
+    std::map<std::pair<uint32, uint32>, uint32> edgesAfter = sEdgesGet(indices, positionVerts);
+    for (auto it = edgesBefore.begin(); it != edgesBefore.end(); it++)
+    {
+        if (seam[it->first.first] && seam[it->first.second])
+        {
+            CHECK(edgesAfter.find(it->first) != edgesAfter.end());
+        }
+    }
+}
+
+// Reduces to the target when maxError allows, checking the result every time
+static void sTestTargets(
+    const Mesh& mesh)
+{
+    uint32 numIndices = (uint32)mesh.indices.size();
+    sResultCheck(mesh, mesh.indices);
+
+    std::vector<uint32> indices;
+    for (uint32 divisor : { 2u, 4u, 8u })
+    {
+        uint32 target = (numIndices / 3 / divisor) * 3;
+        float error = MeshSimplify::Simplify(mesh.verts.data(), (uint32)mesh.verts.size(), mesh.indices.data(), numIndices, target,
+            FLT_MAX, indices);
+        CHECK(indices.size() <= target);
+        CHECK(error >= 0.0f);
+        sResultCheck(mesh, indices);
+    }
+
+    // Already small enough, so nothing to do
+    float error = MeshSimplify::Simplify(mesh.verts.data(), (uint32)mesh.verts.size(), mesh.indices.data(), numIndices, numIndices,
+        FLT_MAX, indices);
+    CHECK(error == 0.0f && indices == mesh.indices);
+}
+
+// No collapse costing more than maxError is made: the error reported stays within it, a curved surface can hardly be simplified
+// with none allowed, and more allowed never leaves more triangles
+static void sTestMaxError(
+    void)
+{
+    Mesh sphere = sSphere(32, 64);
+    uint32 numIndices = (uint32)sphere.indices.size();
+
+    std::vector<uint32> indices;
+    float error = MeshSimplify::Simplify(sphere.verts.data(), (uint32)sphere.verts.size(), sphere.indices.data(), numIndices, 0, 0.0f,
+        indices);
+    CHECK(error == 0.0f);
+    CHECK(indices.size() == numIndices);
+
+    uint32 lastSize = numIndices;
+    for (float maxError : { 0.001f, 0.005f, 0.02f, 0.1f })
+    {
+        error = MeshSimplify::Simplify(sphere.verts.data(), (uint32)sphere.verts.size(), sphere.indices.data(), numIndices, 0, maxError,
+            indices);
+        printf("Sphere with maxError %.3f: %u of %u triangles, error %.4f\n", maxError, (uint32)indices.size() / 3, numIndices / 3,
+            error);
+        CHECK(error <= maxError * 1.0001f);
+        CHECK(indices.size() <= lastSize);
+        sResultCheck(sphere, indices);
+        lastSize = (uint32)indices.size();
+    }
+    CHECK(lastSize < numIndices / 4);
+
+    // A flat grid with UVs that follow it costs nothing to simplify however far it goes, only its open edge is left
+    Mesh flat = sTerrain(32, 10.0f, 0.0f, 1);
+    error = MeshSimplify::Simplify(flat.verts.data(), (uint32)flat.verts.size(), flat.indices.data(), (uint32)flat.indices.size(), 0,
+        1e-4f, indices);
+    printf("Flat grid: %u of %u triangles, error %g\n", (uint32)indices.size() / 3, (uint32)flat.indices.size() / 3, error);
+    CHECK(error <= 1e-4f);
+    CHECK(indices.size() < flat.indices.size() / 4);
+    sResultCheck(flat, indices);
+}
+
+int main()
+{
+    sTestTargets(sSphere(32, 64));
+    sTestTargets(sTerrain(48, 10.0f, 0.5f, 2));
+    sTestMaxError();
+
+    printf("MeshSimplifyTest passed\n");
+    return 0;
+}
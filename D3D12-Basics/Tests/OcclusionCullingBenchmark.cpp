@@ -0,0 +1,131 @@
+#include "Test.h"
+
+#include "Generic/JobSystem.h"
+#include "Renderer/OcclusionCulling.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#define NUM_BOXES 100000
+#define OCCLUDER_GRID_SIZE 32
+#define NUM_REPEATS 50
+
+// Same camera as OcclusionCullingTest, at the origin looking down +z
+static Matrix4x4 sViewProj(
+    void)
+{
+    const float nearPlane = 0.1f;
+    const float farPlane = 1000.0f;
+
+    Matrix4x4 matViewProj;
+    matViewProj._11 = 2.0f;
+    matViewProj._22 = 2.0f;
+    matViewProj._33 = farPlane / (farPlane - nearPlane);
+    matViewProj._34 = -nearPlane * farPlane / (farPlane - nearPlane);
+    matViewProj._43 = 1.0f;
+    matViewProj._44 = 0.0f;
+    return matViewProj;
+}
+
+static OccluderMesh sGrid(
+    float x0,
+    float y0,
+    float x1,
+    float y1,
+    float z,
+    uint32 n)
+{
+    OccluderMesh mesh;
+    for (uint32 j = 0; j <= n; j++)
+    {
+        for (uint32 i = 0; i <= n; i++)
+        {
+            mesh.positions.push_back(Vector3(x0 + (x1 - x0) * i / n, y0 + (y1 - y0) * j / n, z));
+        }
+    }
+    for (uint32 j = 0; j < n; j++)
+    {
+        for (uint32 i = 0; i < n; i++)
+        {
+            uint32 a = j * (n + 1) + i;
+            uint32 c = a + n + 1;
+            uint32 quad[6] = { a, a + 1, c, a + 1, c + 1, c };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    Matrix4x4 matViewProj = sViewProj();
+    std::mt19937 rng(1);
+
+    // OCCLUSION_MAX_OCCLUDERS walls of 2 * OCCLUDER_GRID_SIZE^2 triangles each, the most a frame draws
+    std::uniform_real_distribution<float> occluderXY(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> occluderZ(8.0f, 40.0f);
+    std::vector<OccluderMesh> occluders;
+    for (uint32 i = 0; i < OCCLUSION_MAX_OCCLUDERS; i++)
+    {
+        float x = occluderXY(rng);
+        float y = occluderXY(rng);
+        occluders.push_back(sGrid(x - 4.0f, y - 3.0f, x + 4.0f, y + 3.0f, occluderZ(rng), OCCLUDER_GRID_SIZE));
+    }
+    std::vector<const OccluderMesh*> pOccluders;
+    for (const OccluderMesh& occluder : occluders)
+    {
+        pOccluders.push_back(&occluder);
+    }
+    std::vector<Matrix4x4> matWorlds(occluders.size());
+
+    std::uniform_real_distribution<float> boxXY(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> boxZ(2.0f, 80.0f);
+    std::uniform_real_distribution<float> boxExtent(0.05f, 2.0f);
+    CullingBounds bounds;
+    for (uint32 i = 0; i < NUM_BOXES; i++)
+    {
+        Vector3 centre(boxXY(rng), boxXY(rng), boxZ(rng));
+        float extent = boxExtent(rng);
+        Vector3 offset(extent, extent, extent);
+        bounds.Add(centre - offset, centre + offset, centre, extent * 1.75f);
+    }
+    std::vector<uint32> candidates(NUM_BOXES);
+    for (uint32 i = 0; i < NUM_BOXES; i++)
+    {
+        candidates[i] = i;
+    }
+    std::vector<uint32> visible(NUM_BOXES);
+
+    printf("workers  draw ms  triangles  cull ms  visible  ns per box\n");
+    for (uint32 numWorkers = 1; numWorkers <= 4; numWorkers *= 2)
+    {
+        JobSystem jobSystem(numWorkers);
+        OcclusionBuffer buffer;
+
+        // Warm up, so the bins and hierarchy are already allocated
+        buffer.OccludersDraw(matViewProj, pOccluders.data(), matWorlds.data(), (uint32)pOccluders.size(), jobSystem);
+        buffer.Cull(bounds, candidates.data(), NUM_BOXES, visible.data(), jobSystem);
+
+        Timer drawTimer;
+        for (uint32 repeat = 0; repeat < NUM_REPEATS; repeat++)
+        {
+            buffer.OccludersDraw(matViewProj, pOccluders.data(), matWorlds.data(), (uint32)pOccluders.size(), jobSystem);
+        }
+        double drawMs = drawTimer.ElapsedMs() / NUM_REPEATS;
+
+        uint32 numVisible = 0;
+        Timer cullTimer;
+        for (uint32 repeat = 0; repeat < NUM_REPEATS; repeat++)
+        {
+            numVisible = buffer.Cull(bounds, candidates.data(), NUM_BOXES, visible.data(), jobSystem);
+        }
+        double cullMs = cullTimer.ElapsedMs() / NUM_REPEATS;
+
+        printf("%7u  %7.3f  %9u  %7.3f  %7u  %10.1f\n", numWorkers, drawMs, buffer.GetNumTrianglesDrawn(), cullMs, numVisible,
+            cullMs * 1e6 / NUM_BOXES);
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include "Test.h"
+
+#include "Generic/JobSystem.h"
+#include "Renderer/OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 1000.0f
+
+// Column vector perspective projection with depth from 0 to w and the camera at the origin looking down +z, so view space is world
+// space. x / z and y / z of 0.5 land on the edge of the screen.
+static Matrix4x4 sViewProj(
+    void)
+{
+    Matrix4x4 matViewProj;
+    matViewProj._11 = 2.0f;
+    matViewProj._22 = 2.0f;
+    matViewProj._33 = FAR_PLANE / (FAR_PLANE - NEAR_PLANE);
+    matViewProj._34 = -NEAR_PLANE * FAR_PLANE / (FAR_PLANE - NEAR_PLANE);
+    matViewProj._43 = 1.0f;
+    matViewProj._44 = 0.0f;
+    return matViewProj;
+}
+
+// Grid of quads facing the camera at depth z
+static OccluderMesh sGrid(
+    float x0,
+    float y0,
+    float x1,
+    float y1,
+    float z,
+    uint32 n)
+{
+    OccluderMesh mesh;
+    for (uint32 j = 0; j <= n; j++)
+    {
+        for (uint32 i = 0; i <= n; i++)
+        {
+            mesh.positions.push_back(Vector3(x0 + (x1 - x0) * i / n, y0 + (y1 - y0) * j / n, z));
+        }
+    }
+    for (uint32 j = 0; j < n; j++)
+    {
+        for (uint32 i = 0; i < n; i++)
+        {
+            uint32 a = j * (n + 1) + i;
+            uint32 c = a + n + 1;
+            uint32 quad[6] = { a, a + 1, c, a + 1, c + 1, c };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+static void sBoxAdd(
+    CullingBounds& bounds,
+    const Vector3& centre,
+    float extent)
+{
+    Vector3 offset(extent, extent, extent);
+    bounds.Add(centre - offset, centre + offset, centre, extent * 1.75f);
+}
+
+// Brute force version of IsVisible against level 0 only: projects the box's corners, and it's visible if it crosses the near plane,
+// is entirely off screen, or its nearest depth is in front of any pixel its screen rectangle covers
+static bool sIsVisibleFlat(
+    const OcclusionBuffer& buffer,
+    const Matrix4x4& matViewProj,
+    const CullingBounds& bounds,
+    uint32 index)
+{
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minDepth = FLT_MAX;
+    for (uint32 corner = 0; corner < 8; corner++)
+    {
+        float x = bounds.boxCentreX[index] + ((corner & 1) ? 1.0f : -1.0f) * bounds.boxExtentX[index];
+        float y = bounds.boxCentreY[index] + ((corner & 2) ? 1.0f : -1.0f) * bounds.boxExtentY[index];
+        float z = bounds.boxCentreZ[index] + ((corner & 4) ? 1.0f : -1.0f) * bounds.boxExtentZ[index];
+
+        float clipZ = matViewProj._33 * z + matViewProj._34;
+        if (clipZ < 0.0f)
+        {
+            return true;
+        }
+        minX = std::min(minX, matViewProj._11 * x / z);
+        maxX = std::max(maxX, matViewProj._11 * x / z);
+        minY = std::min(minY, matViewProj._22 * y / z);
+        maxY = std::max(maxY, matViewProj._22 * y / z);
+        minDepth = std::min(minDepth, clipZ / z);
+    }
+
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+    {
+        return true;
+    }
+
+    int32 x0 = (int32)floorf((std::max(minX, -1.0f) * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH);
+    int32 x1 = std::min((int32)floorf((std::min(maxX, 1.0f) * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH), OCCLUSION_BUFFER_WIDTH - 1);
+    int32 y0 = (int32)floorf((0.5f - std::min(maxY, 1.0f) * 0.5f) * OCCLUSION_BUFFER_HEIGHT);
+    int32 y1 = std::min((int32)floorf((0.5f - std::max(minY, -1.0f) * 0.5f) * OCCLUSION_BUFFER_HEIGHT), OCCLUSION_BUFFER_HEIGHT - 1);
+    for (int32 y = y0; y <= y1; y++)
+    {
+        for (int32 x = x0; x <= x1; x++)
+        {
+            if (minDepth <= buffer.DepthGet(x, y))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// One wall covering the middle of the screen: what's drawn is where it should be, everything in front of or beside it is kept, and
+// only boxes entirely behind it are culled
+static void sTestWall(
+    JobSystem& jobSystem)
+{
+    Matrix4x4 matViewProj = sViewProj();
+
+    // At z = 10 this covers x / z and y / z up to 0.25, the middle half of the screen
+    OcclusionBuffer buffer;
+    OccluderMesh wall = sGrid(-2.5f, -2.5f, 2.5f, 2.5f, 10.0f, 1);
+    const OccluderMesh* pWall = &wall;
+    Matrix4x4 matWorld;
+    buffer.OccludersDraw(matViewProj, &pWall, &matWorld, 1, jobSystem);
+    CHECK(buffer.GetNumTrianglesDrawn() == 2);
+
+    float wallDepth = (matViewProj._33 * 10.0f + matViewProj._34) / 10.0f;
+    CHECK(fabsf(buffer.DepthGet(OCCLUSION_BUFFER_WIDTH / 2, OCCLUSION_BUFFER_HEIGHT / 2) - wallDepth) < 1e-4f);
+    CHECK(buffer.DepthGet(0, 0) == 1.0f);
+    CHECK(buffer.DepthGet(OCCLUSION_BUFFER_WIDTH - 1, OCCLUSION_BUFFER_HEIGHT - 1) == 1.0f);
+
+    CullingBounds bounds;
+    sBoxAdd(bounds, Vector3(0, 0, 20), 1.0f);       // Behind the wall
+    sBoxAdd(bounds, Vector3(0, 0, 5), 1.0f);        // In front of it
+    sBoxAdd(bounds, Vector3(0, 0, 10), 1.0f);       // Through it
+    sBoxAdd(bounds, Vector3(8, 0, 20), 1.0f);       // Behind, but beside it
+    sBoxAdd(bounds, Vector3(4.5f, 0, 20), 1.0f);    // Behind, half over its edge
+    sBoxAdd(bounds, Vector3(0, 0, 0), 1.0f);        // Around the camera, crossing the near plane
+    sBoxAdd(bounds, Vector3(0, 500, 20), 1.0f);     // Off screen
+    sBoxAdd(bounds, Vector3(0, 0, 900), 1.0f);      // Far away, behind it
+
+    bool expected[] = { false, true, true, true, true, true, true, false };
+    for (uint32 i = 0; i < bounds.Size(); i++)
+    {
+        CHECK(buffer.IsVisible(bounds, i) == expected[i]);
+    }
+
+    // Cull keeps the order, and works in place
+    std::vector<uint32> candidates = { 7, 6, 5, 4, 3, 2, 1, 0 };
+    uint32 numVisible = buffer.Cull(bounds, candidates.data(), (uint32)candidates.size(), candidates.data(), jobSystem);
+    CHECK(numVisible == 6);
+    uint32 expectedVisible[] = { 6, 5, 4, 3, 2, 1 };
+    for (uint32 i = 0; i < numVisible; i++)
+    {
+        CHECK(candidates[i] == expectedVisible[i]);
+    }
+
+    // Nothing drawn hides nothing
+    buffer.OccludersDraw(matViewProj, nullptr, nullptr, 0, jobSystem);
+    CHECK(buffer.GetNumTrianglesDrawn() == 0);
+    for (uint32 i = 0; i < bounds.Size(); i++)
+    {
+        CHECK(buffer.IsVisible(bounds, i));
+    }
+}
+
+// Lots of random occluders and boxes. The hierarchy has to give the same answer as testing every covered pixel of level 0, and
+// every box it culls has to really be hidden.
+static void sTestRandom(
+    JobSystem& jobSystem)
+{
+    Matrix4x4 matViewProj = sViewProj();
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> occluderXY(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> occluderZ(8.0f, 40.0f);
+    std::uniform_real_distribution<float> boxXY(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> boxZ(2.0f, 80.0f);
+    std::uniform_real_distribution<float> boxExtent(0.05f, 2.0f);
+
+    std::vector<OccluderMesh> occluders;
+    for (uint32 i = 0; i < OCCLUSION_MAX_OCCLUDERS; i++)
+    {
+        float x = occluderXY(rng);
+        float y = occluderXY(rng);
+        occluders.push_back(sGrid(x - 4.0f, y - 3.0f, x + 4.0f, y + 3.0f, occluderZ(rng), 8));
+    }
+    std::vector<const OccluderMesh*> pOccluders;
+    for (const OccluderMesh& occluder : occluders)
+    {
+        pOccluders.push_back(&occluder);
+    }
+    std::vector<Matrix4x4> matWorlds(occluders.size());
+
+    OcclusionBuffer buffer;
+    buffer.OccludersDraw(matViewProj, pOccluders.data(), matWorlds.data(), (uint32)pOccluders.size(), jobSystem);
+
+    const uint32 numBoxes = 20000;
+    CullingBounds bounds;
+    for (uint32 i = 0; i < numBoxes; i++)
+    {
+        sBoxAdd(bounds, Vector3(boxXY(rng), boxXY(rng), boxZ(rng)), boxExtent(rng));
+    }
+
+    std::vector<uint32> candidates(numBoxes);
+    for (uint32 i = 0; i < numBoxes; i++)
+    {
+        candidates[i] = i;
+    }
+    std::vector<uint32> visible(numBoxes);
+    uint32 numVisible = buffer.Cull(bounds, candidates.data(), numBoxes, visible.data(), jobSystem);
+
+    uint32 numCulled = 0;
+    uint32 next = 0;
+    for (uint32 i = 0; i < numBoxes; i++)
+    {
+        bool fVisible = next < numVisible && visible[next] == i;
+        if (fVisible)
+        {
+            next++;
+        }
+        else
+        {
+            numCulled++;
+        }
+
+        CHECK(fVisible == buffer.IsVisible(bounds, i));
+        CHECK(fVisible == sIsVisibleFlat(buffer, matViewProj, bounds, i));
+    }
+    CHECK(next == numVisible);
+
+    printf("%u of %u random boxes culled\n", numCulled, numBoxes);
+    CHECK(numCulled > 0 && numCulled < numBoxes);
+}
+
+int main()
+{
+    for (uint32 numWorkers : { 1u, 4u })
+    {
+        JobSystem jobSystem(numWorkers);
+        sTestWall(jobSystem);
+        sTestRandom(jobSystem);
+    }
+
+    printf("OcclusionCullingTest passed\n");
+    return 0;
+}
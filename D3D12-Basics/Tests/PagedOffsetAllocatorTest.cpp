@@ -0,0 +1,136 @@
+#include "Test.h"
+
+#include "Generic/PagedOffsetAllocator.h"
+
+#include <random>
+#include <vector>
+
+#define PAGE_SIZE 64
+
+static void sTestPages()
+{
+    PagedOffsetAllocator allocator(PAGE_SIZE);
+
+    uint32 numPages, used, free;
+    allocator.GetStats(numPages, used, free);
+    CHECK(numPages == 1 && used == 0 && free == PAGE_SIZE);
+
+    // Fill the first page one at a time, then the next allocation needs a new page
+    int32 page;
+    uint32 offset;
+    for (uint32 i = 0; i < PAGE_SIZE; i++)
+    {
+        CHECK(!allocator.Allocate(1, page, offset));
+        CHECK(page == 0 && offset == i);
+    }
+    CHECK(allocator.Allocate(1, page, offset));
+    CHECK(page == 1 && offset == 0);
+    CHECK(allocator.GetPageSize(1) == PAGE_SIZE);
+
+    // Too big for a page, so gets one of its own
+    int32 bigPage;
+    CHECK(allocator.Allocate(PAGE_SIZE * 3, bigPage, offset));
+    CHECK(bigPage == 2 && offset == 0);
+    CHECK(allocator.GetPageSize(bigPage) == PAGE_SIZE * 3);
+
+    allocator.GetStats(numPages, used, free);
+    CHECK(numPages == 3 && used == PAGE_SIZE + 1 + PAGE_SIZE * 3 && free == PAGE_SIZE - 1);
+
+    // Emptying a page releases it, and its index is reused by the next page created
+    CHECK(allocator.Free(bigPage, 0, PAGE_SIZE * 3));
+    allocator.GetStats(numPages, used, free);
+    CHECK(numPages == 2);
+    CHECK(!allocator.Allocate(1, page, offset));
+    CHECK(page == 1 && offset == 1);
+    CHECK(allocator.Allocate(PAGE_SIZE, page, offset));
+    CHECK(page == bigPage);
+
+    // The first page stays around even when it's empty
+    for (uint32 i = 0; i < PAGE_SIZE; i++)
+    {
+        CHECK(!allocator.Free(0, i, 1));
+    }
+    allocator.GetStats(numPages, used, free);
+    CHECK(numPages == 3);
+}
+
+// Random ranges, checked against a map of what's in use in each page
+static void sTestRandom()
+{
+    PagedOffsetAllocator allocator(PAGE_SIZE);
+    // The first page is there from the start
+    std::vector<std::vector<bool>> used(1, std::vector<bool>(PAGE_SIZE, false));
+    struct Alloc
+    {
+        int32 page;
+        uint32 offset;
+        uint32 count;
+    };
+    std::vector<Alloc> live;
+    std::mt19937 rng(7);
+
+    for (uint32 i = 0; i < 100000; i++)
+    {
+        if ((rng() % 3) == 0 && !live.empty())
+        {
+            size_t index = rng() % live.size();
+            Alloc alloc = live[index];
+            live[index] = live.back();
+            live.pop_back();
+
+            for (uint32 j = 0; j < alloc.count; j++)
+            {
+                used[alloc.page][alloc.offset + j] = false;
+            }
+            if (allocator.Free(alloc.page, alloc.offset, alloc.count))
+            {
+                used[alloc.page].clear();
+            }
+        }
+        else if (live.size() < 200)
+        {
+            Alloc alloc;
+            alloc.count = 1 + ((rng() % 10) == 0 ? rng() % (PAGE_SIZE * 2) : rng() % 8);
+            if (allocator.Allocate(alloc.count, alloc.page, alloc.offset))
+            {
+                if (alloc.page >= (int32)used.size())
+                {
+                    used.resize(alloc.page + 1);
+                }
+                CHECK(used[alloc.page].empty());
+                used[alloc.page].resize(allocator.GetPageSize(alloc.page), false);
+            }
+            CHECK(alloc.offset + alloc.count <= allocator.GetPageSize(alloc.page));
+            for (uint32 j = 0; j < alloc.count; j++)
+            {
+                CHECK(!used[alloc.page][alloc.offset + j]);
+                used[alloc.page][alloc.offset + j] = true;
+            }
+            live.push_back(alloc);
+        }
+    }
+
+    uint32 liveCount = 0;
+    for (const Alloc& alloc : live)
+    {
+        liveCount += alloc.count;
+    }
+    uint32 numPages, usedCount, free;
+    allocator.GetStats(numPages, usedCount, free);
+    CHECK(usedCount == liveCount);
+
+    for (const Alloc& alloc : live)
+    {
+        allocator.Free(alloc.page, alloc.offset, alloc.count);
+    }
+    allocator.GetStats(numPages, usedCount, free);
+    CHECK(numPages == 1 && usedCount == 0 && free == PAGE_SIZE);
+}
+
+int main()
+{
+    sTestPages();
+    sTestRandom();
+    printf("PagedOffsetAllocatorTest passed\n");
+    return 0;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cmath>
+
+// The few DirectX::SimpleMath types and operations the std only parts of the engine use, so they build without DirectXMath. Matrices
+// are row major like SimpleMath's, and multiply the same way.
+
+namespace DirectX
+{
+namespace SimpleMath
+{
+    struct Vector2
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+
+        Vector2() = default;
+        Vector2(float _x, float _y) :
+            x(_x), y(_y) {}
+    };
+
+    struct Vector3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+
+        Vector3() = default;
+        Vector3(float _x, float _y, float _z) :
+            x(_x), y(_y), z(_z) {}
+
+        float Dot(const Vector3& v) const
+        {
+            return x * v.x + y * v.y + z * v.z;
+        }
+
+        Vector3 Cross(const Vector3& v) const
+        {
+            return Vector3(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
+        }
+
+        float Length() const
+        {
+            return sqrtf(Dot(*this));
+        }
+    };
+
+    inline Vector3 operator+(const Vector3& a, const Vector3& b)
+    {
+        return Vector3(a.x + b.x, a.y + b.y, a.z + b.z);
+    }
+
+    inline Vector3 operator-(const Vector3& a, const Vector3& b)
+    {
+        return Vector3(a.x - b.x, a.y - b.y, a.z - b.z);
+    }
+
+    inline Vector3 operator*(const Vector3& v, float s)
+    {
+        return Vector3(v.x * s, v.y * s, v.z * s);
+    }
+
+    struct Vector4
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 0.0f;
+
+        Vector4() = default;
+        Vector4(float _x, float _y, float _z, float _w) :
+            x(_x), y(_y), z(_z), w(_w) {}
+    };
+
+    struct Matrix
+    {
+        union
+        {
+            struct
+            {
+                float _11, _12, _13, _14;
+                float _21, _22, _23, _24;
+                float _31, _32, _33, _34;
+                float _41, _42, _43, _44;
+            };
+            float m[4][4];
+        };
+
+        Matrix() :
+            Matrix(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f) {}
+
+        Matrix(
+            float m00, float m01, float m02, float m03,
+            float m10, float m11, float m12, float m13,
+            float m20, float m21, float m22, float m23,
+            float m30, float m31, float m32, float m33) :
+            _11(m00), _12(m01), _13(m02), _14(m03),
+            _21(m10), _22(m11), _23(m12), _24(m13),
+            _31(m20), _32(m21), _33(m22), _34(m23),
+            _41(m30), _42(m31), _43(m32), _44(m33) {}
+
+        void Transpose(Matrix& result) const
+        {
+            Matrix t;
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    t.m[i][j] = m[j][i];
+                }
+            }
+            result = t;
+        }
+
+        Matrix Transpose() const
+        {
+            Matrix t;
+            Transpose(t);
+            return t;
+        }
+
+        static const Matrix Identity;
+    };
+
+    inline const Matrix Matrix::Identity;
+
+    inline Matrix operator*(const Matrix& a, const Matrix& b)
+    {
+        Matrix result;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+            }
+        }
+        return result;
+    }
+}
+}
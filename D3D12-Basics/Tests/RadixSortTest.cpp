@@ -0,0 +1,201 @@
+#include "Test.h"
+
+#include "Generic/RadixSort.h"
+#include "Renderer/DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Passes SortKeyValues will actually do, one per byte where the keys don't all have the same digit
+static uint32 sNumPasses(
+    const std::vector<uint64>& keys)
+{
+    uint32 numPasses = 0;
+    for (uint32 pass = 0; pass < 8; pass++)
+    {
+        for (uint64 key : keys)
+        {
+            if (((key ^ keys[0]) >> (pass * 8)) & 0xFF)
+            {
+                numPasses++;
+                break;
+            }
+        }
+    }
+    return numPasses;
+}
+
+// Sorts keys with each one's position as its value and checks against std::stable_sort, so equal keys have to keep their order
+static void sSortCheck(
+    const std::vector<uint64>& keys,
+    uint32 expectedPasses)
+{
+    uint32 count = (uint32)keys.size();
+    CHECK(count == 0 || sNumPasses(keys) == expectedPasses);
+
+    std::vector<std::pair<uint64, uint32>> expected(count);
+    for (uint32 i = 0; i < count; i++)
+    {
+        expected[i] = { keys[i], i };
+    }
+    std::stable_sort(expected.begin(), expected.end(), [](const std::pair<uint64, uint32>& a, const std::pair<uint64, uint32>& b)
+    {
+        return a.first < b.first;
+    });
+
+    // One past the end of each array has to be left alone
+    std::vector<uint64> sortedKeys(keys);
+    std::vector<uint32> values(count);
+    for (uint32 i = 0; i < count; i++)
+    {
+        values[i] = i;
+    }
+    std::vector<uint64> tempKeys(count + 1, 0xDEADBEEF);
+    std::vector<uint32> tempValues(count + 1, 0xDEADBEEF);
+    sortedKeys.push_back(0xDEADBEEF);
+    values.push_back(0xDEADBEEF);
+
+    RadixSort::SortKeyValues(sortedKeys.data(), values.data(), tempKeys.data(), tempValues.data(), count);
+
+    for (uint32 i = 0; i < count; i++)
+    {
+        CHECK(sortedKeys[i] == expected[i].first);
+        CHECK(values[i] == expected[i].second);
+    }
+    CHECK(sortedKeys[count] == 0xDEADBEEF && values[count] == 0xDEADBEEF);
+    CHECK(tempKeys[count] == 0xDEADBEEF && tempValues[count] == 0xDEADBEEF);
+}
+
+// Keys with random digits in the given bytes and a fixed pattern in the rest, which every key shares so those passes are skipped.
+// Digits come from a small range so there are plenty of duplicates to test stability with.
+static std::vector<uint64> sKeysMake(
+    std::mt19937& rng,
+    uint32 count,
+    std::initializer_list<uint32> randomBytes,
+    uint32 numDigits)
+{
+    std::vector<uint64> keys(count, 0x0123456789ABCDEFull);
+    for (uint64& key : keys)
+    {
+        for (uint32 byte : randomBytes)
+        {
+            key &= ~(0xFFull << (byte * 8));
+            key |= (uint64)(rng() % numDigits) << (byte * 8);
+        }
+    }
+
+    // Makes sure every random byte really does differ, so the pass count is what the caller expects
+    if (count > 1)
+    {
+        for (uint32 byte : randomBytes)
+        {
+            keys[0] &= ~(0xFFull << (byte * 8));
+            keys[1] |= 0x1ull << (byte * 8);
+        }
+    }
+    return keys;
+}
+
+static void sTestRadixSort(
+    void)
+{
+    std::mt19937 rng(1);
+
+    sSortCheck({}, 0);
+    sSortCheck({ 42 }, 0);
+
+    for (uint32 count : { 2u, 100u, 5000u })
+    {
+        // Every key the same, every pass is skipped
+        sSortCheck(std::vector<uint64>(count, 7), 0);
+
+        // Odd numbers of passes leave the result in the temp arrays, which has to be copied back
+        sSortCheck(sKeysMake(rng, count, { 0 }, 16), 1);
+        sSortCheck(sKeysMake(rng, count, { 7 }, 4), 1);
+        sSortCheck(sKeysMake(rng, count, { 0, 3, 6 }, 8), 3);
+        sSortCheck(sKeysMake(rng, count, { 1, 2, 3, 4, 5, 6, 7 }, 256), 7);
+
+        // Even numbers finish back in the original arrays, with and without skipped passes in between
+        sSortCheck(sKeysMake(rng, count, { 0, 1 }, 256), 2);
+        sSortCheck(sKeysMake(rng, count, { 2, 5 }, 3), 2);
+        sSortCheck(sKeysMake(rng, count, { 0, 1, 2, 3, 4, 5, 6, 7 }, 256), 8);
+    }
+
+    // Fully random 64 bit keys
+    std::vector<uint64> keys(20000);
+    for (uint64& key : keys)
+    {
+        key = ((uint64)rng() << 32) | rng();
+    }
+    sSortCheck(keys, 8);
+}
+
+// Keys order by pipeline, then material, then geometry, then nearest first, and Sort counts the changes between consecutive draws
+static void sTestDrawList(
+    void)
+{
+    CHECK(DrawList::MakeKey(1, 0, 0, 0.0f) > DrawList::MakeKey(0, (1 << DRAW_KEY_MATERIAL_BITS) - 1, (1 << DRAW_KEY_GEOMETRY_BITS) - 1, 1e30f));
+    CHECK(DrawList::MakeKey(0, 1, 0, 0.0f) > DrawList::MakeKey(0, 0, (1 << DRAW_KEY_GEOMETRY_BITS) - 1, 1e30f));
+    CHECK(DrawList::MakeKey(0, 0, 1, 0.0f) > DrawList::MakeKey(0, 0, 0, 1e30f));
+    CHECK(DrawList::MakeKey(0, 0, 0, 2.0f) > DrawList::MakeKey(0, 0, 0, 1.0f));
+    CHECK(DrawList::MakeKey(0, 0, 0, 1.0f) > DrawList::MakeKey(0, 0, 0, 0.001f));
+    // Behind the camera clamps to the nearest
+    CHECK(DrawList::MakeKey(0, 0, 0, -5.0f) == DrawList::MakeKey(0, 0, 0, 0.0f));
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+
+    DrawList drawList;
+    std::vector<std::pair<uint64, uint32>> expected;
+    for (uint32 i = 0; i < 10000; i++)
+    {
+        uint64 key = DrawList::MakeKey(rng() % 3, rng() % 50, rng() % 200, depth(rng));
+        drawList.Add(key, i);
+        expected.push_back({ key, i });
+    }
+    std::stable_sort(expected.begin(), expected.end(), [](const std::pair<uint64, uint32>& a, const std::pair<uint64, uint32>& b)
+    {
+        return a.first < b.first;
+    });
+
+    DrawListStats stats;
+    drawList.Sort(stats);
+    CHECK(stats.numDraws == 10000);
+    CHECK(drawList.Size() == 10000);
+
+    uint32 pipelineChanges = 0;
+    uint32 materialChanges = 0;
+    uint32 geometryChanges = 0;
+    for (uint32 i = 0; i < drawList.Size(); i++)
+    {
+        CHECK(drawList.GetKey(i) == expected[i].first);
+        CHECK(drawList.GetIndex(i) == expected[i].second);
+        if (i > 0)
+        {
+            uint64 diff = drawList.GetKey(i) ^ drawList.GetKey(i - 1);
+            pipelineChanges += (diff >> DRAW_KEY_PIPELINE_SHIFT) != 0;
+            materialChanges += ((diff >> DRAW_KEY_MATERIAL_SHIFT) & ((1ull << DRAW_KEY_MATERIAL_BITS) - 1)) != 0;
+            geometryChanges += ((diff >> DRAW_KEY_GEOMETRY_SHIFT) & ((1ull << DRAW_KEY_GEOMETRY_BITS) - 1)) != 0;
+        }
+    }
+    CHECK(stats.pipelineChanges == pipelineChanges && pipelineChanges == 2);
+    CHECK(stats.materialChanges == materialChanges);
+    CHECK(stats.geometryChanges == geometryChanges);
+
+    // Clearing keeps nothing from the last frame
+    drawList.Clear();
+    CHECK(drawList.Size() == 0);
+    drawList.Sort(stats);
+    CHECK(stats.numDraws == 0 && stats.materialChanges == 0);
+}
+
+int main()
+{
+    sTestRadixSort();
+    sTestDrawList();
+
+    printf("RadixSortTest passed\n");
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "Test.h"
+
+#include "Generic/ConcurrentSlotMap.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// GEOMETRY_TABLE_CAPACITY
+#define TABLE_CAPACITY 65536
+#define NUM_HELD_PER_THREAD 1024
+#define NUM_OPERATIONS 4000000
+#define NUM_LOOKUPS 10000000
+
+enum VertexBufferID : int32
+{
+    VertexBufferIDInvalid = -1
+};
+
+struct VertexBuffer
+{
+    uint32 block = 0;
+    uint32 offset = 0;
+    uint32 count = 0;
+};
+
+// The SlotMap behind one mutex which D3D12Core used before the tables were made lock free
+class LockedTable
+{
+public:
+    VertexBufferID Insert(const VertexBuffer& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map.Insert(value);
+    }
+
+    void Remove(VertexBufferID id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.Remove(id);
+    }
+
+private:
+    SlotMap<VertexBufferID, VertexBuffer> m_map;
+    std::mutex m_mutex;
+};
+
+class LockFreeTable
+{
+public:
+    LockFreeTable() :
+        m_map(TABLE_CAPACITY) {}
+
+    VertexBufferID Insert(const VertexBuffer& value)
+    {
+        return m_map.Insert(value);
+    }
+
+    void Remove(VertexBufferID id)
+    {
+        m_map.Remove(id);
+    }
+
+private:
+    ConcurrentSlotMap<VertexBufferID, VertexBuffer> m_map;
+};
+
+// The tables as they were before slot maps, with IDs handed out in order and looked up by hashing
+class HashTable
+{
+public:
+    HashTable(uint32 capacity)
+    {
+        m_map.reserve(capacity);
+    }
+
+    VertexBufferID Insert(const VertexBuffer& value)
+    {
+        VertexBufferID id = (VertexBufferID)m_nextID++;
+        m_map.emplace(id, value);
+        return id;
+    }
+
+    VertexBuffer& Get(VertexBufferID id)
+    {
+        return m_map.find(id)->second;
+    }
+
+private:
+    std::unordered_map<VertexBufferID, VertexBuffer> m_map;
+    int32 m_nextID = 0;
+};
+
+class SlotMapTable
+{
+public:
+    SlotMapTable(uint32) {}
+
+    VertexBufferID Insert(const VertexBuffer& value)
+    {
+        return m_map.Insert(value);
+    }
+
+    VertexBuffer& Get(VertexBufferID id)
+    {
+        return m_map.Get(id);
+    }
+
+private:
+    SlotMap<VertexBufferID, VertexBuffer> m_map;
+};
+
+class ConcurrentSlotMapTable
+{
+public:
+    ConcurrentSlotMapTable(uint32 capacity) :
+        m_map(capacity) {}
+
+    VertexBufferID Insert(const VertexBuffer& value)
+    {
+        return m_map.Insert(value);
+    }
+
+    VertexBuffer& Get(VertexBufferID id)
+    {
+        return m_map.Get(id);
+    }
+
+private:
+    ConcurrentSlotMap<VertexBufferID, VertexBuffer> m_map;
+};
+
+// Fills a table with numHandles entries then does NUM_LOOKUPS lookups on one thread, walking the handles in a shuffled order so
+// they miss the cache the way draws looking up their buffers do. Returns ns per lookup.
+template <typename Table>
+static double sLookupRun(uint32 numHandles)
+{
+    Table table(numHandles);
+    std::vector<VertexBufferID> ids(numHandles);
+    for (uint32 i = 0; i < numHandles; i++)
+    {
+        ids[i] = table.Insert({ 0, i, 3 });
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+
+    uint64 sum = 0;
+    Timer timer;
+    for (uint32 i = 0; i < NUM_LOOKUPS; i++)
+    {
+        sum += table.Get(ids[i % numHandles]).offset;
+    }
+    double ms = timer.ElapsedMs();
+
+    // Uses the sum so the lookups can't be optimised away
+    uint64 expected = (uint64)(NUM_LOOKUPS / numHandles) * numHandles * (numHandles - 1) / 2;
+    CHECK(sum == expected);
+    return ms * 1e6 / NUM_LOOKUPS;
+}
+
+// Every thread holds NUM_HELD_PER_THREAD handles and replaces them round robin, NUM_OPERATIONS insert/remove pairs split between them
+template <typename Table>
+static double sRun(uint32 numThreads)
+{
+    Table table;
+
+    Timer timer;
+    std::vector<std::thread> threads;
+    for (uint32 t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&table, numThreads]()
+        {
+            std::vector<VertexBufferID> held(NUM_HELD_PER_THREAD);
+            for (VertexBufferID& id : held)
+            {
+                id = table.Insert(VertexBuffer());
+            }
+
+            for (uint32 i = 0; i < NUM_OPERATIONS / numThreads; i++)
+            {
+                VertexBufferID& id = held[i % NUM_HELD_PER_THREAD];
+                table.Remove(id);
+                id = table.Insert({ 0, i, 3 });
+            }
+
+            for (VertexBufferID id : held)
+            {
+                table.Remove(id);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return timer.ElapsedMs();
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    printf("threads  locked SlotMap  ConcurrentSlotMap  (ns per insert/remove pair)\n");
+    for (uint32 numThreads = 1; numThreads <= 32; numThreads *= 2)
+    {
+        double lockedMs = sRun<LockedTable>(numThreads);
+        double lockFreeMs = sRun<LockFreeTable>(numThreads);
+        printf("%7u  %14.1f  %17.1f\n", numThreads, lockedMs * 1e6 / NUM_OPERATIONS, lockFreeMs * 1e6 / NUM_OPERATIONS);
+    }
+
+    printf("\nhandles  unordered_map  SlotMap  ConcurrentSlotMap  (ns per shuffled lookup)\n");
+    for (uint32 numHandles : { 10000u, 100000u, 1000000u })
+    {
+        double hashNs = sLookupRun<HashTable>(numHandles);
+        double slotMapNs = sLookupRun<SlotMapTable>(numHandles);
+        double concurrentNs = sLookupRun<ConcurrentSlotMapTable>(numHandles);
+        printf("%7u  %13.1f  %7.1f  %17.1f\n", numHandles, hashNs, slotMapNs, concurrentNs);
+    }
+    return 0;
+}
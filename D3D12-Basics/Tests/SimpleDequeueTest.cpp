@@ -0,0 +1,292 @@
+#include "Test.h"
+
+#include "Generic/IDAllocator.h"
+
+#include <deque>
+#include <random>
+
+template <typename T, uint32 InlineCapacity>
+static void sCheckEqual(
+    const SimpleDequeue<T, InlineCapacity>& dequeue,
+    const std::deque<T>& expected)
+{
+    // Copies so popping doesn't disturb either side
+    SimpleDequeue<T, InlineCapacity> copy(dequeue);
+    CHECK(copy.Size() == expected.size());
+    for (T value : expected)
+    {
+        CHECK(!copy.IsEmpty());
+        CHECK(copy.PopFront() == value);
+    }
+    CHECK(copy.IsEmpty());
+}
+
+// Pushing at the front from empty wraps the head straight round to the end of the array, and pushing at the back after popping the
+// front wraps the tail round to the start
+template <uint32 InlineCapacity>
+static void sTestWraparound(
+    void)
+{
+    SimpleDequeue<uint32, InlineCapacity> dequeue;
+    std::deque<uint32> expected;
+
+    for (uint32 i = 0; i < 3; i++)
+    {
+        dequeue.PushFront(i);
+        expected.push_front(i);
+    }
+    sCheckEqual(dequeue, expected);
+
+    for (uint32 i = 0; i < 2; i++)
+    {
+        CHECK(dequeue.PopBack() == expected.back());
+        expected.pop_back();
+    }
+
+    // Round and round the same array many times from both ends
+    for (uint32 i = 0; i < 1000; i++)
+    {
+        dequeue.PushBack(100 + i);
+        expected.push_back(100 + i);
+        CHECK(dequeue.PopFront() == expected.front());
+        expected.pop_front();
+
+        dequeue.PushFront(5000 + i);
+        expected.push_front(5000 + i);
+        CHECK(dequeue.PopBack() == expected.back());
+        expected.pop_back();
+    }
+    sCheckEqual(dequeue, expected);
+}
+
+// Fills the array with the head part way along so the values wrap, then pushes one more at each end so it grows while wrapped.
+// The values have to come out in the same order once they're unwrapped into the new array.
+template <uint32 InlineCapacity>
+static void sTestGrowWhileWrapped(
+    void)
+{
+    SimpleDequeue<uint32, InlineCapacity> dequeue;
+    std::deque<uint32> expected;
+
+    // The first heap array holds 16 if there's no inline storage
+    uint32 capacity = InlineCapacity > 0 ? InlineCapacity : 16;
+    for (uint32 i = 0; i < capacity / 2; i++)
+    {
+        dequeue.PushBack(i);
+        expected.push_back(i);
+    }
+    for (uint32 i = 0; i < capacity / 4; i++)
+    {
+        CHECK(dequeue.PopFront() == expected.front());
+        expected.pop_front();
+    }
+    for (uint32 i = 0; (uint32)expected.size() < capacity; i++)
+    {
+        dequeue.PushBack(1000 + i);
+        expected.push_back(1000 + i);
+    }
+    sCheckEqual(dequeue, expected);
+
+    dequeue.PushBack(2000);
+    expected.push_back(2000);
+    dequeue.PushFront(3000);
+    expected.push_front(3000);
+    sCheckEqual(dequeue, expected);
+
+    // Grows a few more times from the front
+    for (uint32 i = 0; i < capacity * 8; i++)
+    {
+        dequeue.PushFront(4000 + i);
+        expected.push_front(4000 + i);
+    }
+    sCheckEqual(dequeue, expected);
+}
+
+// Up to InlineCapacity values stay inline, the next one moves them all to the heap, and popping back down keeps working out of the
+// heap array
+static void sTestInlineToHeap(
+    void)
+{
+    SimpleDequeue<uint32, 4> dequeue;
+    std::deque<uint32> expected;
+    for (uint32 i = 0; i < 4; i++)
+    {
+        dequeue.PushBack(i);
+        expected.push_back(i);
+    }
+    CHECK(dequeue.PopFront() == 0);
+    expected.pop_front();
+    dequeue.PushBack(4);
+    expected.push_back(4);
+    sCheckEqual(dequeue, expected);
+
+    // Wrapped and full inline, this one goes to the heap
+    dequeue.PushFront(5);
+    expected.push_front(5);
+    sCheckEqual(dequeue, expected);
+
+    while (!expected.empty())
+    {
+        CHECK(dequeue.PopBack() == expected.back());
+        expected.pop_back();
+    }
+    CHECK(dequeue.IsEmpty());
+    CHECK(dequeue.Size() == 0);
+
+    dequeue.PushFront(6);
+    CHECK(dequeue.Size() == 1);
+    CHECK(dequeue.PopFront() == 6);
+}
+
+// Copies have to be independent of the original, whether it's inline, on the heap, or wrapped
+template <uint32 InlineCapacity>
+static void sTestCopy(
+    void)
+{
+    for (uint32 count : { 0u, 1u, 3u, 4u, 5u, 40u })
+    {
+        SimpleDequeue<uint32, InlineCapacity> original;
+        std::deque<uint32> expected;
+        for (uint32 i = 0; i < count; i++)
+        {
+            // Alternating ends so anything over one value wraps
+            if (i & 1)
+            {
+                original.PushFront(i);
+                expected.push_front(i);
+            }
+            else
+            {
+                original.PushBack(i);
+                expected.push_back(i);
+            }
+        }
+
+        SimpleDequeue<uint32, InlineCapacity> copy(original);
+        sCheckEqual(copy, expected);
+
+        // Changing the copy leaves the original alone
+        copy.PushBack(999);
+        copy.PushFront(998);
+        sCheckEqual(original, expected);
+
+        // Assigning over a bigger dequeue on the heap, a smaller one, an empty one, and itself
+        for (uint32 targetCount : { 0u, 2u, 100u })
+        {
+            SimpleDequeue<uint32, InlineCapacity> target;
+            for (uint32 i = 0; i < targetCount; i++)
+            {
+                target.PushFront(500 + i);
+            }
+            target = original;
+            sCheckEqual(target, expected);
+
+            target.PushBack(777);
+            sCheckEqual(original, expected);
+        }
+
+        SimpleDequeue<uint32, InlineCapacity>& self = copy;
+        copy = self;
+        CHECK(copy.Size() == count + 2);
+        CHECK(copy.PopFront() == 998);
+        CHECK(copy.PopBack() == 999);
+        sCheckEqual(copy, expected);
+    }
+}
+
+// Random pushes and pops at both ends against std::deque
+template <uint32 InlineCapacity>
+static void sTestRandom(
+    void)
+{
+    std::mt19937 rng(1);
+    SimpleDequeue<uint32, InlineCapacity> dequeue;
+    std::deque<uint32> expected;
+    for (uint32 i = 0; i < 200000; i++)
+    {
+        // Pushes slightly more often than pops so it grows slowly through several capacities
+        uint32 op = rng() % 9;
+        if (op < 5 || expected.empty())
+        {
+            if (op & 1)
+            {
+                dequeue.PushFront(i);
+                expected.push_front(i);
+            }
+            else
+            {
+                dequeue.PushBack(i);
+                expected.push_back(i);
+            }
+        }
+        else if (op & 1)
+        {
+            CHECK(dequeue.PopFront() == expected.front());
+            expected.pop_front();
+        }
+        else
+        {
+            CHECK(dequeue.PopBack() == expected.back());
+            expected.pop_back();
+        }
+        CHECK(dequeue.Size() == expected.size());
+        CHECK(dequeue.IsEmpty() == expected.empty());
+    }
+    sCheckEqual(dequeue, expected);
+}
+
+enum TestID : int32
+{
+    TestIDInvalid = -1
+};
+
+// IsEmpty used to be inverted, and AllocID inverted it back. Freed IDs have to be reused, most recently freed first, and new ones
+// only handed out once there are none, including past the freed IDs kept inline.
+static void sTestIDAllocator(
+    void)
+{
+    IDAllocator<TestID> allocator((TestID)10);
+    CHECK(allocator.AllocID() == 10);
+    CHECK(allocator.AllocID() == 11);
+    CHECK(allocator.AllocID() == 12);
+
+    allocator.FreeID((TestID)11);
+    CHECK(allocator.AllocID() == 11);
+    CHECK(allocator.AllocID() == 13);
+
+    const uint32 numIDs = ID_ALLOCATOR_INLINE_FREE_IDS * 3;
+    std::vector<TestID> ids;
+    for (uint32 i = 0; i < numIDs; i++)
+    {
+        ids.push_back(allocator.AllocID());
+        CHECK(ids.back() == (TestID)(14 + i));
+    }
+    for (TestID id : ids)
+    {
+        allocator.FreeID(id);
+    }
+    for (uint32 i = 0; i < numIDs; i++)
+    {
+        CHECK(allocator.AllocID() == ids[numIDs - 1 - i]);
+    }
+    CHECK(allocator.AllocID() == (TestID)(14 + numIDs));
+}
+
+int main()
+{
+    sTestWraparound<0>();
+    sTestWraparound<4>();
+    sTestWraparound<16>();
+    sTestGrowWhileWrapped<0>();
+    sTestGrowWhileWrapped<4>();
+    sTestGrowWhileWrapped<16>();
+    sTestInlineToHeap();
+    sTestCopy<0>();
+    sTestCopy<4>();
+    sTestRandom<0>();
+    sTestRandom<4>();
+    sTestIDAllocator();
+
+    printf("SimpleDequeueTest passed\n");
+    return 0;
+}
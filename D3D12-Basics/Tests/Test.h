@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Unlike ASSERT this is checked in every build, and fails the test rather than breaking into a debugger
+#define CHECK(x) \
+    do \
+    { \
+        if (!(x)) \
+        { \
+            printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #x); \
+            exit(1); \
+        } \
+    } while (0)
+
+class Timer
+{
+public:
+    Timer() :
+        m_start(std::chrono::steady_clock::now()) {}
+
+    double ElapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+// Stands in for EnginePCH.h, without windows.h
+
+#include "Types.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <SimpleMath.h>
+
+typedef DirectX::SimpleMath::Matrix Matrix4x4;
+typedef DirectX::SimpleMath::Vector4 Vector4;
+typedef DirectX::SimpleMath::Vector3 Vector3;
+typedef DirectX::SimpleMath::Vector2 Vector2;
+
+#define F_PI 3.14159265358979323846264338327950288f
+#define F_DEG_TO_RAD (F_PI / 180.f)
+
+#define _KB(x) (x * 1024)
+#define _MB(x) (x * 1024 * 1024)
+
+#define _64KB _KB(64)
+#define _1MB _MB(1)
+#define _64MB _MB(64)
+
+#define _countof(x) (sizeof(x) / sizeof((x)[0]))
+
+#ifdef ASSERTIONS_ENABLED
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(X)
+#endif
+
+#include "Generic/Utils.h"
@@ -0,0 +1,289 @@
+#include "Test.h"
+
+#include "Renderer/Core/UploadContext.h"
+
+#include <algorithm>
+#include <vector>
+
+// Only ever compared, never dereferenced
+#define DIRECT_QUEUE reinterpret_cast<ID3D12CommandQueue*>(0x1000)
+#define COMPUTE_QUEUE reinterpret_cast<ID3D12CommandQueue*>(0x2000)
+#define CMD_LIST reinterpret_cast<ID3D12GraphicsCommandList*>(0x3000)
+
+enum UploadCallType
+{
+    UploadCallBatchBegin,
+    UploadCallBatchSubmit,
+    UploadCallQueueWait,
+    UploadCallFenceWait,
+};
+
+struct UploadCall
+{
+    UploadCallType type;
+    uint32 batch;
+    uint64 fenceValue;
+    ID3D12CommandQueue* pQueue;
+};
+
+// Keeps every call in order instead of touching a GPU. The fence only moves when the test says the copy queue has got that far, or
+// when something blocks on it.
+class RecordingUploadQueue : public UploadQueue
+{
+public:
+    ID3D12GraphicsCommandList* BatchBegin(
+        uint32 batch) override
+    {
+        // The allocator mustn't still be in use by the GPU, and only one batch is open at a time
+        CHECK(batch < UPLOAD_CONTEXT_NUM_BATCHES);
+        CHECK(m_completedValue >= m_allocatorSyncPoints[batch]);
+        CHECK(!m_fOpen);
+        m_fOpen = true;
+        m_openBatch = batch;
+
+        calls.push_back({ UploadCallBatchBegin, batch, 0, nullptr });
+        return CMD_LIST;
+    }
+
+    void BatchSubmit(
+        uint32 batch,
+        uint64 fenceValue) override
+    {
+        CHECK(m_fOpen && batch == m_openBatch);
+        CHECK(fenceValue > m_signalledValue);
+        m_fOpen = false;
+        m_signalledValue = fenceValue;
+        m_allocatorSyncPoints[batch] = fenceValue;
+
+        calls.push_back({ UploadCallBatchSubmit, batch, fenceValue, nullptr });
+    }
+
+    void QueueWait(
+        ID3D12CommandQueue* pQueue,
+        uint64 fenceValue) override
+    {
+        CHECK(fenceValue <= m_signalledValue);
+        calls.push_back({ UploadCallQueueWait, 0, fenceValue, pQueue });
+    }
+
+    uint64 GetFenceCompletedValue(
+        void) override
+    {
+        return m_completedValue;
+    }
+
+    void FenceWait(
+        uint64 fenceValue) override
+    {
+        // Would block forever on a value which is never signalled
+        CHECK(fenceValue <= m_signalledValue);
+        m_completedValue = std::max(m_completedValue, fenceValue);
+        calls.push_back({ UploadCallFenceWait, 0, fenceValue, nullptr });
+    }
+
+    // The copy queue has finished everything up to fenceValue
+    void Complete(
+        uint64 fenceValue)
+    {
+        CHECK(fenceValue <= m_signalledValue);
+        m_completedValue = std::max(m_completedValue, fenceValue);
+    }
+
+    // Returns the calls made since last time
+    std::vector<UploadCall> Take(
+        void)
+    {
+        std::vector<UploadCall> taken;
+        taken.swap(calls);
+        return taken;
+    }
+
+    std::vector<UploadCall> calls;
+
+private:
+    uint64 m_allocatorSyncPoints[UPLOAD_CONTEXT_NUM_BATCHES] = {};
+    uint64 m_signalledValue = 0;
+    uint64 m_completedValue = 0;
+    uint32 m_openBatch = 0;
+    bool m_fOpen = false;
+};
+
+static bool sCallIs(
+    const UploadCall& call,
+    UploadCallType type,
+    uint32 batch,
+    uint64 fenceValue)
+{
+    return call.type == type && call.batch == batch && call.fenceValue == fenceValue;
+}
+
+// Records a batch and flushes it, returning the calls that made
+static std::vector<UploadCall> sBatchRecord(
+    UploadContext& context,
+    RecordingUploadQueue& queue)
+{
+    CHECK(context.GetCmdList() == CMD_LIST);
+    // Asking again carries on with the same batch
+    CHECK(context.GetCmdList() == CMD_LIST);
+    context.Flush();
+    return queue.Take();
+}
+
+// Batches go round the allocators in order, only waiting when the GPU hasn't finished with the one up next
+static void sTestBatchRotation(
+    void)
+{
+    RecordingUploadQueue queue;
+    {
+        UploadContext context(&queue);
+
+        // Nothing recorded yet, so flushing submits nothing and the sync point stays 0
+        CHECK(context.Flush() == 0);
+        CHECK(queue.Take().empty());
+
+        // One batch per allocator, none of which has to wait
+        for (uint32 batch = 0; batch < UPLOAD_CONTEXT_NUM_BATCHES; batch++)
+        {
+            std::vector<UploadCall> calls = sBatchRecord(context, queue);
+            CHECK(calls.size() == 2);
+            CHECK(sCallIs(calls[0], UploadCallBatchBegin, batch, 0));
+            CHECK(sCallIs(calls[1], UploadCallBatchSubmit, batch, batch + 1));
+        }
+
+        // Back on the first allocator with its batch still in flight, so that has to finish first
+        std::vector<UploadCall> calls = sBatchRecord(context, queue);
+        CHECK(calls.size() == 3);
+        CHECK(sCallIs(calls[0], UploadCallFenceWait, 0, 1));
+        CHECK(sCallIs(calls[1], UploadCallBatchBegin, 0, 0));
+        CHECK(sCallIs(calls[2], UploadCallBatchSubmit, 0, UPLOAD_CONTEXT_NUM_BATCHES + 1));
+
+        // The GPU has already got past the other allocators' last batches, so no waits
+        queue.Complete(UPLOAD_CONTEXT_NUM_BATCHES);
+        for (uint32 batch = 1; batch < UPLOAD_CONTEXT_NUM_BATCHES; batch++)
+        {
+            calls = sBatchRecord(context, queue);
+            CHECK(calls.size() == 2);
+            CHECK(sCallIs(calls[0], UploadCallBatchBegin, batch, 0));
+            CHECK(sCallIs(calls[1], UploadCallBatchSubmit, batch, batch + UPLOAD_CONTEXT_NUM_BATCHES + 1));
+        }
+
+        // A long run of loads with the GPU never catching up waits on the batch from UPLOAD_CONTEXT_NUM_BATCHES ago each time
+        for (uint64 fenceValue = 2 * UPLOAD_CONTEXT_NUM_BATCHES + 1; fenceValue < 30; fenceValue++)
+        {
+            uint32 batch = (uint32)((fenceValue - 1) % UPLOAD_CONTEXT_NUM_BATCHES);
+            calls = sBatchRecord(context, queue);
+            CHECK(calls.size() == 3);
+            CHECK(sCallIs(calls[0], UploadCallFenceWait, 0, fenceValue - UPLOAD_CONTEXT_NUM_BATCHES));
+            CHECK(sCallIs(calls[1], UploadCallBatchBegin, batch, 0));
+            CHECK(sCallIs(calls[2], UploadCallBatchSubmit, batch, fenceValue));
+        }
+    }
+
+    // Going away waits for everything, but with nothing left to submit
+    std::vector<UploadCall> calls = queue.Take();
+    CHECK(calls.size() == 1);
+    CHECK(sCallIs(calls[0], UploadCallFenceWait, 0, 29));
+}
+
+// Flush hands back the sync point of the last batch submitted, and QueueWait only waits on a queue for batches it isn't already
+// waiting for
+static void sTestFenceValues(
+    void)
+{
+    RecordingUploadQueue queue;
+    UploadContext context(&queue);
+
+    // Nothing submitted, so there's nothing to wait for
+    context.QueueWait(DIRECT_QUEUE);
+    CHECK(queue.Take().empty());
+
+    context.GetCmdList();
+    CHECK(context.Flush() == 1);
+    CHECK(context.Flush() == 1);
+    queue.Take();
+
+    context.QueueWait(DIRECT_QUEUE);
+    std::vector<UploadCall> calls = queue.Take();
+    CHECK(calls.size() == 1);
+    CHECK(calls[0].type == UploadCallQueueWait && calls[0].fenceValue == 1 && calls[0].pQueue == DIRECT_QUEUE);
+
+    // Already waited for
+    context.QueueWait(DIRECT_QUEUE);
+    CHECK(queue.Take().empty());
+
+    // A batch that's still being recorded isn't waited for until it's flushed
+    context.GetCmdList();
+    context.QueueWait(DIRECT_QUEUE);
+    CHECK(queue.Take().size() == 1);
+    CHECK(context.Flush() == 2);
+    context.GetCmdList();
+    CHECK(context.Flush() == 3);
+    queue.Take();
+
+    // One wait covers both new batches
+    context.QueueWait(DIRECT_QUEUE);
+    calls = queue.Take();
+    CHECK(calls.size() == 1);
+    CHECK(calls[0].type == UploadCallQueueWait && calls[0].fenceValue == 3 && calls[0].pQueue == DIRECT_QUEUE);
+
+    // Waits aren't tracked per queue, so a second queue asking straight after gets nothing
+    context.QueueWait(COMPUTE_QUEUE);
+    CHECK(queue.Take().empty());
+
+    // Waiting never touches the CPU side fence
+    CHECK(queue.GetFenceCompletedValue() == 0);
+    queue.Complete(3);
+}
+
+// WaitForIdle submits whatever's being recorded, then blocks until the copy queue has done everything
+static void sTestWaitForIdle(
+    void)
+{
+    RecordingUploadQueue queue;
+    UploadContext context(&queue);
+
+    // Nothing submitted, so nothing to wait for
+    context.WaitForIdle();
+    CHECK(queue.Take().empty());
+
+    context.GetCmdList();
+    context.Flush();
+    context.GetCmdList();
+    queue.Take();
+
+    context.WaitForIdle();
+    std::vector<UploadCall> calls = queue.Take();
+    CHECK(calls.size() == 2);
+    CHECK(sCallIs(calls[0], UploadCallBatchSubmit, 1, 2));
+    CHECK(sCallIs(calls[1], UploadCallFenceWait, 0, 2));
+    CHECK(queue.GetFenceCompletedValue() == 2);
+
+    // Already idle
+    context.WaitForIdle();
+    CHECK(queue.Take().empty());
+
+    // Once the GPU has caught up by itself there's no need to block
+    context.GetCmdList();
+    context.Flush();
+    queue.Complete(3);
+    queue.Take();
+    context.WaitForIdle();
+    CHECK(queue.Take().empty());
+
+    // The next batch carries on round the allocators, and the one it lands on was freed by the wait
+    calls = sBatchRecord(context, queue);
+    CHECK(calls.size() == 2);
+    CHECK(sCallIs(calls[0], UploadCallBatchBegin, 0, 0));
+    CHECK(sCallIs(calls[1], UploadCallBatchSubmit, 0, 4));
+    queue.Complete(4);
+}
+
+int main()
+{
+    sTestBatchRotation();
+    sTestFenceValues();
+    sTestWaitForIdle();
+
+    printf("UploadContextTest passed\n");
+    return 0;
+}